@@ -0,0 +1,387 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+// Benchmark of the public clustering functions. Data sets are drawn from
+// a set of workloads with a fixed pseudo-random generator, so that every run
+// on every platform clusters the same points. Each workload is clustered with
+// `scc_sc_clustering` using every seed method (and several batch sizes for
+// `SCC_SM_BATCHES`), with type constraints when the workload has type labels,
+// and with `scc_hierarchical_clustering`.
+//
+// Results are printed as CSV, one line per run, with the fastest of
+// `BENCH_REPETITIONS` wall clock times and the phase times recorded with
+// `scc_set_clustering_profile`.
+//
+// Usage: bench_clustering.out [quick] [kdtree]
+//   quick   use one tenth of the data points
+//   kdtree  use kd-tree nearest neighbor search (`scc_set_kdtree_nn_search`)
+
+// Monotonic clock requires POSIX; must be set before any system header
+#define _POSIX_C_SOURCE 200112L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+
+#define BENCH_REPETITIONS 3
+#define BENCH_SEED 20170101u
+
+
+// =============================================================================
+// Data generators
+// =============================================================================
+
+typedef enum bench_Generator {
+	BENCH_UNIFORM,
+	BENCH_GAUSSIAN_MIXTURE,
+	BENCH_DUPLICATES,
+} bench_Generator;
+
+
+typedef struct bench_Workload {
+	const char* name;
+	bench_Generator generator;
+	uint64_t num_data_points;
+	uint32_t num_dimensions;
+	// Number of mixture components or distinct locations
+	uint32_t num_centers;
+	// Number of types; zero if no type labels
+	uint32_t num_types;
+} bench_Workload;
+
+
+// xorshift64* generator; gives the same sequence on all platforms
+static uint64_t bench_rng_state;
+
+
+static uint64_t bench_rand_u64(void)
+{
+	bench_rng_state ^= bench_rng_state >> 12;
+	bench_rng_state ^= bench_rng_state << 25;
+	bench_rng_state ^= bench_rng_state >> 27;
+	return bench_rng_state * UINT64_C(2685821657736338717);
+}
+
+
+// Uniform on [0, 1)
+static double bench_rand_unif(void)
+{
+	return ((double) (bench_rand_u64() >> 11)) * (1.0 / 9007199254740992.0);
+}
+
+
+// Standard normal with the Box-Muller transform
+static double bench_rand_normal(void)
+{
+	const double u1 = 1.0 - bench_rand_unif();
+	const double u2 = bench_rand_unif();
+	return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+
+static void bench_generate(const bench_Workload* const workload,
+                           double* const data,
+                           scc_TypeLabel* const type_labels)
+{
+	bench_rng_state = BENCH_SEED;
+	const uint64_t n = workload->num_data_points;
+	const uint32_t d = workload->num_dimensions;
+
+	double* centers = NULL;
+	if (workload->generator != BENCH_UNIFORM) {
+		centers = malloc(sizeof(double[workload->num_centers * d]));
+		if (centers == NULL) exit(1);
+		for (size_t i = 0; i < (size_t) workload->num_centers * d; ++i) {
+			centers[i] = 100.0 * bench_rand_unif();
+		}
+	}
+
+	for (uint64_t i = 0; i < n; ++i) {
+		double* const row = data + i * d;
+		if (workload->generator == BENCH_UNIFORM) {
+			for (uint32_t j = 0; j < d; ++j) {
+				row[j] = 100.0 * bench_rand_unif();
+			}
+		} else {
+			const size_t c = (size_t) (bench_rand_u64() % workload->num_centers);
+			for (uint32_t j = 0; j < d; ++j) {
+				row[j] = centers[c * d + j];
+				if (workload->generator == BENCH_GAUSSIAN_MIXTURE) {
+					row[j] += 3.0 * bench_rand_normal();
+				}
+			}
+		}
+	}
+
+	// Skewed types: 90%, 9% and 1% of the points for three types, etc.
+	if (workload->num_types > 0) {
+		for (uint64_t i = 0; i < n; ++i) {
+			const double u = bench_rand_unif();
+			uint32_t type = 0;
+			for (double share = 0.1; (u < share) && (type + 1 < workload->num_types); share *= 0.1) {
+				++type;
+			}
+			type_labels[i] = (scc_TypeLabel) type;
+		}
+	}
+
+	free(centers);
+}
+
+
+// =============================================================================
+// Timing
+// =============================================================================
+
+static double bench_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec) + 1e-9 * ((double) ts.tv_nsec);
+}
+
+
+static const char* bench_seed_method_name(const scc_SeedMethod seed_method)
+{
+	switch (seed_method) {
+		case SCC_SM_LEXICAL: return "lexical";
+		case SCC_SM_BATCHES: return "batches";
+		case SCC_SM_INWARDS_ORDER: return "inwards_order";
+		case SCC_SM_INWARDS_UPDATING: return "inwards_updating";
+		case SCC_SM_EXCLUSION_ORDER: return "exclusion_order";
+		case SCC_SM_EXCLUSION_UPDATING: return "exclusion_updating";
+		case SCC_SM_EXCLUSION_ORDER_IMPLICIT: return "exclusion_order_implicit";
+		case SCC_SM_EXCLUSION_UPDATING_IMPLICIT: return "exclusion_updating_implicit";
+		case SCC_SM_PARALLEL_MIS: return "parallel_mis";
+		default: return "unknown";
+	}
+}
+
+
+static void bench_print_header(void)
+{
+	printf("version,search,threads,workload,n,d,types,function,seed_method,size_constraint,batch_size,"
+	       "status,num_clusters,seconds,nng,type_union,seeds,radius,assign,other,nn_queries,dist_evaluations,peak_scratch_bytes\n");
+}
+
+
+// Runs `scc_sc_clustering` (if `options != NULL`) or `scc_hierarchical_clustering`, and prints a CSV line
+static void bench_run(const char* const search,
+                      const bench_Workload* const workload,
+                      scc_DataSet* const data_set,
+                      const scc_ClusterOptions* const options,
+                      const uint32_t size_constraint,
+                      const bool batch_assign)
+{
+	const size_t n = (size_t) workload->num_data_points;
+	double best_seconds = HUGE_VAL;
+	scc_ClusteringProfile best_profile;
+	memset(&best_profile, 0, sizeof(scc_ClusteringProfile));
+	scc_ErrorCode ec = SCC_ER_OK;
+	size_t num_clusters = 0;
+
+	for (int r = 0; r < BENCH_REPETITIONS; ++r) {
+		scc_Clustering* clustering;
+		if (scc_init_empty_clustering(n, NULL, &clustering) != SCC_ER_OK) exit(1);
+
+		scc_ClusteringProfile profile;
+		scc_set_clustering_profile(&profile);
+		const double start = bench_time();
+		if (options != NULL) {
+			ec = scc_sc_clustering(data_set, options, clustering);
+		} else {
+			ec = scc_hierarchical_clustering(data_set, size_constraint, batch_assign, clustering);
+		}
+		const double seconds = bench_time() - start;
+		scc_set_clustering_profile(NULL);
+
+		if (ec == SCC_ER_OK) {
+			uint64_t num_data_points;
+			uint64_t nc;
+			if (scc_get_clustering_info(clustering, &num_data_points, &nc) != SCC_ER_OK) exit(1);
+			num_clusters = (size_t) nc;
+		}
+		scc_free_clustering(&clustering);
+
+		if (seconds < best_seconds) {
+			best_seconds = seconds;
+			if (options != NULL) best_profile = profile;
+		}
+		if (ec != SCC_ER_OK) break;
+	}
+
+	uint32_t major, minor, patch;
+	scc_get_compiled_version(&major, &minor, &patch);
+
+	uint64_t nn_queries = 0;
+	uint64_t dist_evaluations = 0;
+	uint64_t peak_scratch_bytes = 0;
+	for (int p = 0; p < SCC_PH_NUM_PHASES; ++p) {
+		nn_queries += best_profile.phases[p].nn_queries;
+		dist_evaluations += best_profile.phases[p].dist_evaluations;
+		if (peak_scratch_bytes < best_profile.phases[p].peak_scratch_bytes) {
+			peak_scratch_bytes = best_profile.phases[p].peak_scratch_bytes;
+		}
+	}
+
+	printf("%u.%u.%u,%s,%u,%s,%zu,%u,%u,%s,%s,%u,%u,%s,%zu,%.6f",
+	       major, minor, patch,
+	       search,
+	       scc_get_num_threads(),
+	       workload->name,
+	       n,
+	       workload->num_dimensions,
+	       (options != NULL) ? options->num_types : 0,
+	       (options != NULL) ? "sc_clustering" : (batch_assign ? "hierarchical_batch" : "hierarchical"),
+	       (options != NULL) ? bench_seed_method_name(options->seed_method) : "",
+	       size_constraint,
+	       (options != NULL) ? options->batch_size : 0,
+	       (ec == SCC_ER_OK) ? "ok" : "error",
+	       num_clusters,
+	       best_seconds);
+	for (int p = 0; p < SCC_PH_NUM_PHASES; ++p) {
+		printf(",%.6f", best_profile.phases[p].wall_time);
+	}
+	printf(",%llu,%llu,%llu\n",
+	       (unsigned long long) nn_queries,
+	       (unsigned long long) dist_evaluations,
+	       (unsigned long long) peak_scratch_bytes);
+	fflush(stdout);
+}
+
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(const int argc, char** const argv)
+{
+	bool quick = false;
+	const char* search = "default";
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "quick") == 0) {
+			quick = true;
+		} else if (strcmp(argv[i], "kdtree") == 0) {
+			if (!scc_set_kdtree_nn_search()) return 1;
+			search = "kdtree";
+		} else {
+			fprintf(stderr, "Usage: %s [quick] [kdtree]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const bench_Workload workloads[] = {
+		{ "uniform", BENCH_UNIFORM, 10000, 2, 0, 0 },
+		{ "uniform", BENCH_UNIFORM, 100000, 2, 0, 0 },
+		{ "uniform", BENCH_UNIFORM, 50000, 8, 0, 0 },
+		{ "gaussian_mixture", BENCH_GAUSSIAN_MIXTURE, 100000, 4, 20, 0 },
+		{ "high_dimensional", BENCH_GAUSSIAN_MIXTURE, 20000, 64, 20, 0 },
+		{ "duplicates", BENCH_DUPLICATES, 50000, 2, 500, 0 },
+		{ "skewed_types", BENCH_UNIFORM, 50000, 2, 0, 3 },
+	};
+	const size_t num_workloads = sizeof(workloads) / sizeof(workloads[0]);
+
+	const scc_SeedMethod seed_methods[] = {
+		SCC_SM_LEXICAL,
+		SCC_SM_INWARDS_ORDER,
+		SCC_SM_INWARDS_UPDATING,
+		SCC_SM_EXCLUSION_ORDER,
+		SCC_SM_EXCLUSION_UPDATING,
+		SCC_SM_EXCLUSION_ORDER_IMPLICIT,
+		SCC_SM_EXCLUSION_UPDATING_IMPLICIT,
+		SCC_SM_PARALLEL_MIS,
+	};
+	const size_t num_seed_methods = sizeof(seed_methods) / sizeof(seed_methods[0]);
+
+	const uint32_t size_constraints[] = { 2, 10 };
+	const size_t num_size_constraints = sizeof(size_constraints) / sizeof(size_constraints[0]);
+
+	// Zero is the default batch size
+	const uint32_t batch_sizes[] = { 100, 10000, 0 };
+	const size_t num_batch_sizes = sizeof(batch_sizes) / sizeof(batch_sizes[0]);
+
+	bench_print_header();
+
+	for (size_t w = 0; w < num_workloads; ++w) {
+		bench_Workload workload = workloads[w];
+		if (quick) workload.num_data_points /= 10;
+		const size_t n = (size_t) workload.num_data_points;
+		const uint32_t d = workload.num_dimensions;
+
+		double* const data = malloc(sizeof(double[n * d]));
+		scc_TypeLabel* const type_labels = malloc(sizeof(scc_TypeLabel[n]));
+		if ((data == NULL) || (type_labels == NULL)) return 1;
+		bench_generate(&workload, data, type_labels);
+
+		scc_DataSet* data_set;
+		if (scc_init_data_set(n, d, n * d, data, &data_set) != SCC_ER_OK) return 1;
+
+		for (size_t s = 0; s < num_size_constraints; ++s) {
+			const uint32_t size_constraint = size_constraints[s];
+
+			scc_ClusterOptions options = scc_get_default_options();
+			options.size_constraint = size_constraint;
+			options.primary_unassigned_method = SCC_UM_CLOSEST_SEED;
+
+			if (workload.num_types > 0) {
+				// At least one point of each of the two rarest types
+				uint32_t type_constraints[3] = { 0, 1, 1 };
+				options.num_types = workload.num_types;
+				options.type_constraints = type_constraints;
+				options.len_type_labels = n;
+				options.type_labels = type_labels;
+				options.seed_method = SCC_SM_LEXICAL;
+				bench_run(search, &workload, data_set, &options, size_constraint, false);
+				options.seed_method = SCC_SM_INWARDS_UPDATING;
+				bench_run(search, &workload, data_set, &options, size_constraint, false);
+				continue;
+			}
+
+			for (size_t m = 0; m < num_seed_methods; ++m) {
+				options.seed_method = seed_methods[m];
+				bench_run(search, &workload, data_set, &options, size_constraint, false);
+			}
+
+			// Batches cannot assign to the closest seed
+			options.seed_method = SCC_SM_BATCHES;
+			options.primary_unassigned_method = SCC_UM_ANY_NEIGHBOR;
+			for (size_t b = 0; b < num_batch_sizes; ++b) {
+				options.batch_size = batch_sizes[b];
+				bench_run(search, &workload, data_set, &options, size_constraint, false);
+			}
+
+			bench_run(search, &workload, data_set, NULL, size_constraint, false);
+			bench_run(search, &workload, data_set, NULL, size_constraint, true);
+		}
+
+		scc_free_data_set(&data_set);
+		free(data);
+		free(type_labels);
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+// Benchmark of blocks of distances. For each number of dimensions, a block of
+// distances is computed with `iscc_imp_get_dist_rows`, both with the tiled
+// path using cached norms and with the pairwise path (by hiding the norms),
+// and the time per distance and the speedup of the tiled path is printed.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <include/scclust.h>
+#include <src/data_set_struct.h>
+#include <src/dist_search_imp.h>
+
+#define BENCH_NUM_POINTS 2000
+#define BENCH_NUM_QUERIES 200
+#define BENCH_TARGET_VALUES 400000000.0
+
+
+static double bench_dist_rows(scc_DataSet* const data_set,
+                              const size_t repetitions,
+                              double* const output,
+                              double* const out_checksum)
+{
+	const clock_t start = clock();
+	for (size_t r = 0; r < repetitions; ++r) {
+		iscc_imp_get_dist_rows(data_set, BENCH_NUM_QUERIES, NULL, BENCH_NUM_POINTS, NULL, output);
+	}
+	const clock_t stop = clock();
+
+	double checksum = 0.0;
+	for (size_t i = 0; i < BENCH_NUM_QUERIES * BENCH_NUM_POINTS; ++i) {
+		checksum += output[i];
+	}
+	*out_checksum = checksum;
+
+	const double num_dists = (double) (repetitions * BENCH_NUM_QUERIES * BENCH_NUM_POINTS);
+	return 1e9 * ((double) (stop - start)) / ((double) CLOCKS_PER_SEC) / num_dists;
+}
+
+
+int main(void)
+{
+	const uint32_t dimensions[] = { 16, 32, 64, 128, 256, 512 };
+	const size_t num_settings = sizeof(dimensions) / sizeof(dimensions[0]);
+
+	double* const data = malloc(sizeof(double[BENCH_NUM_POINTS * 512]));
+	double* const output = malloc(sizeof(double[BENCH_NUM_QUERIES * BENCH_NUM_POINTS]));
+	if (data == NULL || output == NULL) return 1;
+	srand(12345);
+	for (size_t i = 0; i < BENCH_NUM_POINTS * 512; ++i) {
+		data[i] = ((double) rand()) / ((double) RAND_MAX);
+	}
+
+	printf("%10s %10s %10s %8s\n", "dimensions", "pairwise", "tiled", "speedup");
+
+	for (size_t s = 0; s < num_settings; ++s) {
+		const uint32_t num_dimensions = dimensions[s];
+		size_t repetitions = (size_t) (BENCH_TARGET_VALUES / (double) (BENCH_NUM_QUERIES * BENCH_NUM_POINTS * num_dimensions));
+		if (repetitions == 0) repetitions = 1;
+
+		scc_DataSet* data_set;
+		if (scc_init_data_set(BENCH_NUM_POINTS, num_dimensions, BENCH_NUM_POINTS * 512, data, &data_set) != SCC_ER_OK) return 1;
+
+		double tiled_checksum;
+		const double tiled_ns = bench_dist_rows(data_set, repetitions, output, &tiled_checksum);
+
+		double* const sq_norms = data_set->sq_norms;
+		data_set->sq_norms = NULL;
+		double pairwise_checksum;
+		const double pairwise_ns = bench_dist_rows(data_set, repetitions, output, &pairwise_checksum);
+		data_set->sq_norms = sq_norms;
+
+		printf("%10u %8.2fns %8.2fns %7.2fx   (checksums %.6e %.6e)\n", num_dimensions, pairwise_ns, tiled_ns,
+		       pairwise_ns / tiled_ns, pairwise_checksum, tiled_checksum);
+
+		scc_free_data_set(&data_set);
+	}
+
+	free(data);
+	free(output);
+
+	return 0;
+}
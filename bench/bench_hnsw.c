@@ -0,0 +1,181 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+// Benchmark of approximate nearest neighbor search with HNSW graphs. For each
+// number of dimensions, the neighbors of some of the points in a clustered data
+// set are found with the brute-force search and with HNSW searches with
+// different `ef_search`, and the time of building the graph, the time per query
+// and the recall (the share of the exact neighbors that are found) is printed.
+// Finally, the wall clock time of building the graph with one thread and with
+// all threads (see `scc_set_num_threads`) is printed.
+
+// Monotonic clock requires POSIX; must be set before any system header
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+#include <src/dist_search_imp.h>
+
+#define BENCH_NUM_POINTS 10000
+#define BENCH_NUM_QUERIES 1000
+#define BENCH_NUM_CENTERS 50
+#define BENCH_K 10
+
+
+static double bench_seconds(const clock_t start,
+                            const clock_t stop)
+{
+	return ((double) (stop - start)) / ((double) CLOCKS_PER_SEC);
+}
+
+
+static double bench_wall_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec) + 1e-9 * ((double) ts.tv_nsec);
+}
+
+
+int main(void)
+{
+	const uint32_t dimensions[] = { 128, 256, 512 };
+	const size_t num_dimension_settings = sizeof(dimensions) / sizeof(dimensions[0]);
+	const uint32_t ef_values[] = { 16, 32, 64, 128 };
+	const size_t num_ef_settings = sizeof(ef_values) / sizeof(ef_values[0]);
+
+	double* const data = malloc(sizeof(double[BENCH_NUM_POINTS * 512]));
+	double* const centers = malloc(sizeof(double[BENCH_NUM_CENTERS * 512]));
+	scc_PointIndex* const queries = malloc(sizeof(scc_PointIndex[BENCH_NUM_QUERIES]));
+	scc_PointIndex* const ref_nn = malloc(sizeof(scc_PointIndex[BENCH_NUM_QUERIES * BENCH_K]));
+	scc_PointIndex* const hnsw_nn = malloc(sizeof(scc_PointIndex[BENCH_NUM_QUERIES * BENCH_K]));
+	if (data == NULL || centers == NULL || queries == NULL || ref_nn == NULL || hnsw_nn == NULL) return 1;
+
+	srand(12345);
+	for (size_t i = 0; i < BENCH_NUM_CENTERS * 512; ++i) {
+		centers[i] = ((double) rand()) / ((double) RAND_MAX);
+	}
+	for (size_t i = 0; i < BENCH_NUM_POINTS; ++i) {
+		const size_t center = ((size_t) rand()) % BENCH_NUM_CENTERS;
+		for (size_t d = 0; d < 512; ++d) {
+			data[i * 512 + d] = centers[center * 512 + d] + 0.2 * ((double) rand()) / ((double) RAND_MAX);
+		}
+	}
+	for (size_t q = 0; q < BENCH_NUM_QUERIES; ++q) {
+		queries[q] = (scc_PointIndex) ((q * 7919) % BENCH_NUM_POINTS);
+	}
+
+	printf("%10s %10s %10s %12s %8s %8s\n", "dimensions", "method", "build", "per query", "speedup", "recall");
+
+	for (size_t s = 0; s < num_dimension_settings; ++s) {
+		const uint32_t num_dimensions = dimensions[s];
+
+		// Points are rows of 512 values, of which the first `num_dimensions` are used
+		scc_DataSet* data_set;
+		if (scc_init_data_set(BENCH_NUM_POINTS, num_dimensions, BENCH_NUM_POINTS * 512, data, &data_set) != SCC_ER_OK) return 1;
+
+		size_t num_ok;
+		iscc_NNSearchObject* search;
+		clock_t start = clock();
+		if (!iscc_imp_init_nn_search_object(data_set, BENCH_NUM_POINTS, NULL, &search)) return 1;
+		if (!iscc_imp_nearest_neighbor_search(search, BENCH_NUM_QUERIES, queries, BENCH_K, false, 0.0, &num_ok, NULL, ref_nn)) return 1;
+		clock_t stop = clock();
+		iscc_imp_close_nn_search_object(&search);
+		const double ref_query_time = bench_seconds(start, stop) / BENCH_NUM_QUERIES;
+		printf("%10u %10s %9.3fs %10.1fus %7.2fx %8.4f\n", num_dimensions, "brute", 0.0,
+		       1e6 * ref_query_time, 1.0, 1.0);
+
+		for (size_t e = 0; e < num_ef_settings; ++e) {
+			if (!scc_set_hnsw_parameters(16, 100, ef_values[e])) return 1;
+
+			start = clock();
+			if (!iscc_imp_init_hnsw_nn_search_object(data_set, BENCH_NUM_POINTS, NULL, &search)) return 1;
+			const clock_t built = clock();
+			if (!iscc_imp_nearest_neighbor_search(search, BENCH_NUM_QUERIES, queries, BENCH_K, false, 0.0, &num_ok, NULL, hnsw_nn)) return 1;
+			stop = clock();
+			iscc_imp_close_nn_search_object(&search);
+
+			size_t num_found = 0;
+			for (size_t q = 0; q < BENCH_NUM_QUERIES; ++q) {
+				for (size_t i = 0; i < BENCH_K; ++i) {
+					for (size_t j = 0; j < BENCH_K; ++j) {
+						if (hnsw_nn[q * BENCH_K + i] == ref_nn[q * BENCH_K + j]) {
+							++num_found;
+							break;
+						}
+					}
+				}
+			}
+
+			const double query_time = bench_seconds(built, stop) / BENCH_NUM_QUERIES;
+			char method[16];
+			snprintf(method, sizeof(method), "ef=%u", ef_values[e]);
+			printf("%10u %10s %9.3fs %10.1fus %7.2fx %8.4f\n", num_dimensions, method, bench_seconds(start, built),
+			       1e6 * query_time, ref_query_time / query_time,
+			       ((double) num_found) / ((double) (BENCH_NUM_QUERIES * BENCH_K)));
+		}
+
+		scc_free_data_set(&data_set);
+	}
+
+	if (!scc_set_hnsw_parameters(16, 100, 64)) return 1;
+	scc_set_num_threads(0);
+	const uint32_t max_threads = scc_get_num_threads();
+	const uint32_t thread_settings[2] = { 1, max_threads };
+
+	printf("\n%10s %10s %10s %8s\n", "dimensions", "threads", "build", "speedup");
+
+	for (size_t s = 0; s < num_dimension_settings; ++s) {
+		const uint32_t num_dimensions = dimensions[s];
+
+		scc_DataSet* data_set;
+		if (scc_init_data_set(BENCH_NUM_POINTS, num_dimensions, BENCH_NUM_POINTS * 512, data, &data_set) != SCC_ER_OK) return 1;
+
+		double single_thread_time = 0.0;
+		for (size_t t = 0; t < 2; ++t) {
+			scc_set_num_threads(thread_settings[t]);
+			iscc_NNSearchObject* search;
+			const double start = bench_wall_time();
+			if (!iscc_imp_init_hnsw_nn_search_object(data_set, BENCH_NUM_POINTS, NULL, &search)) return 1;
+			const double build_time = bench_wall_time() - start;
+			iscc_imp_close_nn_search_object(&search);
+			if (t == 0) single_thread_time = build_time;
+			printf("%10u %10u %9.3fs %7.2fx\n", num_dimensions, thread_settings[t], build_time,
+			       single_thread_time / build_time);
+		}
+		scc_set_num_threads(0);
+
+		scc_free_data_set(&data_set);
+	}
+
+	free(data);
+	free(centers);
+	free(queries);
+	free(ref_nn);
+	free(hnsw_nn);
+
+	return 0;
+}
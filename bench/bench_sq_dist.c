@@ -0,0 +1,110 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+// Microbenchmark of the squared distance kernels. For each number of
+// dimensions, all pairs among a small set of rows are evaluated repeatedly
+// with every kernel supported by the CPU, and the time per evaluation and
+// the speedup relative to the scalar kernel is printed.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <src/dist_kernels.h>
+
+#define BENCH_NUM_ROWS 64
+#define BENCH_TARGET_VALUES 200000000.0
+
+
+static double bench_kernel(const iscc_SqDistKernel kernel,
+                           const double* const data,
+                           const size_t num_dimensions,
+                           const size_t repetitions,
+                           double* const out_checksum)
+{
+	double checksum = 0.0;
+	const clock_t start = clock();
+	for (size_t r = 0; r < repetitions; ++r) {
+		for (size_t i = 0; i < BENCH_NUM_ROWS; ++i) {
+			for (size_t j = 0; j < BENCH_NUM_ROWS; ++j) {
+				checksum += kernel(data + i * num_dimensions, data + j * num_dimensions, num_dimensions);
+			}
+		}
+	}
+	const clock_t stop = clock();
+	*out_checksum = checksum;
+
+	const double num_evals = (double) (repetitions * BENCH_NUM_ROWS * BENCH_NUM_ROWS);
+	return 1e9 * ((double) (stop - start)) / ((double) CLOCKS_PER_SEC) / num_evals;
+}
+
+
+int main(void)
+{
+	const size_t dimensions[] = { 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+	const size_t num_settings = sizeof(dimensions) / sizeof(dimensions[0]);
+
+	double* const data = malloc(sizeof(double[BENCH_NUM_ROWS * 1024]));
+	if (data == NULL) return 1;
+	srand(12345);
+	for (size_t i = 0; i < BENCH_NUM_ROWS * 1024; ++i) {
+		data[i] = ((double) rand()) / ((double) RAND_MAX);
+	}
+
+	printf("%10s", "dimensions");
+	for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+		if (iscc_get_sq_dist_kernel((iscc_SqDistKernelType) kt) == NULL) continue;
+		printf(" %10s %8s", iscc_get_sq_dist_kernel_name((iscc_SqDistKernelType) kt), "speedup");
+	}
+	printf("\n");
+
+	for (size_t s = 0; s < num_settings; ++s) {
+		const size_t num_dimensions = dimensions[s];
+		size_t repetitions = (size_t) (BENCH_TARGET_VALUES / (double) (BENCH_NUM_ROWS * BENCH_NUM_ROWS * num_dimensions));
+		if (repetitions == 0) repetitions = 1;
+
+		double checksum;
+		const double scalar_ns = bench_kernel(iscc_get_sq_dist_kernel(ISCC_SQ_DIST_SCALAR),
+		                                      data, num_dimensions, repetitions, &checksum);
+
+		printf("%10zu", num_dimensions);
+		for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+			const iscc_SqDistKernel kernel = iscc_get_sq_dist_kernel((iscc_SqDistKernelType) kt);
+			if (kernel == NULL) continue;
+			double kernel_checksum;
+			const double kernel_ns = bench_kernel(kernel, data, num_dimensions, repetitions, &kernel_checksum);
+			printf(" %8.2fns %7.2fx", kernel_ns, scalar_ns / kernel_ns);
+		}
+		printf("   (checksum %.6e)\n", checksum);
+	}
+
+	printf("selected kernel:");
+	for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+		if (iscc_get_sq_dist_kernel((iscc_SqDistKernelType) kt) == iscc_sq_dist_kernel) {
+			printf(" %s", iscc_get_sq_dist_kernel_name((iscc_SqDistKernelType) kt));
+		}
+	}
+	printf("\n");
+
+	free(data);
+
+	return 0;
+}
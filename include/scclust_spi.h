@@ -106,6 +106,23 @@ typedef bool (*scc_nearest_neighbor_search) (iscc_NNSearchObject*,
 typedef bool (*scc_close_nn_search_object) (iscc_NNSearchObject**);
 
 
+// Table of distance search functions. Can be passed to the `_with_dist_functions`
+// functions to use a backend for a single call, without changing the global
+// functions set by `scc_set_dist_functions`. All members must be non-NULL.
+typedef struct scc_DistFunctions {
+	scc_check_data_set check_data_set;
+	scc_num_data_points num_data_points;
+	scc_get_dist_matrix get_dist_matrix;
+	scc_get_dist_rows get_dist_rows;
+	scc_init_max_dist_object init_max_dist_object;
+	scc_get_max_dist get_max_dist;
+	scc_close_max_dist_object close_max_dist_object;
+	scc_init_nn_search_object init_nn_search_object;
+	scc_nearest_neighbor_search nearest_neighbor_search;
+	scc_close_nn_search_object close_nn_search_object;
+} scc_DistFunctions;
+
+
 // =============================================================================
 // SPI functions
 // =============================================================================
@@ -125,6 +142,148 @@ bool scc_set_dist_functions(scc_check_data_set,
                             scc_close_nn_search_object);
 
 
+// Use the built-in kd-tree for nearest neighbor and farthest point searches. The
+// remaining distance functions are not changed. The kd-tree gives the same results
+// as the default brute-force searches, but is much faster for large,
+// low-dimensional data sets.
+// Requires that data sets are `scc_DataSet`s. Undone by `scc_reset_dist_functions`
+// (unless the library is configured with `--enable-kdtree`).
+bool scc_set_kdtree_nn_search(void);
+
+
+// Use a brute-force nearest neighbor search that skips most distance calculations
+// using the distances to a few pivot points. The remaining distance functions are
+// not changed. The pivot search gives the same results as the default brute-force
+// search, and is faster for large, clustered data sets with more dimensions than
+// kd-trees handle well.
+// Requires that data sets are `scc_DataSet`s. Undone by `scc_reset_dist_functions`.
+bool scc_set_pivot_nn_search(void);
+
+
+// Use an approximate nearest neighbor search with hierarchical navigable small
+// world (HNSW) graphs. The remaining distance functions are not changed. Some
+// of the found neighbors may not be the nearest ones, but a query that is a
+// search point finds itself whenever an exact search would. The search is much faster
+// than exact searches for large data sets with many dimensions. Building the
+// graphs is multi-threaded (see `scc_set_num_threads`), and gives the same
+// graph with any number of threads.
+// Requires that data sets are `scc_DataSet`s. Undone by `scc_reset_dist_functions`.
+bool scc_set_hnsw_nn_search(void);
+
+
+// Sets the parameters of the HNSW search in the calling thread. `num_links` is the
+// number of links of each point in the graphs (twice as many on the bottom
+// level), `ef_construction` is the number of candidates considered when
+// linking a point, and `ef_search` the number considered in each query (at
+// least the number of neighbors searched for). Larger values give more
+// accurate searches, but take more time and memory. The defaults are 16, 100
+// and 64. Cached search objects (see `scc_pin_nn_search_cache`) are not rebuilt
+// when the parameters change. Graphs built in other threads are unaffected.
+// Returns `false` if `num_links` is not between 2 and 1024, or if an `ef` is zero.
+bool scc_set_hnsw_parameters(uint32_t num_links,
+                             uint32_t ef_construction,
+                             uint32_t ef_search);
+
+
+// Returns the built-in distance functions (as set by `scc_reset_dist_functions`).
+scc_DistFunctions scc_get_default_dist_functions(void);
+
+
+// Returns the built-in distance functions with kd-tree nearest neighbor and farthest point search.
+scc_DistFunctions scc_get_kdtree_dist_functions(void);
+
+
+// Returns the built-in distance functions with pivot nearest neighbor search.
+scc_DistFunctions scc_get_pivot_dist_functions(void);
+
+
+// Returns the built-in distance functions with HNSW nearest neighbor search.
+scc_DistFunctions scc_get_hnsw_dist_functions(void);
+
+
+// Returns the distance functions currently set by `scc_set_dist_functions`.
+scc_DistFunctions scc_get_dist_functions(void);
+
+
+// =============================================================================
+// NN-descent
+// =============================================================================
+
+// Build the nearest neighbor graph of all data points with NN-descent rather
+// than with the nearest neighbor search functions. The graph is used when
+// clustering without primary data points, radius constraint or type
+// constraints. NN-descent starts from a random graph and compares each point
+// with the neighbors of its neighbors for at most `max_iterations` iterations.
+// It stops earlier when no neighbors change, or when the estimated share of the
+// true nearest neighbors that are found (estimated from the exact neighbors of
+// 100 sampled points) reaches `recall_target`. If `exact_refinement`, the
+// neighbors are finally chosen among all neighbors of neighbors of each point.
+// The graph is approximate, so the clustering may differ from the one made with
+// exact searches, but the size constraint is always satisfied. Distances are
+// calculated with the `get_dist_rows` distance function, so any data set can be
+// used. With the built-in distance functions, the graph is built on multiple
+// threads (see `scc_set_num_threads`) and does not depend on the number of threads.
+// NN-descent is turned off (the default) by setting `max_iterations` to zero.
+// The setting only applies to clustering calls made in the calling thread.
+// Returns `false` if `recall_target` is not in (0, 1].
+bool scc_set_nn_descent(uint32_t max_iterations,
+                        double recall_target,
+                        bool exact_refinement);
+
+
+// =============================================================================
+// Search object cache
+// =============================================================================
+
+// Keeps the nearest neighbor search objects that are built over `data_set` in
+// this thread, so that later clustering calls reuse them rather than build them
+// again. An object is reused only with the same search points and the same
+// nearest neighbor functions. This saves time when the search objects are
+// expensive to build (e.g., kd-trees), and the same data set is clustered
+// several times (e.g., with different size constraints). At most 16 objects
+// are cached in a thread, and at most 8 data sets can be pinned.
+// The data set must not be changed while pinned, unless the cache is
+// invalidated afterwards, and must be unpinned before it is freed.
+bool scc_pin_nn_search_cache(void* data_set);
+
+
+// Closes all cached search objects over `data_set`. The data set stays pinned.
+bool scc_invalidate_nn_search_cache(void* data_set);
+
+
+// Closes all cached search objects over `data_set` and stops caching them.
+bool scc_unpin_nn_search_cache(void* data_set);
+
+
+// =============================================================================
+// Clustering with explicit distance functions
+// =============================================================================
+
+// The following functions are identical to the corresponding functions in
+// "scclust.h", except that `dist_functions` is used for all distance
+// calculations in the call instead of the global distance functions. The global
+// functions are not changed, so calls with different distance functions can
+// run concurrently in different threads.
+
+scc_ErrorCode scc_sc_clustering_with_dist_functions(void* data_set,
+                                                    const scc_ClusterOptions* options,
+                                                    scc_Clustering* out_clustering,
+                                                    const scc_DistFunctions* dist_functions);
+
+
+scc_ErrorCode scc_hierarchical_clustering_with_dist_functions(void* data_set,
+                                                              uint32_t size_constraint,
+                                                              bool batch_assign,
+                                                              scc_Clustering* out_clustering,
+                                                              const scc_DistFunctions* dist_functions);
+
+
+scc_ErrorCode scc_get_clustering_stats_with_dist_functions(void* data_set,
+                                                           const scc_Clustering* clustering,
+                                                           scc_ClusteringStats* out_stats,
+                                                           const scc_DistFunctions* dist_functions);
+
+
 #ifdef __cplusplus
 }
 #endif
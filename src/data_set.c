@@ -18,6 +18,14 @@
  * License along with this library. If not, see http://www.gnu.org/licenses/
  * ========================================================================== */
 
+// Memory-mapped files require POSIX; must be set before any system header
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+	#define ISCC_HAS_MMAP
+	#ifndef _POSIX_C_SOURCE
+		#define _POSIX_C_SOURCE 200112L
+	#endif
+#endif
+
 #include "../include/scclust.h"
 
 #include <assert.h>
@@ -28,8 +36,50 @@
 #include <string.h>
 #include "error.h"
 #include "data_set_struct.h"
+#include "dist_kernels.h"
+#include "kdtree.h"
 #include "scclust_types.h"
 
+#ifdef ISCC_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+// =============================================================================
+// Internal variables
+// =============================================================================
+
+#define ISCC_DATA_FILE_HEADER_SIZE 32
+#define ISCC_DATA_FILE_VERSION 1
+#define ISCC_DATA_FILE_DOUBLE 1
+#define ISCC_DATA_FILE_FLOAT 2
+
+static const char ISCC_DATA_FILE_MAGIC[8] = "SCCDATA";
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static scc_ErrorCode iscc_init_data_set(uint64_t num_data_points,
+                                        uint32_t num_dimensions,
+                                        size_t len_data_matrix,
+                                        const double data_matrix[],
+                                        const float float_matrix[],
+                                        bool compute_norms,
+                                        scc_DataSet** out_data_set);
+
+#ifdef ISCC_HAS_MMAP
+
+static scc_ErrorCode iscc_init_data_set_from_mapping(void* mapping,
+                                                     size_t len_mapping,
+                                                     scc_DataSet** out_data_set);
+
+#endif // ifdef ISCC_HAS_MMAP
+
 
 // =============================================================================
 // Public function implementations
@@ -40,6 +90,189 @@ scc_ErrorCode scc_init_data_set(const uint64_t num_data_points,
                                 const size_t len_data_matrix,
                                 const double data_matrix[const],
                                 scc_DataSet** const out_data_set)
+{
+	return iscc_init_data_set(num_data_points, num_dimensions, len_data_matrix, data_matrix, NULL, true, out_data_set);
+}
+
+
+scc_ErrorCode scc_init_data_set_float(const uint64_t num_data_points,
+                                      const uint32_t num_dimensions,
+                                      const size_t len_data_matrix,
+                                      const float data_matrix[const],
+                                      scc_DataSet** const out_data_set)
+{
+	return iscc_init_data_set(num_data_points, num_dimensions, len_data_matrix, NULL, data_matrix, true, out_data_set);
+}
+
+
+scc_ErrorCode scc_init_data_set_from_file(const char* const file_path,
+                                          const scc_AccessPattern access_pattern,
+                                          scc_DataSet** const out_data_set)
+{
+	if (out_data_set == NULL) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Output parameter may not be NULL.");
+	}
+	*out_data_set = NULL;
+
+	if (file_path == NULL) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "File path may not be NULL.");
+	}
+	if ((access_pattern != SCC_AP_NORMAL) &&
+	        (access_pattern != SCC_AP_SEQUENTIAL) &&
+	        (access_pattern != SCC_AP_RANDOM) &&
+	        (access_pattern != SCC_AP_WILL_NEED)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Unknown access pattern.");
+	}
+
+#ifdef ISCC_HAS_MMAP
+
+	const int fd = open(file_path, O_RDONLY);
+	if (fd == -1) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Cannot open data set file.");
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Cannot read data set file.");
+	}
+	if (file_stat.st_size < ISCC_DATA_FILE_HEADER_SIZE) {
+		close(fd);
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid data set file.");
+	}
+	if ((uintmax_t) file_stat.st_size > SIZE_MAX) {
+		close(fd);
+		return iscc_make_error_msg(SCC_ER_TOO_LARGE_PROBLEM, "Data set file too large to map.");
+	}
+	const size_t len_mapping = (size_t) file_stat.st_size;
+
+	// The mapping stays valid after the descriptor is closed
+	void* const mapping = mmap(NULL, len_mapping, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return iscc_make_error_msg(SCC_ER_NO_MEMORY, "Cannot map data set file.");
+	}
+
+	// Hints are advisory, so failures are ignored. `posix_madvise` is hidden
+	// by some system headers in strict ISO C mode.
+	#ifdef POSIX_MADV_NORMAL
+		switch (access_pattern) {
+		case SCC_AP_SEQUENTIAL:
+			posix_madvise(mapping, len_mapping, POSIX_MADV_SEQUENTIAL);
+			break;
+		case SCC_AP_RANDOM:
+			posix_madvise(mapping, len_mapping, POSIX_MADV_RANDOM);
+			break;
+		case SCC_AP_WILL_NEED:
+			posix_madvise(mapping, len_mapping, POSIX_MADV_WILLNEED);
+			break;
+		default:
+			break;
+		}
+	#endif
+
+	const scc_ErrorCode ec = iscc_init_data_set_from_mapping(mapping, len_mapping, out_data_set);
+	if (ec != SCC_ER_OK) {
+		munmap(mapping, len_mapping);
+	}
+	return ec;
+
+#else // ifdef ISCC_HAS_MMAP
+
+	return iscc_make_error_msg(SCC_ER_NOT_IMPLEMENTED, "Memory-mapped files are not supported on this platform.");
+
+#endif // ifdef ISCC_HAS_MMAP
+}
+
+
+void scc_free_data_set(scc_DataSet** const data_set)
+{
+	if ((data_set != NULL) && (*data_set != NULL)) {
+		free((*data_set)->sq_norms);
+		iscc_kdt_free_tree(&(*data_set)->nn_index);
+		#ifdef ISCC_HAS_MMAP
+			if ((*data_set)->file_mapping != NULL) {
+				munmap((*data_set)->file_mapping, (*data_set)->len_file_mapping);
+			}
+		#endif
+		free(*data_set);
+		*data_set = NULL;
+	}
+}
+
+
+scc_ErrorCode scc_save_nn_search_index(const scc_DataSet* const data_set,
+                                       const char* const file_path)
+{
+	if (!scc_is_initialized_data_set(data_set)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid data set object.");
+	}
+	if (file_path == NULL) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "File path may not be NULL.");
+	}
+
+	if (data_set->nn_index != NULL) {
+		return iscc_kdt_save_tree(data_set->nn_index, file_path);
+	}
+
+	iscc_KDTree* tree;
+	if (!iscc_kdt_build_tree(data_set, data_set->num_data_points, NULL, ISCC_KDT_NN_LEAF_SIZE, false, &tree)) {
+		return iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+	const scc_ErrorCode ec = iscc_kdt_save_tree(tree, file_path);
+	iscc_kdt_free_tree(&tree);
+
+	return ec;
+}
+
+
+scc_ErrorCode scc_load_nn_search_index(scc_DataSet* const data_set,
+                                       const char* const file_path)
+{
+	if (!scc_is_initialized_data_set(data_set)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid data set object.");
+	}
+	if (file_path == NULL) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "File path may not be NULL.");
+	}
+
+	// Search objects in any thread may use a loaded index, so it is never replaced
+	if (data_set->nn_index != NULL) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "A search index is already loaded.");
+	}
+
+	iscc_KDTree* tree;
+	const scc_ErrorCode ec = iscc_kdt_load_tree(data_set, file_path, &tree);
+	if (ec != SCC_ER_OK) return ec;
+
+	data_set->nn_index = tree;
+
+	return iscc_no_error();
+}
+
+
+bool scc_is_initialized_data_set(const scc_DataSet* const data_set)
+{
+	if (data_set == NULL) return false;
+	if (data_set->data_set_version != ISCC_DATASET_STRUCT_VERSION) return false;
+	if (data_set->num_data_points == 0) return false;
+	if (data_set->num_dimensions == 0) return false;
+	if ((data_set->data_matrix == NULL) == (data_set->float_matrix == NULL)) return false;
+	return true;
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+static scc_ErrorCode iscc_init_data_set(const uint64_t num_data_points,
+                                        const uint32_t num_dimensions,
+                                        const size_t len_data_matrix,
+                                        const double data_matrix[const],
+                                        const float float_matrix[const],
+                                        const bool compute_norms,
+                                        scc_DataSet** const out_data_set)
 {
 	if (out_data_set == NULL) {
 		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Output parameter may not be NULL.");
@@ -63,10 +296,11 @@ scc_ErrorCode scc_init_data_set(const uint64_t num_data_points,
 	if (num_dimensions > UINT16_MAX) {
 		return iscc_make_error_msg(SCC_ER_TOO_LARGE_PROBLEM, "Too many data dimensions.");
 	}
-	if (len_data_matrix < num_data_points * num_dimensions) {
+	// Division, as the product may wrap with counts from a file header
+	if (num_data_points > len_data_matrix / num_dimensions) {
 		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid data matrix.");
 	}
-	if (data_matrix == NULL) {
+	if ((data_matrix == NULL) == (float_matrix == NULL)) {
 		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid data matrix.");
 	}
 
@@ -78,29 +312,89 @@ scc_ErrorCode scc_init_data_set(const uint64_t num_data_points,
 		.num_data_points = (size_t) num_data_points,
 		.num_dimensions = (uint_fast16_t) num_dimensions,
 		.data_matrix = data_matrix,
+		.float_matrix = float_matrix,
+		.sq_norms = NULL,
+		.file_mapping = NULL,
+		.len_file_mapping = 0,
+		.nn_index = NULL,
 	};
 
+	// Norms are used for blocked distance calculations, which are only done
+	// for double precision data
+	if (compute_norms && (data_matrix != NULL) && (num_dimensions >= ISCC_DOT_TILE_MIN_DIMENSIONS)) {
+		tmp_dso->sq_norms = malloc(sizeof(double[num_data_points]));
+		if (tmp_dso->sq_norms == NULL) {
+			free(tmp_dso);
+			return iscc_make_error(SCC_ER_NO_MEMORY);
+		}
+		const double* row = data_matrix;
+		for (size_t i = 0; i < num_data_points; ++i) {
+			tmp_dso->sq_norms[i] = 0.0;
+			for (const double* const row_stop = row + num_dimensions; row != row_stop; ++row) {
+				tmp_dso->sq_norms[i] += (*row) * (*row);
+			}
+		}
+	}
+
 	*out_data_set = tmp_dso;
 
 	return iscc_no_error();
 }
 
 
-void scc_free_data_set(scc_DataSet** const data_set)
+#ifdef ISCC_HAS_MMAP
+
+static scc_ErrorCode iscc_init_data_set_from_mapping(void* const mapping,
+                                                     const size_t len_mapping,
+                                                     scc_DataSet** const out_data_set)
 {
-	if ((data_set != NULL) && (*data_set != NULL)) {
-		free(*data_set);
-		*data_set = NULL;
+	assert(len_mapping >= ISCC_DATA_FILE_HEADER_SIZE);
+	const unsigned char* const header = mapping;
+
+	// Copy fields out of the header to avoid unaligned reads
+	uint32_t version;
+	uint32_t element_type;
+	uint64_t num_data_points;
+	uint32_t num_dimensions;
+	uint32_t reserved;
+	memcpy(&version, header + 8, sizeof(uint32_t));
+	memcpy(&element_type, header + 12, sizeof(uint32_t));
+	memcpy(&num_data_points, header + 16, sizeof(uint64_t));
+	memcpy(&num_dimensions, header + 24, sizeof(uint32_t));
+	memcpy(&reserved, header + 28, sizeof(uint32_t));
+
+	if (memcmp(header, ISCC_DATA_FILE_MAGIC, sizeof(ISCC_DATA_FILE_MAGIC)) != 0) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid data set file.");
+	}
+	if ((version != ISCC_DATA_FILE_VERSION) || (reserved != 0)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Unsupported data set file version or byte order.");
 	}
-}
 
+	size_t element_size;
+	if (element_type == ISCC_DATA_FILE_DOUBLE) {
+		element_size = sizeof(double);
+	} else if (element_type == ISCC_DATA_FILE_FLOAT) {
+		element_size = sizeof(float);
+	} else {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid element type in data set file.");
+	}
 
-bool scc_is_initialized_data_set(const scc_DataSet* const data_set)
-{
-	if (data_set == NULL) return false;
-	if (data_set->data_set_version != ISCC_DATASET_STRUCT_VERSION) return false;
-	if (data_set->num_data_points == 0) return false;
-	if (data_set->num_dimensions == 0) return false;
-	if (data_set->data_matrix == NULL) return false;
-	return true;
+	// Number of elements in the file; `iscc_init_data_set` checks that it's enough
+	const size_t len_data_matrix = (len_mapping - ISCC_DATA_FILE_HEADER_SIZE) / element_size;
+
+	const void* const data = header + ISCC_DATA_FILE_HEADER_SIZE;
+	scc_ErrorCode ec;
+	if (element_type == ISCC_DATA_FILE_DOUBLE) {
+		ec = iscc_init_data_set(num_data_points, num_dimensions, len_data_matrix, data, NULL, false, out_data_set);
+	} else {
+		ec = iscc_init_data_set(num_data_points, num_dimensions, len_data_matrix, NULL, data, false, out_data_set);
+	}
+	if (ec != SCC_ER_OK) return ec;
+
+	(*out_data_set)->file_mapping = mapping;
+	(*out_data_set)->len_file_mapping = len_mapping;
+
+	return iscc_no_error();
 }
+
+#endif // ifdef ISCC_HAS_MMAP
@@ -40,12 +40,31 @@ struct scc_DataSet {
 	size_t num_data_points;
 	uint_fast16_t num_dimensions;
 	const double* data_matrix;
+	const float* float_matrix;
+	double* sq_norms;
+	void* file_mapping;
+	size_t len_file_mapping;
+	// Loaded by `scc_load_nn_search_index`, over all points
+	struct iscc_KDTree* nn_index;
 };
 
 
 static const int32_t ISCC_DATASET_STRUCT_VERSION = 722328001;
 
 
+// Exactly one of `data_matrix` and `float_matrix` is non-NULL
+static inline double iscc_get_coordinate(const scc_DataSet* const data_set,
+                                         const size_t point,
+                                         const size_t dim)
+{
+	const size_t offset = point * data_set->num_dimensions + dim;
+	if (data_set->float_matrix != NULL) {
+		return (double) data_set->float_matrix[offset];
+	}
+	return data_set->data_matrix[offset];
+}
+
+
 #ifdef __cplusplus
 }
 #endif
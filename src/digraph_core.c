@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include "../include/scclust.h"
 #include "error.h"
+#include "profile.h"
 #include "scclust_types.h"
 
 
@@ -37,6 +38,12 @@
 void iscc_free_digraph(iscc_Digraph* const dg)
 {
 	if (dg != NULL) {
+		if (dg->tail_ptr != NULL) {
+			iscc_profile_count_free(sizeof(iscc_ArcIndex[dg->vertices + 1]));
+		}
+		if (dg->head != NULL) {
+			iscc_profile_count_free(sizeof(scc_PointIndex[dg->max_arcs]));
+		}
 		free(dg->head);
 		free(dg->tail_ptr);
 		*dg = ISCC_NULL_DIGRAPH;
@@ -100,6 +107,7 @@ scc_ErrorCode iscc_init_digraph(const size_t vertices,
 		.tail_ptr = malloc(sizeof(iscc_ArcIndex[vertices + 1])),
 	};
 	if (out_dg->tail_ptr == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+	iscc_profile_count_alloc(0, sizeof(iscc_ArcIndex[vertices + 1]));
 
 	if (max_arcs > 0) {
 		out_dg->head = malloc(sizeof(scc_PointIndex[max_arcs]));
@@ -107,6 +115,7 @@ scc_ErrorCode iscc_init_digraph(const size_t vertices,
 			iscc_free_digraph(out_dg);
 			return iscc_make_error(SCC_ER_NO_MEMORY);
 		}
+		iscc_profile_count_alloc(max_arcs, sizeof(scc_PointIndex[max_arcs]));
 	}
 
 	assert(iscc_digraph_is_initialized(out_dg));
@@ -134,6 +143,7 @@ scc_ErrorCode iscc_empty_digraph(const size_t vertices,
 		.tail_ptr = calloc(vertices + 1, sizeof(iscc_ArcIndex)),
 	};
 	if (out_dg->tail_ptr == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+	iscc_profile_count_alloc(0, sizeof(iscc_ArcIndex[vertices + 1]));
 
 	if (max_arcs > 0) {
 		out_dg->head = malloc(sizeof(scc_PointIndex[max_arcs]));
@@ -141,6 +151,7 @@ scc_ErrorCode iscc_empty_digraph(const size_t vertices,
 			iscc_free_digraph(out_dg);
 			return iscc_make_error(SCC_ER_NO_MEMORY);
 		}
+		iscc_profile_count_alloc(max_arcs, sizeof(scc_PointIndex[max_arcs]));
 	}
 
 	assert(iscc_digraph_is_valid(out_dg));
@@ -160,12 +171,18 @@ scc_ErrorCode iscc_change_arc_storage(iscc_Digraph* const dg,
 	if (dg->max_arcs == new_max_arcs) return iscc_no_error();
 
 	if (new_max_arcs == 0) {
+		iscc_profile_count_free(sizeof(scc_PointIndex[dg->max_arcs]));
 		free(dg->head);
 		dg->head = NULL;
 		dg->max_arcs = 0;
 	} else {
 		scc_PointIndex* const tmp_ptr = realloc(dg->head, sizeof(scc_PointIndex[new_max_arcs]));
 		if (tmp_ptr == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+		if (new_max_arcs > dg->max_arcs) {
+			iscc_profile_count_alloc(new_max_arcs - dg->max_arcs, sizeof(scc_PointIndex[new_max_arcs - dg->max_arcs]));
+		} else {
+			iscc_profile_count_free(sizeof(scc_PointIndex[dg->max_arcs - new_max_arcs]));
+		}
 		dg->head = tmp_ptr;
 		dg->max_arcs = (size_t) new_max_arcs;
 	}
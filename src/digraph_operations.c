@@ -28,6 +28,15 @@
 #include "digraph_core.h"
 #include "error.h"
 #include "scclust_types.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Internal variables
+// =============================================================================
+
+// Products with fewer vertices than this are not split between threads
+#define ISCC_ADJACENCY_PRODUCT_MIN_PARALLEL_VERTICES 1024
 
 
 // =============================================================================
@@ -54,6 +63,22 @@ static inline uintmax_t iscc_do_adjacency_product(const iscc_Digraph* dg_a,
                                                   scc_PointIndex out_head[restrict]);
 
 
+static scc_ErrorCode iscc_parallel_adjacency_product(const iscc_Digraph* dg_a,
+                                                     const iscc_Digraph* dg_b,
+                                                     bool force_loops,
+                                                     uint32_t num_threads,
+                                                     scc_PointIndex thread_row_markers[],
+                                                     iscc_Digraph* out_dg);
+
+
+static inline size_t iscc_adjacency_product_row(const iscc_Digraph* dg_a,
+                                                const iscc_Digraph* dg_b,
+                                                scc_PointIndex v,
+                                                scc_PointIndex row_markers[restrict],
+                                                bool force_loops,
+                                                scc_PointIndex out_head[restrict]);
+
+
 // =============================================================================
 // External function implementations
 // =============================================================================
@@ -252,6 +277,23 @@ scc_ErrorCode iscc_adjacency_product(const iscc_Digraph* const in_dg_a,
 
 	const size_t vertices = in_dg_a->vertices;
 
+	uint32_t num_threads = iscc_get_num_threads();
+	if ((vertices < ISCC_ADJACENCY_PRODUCT_MIN_PARALLEL_VERTICES) || (vertices > SIZE_MAX / num_threads)) {
+		num_threads = 1;
+	}
+
+	if (num_threads > 1) {
+		// Each thread needs its own row markers
+		scc_PointIndex* const thread_row_markers = malloc(sizeof(scc_PointIndex[num_threads * vertices]));
+		if (thread_row_markers != NULL) {
+			const scc_ErrorCode ec = iscc_parallel_adjacency_product(in_dg_a, in_dg_b, force_loops,
+			                                                         num_threads, thread_row_markers, out_dg);
+			free(thread_row_markers);
+			return ec;
+		}
+		// Not enough memory for the markers, do serial product instead
+	}
+
 	scc_PointIndex* const row_markers = malloc(sizeof(scc_PointIndex[vertices]));
 	if (row_markers == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
 
@@ -504,3 +546,113 @@ static inline uintmax_t iscc_do_adjacency_product(const iscc_Digraph* const dg_a
 
 	return counter;
 }
+
+
+static scc_ErrorCode iscc_parallel_adjacency_product(const iscc_Digraph* const dg_a,
+                                                     const iscc_Digraph* const dg_b,
+                                                     const bool force_loops,
+                                                     const uint32_t num_threads,
+                                                     scc_PointIndex thread_row_markers[const],
+                                                     iscc_Digraph* const out_dg)
+{
+	assert(dg_a->vertices == dg_b->vertices);
+	assert(num_threads > 1);
+	assert(thread_row_markers != NULL);
+	assert(out_dg != NULL);
+	(void) num_threads; // Unused without OpenMP
+
+	const size_t vertices = dg_a->vertices;
+
+	size_t* const row_counts = malloc(sizeof(size_t[vertices]));
+	if (row_counts == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+
+	// Symbolic phase: count the arcs in each row of the product
+	ISCC_OMP_PRAGMA(omp parallel num_threads((int) num_threads))
+	{
+		scc_PointIndex* const row_markers = thread_row_markers + iscc_get_thread_num() * vertices;
+		for (size_t i = 0; i < vertices; ++i) {
+			row_markers[i] = ISCC_POINTINDEX_MAX_PI;
+		}
+		ISCC_OMP_PRAGMA(omp for schedule(dynamic, 256))
+		for (size_t v = 0; v < vertices; ++v) {
+			row_counts[v] = iscc_adjacency_product_row(dg_a, dg_b, (scc_PointIndex) v,
+			                                           row_markers, force_loops, NULL);
+		}
+	}
+
+	uintmax_t out_arcs = 0;
+	for (size_t v = 0; v < vertices; ++v) {
+		out_arcs += row_counts[v];
+	}
+
+	scc_ErrorCode ec;
+	if ((ec = iscc_init_digraph(vertices, out_arcs, out_dg)) != SCC_ER_OK) {
+		free(row_counts);
+		return ec;
+	}
+
+	out_dg->tail_ptr[0] = 0;
+	for (size_t v = 0; v < vertices; ++v) {
+		out_dg->tail_ptr[v + 1] = out_dg->tail_ptr[v] + (iscc_ArcIndex) row_counts[v];
+	}
+	free(row_counts);
+
+	// Numeric phase: each row is written to its own slice of `head`, in the
+	// same order as in the serial product
+	if (out_arcs > 0) {
+		const iscc_ArcIndex* const out_tail_ptr = out_dg->tail_ptr;
+		scc_PointIndex* const out_head = out_dg->head;
+		ISCC_OMP_PRAGMA(omp parallel num_threads((int) num_threads))
+		{
+			scc_PointIndex* const row_markers = thread_row_markers + iscc_get_thread_num() * vertices;
+			for (size_t i = 0; i < vertices; ++i) {
+				row_markers[i] = ISCC_POINTINDEX_MAX_PI;
+			}
+			ISCC_OMP_PRAGMA(omp for schedule(dynamic, 256))
+			for (size_t v = 0; v < vertices; ++v) {
+				iscc_adjacency_product_row(dg_a, dg_b, (scc_PointIndex) v,
+				                           row_markers, force_loops, out_head + out_tail_ptr[v]);
+			}
+		}
+	}
+
+	return iscc_no_error();
+}
+
+
+static inline size_t iscc_adjacency_product_row(const iscc_Digraph* const dg_a,
+                                                const iscc_Digraph* const dg_b,
+                                                const scc_PointIndex v,
+                                                scc_PointIndex row_markers[restrict const],
+                                                const bool force_loops,
+                                                scc_PointIndex out_head[restrict const])
+{
+	// `row_markers[x] == v` if `x` is already in row `v` (or `x == v`)
+	size_t counter = 0;
+	row_markers[v] = v;
+	if (force_loops) {
+		const scc_PointIndex* const v_arc_b_stop = dg_b->head + dg_b->tail_ptr[v + 1];
+		for (const scc_PointIndex* v_arc_b = dg_b->head + dg_b->tail_ptr[v];
+		        v_arc_b != v_arc_b_stop; ++v_arc_b) {
+			if (row_markers[*v_arc_b] != v) {
+				row_markers[*v_arc_b] = v;
+				if (out_head != NULL) out_head[counter] = *v_arc_b;
+				++counter;
+			}
+		}
+	}
+	const scc_PointIndex* const arc_a_stop = dg_a->head + dg_a->tail_ptr[v + 1];
+	for (const scc_PointIndex* arc_a = dg_a->head + dg_a->tail_ptr[v];
+	        arc_a != arc_a_stop; ++arc_a) {
+		const scc_PointIndex* const arc_b_stop = dg_b->head + dg_b->tail_ptr[*arc_a + 1];
+		for (const scc_PointIndex* arc_b = dg_b->head + dg_b->tail_ptr[*arc_a];
+		        arc_b != arc_b_stop; ++arc_b) {
+			if (row_markers[*arc_b] != v) {
+				row_markers[*arc_b] = v;
+				if (out_head != NULL) out_head[counter] = *arc_b;
+				++counter;
+			}
+		}
+	}
+	return counter;
+}
@@ -0,0 +1,628 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "dist_kernels.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef ISCC_SQ_DIST_DISPATCH
+	#include <immintrin.h>
+#endif
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static double iscc_sq_dist_scalar(const double* x,
+                                  const double* y,
+                                  size_t num_dimensions);
+
+static double iscc_sq_dist_float_scalar(const float* x,
+                                        const float* y,
+                                        size_t num_dimensions);
+
+static void iscc_dot_tile_scalar(const double* const x[ISCC_DOT_TILE_ROWS],
+                                 const double* const y[ISCC_DOT_TILE_COLUMNS],
+                                 size_t num_dimensions,
+                                 double out_dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS]);
+
+static void iscc_dot_tile_tail(const double* const x[ISCC_DOT_TILE_ROWS],
+                               const double* const y[ISCC_DOT_TILE_COLUMNS],
+                               size_t start,
+                               size_t num_dimensions,
+                               double out_dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS]);
+
+#ifdef ISCC_SQ_DIST_DISPATCH
+
+static double iscc_sq_dist_sse2(const double* x,
+                                const double* y,
+                                size_t num_dimensions);
+
+static double iscc_sq_dist_avx2(const double* x,
+                                const double* y,
+                                size_t num_dimensions);
+
+static double iscc_sq_dist_avx512(const double* x,
+                                  const double* y,
+                                  size_t num_dimensions);
+
+static double iscc_sq_dist_float_sse2(const float* x,
+                                      const float* y,
+                                      size_t num_dimensions);
+
+static double iscc_sq_dist_float_avx2(const float* x,
+                                      const float* y,
+                                      size_t num_dimensions);
+
+static double iscc_sq_dist_float_avx512(const float* x,
+                                        const float* y,
+                                        size_t num_dimensions);
+
+static void iscc_dot_tile_sse2(const double* const x[ISCC_DOT_TILE_ROWS],
+                               const double* const y[ISCC_DOT_TILE_COLUMNS],
+                               size_t num_dimensions,
+                               double out_dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS]);
+
+static void iscc_dot_tile_avx2(const double* const x[ISCC_DOT_TILE_ROWS],
+                               const double* const y[ISCC_DOT_TILE_COLUMNS],
+                               size_t num_dimensions,
+                               double out_dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS]);
+
+static void iscc_dot_tile_avx512(const double* const x[ISCC_DOT_TILE_ROWS],
+                                 const double* const y[ISCC_DOT_TILE_COLUMNS],
+                                 size_t num_dimensions,
+                                 double out_dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS]);
+
+static void iscc_select_sq_dist_kernel(void);
+
+#endif // ifdef ISCC_SQ_DIST_DISPATCH
+
+
+// =============================================================================
+// External variables
+// =============================================================================
+
+// Overwritten by `iscc_select_sq_dist_kernel` when the library is loaded
+iscc_SqDistKernel iscc_sq_dist_kernel = iscc_sq_dist_scalar;
+
+// Overwritten by `iscc_select_sq_dist_kernel` when the library is loaded
+iscc_SqDistFloatKernel iscc_sq_dist_float_kernel = iscc_sq_dist_float_scalar;
+
+// Overwritten by `iscc_select_sq_dist_kernel` when the library is loaded
+iscc_DotTileKernel iscc_dot_tile_kernel = iscc_dot_tile_scalar;
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+iscc_SqDistKernel iscc_get_sq_dist_kernel(const iscc_SqDistKernelType kernel_type)
+{
+	switch (kernel_type) {
+		case ISCC_SQ_DIST_SCALAR:
+			return iscc_sq_dist_scalar;
+		#ifdef ISCC_SQ_DIST_DISPATCH
+			case ISCC_SQ_DIST_SSE2:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("sse2")) return iscc_sq_dist_sse2;
+				return NULL;
+			case ISCC_SQ_DIST_AVX2:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx2")) return iscc_sq_dist_avx2;
+				return NULL;
+			case ISCC_SQ_DIST_AVX512:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx512f")) return iscc_sq_dist_avx512;
+				return NULL;
+		#endif // ifdef ISCC_SQ_DIST_DISPATCH
+		default:
+			return NULL;
+	}
+}
+
+
+iscc_SqDistFloatKernel iscc_get_sq_dist_float_kernel(const iscc_SqDistKernelType kernel_type)
+{
+	switch (kernel_type) {
+		case ISCC_SQ_DIST_SCALAR:
+			return iscc_sq_dist_float_scalar;
+		#ifdef ISCC_SQ_DIST_DISPATCH
+			case ISCC_SQ_DIST_SSE2:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("sse2")) return iscc_sq_dist_float_sse2;
+				return NULL;
+			case ISCC_SQ_DIST_AVX2:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx2")) return iscc_sq_dist_float_avx2;
+				return NULL;
+			case ISCC_SQ_DIST_AVX512:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx512f")) return iscc_sq_dist_float_avx512;
+				return NULL;
+		#endif // ifdef ISCC_SQ_DIST_DISPATCH
+		default:
+			return NULL;
+	}
+}
+
+
+iscc_DotTileKernel iscc_get_dot_tile_kernel(const iscc_SqDistKernelType kernel_type)
+{
+	switch (kernel_type) {
+		case ISCC_SQ_DIST_SCALAR:
+			return iscc_dot_tile_scalar;
+		#ifdef ISCC_SQ_DIST_DISPATCH
+			case ISCC_SQ_DIST_SSE2:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("sse2")) return iscc_dot_tile_sse2;
+				return NULL;
+			case ISCC_SQ_DIST_AVX2:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx2")) return iscc_dot_tile_avx2;
+				return NULL;
+			case ISCC_SQ_DIST_AVX512:
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx512f")) return iscc_dot_tile_avx512;
+				return NULL;
+		#endif // ifdef ISCC_SQ_DIST_DISPATCH
+		default:
+			return NULL;
+	}
+}
+
+
+const char* iscc_get_sq_dist_kernel_name(const iscc_SqDistKernelType kernel_type)
+{
+	switch (kernel_type) {
+		case ISCC_SQ_DIST_SCALAR:
+			return "scalar";
+		case ISCC_SQ_DIST_SSE2:
+			return "sse2";
+		case ISCC_SQ_DIST_AVX2:
+			return "avx2";
+		case ISCC_SQ_DIST_AVX512:
+			return "avx512";
+		default:
+			return "unknown";
+	}
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+static double iscc_sq_dist_scalar(const double* const x,
+                                  const double* const y,
+                                  const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+	return iscc_sq_dist_scalar_inline(x, x + num_dimensions, y);
+}
+
+
+static double iscc_sq_dist_float_scalar(const float* const x,
+                                        const float* const y,
+                                        const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+	return iscc_sq_dist_float_scalar_inline(x, x + num_dimensions, y);
+}
+
+
+static void iscc_dot_tile_scalar(const double* const x[const ISCC_DOT_TILE_ROWS],
+                                 const double* const y[const ISCC_DOT_TILE_COLUMNS],
+                                 const size_t num_dimensions,
+                                 double out_dots[const ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS])
+{
+	for (size_t t = 0; t < ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS; ++t) {
+		out_dots[t] = 0.0;
+	}
+	iscc_dot_tile_tail(x, y, 0, num_dimensions, out_dots);
+}
+
+
+// Adds the products of dimensions [start, num_dimensions) to `out_dots`
+static void iscc_dot_tile_tail(const double* const x[const ISCC_DOT_TILE_ROWS],
+                               const double* const y[const ISCC_DOT_TILE_COLUMNS],
+                               const size_t start,
+                               const size_t num_dimensions,
+                               double out_dots[const ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS])
+{
+	assert(x != NULL);
+	assert(y != NULL);
+	assert(out_dots != NULL);
+
+	for (size_t i = start; i < num_dimensions; ++i) {
+		const double y0 = y[0][i];
+		const double y1 = y[1][i];
+		for (size_t r = 0; r < ISCC_DOT_TILE_ROWS; ++r) {
+			out_dots[ISCC_DOT_TILE_COLUMNS * r] += x[r][i] * y0;
+			out_dots[ISCC_DOT_TILE_COLUMNS * r + 1] += x[r][i] * y1;
+		}
+	}
+}
+
+
+#ifdef ISCC_SQ_DIST_DISPATCH
+
+__attribute__((target("sse2")))
+static double iscc_sq_dist_sse2(const double* const x,
+                                const double* const y,
+                                const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= num_dimensions; i += 4) {
+		const __m128d diff0 = _mm_sub_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i));
+		const __m128d diff1 = _mm_sub_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2));
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(diff0, diff0));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(diff1, diff1));
+	}
+	acc0 = _mm_add_pd(acc0, acc1);
+	acc0 = _mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0));
+
+	return _mm_cvtsd_f64(acc0) + iscc_sq_dist_scalar_inline(x + i, x + num_dimensions, y + i);
+}
+
+
+__attribute__((target("avx2")))
+static double iscc_sq_dist_avx2(const double* const x,
+                                const double* const y,
+                                const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	__m256d acc2 = _mm256_setzero_pd();
+	__m256d acc3 = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 16 <= num_dimensions; i += 16) {
+		const __m256d diff0 = _mm256_sub_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+		const __m256d diff1 = _mm256_sub_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4));
+		const __m256d diff2 = _mm256_sub_pd(_mm256_loadu_pd(x + i + 8), _mm256_loadu_pd(y + i + 8));
+		const __m256d diff3 = _mm256_sub_pd(_mm256_loadu_pd(x + i + 12), _mm256_loadu_pd(y + i + 12));
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(diff0, diff0));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(diff1, diff1));
+		acc2 = _mm256_add_pd(acc2, _mm256_mul_pd(diff2, diff2));
+		acc3 = _mm256_add_pd(acc3, _mm256_mul_pd(diff3, diff3));
+	}
+	for (; i + 4 <= num_dimensions; i += 4) {
+		const __m256d diff0 = _mm256_sub_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(diff0, diff0));
+	}
+	acc0 = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+	__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+	sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+
+	return _mm_cvtsd_f64(sum) + iscc_sq_dist_scalar_inline(x + i, x + num_dimensions, y + i);
+}
+
+
+__attribute__((target("avx512f")))
+static double iscc_sq_dist_avx512(const double* const x,
+                                  const double* const y,
+                                  const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+
+	__m512d acc0 = _mm512_setzero_pd();
+	__m512d acc1 = _mm512_setzero_pd();
+	__m512d acc2 = _mm512_setzero_pd();
+	__m512d acc3 = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i + 32 <= num_dimensions; i += 32) {
+		const __m512d diff0 = _mm512_sub_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i));
+		const __m512d diff1 = _mm512_sub_pd(_mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8));
+		const __m512d diff2 = _mm512_sub_pd(_mm512_loadu_pd(x + i + 16), _mm512_loadu_pd(y + i + 16));
+		const __m512d diff3 = _mm512_sub_pd(_mm512_loadu_pd(x + i + 24), _mm512_loadu_pd(y + i + 24));
+		acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(diff0, diff0));
+		acc1 = _mm512_add_pd(acc1, _mm512_mul_pd(diff1, diff1));
+		acc2 = _mm512_add_pd(acc2, _mm512_mul_pd(diff2, diff2));
+		acc3 = _mm512_add_pd(acc3, _mm512_mul_pd(diff3, diff3));
+	}
+	for (; i + 8 <= num_dimensions; i += 8) {
+		const __m512d diff0 = _mm512_sub_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i));
+		acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(diff0, diff0));
+	}
+	if (i < num_dimensions) {
+		// Masked loads set the lanes past the end to zero
+		const __mmask8 tail_mask = (__mmask8) ((1u << (num_dimensions - i)) - 1u);
+		const __m512d diff0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(tail_mask, x + i),
+		                                    _mm512_maskz_loadu_pd(tail_mask, y + i));
+		acc1 = _mm512_add_pd(acc1, _mm512_mul_pd(diff0, diff0));
+	}
+	acc0 = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+
+	return _mm512_reduce_add_pd(acc0);
+}
+
+
+// The single precision kernels convert the coordinates to double precision
+// when loading, and then proceed as the double precision kernels.
+
+__attribute__((target("sse2")))
+static double iscc_sq_dist_float_sse2(const float* const x,
+                                      const float* const y,
+                                      const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= num_dimensions; i += 4) {
+		const __m128 xf = _mm_loadu_ps(x + i);
+		const __m128 yf = _mm_loadu_ps(y + i);
+		const __m128d diff0 = _mm_sub_pd(_mm_cvtps_pd(xf), _mm_cvtps_pd(yf));
+		const __m128d diff1 = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(xf, xf)), _mm_cvtps_pd(_mm_movehl_ps(yf, yf)));
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(diff0, diff0));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(diff1, diff1));
+	}
+	acc0 = _mm_add_pd(acc0, acc1);
+	acc0 = _mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0));
+
+	return _mm_cvtsd_f64(acc0) + iscc_sq_dist_float_scalar_inline(x + i, x + num_dimensions, y + i);
+}
+
+
+__attribute__((target("avx2")))
+static double iscc_sq_dist_float_avx2(const float* const x,
+                                      const float* const y,
+                                      const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	__m256d acc2 = _mm256_setzero_pd();
+	__m256d acc3 = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 16 <= num_dimensions; i += 16) {
+		const __m256d diff0 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i)), _mm256_cvtps_pd(_mm_loadu_ps(y + i)));
+		const __m256d diff1 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i + 4)), _mm256_cvtps_pd(_mm_loadu_ps(y + i + 4)));
+		const __m256d diff2 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i + 8)), _mm256_cvtps_pd(_mm_loadu_ps(y + i + 8)));
+		const __m256d diff3 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i + 12)), _mm256_cvtps_pd(_mm_loadu_ps(y + i + 12)));
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(diff0, diff0));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(diff1, diff1));
+		acc2 = _mm256_add_pd(acc2, _mm256_mul_pd(diff2, diff2));
+		acc3 = _mm256_add_pd(acc3, _mm256_mul_pd(diff3, diff3));
+	}
+	for (; i + 4 <= num_dimensions; i += 4) {
+		const __m256d diff0 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i)), _mm256_cvtps_pd(_mm_loadu_ps(y + i)));
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(diff0, diff0));
+	}
+	acc0 = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+	__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+	sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+
+	return _mm_cvtsd_f64(sum) + iscc_sq_dist_float_scalar_inline(x + i, x + num_dimensions, y + i);
+}
+
+
+__attribute__((target("avx512f")))
+static double iscc_sq_dist_float_avx512(const float* const x,
+                                        const float* const y,
+                                        const size_t num_dimensions)
+{
+	assert(x != NULL);
+	assert(y != NULL);
+
+	__m512d acc0 = _mm512_setzero_pd();
+	__m512d acc1 = _mm512_setzero_pd();
+	__m512d acc2 = _mm512_setzero_pd();
+	__m512d acc3 = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i + 32 <= num_dimensions; i += 32) {
+		const __m512d diff0 = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i)), _mm512_cvtps_pd(_mm256_loadu_ps(y + i)));
+		const __m512d diff1 = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i + 8)), _mm512_cvtps_pd(_mm256_loadu_ps(y + i + 8)));
+		const __m512d diff2 = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i + 16)), _mm512_cvtps_pd(_mm256_loadu_ps(y + i + 16)));
+		const __m512d diff3 = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i + 24)), _mm512_cvtps_pd(_mm256_loadu_ps(y + i + 24)));
+		acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(diff0, diff0));
+		acc1 = _mm512_add_pd(acc1, _mm512_mul_pd(diff1, diff1));
+		acc2 = _mm512_add_pd(acc2, _mm512_mul_pd(diff2, diff2));
+		acc3 = _mm512_add_pd(acc3, _mm512_mul_pd(diff3, diff3));
+	}
+	for (; i + 8 <= num_dimensions; i += 8) {
+		const __m512d diff0 = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i)), _mm512_cvtps_pd(_mm256_loadu_ps(y + i)));
+		acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(diff0, diff0));
+	}
+	if (i < num_dimensions) {
+		// Masked loads set the lanes past the end to zero
+		const __mmask16 tail_mask = (__mmask16) ((1u << (num_dimensions - i)) - 1u);
+		const __m512d diff0 = _mm512_sub_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(_mm512_maskz_loadu_ps(tail_mask, x + i))),
+		                                    _mm512_cvtps_pd(_mm512_castps512_ps256(_mm512_maskz_loadu_ps(tail_mask, y + i))));
+		acc1 = _mm512_add_pd(acc1, _mm512_mul_pd(diff0, diff0));
+	}
+	acc0 = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+
+	return _mm512_reduce_add_pd(acc0);
+}
+
+
+// The dot product tiles load each column once per step and use it for all
+// rows, with one accumulator per row and column pair. The kernels are
+// written for tiles of 4 rows and 2 columns.
+
+__attribute__((target("sse2")))
+static void iscc_dot_tile_sse2(const double* const x[const ISCC_DOT_TILE_ROWS],
+                               const double* const y[const ISCC_DOT_TILE_COLUMNS],
+                               const size_t num_dimensions,
+                               double out_dots[const ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS])
+{
+	assert(x != NULL);
+	assert(y != NULL);
+	assert(out_dots != NULL);
+
+	__m128d acc00 = _mm_setzero_pd(), acc01 = _mm_setzero_pd();
+	__m128d acc10 = _mm_setzero_pd(), acc11 = _mm_setzero_pd();
+	__m128d acc20 = _mm_setzero_pd(), acc21 = _mm_setzero_pd();
+	__m128d acc30 = _mm_setzero_pd(), acc31 = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 2 <= num_dimensions; i += 2) {
+		const __m128d y0 = _mm_loadu_pd(y[0] + i);
+		const __m128d y1 = _mm_loadu_pd(y[1] + i);
+		__m128d xr = _mm_loadu_pd(x[0] + i);
+		acc00 = _mm_add_pd(acc00, _mm_mul_pd(xr, y0));
+		acc01 = _mm_add_pd(acc01, _mm_mul_pd(xr, y1));
+		xr = _mm_loadu_pd(x[1] + i);
+		acc10 = _mm_add_pd(acc10, _mm_mul_pd(xr, y0));
+		acc11 = _mm_add_pd(acc11, _mm_mul_pd(xr, y1));
+		xr = _mm_loadu_pd(x[2] + i);
+		acc20 = _mm_add_pd(acc20, _mm_mul_pd(xr, y0));
+		acc21 = _mm_add_pd(acc21, _mm_mul_pd(xr, y1));
+		xr = _mm_loadu_pd(x[3] + i);
+		acc30 = _mm_add_pd(acc30, _mm_mul_pd(xr, y0));
+		acc31 = _mm_add_pd(acc31, _mm_mul_pd(xr, y1));
+	}
+
+	const __m128d accs[8] = { acc00, acc01, acc10, acc11, acc20, acc21, acc30, acc31 };
+	for (size_t t = 0; t < 8; ++t) {
+		out_dots[t] = _mm_cvtsd_f64(_mm_add_sd(accs[t], _mm_unpackhi_pd(accs[t], accs[t])));
+	}
+	iscc_dot_tile_tail(x, y, i, num_dimensions, out_dots);
+}
+
+
+__attribute__((target("avx2")))
+static void iscc_dot_tile_avx2(const double* const x[const ISCC_DOT_TILE_ROWS],
+                               const double* const y[const ISCC_DOT_TILE_COLUMNS],
+                               const size_t num_dimensions,
+                               double out_dots[const ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS])
+{
+	assert(x != NULL);
+	assert(y != NULL);
+	assert(out_dots != NULL);
+
+	__m256d acc00 = _mm256_setzero_pd(), acc01 = _mm256_setzero_pd();
+	__m256d acc10 = _mm256_setzero_pd(), acc11 = _mm256_setzero_pd();
+	__m256d acc20 = _mm256_setzero_pd(), acc21 = _mm256_setzero_pd();
+	__m256d acc30 = _mm256_setzero_pd(), acc31 = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= num_dimensions; i += 4) {
+		const __m256d y0 = _mm256_loadu_pd(y[0] + i);
+		const __m256d y1 = _mm256_loadu_pd(y[1] + i);
+		__m256d xr = _mm256_loadu_pd(x[0] + i);
+		acc00 = _mm256_add_pd(acc00, _mm256_mul_pd(xr, y0));
+		acc01 = _mm256_add_pd(acc01, _mm256_mul_pd(xr, y1));
+		xr = _mm256_loadu_pd(x[1] + i);
+		acc10 = _mm256_add_pd(acc10, _mm256_mul_pd(xr, y0));
+		acc11 = _mm256_add_pd(acc11, _mm256_mul_pd(xr, y1));
+		xr = _mm256_loadu_pd(x[2] + i);
+		acc20 = _mm256_add_pd(acc20, _mm256_mul_pd(xr, y0));
+		acc21 = _mm256_add_pd(acc21, _mm256_mul_pd(xr, y1));
+		xr = _mm256_loadu_pd(x[3] + i);
+		acc30 = _mm256_add_pd(acc30, _mm256_mul_pd(xr, y0));
+		acc31 = _mm256_add_pd(acc31, _mm256_mul_pd(xr, y1));
+	}
+
+	const __m256d accs[8] = { acc00, acc01, acc10, acc11, acc20, acc21, acc30, acc31 };
+	for (size_t t = 0; t < 8; ++t) {
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(accs[t]), _mm256_extractf128_pd(accs[t], 1));
+		out_dots[t] = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+	iscc_dot_tile_tail(x, y, i, num_dimensions, out_dots);
+}
+
+
+__attribute__((target("avx512f")))
+static void iscc_dot_tile_avx512(const double* const x[const ISCC_DOT_TILE_ROWS],
+                                 const double* const y[const ISCC_DOT_TILE_COLUMNS],
+                                 const size_t num_dimensions,
+                                 double out_dots[const ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS])
+{
+	assert(x != NULL);
+	assert(y != NULL);
+	assert(out_dots != NULL);
+
+	__m512d acc00 = _mm512_setzero_pd(), acc01 = _mm512_setzero_pd();
+	__m512d acc10 = _mm512_setzero_pd(), acc11 = _mm512_setzero_pd();
+	__m512d acc20 = _mm512_setzero_pd(), acc21 = _mm512_setzero_pd();
+	__m512d acc30 = _mm512_setzero_pd(), acc31 = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i < num_dimensions; i += 8) {
+		// Masked loads set the lanes past the end to zero
+		const __mmask8 mask = (i + 8 <= num_dimensions) ? (__mmask8) 0xFF : (__mmask8) ((1u << (num_dimensions - i)) - 1u);
+		const __m512d y0 = _mm512_maskz_loadu_pd(mask, y[0] + i);
+		const __m512d y1 = _mm512_maskz_loadu_pd(mask, y[1] + i);
+		__m512d xr = _mm512_maskz_loadu_pd(mask, x[0] + i);
+		acc00 = _mm512_add_pd(acc00, _mm512_mul_pd(xr, y0));
+		acc01 = _mm512_add_pd(acc01, _mm512_mul_pd(xr, y1));
+		xr = _mm512_maskz_loadu_pd(mask, x[1] + i);
+		acc10 = _mm512_add_pd(acc10, _mm512_mul_pd(xr, y0));
+		acc11 = _mm512_add_pd(acc11, _mm512_mul_pd(xr, y1));
+		xr = _mm512_maskz_loadu_pd(mask, x[2] + i);
+		acc20 = _mm512_add_pd(acc20, _mm512_mul_pd(xr, y0));
+		acc21 = _mm512_add_pd(acc21, _mm512_mul_pd(xr, y1));
+		xr = _mm512_maskz_loadu_pd(mask, x[3] + i);
+		acc30 = _mm512_add_pd(acc30, _mm512_mul_pd(xr, y0));
+		acc31 = _mm512_add_pd(acc31, _mm512_mul_pd(xr, y1));
+	}
+
+	out_dots[0] = _mm512_reduce_add_pd(acc00);
+	out_dots[1] = _mm512_reduce_add_pd(acc01);
+	out_dots[2] = _mm512_reduce_add_pd(acc10);
+	out_dots[3] = _mm512_reduce_add_pd(acc11);
+	out_dots[4] = _mm512_reduce_add_pd(acc20);
+	out_dots[5] = _mm512_reduce_add_pd(acc21);
+	out_dots[6] = _mm512_reduce_add_pd(acc30);
+	out_dots[7] = _mm512_reduce_add_pd(acc31);
+}
+
+
+// Runs when the library is loaded, before any other code can use the kernel
+__attribute__((constructor))
+static void iscc_select_sq_dist_kernel(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		iscc_sq_dist_kernel = iscc_sq_dist_avx512;
+		iscc_sq_dist_float_kernel = iscc_sq_dist_float_avx512;
+		iscc_dot_tile_kernel = iscc_dot_tile_avx512;
+	} else if (__builtin_cpu_supports("avx2")) {
+		iscc_sq_dist_kernel = iscc_sq_dist_avx2;
+		iscc_sq_dist_float_kernel = iscc_sq_dist_float_avx2;
+		iscc_dot_tile_kernel = iscc_dot_tile_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		iscc_sq_dist_kernel = iscc_sq_dist_sse2;
+		iscc_sq_dist_float_kernel = iscc_sq_dist_float_sse2;
+		iscc_dot_tile_kernel = iscc_dot_tile_sse2;
+	} else {
+		iscc_sq_dist_kernel = iscc_sq_dist_scalar;
+		iscc_sq_dist_float_kernel = iscc_sq_dist_float_scalar;
+		iscc_dot_tile_kernel = iscc_dot_tile_scalar;
+	}
+}
+
+#endif // ifdef ISCC_SQ_DIST_DISPATCH
@@ -0,0 +1,259 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+/** @file
+ *
+ *  Squared Euclidean distance kernels.
+ *
+ *  The kernels compute \f$\sum_i (x_i - y_i)^2\f$ for two rows of a data matrix.
+ *  On x86 targets compiled with GCC or Clang, vectorized versions (SSE2, AVX2 and
+ *  AVX-512) are compiled in, and the fastest one supported by the CPU is selected
+ *  once when the library is loaded. On all other targets, only the scalar kernel
+ *  is available.
+ *
+ *  The vectorized kernels use several accumulators and thus sum the terms in a
+ *  different order than the scalar kernel. As all terms are non-negative, any
+ *  summation order has a relative error of at most \f$(d - 1) \epsilon\f$ where
+ *  \f$d\f$ is the number of dimensions and \f$\epsilon\f$ is `DBL_EPSILON`. The
+ *  kernels therefore agree with each other up to a relative difference of
+ *  #ISCC_SQ_DIST_TOLERANCE_FACTOR \f$\times d \epsilon\f$. Rows with fewer than
+ *  #ISCC_SQ_DIST_MIN_VECTOR_DIMENSIONS dimensions are always summed by the scalar
+ *  loop, so results for such data are identical on all machines.
+ *
+ *  Data sets stored in single precision have their own kernels. These convert
+ *  the coordinates to double precision before the differences are taken, so
+ *  they agree with the double precision kernels applied to a converted copy of
+ *  the data up to the same tolerance.
+ *
+ *  For blocks of distances, the dot product kernels compute \f$x \cdot y\f$ for a
+ *  tile of #ISCC_DOT_TILE_ROWS rows and #ISCC_DOT_TILE_COLUMNS columns at once, so
+ *  that each loaded element is used several times. The squared distance is then
+ *  derived as \f$\|x\|^2 + \|y\|^2 - 2 x \cdot y\f$ using norms cached in the
+ *  data set (see #iscc_sq_dist_from_dot). This form suffers from cancellation when
+ *  the distance is small relative to the norms, in which case the distance is
+ *  recomputed with #iscc_get_sq_dist.
+ */
+
+#ifndef SCC_DIST_KERNELS_HG
+#define SCC_DIST_KERNELS_HG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "data_set_struct.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Macros
+// =============================================================================
+
+#if !defined(SCC_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#define ISCC_SQ_DIST_DISPATCH
+#endif
+
+/// Rows with fewer dimensions than this are always summed by the scalar loop.
+#define ISCC_SQ_DIST_MIN_VECTOR_DIMENSIONS 8
+
+/// Kernels agree up to a relative difference of `ISCC_SQ_DIST_TOLERANCE_FACTOR * d * DBL_EPSILON`.
+#define ISCC_SQ_DIST_TOLERANCE_FACTOR 2.0
+
+/// Norms are cached, and blocks of distances are tiled, for data sets with at least this many dimensions.
+#define ISCC_DOT_TILE_MIN_DIMENSIONS 16
+
+/// Number of rows in a dot product tile.
+#define ISCC_DOT_TILE_ROWS 4
+
+/// Number of columns in a dot product tile.
+#define ISCC_DOT_TILE_COLUMNS 2
+
+/// Distances below this fraction of the sum of the squared norms are recomputed from the coordinates.
+#define ISCC_SQ_DIST_RECOMPUTE_FACTOR 1e-4
+
+
+// =============================================================================
+// Structs, types and variables
+// =============================================================================
+
+/// Squared distance kernel between two rows of length `num_dimensions`.
+typedef double (*iscc_SqDistKernel)(const double* x,
+                                    const double* y,
+                                    size_t num_dimensions);
+
+
+/// Squared distance kernel between two single precision rows, computed in double precision.
+typedef double (*iscc_SqDistFloatKernel)(const float* x,
+                                         const float* y,
+                                         size_t num_dimensions);
+
+
+/// Enum of the available kernels.
+typedef enum iscc_SqDistKernelType {
+	ISCC_SQ_DIST_SCALAR,
+	ISCC_SQ_DIST_SSE2,
+	ISCC_SQ_DIST_AVX2,
+	ISCC_SQ_DIST_AVX512,
+	ISCC_SQ_DIST_NUM_KERNELS,
+} iscc_SqDistKernelType;
+
+
+/** Dot product kernel for a tile of rows.
+ *
+ *  Writes the dot product between row `x[r]` and row `y[c]` to
+ *  `out_dots[r * ISCC_DOT_TILE_COLUMNS + c]`.
+ */
+typedef void (*iscc_DotTileKernel)(const double* const x[ISCC_DOT_TILE_ROWS],
+                                   const double* const y[ISCC_DOT_TILE_COLUMNS],
+                                   size_t num_dimensions,
+                                   double out_dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS]);
+
+
+/// The kernel selected when the library was loaded.
+extern iscc_SqDistKernel iscc_sq_dist_kernel;
+
+
+/// The single precision kernel selected when the library was loaded.
+extern iscc_SqDistFloatKernel iscc_sq_dist_float_kernel;
+
+
+/// The dot product kernel selected when the library was loaded.
+extern iscc_DotTileKernel iscc_dot_tile_kernel;
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/** Returns the requested kernel.
+ *
+ *  \param kernel_type the kernel to get.
+ *
+ *  \return the kernel if it is compiled in and supported by the CPU, otherwise `NULL`.
+ */
+iscc_SqDistKernel iscc_get_sq_dist_kernel(iscc_SqDistKernelType kernel_type);
+
+
+/// Returns the requested single precision kernel, or `NULL` if it is not compiled in or not supported by the CPU.
+iscc_SqDistFloatKernel iscc_get_sq_dist_float_kernel(iscc_SqDistKernelType kernel_type);
+
+
+/// Returns the requested dot product kernel, or `NULL` if it is not compiled in or not supported by the CPU.
+iscc_DotTileKernel iscc_get_dot_tile_kernel(iscc_SqDistKernelType kernel_type);
+
+
+/// Returns the name of a kernel type.
+const char* iscc_get_sq_dist_kernel_name(iscc_SqDistKernelType kernel_type);
+
+
+// =============================================================================
+// Inline function implementations
+// =============================================================================
+
+/// Scalar squared distance, summing the terms in order.
+static inline double iscc_sq_dist_scalar_inline(const double* x,
+                                                const double* const x_stop,
+                                                const double* y)
+{
+	double tmp_dist = 0.0;
+	while (x != x_stop) {
+		const double value_diff = (*x - *y);
+		++x;
+		++y;
+		tmp_dist += value_diff * value_diff;
+	}
+	return tmp_dist;
+}
+
+
+/// Scalar squared distance between single precision rows, summing the terms in order.
+static inline double iscc_sq_dist_float_scalar_inline(const float* x,
+                                                      const float* const x_stop,
+                                                      const float* y)
+{
+	double tmp_dist = 0.0;
+	while (x != x_stop) {
+		const double value_diff = ((double) *x - (double) *y);
+		++x;
+		++y;
+		tmp_dist += value_diff * value_diff;
+	}
+	return tmp_dist;
+}
+
+
+/// Squared distance between two data points in a `scc_DataSet`, using the selected kernel.
+static inline double iscc_get_sq_dist(const scc_DataSet* const data_set,
+                                      const size_t index1,
+                                      const size_t index2)
+{
+	assert(index1 < data_set->num_data_points);
+	assert(index2 < data_set->num_data_points);
+
+	const size_t num_dimensions = data_set->num_dimensions;
+
+	if (data_set->float_matrix != NULL) {
+		const float* const fdata1 = &data_set->float_matrix[index1 * num_dimensions];
+		const float* const fdata2 = &data_set->float_matrix[index2 * num_dimensions];
+		if (num_dimensions < ISCC_SQ_DIST_MIN_VECTOR_DIMENSIONS) {
+			return iscc_sq_dist_float_scalar_inline(fdata1, fdata1 + num_dimensions, fdata2);
+		}
+		return iscc_sq_dist_float_kernel(fdata1, fdata2, num_dimensions);
+	}
+
+	const double* const data1 = &data_set->data_matrix[index1 * num_dimensions];
+	const double* const data2 = &data_set->data_matrix[index2 * num_dimensions];
+
+	// Few dimensions: the call overhead would dominate the vectorized kernel
+	if (num_dimensions < ISCC_SQ_DIST_MIN_VECTOR_DIMENSIONS) {
+		return iscc_sq_dist_scalar_inline(data1, data1 + num_dimensions, data2);
+	}
+	return iscc_sq_dist_kernel(data1, data2, num_dimensions);
+}
+
+
+/** Squared distance between two data points derived from their dot product.
+ *
+ *  Requires that the data set has cached squared norms. When the result is
+ *  small relative to the norms (including when it is negative due to rounding),
+ *  the distance is instead recomputed with #iscc_get_sq_dist.
+ */
+static inline double iscc_sq_dist_from_dot(const scc_DataSet* const data_set,
+                                           const size_t index1,
+                                           const size_t index2,
+                                           const double dot)
+{
+	assert(data_set->sq_norms != NULL);
+	const double norm_sum = data_set->sq_norms[index1] + data_set->sq_norms[index2];
+	const double sq_dist = norm_sum - 2.0 * dot;
+	if (sq_dist < ISCC_SQ_DIST_RECOMPUTE_FACTOR * norm_sum) {
+		return iscc_get_sq_dist(data_set, index1, index2);
+	}
+	return sq_dist;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_DIST_KERNELS_HG
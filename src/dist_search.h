@@ -25,42 +25,47 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "../include/scclust_spi.h"
+#include "nn_search_cache.h"
+#include "profile.h"
+#include "threads.h"
 
 
 // =============================================================================
 // Structs and variables
 // =============================================================================
 
-typedef struct iscc_dist_functions_struct {
-	scc_check_data_set check_data_set;
-	scc_num_data_points num_data_points;
-	scc_get_dist_matrix get_dist_matrix;
-	scc_get_dist_rows get_dist_rows;
-	scc_init_max_dist_object init_max_dist_object;
-	scc_get_max_dist get_max_dist;
-	scc_close_max_dist_object close_max_dist_object;
-	scc_init_nn_search_object init_nn_search_object;
-	scc_nearest_neighbor_search nearest_neighbor_search;
-	scc_close_nn_search_object close_nn_search_object;
-} iscc_dist_functions_struct;
+typedef scc_DistFunctions iscc_dist_functions_struct;
 
 
+// Global distance functions, set by `scc_set_dist_functions`
 extern iscc_dist_functions_struct iscc_dist_functions;
 
 
+// Distance functions of the current call in this thread. If `NULL`, the global
+// functions are used. Parallel regions that call the functions below must pass
+// this pointer on to their worker threads.
+extern ISCC_THREAD_LOCAL const iscc_dist_functions_struct* iscc_current_dist_functions;
+
+
+static inline const iscc_dist_functions_struct* iscc_get_dist_functions(void)
+{
+	return (iscc_current_dist_functions != NULL) ? iscc_current_dist_functions : &iscc_dist_functions;
+}
+
+
 // =============================================================================
 // Miscellaneous functions
 // =============================================================================
 
 static inline bool iscc_check_data_set(void* data_set)
 {
-	return iscc_dist_functions.check_data_set(data_set);
+	return iscc_get_dist_functions()->check_data_set(data_set);
 }
 
 
 static inline size_t iscc_num_data_points(void* data_set)
 {
-	return iscc_dist_functions.num_data_points(data_set);
+	return iscc_get_dist_functions()->num_data_points(data_set);
 }
 
 
@@ -69,10 +74,11 @@ static inline bool iscc_get_dist_matrix(void* data_set,
                                         const scc_PointIndex point_indices[],
                                         double output_dists[])
 {
-	return iscc_dist_functions.get_dist_matrix(data_set,
-	                                           len_point_indices,
-	                                           point_indices,
-	                                           output_dists);
+	iscc_profile_count_dists(((uint64_t) len_point_indices) * ((uint64_t) len_point_indices - 1) / 2);
+	return iscc_get_dist_functions()->get_dist_matrix(data_set,
+	                                                  len_point_indices,
+	                                                  point_indices,
+	                                                  output_dists);
 }
 
 
@@ -83,12 +89,13 @@ static inline bool iscc_get_dist_rows(void* data_set,
                                       const scc_PointIndex column_indices[],
                                       double output_dists[])
 {
-	return iscc_dist_functions.get_dist_rows(data_set,
-	                                         len_query_indices,
-	                                         query_indices,
-	                                         len_column_indices,
-	                                         column_indices,
-	                                         output_dists);
+	iscc_profile_count_dists(((uint64_t) len_query_indices) * ((uint64_t) len_column_indices));
+	return iscc_get_dist_functions()->get_dist_rows(data_set,
+	                                                len_query_indices,
+	                                                query_indices,
+	                                                len_column_indices,
+	                                                column_indices,
+	                                                output_dists);
 }
 
 
@@ -101,10 +108,10 @@ static inline bool iscc_init_max_dist_object(void* data_set,
                                              const scc_PointIndex search_indices[],
                                              iscc_MaxDistObject** out_max_dist_object)
 {
-	return iscc_dist_functions.init_max_dist_object(data_set,
-	                                                len_search_indices,
-	                                                search_indices,
-	                                                out_max_dist_object);
+	return iscc_get_dist_functions()->init_max_dist_object(data_set,
+	                                                       len_search_indices,
+	                                                       search_indices,
+	                                                       out_max_dist_object);
 }
 
 
@@ -114,17 +121,18 @@ static inline bool iscc_get_max_dist(iscc_MaxDistObject* max_dist_object,
                                      scc_PointIndex out_max_indices[],
                                      double out_max_dists[])
 {
-	return iscc_dist_functions.get_max_dist(max_dist_object,
-	                                        len_query_indices,
-	                                        query_indices,
-	                                        out_max_indices,
-	                                        out_max_dists);
+	iscc_profile_count_queries((uint64_t) len_query_indices);
+	return iscc_get_dist_functions()->get_max_dist(max_dist_object,
+	                                               len_query_indices,
+	                                               query_indices,
+	                                               out_max_indices,
+	                                               out_max_dists);
 }
 
 
 static inline bool iscc_close_max_dist_object(iscc_MaxDistObject** max_dist_object)
 {
-	return iscc_dist_functions.close_max_dist_object(max_dist_object);
+	return iscc_get_dist_functions()->close_max_dist_object(max_dist_object);
 }
 
 
@@ -137,10 +145,16 @@ static inline bool iscc_init_nn_search_object(void* data_set,
                                               const scc_PointIndex search_indices[],
                                               iscc_NNSearchObject** out_nn_search_object)
 {
-	return iscc_dist_functions.init_nn_search_object(data_set,
-	                                                 len_search_indices,
-	                                                 search_indices,
-	                                                 out_nn_search_object);
+	if (iscc_nn_search_cache_is_pinned(data_set)) {
+		return iscc_nn_search_cache_get(data_set,
+		                                len_search_indices,
+		                                search_indices,
+		                                out_nn_search_object);
+	}
+	return iscc_get_dist_functions()->init_nn_search_object(data_set,
+	                                                        len_search_indices,
+	                                                        search_indices,
+	                                                        out_nn_search_object);
 }
 
 
@@ -154,21 +168,24 @@ static inline bool iscc_nearest_neighbor_search(iscc_NNSearchObject* nn_search_o
                                                 scc_PointIndex out_query_indices[],
                                                 scc_PointIndex out_nn_indices[])
 {
-	return iscc_dist_functions.nearest_neighbor_search(nn_search_object,
-	                                                   len_query_indices,
-	                                                   query_indices,
-	                                                   k,
-	                                                   radius_search,
-	                                                   radius,
-	                                                   out_num_ok_queries,
-	                                                   out_query_indices,
-	                                                   out_nn_indices);
+	iscc_profile_count_queries((uint64_t) len_query_indices);
+	return iscc_get_dist_functions()->nearest_neighbor_search(nn_search_object,
+	                                                          len_query_indices,
+	                                                          query_indices,
+	                                                          k,
+	                                                          radius_search,
+	                                                          radius,
+	                                                          out_num_ok_queries,
+	                                                          out_query_indices,
+	                                                          out_nn_indices);
 }
 
 
 static inline bool iscc_close_nn_search_object(iscc_NNSearchObject** nn_search_object)
 {
-	return iscc_dist_functions.close_nn_search_object(nn_search_object);
+	// Cached objects are given back to the cache
+	if (iscc_nn_search_cache_release(nn_search_object)) return true;
+	return iscc_get_dist_functions()->close_nn_search_object(nn_search_object);
 }
 
 
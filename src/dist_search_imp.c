@@ -25,34 +25,61 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../include/scclust.h"
 #include "data_set_struct.h"
+#include "dist_kernels.h"
+#include "hnsw.h"
+#include "kdtree.h"
 #include "scclust_types.h"
+#include "threads.h"
+
+#if !defined(SCC_NO_SIMD) && defined(__SSE2__)
+	#define ISCC_PIVOT_SSE2
+	#include <emmintrin.h>
+#endif
 
 
 // =============================================================================
-// Distance calculations
+// Static function prototypes
 // =============================================================================
 
-static inline double iscc_get_sq_dist(const scc_DataSet* const data_set,
-                                      const size_t index1,
-                                      const size_t index2)
+// Column blocks of the tiled distance calculations are sized to hold about
+// this many coordinates, so that they stay in cache while the rows pass over
+#define ISCC_DIST_COLUMN_BLOCK_DOUBLES 16384
+
+
+static void iscc_get_dist_matrix_tiled(const scc_DataSet* data_set,
+                                       size_t len_point_indices,
+                                       const scc_PointIndex point_indices[],
+                                       double output_dists[]);
+
+
+static void iscc_get_dist_rows_tiled(const scc_DataSet* data_set,
+                                     size_t len_query_indices,
+                                     const scc_PointIndex query_indices[],
+                                     size_t len_column_indices,
+                                     const scc_PointIndex column_indices[],
+                                     double output_dists[]);
+
+
+static inline size_t iscc_get_point_index(const scc_PointIndex indices[const],
+                                          const size_t i)
 {
-	assert(index1 < data_set->num_data_points);
-	assert(index2 < data_set->num_data_points);
+	return (indices == NULL) ? i : (size_t) indices[i];
+}
 
-	const double* data1 = &data_set->data_matrix[index1 * data_set->num_dimensions];
-	const double* const data1_stop = data1 + data_set->num_dimensions;
-	const double* data2 = &data_set->data_matrix[index2 * data_set->num_dimensions];
 
-	double tmp_dist = 0.0;
-	while (data1 != data1_stop) {
-		const double value_diff = (*data1 - *data2);
-		++data1;
-		++data2;
-		tmp_dist += value_diff * value_diff;
+// The search index loaded by `scc_load_nn_search_index`, if the search points
+// are all points in the data set
+static inline iscc_KDTree* iscc_get_nn_index(const scc_DataSet* const data_set,
+                                             const size_t len_search_indices,
+                                             const scc_PointIndex search_indices[const])
+{
+	if ((search_indices == NULL) && (len_search_indices == data_set->num_data_points)) {
+		return data_set->nn_index;
 	}
-	return tmp_dist;
+	return NULL;
 }
 
 
@@ -87,6 +114,11 @@ bool iscc_imp_get_dist_matrix(void* const data_set,
 	assert(len_point_indices > 1);
 	assert(output_dists != NULL);
 
+	if (((const scc_DataSet*) data_set)->sq_norms != NULL) {
+		iscc_get_dist_matrix_tiled(data_set, len_point_indices, point_indices, output_dists);
+		return true;
+	}
+
 	if (point_indices == NULL) {
 		for (size_t p1 = 0; p1 < len_point_indices; ++p1) {
 			for (size_t p2 = p1 + 1; p2 < len_point_indices; ++p2) {
@@ -119,6 +151,11 @@ bool iscc_imp_get_dist_rows(void* const data_set,
 	assert(len_column_indices > 0);
 	assert(output_dists != NULL);
 
+	if (((const scc_DataSet*) data_set)->sq_norms != NULL) {
+		iscc_get_dist_rows_tiled(data_set, len_query_indices, query_indices, len_column_indices, column_indices, output_dists);
+		return true;
+	}
+
 	if ((query_indices != NULL) && (column_indices != NULL)) {
 		for (size_t q = 0; q < len_query_indices; ++q) {
 			for (size_t c = 0; c < len_column_indices; ++c) {
@@ -160,15 +197,19 @@ bool iscc_imp_get_dist_rows(void* const data_set,
 // Max dist functions implementations
 // =============================================================================
 
-struct iscc_MaxDistObject {
-	int32_t max_dist_version;
-	scc_DataSet* data_set;
-	size_t len_search_indices;
-	const scc_PointIndex* search_indices;
-};
+static const int32_t ISCC_MAXDIST_STRUCT_VERSION = 722439001;
 
 
-static const int32_t ISCC_MAXDIST_STRUCT_VERSION = 722439001;
+// kd-trees are only built for max dist objects with at least this many search
+// points, as building the tree costs more than it saves for smaller sets
+#define ISCC_MAXDIST_MIN_KDTREE_POINTS 1024
+
+// Bounding boxes prune too little in more dimensions than this for the tree to pay off
+#define ISCC_MAXDIST_MAX_KDTREE_DIMENSIONS 8
+
+// Max dist objects are queried only a few hundred times, so their trees are
+// kept shallow with about this many leaves
+#define ISCC_MAXDIST_KDTREE_LEAVES 64
 
 
 bool iscc_imp_init_max_dist_object(void* const data_set,
@@ -183,14 +224,60 @@ bool iscc_imp_init_max_dist_object(void* const data_set,
 	*out_max_dist_object = malloc(sizeof(iscc_MaxDistObject));
 	if (*out_max_dist_object == NULL) return false;
 
-	**out_max_dist_object = (iscc_MaxDistObject) {
+	iscc_imp_set_max_dist_object(data_set, len_search_indices, search_indices, *out_max_dist_object);
+
+	return true;
+}
+
+
+bool iscc_imp_init_kdtree_max_dist_object(void* const data_set,
+                                          const size_t len_search_indices,
+                                          const scc_PointIndex search_indices[const],
+                                          iscc_MaxDistObject** const out_max_dist_object)
+{
+	assert(iscc_imp_check_data_set(data_set));
+	assert(len_search_indices > 0);
+	assert(out_max_dist_object != NULL);
+
+	iscc_KDTree* kd_tree = NULL;
+	if ((len_search_indices >= ISCC_MAXDIST_MIN_KDTREE_POINTS) &&
+	        (((const scc_DataSet*) data_set)->num_dimensions <= ISCC_MAXDIST_MAX_KDTREE_DIMENSIONS)) {
+		size_t leaf_size = len_search_indices / ISCC_MAXDIST_KDTREE_LEAVES;
+		if (leaf_size < ISCC_KDT_NN_LEAF_SIZE) leaf_size = ISCC_KDT_NN_LEAF_SIZE;
+		if (!iscc_kdt_build_tree(data_set, len_search_indices, search_indices, leaf_size, true, &kd_tree)) {
+			return false;
+		}
+	}
+
+	*out_max_dist_object = malloc(sizeof(iscc_MaxDistObject));
+	if (*out_max_dist_object == NULL) {
+		iscc_kdt_free_tree(&kd_tree);
+		return false;
+	}
+
+	iscc_imp_set_max_dist_object(data_set, len_search_indices, search_indices, *out_max_dist_object);
+	(*out_max_dist_object)->kd_tree = kd_tree;
+
+	return true;
+}
+
+
+void iscc_imp_set_max_dist_object(void* const data_set,
+                                  const size_t len_search_indices,
+                                  const scc_PointIndex search_indices[const],
+                                  iscc_MaxDistObject* const out_max_dist_object)
+{
+	assert(iscc_imp_check_data_set(data_set));
+	assert(len_search_indices > 0);
+	assert(out_max_dist_object != NULL);
+
+	*out_max_dist_object = (iscc_MaxDistObject) {
 		.max_dist_version = ISCC_MAXDIST_STRUCT_VERSION,
 		.data_set = data_set,
 		.len_search_indices = len_search_indices,
 		.search_indices = search_indices,
+		.kd_tree = NULL,
 	};
-
-	return true;
 }
 
 
@@ -212,6 +299,17 @@ bool iscc_imp_get_max_dist(iscc_MaxDistObject* const max_dist_object,
 	assert(out_max_indices != NULL);
 	assert(out_max_dists != NULL);
 
+	if (max_dist_object->kd_tree != NULL) {
+		for (size_t q = 0; q < len_query_indices; ++q) {
+			double max_dist_sq;
+			out_max_indices[q] = iscc_kdt_farthest_point(max_dist_object->kd_tree,
+			                                             iscc_get_point_index(query_indices, q),
+			                                             &max_dist_sq);
+			out_max_dists[q] = sqrt(max_dist_sq);
+		}
+		return true;
+	}
+
 	double tmp_dist;
 	double max_dist;
 
@@ -276,6 +374,7 @@ bool iscc_imp_close_max_dist_object(iscc_MaxDistObject** const max_dist_object)
 {
 	if (max_dist_object != NULL && *max_dist_object != NULL) {
 		assert((*max_dist_object)->max_dist_version == ISCC_MAXDIST_STRUCT_VERSION);
+		iscc_kdt_free_tree(&(*max_dist_object)->kd_tree);
 		free(*max_dist_object);
 		*max_dist_object = NULL;
 	}
@@ -292,28 +391,429 @@ struct iscc_NNSearchObject {
 	scc_DataSet* data_set;
 	size_t len_search_indices;
 	const scc_PointIndex* search_indices;
+	iscc_KDTree* kd_tree;
+	// `false` when `kd_tree` is the search index of the data set, which is freed with the data set
+	bool owns_kd_tree;
+	struct iscc_PivotTable* pivots;
+	iscc_HNSW* hnsw;
 };
 
 
+typedef struct iscc_PivotTable iscc_PivotTable;
+
+
 static const int32_t ISCC_NN_SEARCH_STRUCT_VERSION = 722294001;
 
 
-static inline void iscc_add_dist_to_list(const double add_dist,
-                                         const scc_PointIndex add_index,
-                                         double* dist_list,
-                                         scc_PointIndex* index_list,
-                                         const double* const dist_list_start)
+// Searches with fewer queries than this are not split between threads
+#define ISCC_NN_MIN_PARALLEL_QUERIES 64
+
+
+// Brute-force queries with at least this many neighbors keep their candidates
+// in a heap rather than in a sorted list
+#define ISCC_NN_HEAP_MIN_K 64
+
+
+// The candidates of a brute-force query are ordered by distance and then by
+// position in the search set. As search points are visited in order, a point
+// at the same distance as the last candidate is never added, so ties are
+// broken in favor of earlier points.
+//
+// For small `k`, candidates are kept in a sorted list, where adding a
+// candidate takes O(k) time. For large `k`, they are kept in a max-heap,
+// where it takes O(log k) time, and the heap is sorted once the search is
+// done. Both give exactly the same result.
+
+// Whether candidate `a` is ordered after candidate `b`
+static inline bool iscc_nn_heap_after(const double dist_a,
+                                      const scc_PointIndex pos_a,
+                                      const double dist_b,
+                                      const scc_PointIndex pos_b)
+{
+	return (dist_a > dist_b) || (!(dist_a < dist_b) && (pos_a > pos_b));
+}
+
+
+// Adds a candidate to a heap of length `len`
+static inline void iscc_nn_heap_push(double* const dists,
+                                     scc_PointIndex* const positions,
+                                     const size_t len,
+                                     const double dist,
+                                     const scc_PointIndex pos)
+{
+	size_t i = len;
+	while (i > 0) {
+		const size_t parent = (i - 1) / 2;
+		if (!iscc_nn_heap_after(dist, pos, dists[parent], positions[parent])) break;
+		dists[i] = dists[parent];
+		positions[i] = positions[parent];
+		i = parent;
+	}
+	dists[i] = dist;
+	positions[i] = pos;
+}
+
+
+// Replaces the top of a heap of length `len` with a candidate
+static inline void iscc_nn_heap_replace_top(double* const dists,
+                                            scc_PointIndex* const positions,
+                                            const size_t len,
+                                            const double dist,
+                                            const scc_PointIndex pos)
+{
+	size_t i = 0;
+	for (size_t child = 1; child < len; child = 2 * i + 1) {
+		if ((child + 1 < len) &&
+		        iscc_nn_heap_after(dists[child + 1], positions[child + 1], dists[child], positions[child])) {
+			++child;
+		}
+		if (!iscc_nn_heap_after(dists[child], positions[child], dist, pos)) break;
+		dists[i] = dists[child];
+		positions[i] = positions[child];
+		i = child;
+	}
+	dists[i] = dist;
+	positions[i] = pos;
+}
+
+
+// Sorts a heap of length `len` in ascending order
+static void iscc_nn_heap_sort(double* const dists,
+                              scc_PointIndex* const positions,
+                              size_t len)
+{
+	while (len > 1) {
+		--len;
+		const double dist = dists[len];
+		const scc_PointIndex pos = positions[len];
+		dists[len] = dists[0];
+		positions[len] = positions[0];
+		iscc_nn_heap_replace_top(dists, positions, len, dist, pos);
+	}
+}
+
+
+// Inserts a candidate in a sorted list of length `len`
+static inline void iscc_nn_list_insert(double* const dists,
+                                       scc_PointIndex* const positions,
+                                       size_t len,
+                                       const double dist,
+                                       const scc_PointIndex pos)
+{
+	for (; (len > 0) && (dist < dists[len - 1]); --len) {
+		dists[len] = dists[len - 1];
+		positions[len] = positions[len - 1];
+	}
+	dists[len] = dist;
+	positions[len] = pos;
+}
+
+
+// Adds a candidate when there are `len < k` candidates
+static inline void iscc_nn_add_candidate(const bool use_heap,
+                                         double* const dists,
+                                         scc_PointIndex* const positions,
+                                         const size_t len,
+                                         const double dist,
+                                         const scc_PointIndex pos)
+{
+	if (use_heap) {
+		iscc_nn_heap_push(dists, positions, len, dist, pos);
+	} else {
+		iscc_nn_list_insert(dists, positions, len, dist, pos);
+	}
+}
+
+
+// Replaces the last of `k` candidates, and returns the distance of the new last candidate
+static inline double iscc_nn_replace_candidate(const bool use_heap,
+                                               double* const dists,
+                                               scc_PointIndex* const positions,
+                                               const size_t k,
+                                               const double dist,
+                                               const scc_PointIndex pos)
+{
+	if (use_heap) {
+		iscc_nn_heap_replace_top(dists, positions, k, dist, pos);
+		return dists[0];
+	}
+	iscc_nn_list_insert(dists, positions, k - 1, dist, pos);
+	return dists[k - 1];
+}
+
+
+// Pivot tables are only built for search sets with at least this many points
+#define ISCC_PIVOT_MIN_POINTS 256
+
+// In fewer dimensions, checking the bounds costs about as much as calculating
+// the distance itself
+#define ISCC_PIVOT_MIN_DIMENSIONS 8
+
+// Must be a multiple of four
+#define ISCC_PIVOT_NUM_PIVOTS 8
+
+// Distances to the pivots are stored in single precision, so the bounds are
+// loosened by this fraction of the largest distances they are derived from.
+// This is far larger than the rounding errors, so a point is never skipped
+// unless the brute-force search would have rejected it as well.
+#define ISCC_PIVOT_TOLERANCE 1e-6
+
+
+// The search points are sorted by their distance to the first pivot. A query
+// visits the points in order of how much this distance differs from its own,
+// so it can stop once the difference alone exceeds the distance to the
+// farthest candidate. The other pivots are used to skip points within that range.
+struct iscc_PivotTable {
+	size_t pivots[ISCC_PIVOT_NUM_PIVOTS];
+	// Positions in the search set, sorted by distance to the first pivot
+	scc_PointIndex* order;
+	// `dists[i * ISCC_PIVOT_NUM_PIVOTS + p]` is the distance between the point
+	// at position `order[i]` in the search set and pivot `p`
+	float* dists;
+	double max_dist;
+};
+
+
+typedef struct iscc_PivotSortItem {
+	double dist;
+	scc_PointIndex pos;
+} iscc_PivotSortItem;
+
+
+static int iscc_compare_PivotSortItem(const void* const a,
+                                      const void* const b)
+{
+	const iscc_PivotSortItem* const item1 = (const iscc_PivotSortItem*) a;
+	const iscc_PivotSortItem* const item2 = (const iscc_PivotSortItem*) b;
+	if (item1->dist < item2->dist) return -1;
+	if (item1->dist > item2->dist) return 1;
+	return (item1->pos > item2->pos) - (item1->pos < item2->pos);
+}
+
+
+// Pivots are picked farthest-first, so that they are spread out over the search
+// points. If all points coincide with the pivots already picked, the remaining
+// pivots repeat the first one.
+static bool iscc_build_pivot_table(const scc_DataSet* const data_set,
+                                   const size_t len_search_indices,
+                                   const scc_PointIndex search_indices[const],
+                                   iscc_PivotTable** const out_pivots)
+{
+	assert(out_pivots != NULL);
+
+	*out_pivots = NULL;
+	if ((len_search_indices < ISCC_PIVOT_MIN_POINTS) ||
+	        (data_set->num_dimensions < ISCC_PIVOT_MIN_DIMENSIONS)) {
+		return true;
+	}
+
+	iscc_PivotTable* const pivots = malloc(sizeof(iscc_PivotTable));
+	scc_PointIndex* const order = malloc(sizeof(scc_PointIndex[len_search_indices]));
+	float* const dists = malloc(sizeof(float[len_search_indices * ISCC_PIVOT_NUM_PIVOTS]));
+	float* const unsorted_dists = malloc(sizeof(float[len_search_indices * ISCC_PIVOT_NUM_PIVOTS]));
+	iscc_PivotSortItem* const sort_items = malloc(sizeof(iscc_PivotSortItem[len_search_indices]));
+	if ((pivots == NULL) || (order == NULL) || (dists == NULL) ||
+	        (unsorted_dists == NULL) || (sort_items == NULL)) {
+		free(pivots);
+		free(order);
+		free(dists);
+		free(unsorted_dists);
+		free(sort_items);
+		return false;
+	}
+
+	// Until the pivots are picked, `sort_items[s].dist` is the squared distance
+	// to the closest pivot so far. The first pivot is the point farthest from
+	// the first search point.
+	const size_t first_point = iscc_get_point_index(search_indices, 0);
+	for (size_t s = 0; s < len_search_indices; ++s) {
+		sort_items[s].dist = iscc_get_sq_dist(data_set, first_point, iscc_get_point_index(search_indices, s));
+	}
+
+	double max_dist = 0.0;
+	for (size_t p = 0; p < ISCC_PIVOT_NUM_PIVOTS; ++p) {
+		size_t next_pivot = 0;
+		for (size_t s = 1; s < len_search_indices; ++s) {
+			if (sort_items[next_pivot].dist < sort_items[s].dist) next_pivot = s;
+		}
+
+		if ((p > 0) && !(sort_items[next_pivot].dist > 0.0)) {
+			pivots->pivots[p] = pivots->pivots[0];
+			for (size_t s = 0; s < len_search_indices; ++s) {
+				unsorted_dists[s * ISCC_PIVOT_NUM_PIVOTS + p] = unsorted_dists[s * ISCC_PIVOT_NUM_PIVOTS];
+			}
+			continue;
+		}
+
+		pivots->pivots[p] = iscc_get_point_index(search_indices, next_pivot);
+		for (size_t s = 0; s < len_search_indices; ++s) {
+			const double sq_dist = iscc_get_sq_dist(data_set, pivots->pivots[p], iscc_get_point_index(search_indices, s));
+			const double dist = sqrt(sq_dist);
+			unsorted_dists[s * ISCC_PIVOT_NUM_PIVOTS + p] = (float) dist;
+			if (max_dist < dist) max_dist = dist;
+			if ((p == 0) || (sq_dist < sort_items[s].dist)) sort_items[s].dist = sq_dist;
+		}
+	}
+
+	for (size_t s = 0; s < len_search_indices; ++s) {
+		sort_items[s].dist = (double) unsorted_dists[s * ISCC_PIVOT_NUM_PIVOTS];
+		sort_items[s].pos = (scc_PointIndex) s;
+	}
+	qsort(sort_items, len_search_indices, sizeof(iscc_PivotSortItem), iscc_compare_PivotSortItem);
+
+	for (size_t i = 0; i < len_search_indices; ++i) {
+		order[i] = sort_items[i].pos;
+		memcpy(dists + i * ISCC_PIVOT_NUM_PIVOTS,
+		       unsorted_dists + ((size_t) order[i]) * ISCC_PIVOT_NUM_PIVOTS,
+		       sizeof(float[ISCC_PIVOT_NUM_PIVOTS]));
+	}
+
+	free(unsorted_dists);
+	free(sort_items);
+
+	pivots->order = order;
+	pivots->dists = dists;
+	pivots->max_dist = max_dist;
+	*out_pivots = pivots;
+
+	return true;
+}
+
+
+static void iscc_free_pivot_table(iscc_PivotTable** const pivots)
+{
+	if (pivots != NULL && *pivots != NULL) {
+		free((*pivots)->order);
+		free((*pivots)->dists);
+		free(*pivots);
+		*pivots = NULL;
+	}
+}
+
+
+// Returns true if the `i`th point in the table is certain to be farther than
+// `bound` from the query, using |d(q, p) - d(s, p)| <= d(q, s)
+static inline bool iscc_pivots_exclude(const iscc_PivotTable* const pivots,
+                                       const float query_dists[const],
+                                       const size_t i,
+                                       const float bound)
 {
-	assert(dist_list != NULL);
-	assert(index_list != NULL);
-	assert(dist_list_start != NULL);
+	const float* const search_dists = pivots->dists + i * ISCC_PIVOT_NUM_PIVOTS;
+
+	#ifdef ISCC_PIVOT_SSE2
+		const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 lower = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(query_dists), _mm_loadu_ps(search_dists)), abs_mask);
+		for (size_t p = 4; p < ISCC_PIVOT_NUM_PIVOTS; p += 4) {
+			const __m128 tmp_lower = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(query_dists + p),
+			                                               _mm_loadu_ps(search_dists + p)), abs_mask);
+			lower = _mm_max_ps(lower, tmp_lower);
+		}
+		return (_mm_movemask_ps(_mm_cmpgt_ps(lower, _mm_set1_ps(bound))) != 0);
+	#else
+		// Four independent maxima, so the comparisons do not wait on each other
+		float lower[4];
+		for (size_t j = 0; j < 4; ++j) {
+			lower[j] = fabsf(query_dists[j] - search_dists[j]);
+		}
+		for (size_t p = 4; p < ISCC_PIVOT_NUM_PIVOTS; p += 4) {
+			for (size_t j = 0; j < 4; ++j) {
+				const float tmp_lower = fabsf(query_dists[p + j] - search_dists[p + j]);
+				lower[j] = (lower[j] < tmp_lower) ? tmp_lower : lower[j];
+			}
+		}
+		return (lower[0] > bound) || (lower[1] > bound) || (lower[2] > bound) || (lower[3] > bound);
+	#endif
+}
+
 
-	for (; (dist_list != dist_list_start) && (add_dist < dist_list[-1]); --dist_list, --index_list) {
-		dist_list[0] = dist_list[-1];
-		index_list[0] = index_list[-1];
+// Checks the `i`th point in the table as a candidate for `iscc_pivot_nn_query`,
+// and updates the bound on the distance to accepted candidates
+static inline void iscc_pivot_nn_candidate(const scc_DataSet* const data_set,
+                                           const iscc_PivotTable* const pivots,
+                                           const scc_PointIndex search_indices[const],
+                                           const size_t query,
+                                           const uint32_t k,
+                                           const bool radius_search,
+                                           const double radius_sq,
+                                           const float query_dists[const],
+                                           const double slack,
+                                           const size_t i,
+                                           double* const bound,
+                                           uint32_t* const found,
+                                           double cand_dists[const],
+                                           scc_PointIndex cand_positions[const])
+{
+	if (iscc_pivots_exclude(pivots, query_dists, i, (float) *bound)) return;
+
+	const scc_PointIndex pos = pivots->order[i];
+	const double tmp_dist = iscc_get_sq_dist(data_set, query, iscc_get_point_index(search_indices, pos));
+	if (*found < k) {
+		if (radius_search && (tmp_dist > radius_sq)) return;
+		iscc_nn_heap_push(cand_dists, cand_positions, *found, tmp_dist, pos);
+		++(*found);
+		if (*found == k) *bound = sqrt(cand_dists[0]) + slack;
+	} else if (iscc_nn_heap_after(cand_dists[0], cand_positions[0], tmp_dist, pos)) {
+		iscc_nn_heap_replace_top(cand_dists, cand_positions, k, tmp_dist, pos);
+		*bound = sqrt(cand_dists[0]) + slack;
 	}
-	dist_list[0] = add_dist;
-	index_list[0] = add_index;
+}
+
+
+// Finds the nearest search points to `query` and stores them in a heap, in the
+// same way as the brute-force search. As candidates are compared by both
+// distance and position, the order in which points are visited does not
+// change the result.
+static uint32_t iscc_pivot_nn_query(const scc_DataSet* const data_set,
+                                    const iscc_PivotTable* const pivots,
+                                    const size_t len_search_indices,
+                                    const scc_PointIndex search_indices[const],
+                                    const size_t query,
+                                    const uint32_t k,
+                                    const bool radius_search,
+                                    const double radius_sq,
+                                    double cand_dists[const],
+                                    scc_PointIndex cand_positions[const])
+{
+	float query_dists[ISCC_PIVOT_NUM_PIVOTS];
+	double max_query_dist = 0.0;
+	for (size_t p = 0; p < ISCC_PIVOT_NUM_PIVOTS; ++p) {
+		const double dist = sqrt(iscc_get_sq_dist(data_set, query, pivots->pivots[p]));
+		query_dists[p] = (float) dist;
+		if (max_query_dist < dist) max_query_dist = dist;
+	}
+	const double slack = ISCC_PIVOT_TOLERANCE * (max_query_dist + pivots->max_dist);
+	const double query_dist0 = (double) query_dists[0];
+	double bound = radius_search ? sqrt(radius_sq) + slack : HUGE_VAL;
+
+	// First point with a distance to the first pivot not less than the query's
+	size_t up = 0;
+	size_t down = len_search_indices;
+	while (up < down) {
+		const size_t mid = up + (down - up) / 2;
+		if ((double) pivots->dists[mid * ISCC_PIVOT_NUM_PIVOTS] < query_dist0) {
+			up = mid + 1;
+		} else {
+			down = mid;
+		}
+	}
+
+	// Points with larger distances to the first pivot are visited first, and then
+	// those with smaller distances. Alternating between the two would visit the
+	// closest points earlier, but the branches would be unpredictable.
+	uint32_t found = 0;
+	for (size_t i = up; i < len_search_indices; ++i) {
+		// All remaining points differ more from the query
+		if ((double) pivots->dists[i * ISCC_PIVOT_NUM_PIVOTS] - query_dist0 > bound) break;
+		iscc_pivot_nn_candidate(data_set, pivots, search_indices, query, k, radius_search, radius_sq,
+		                        query_dists, slack, i, &bound, &found, cand_dists, cand_positions);
+	}
+	for (size_t i = down; i > 0; --i) {
+		if (query_dist0 - (double) pivots->dists[(i - 1) * ISCC_PIVOT_NUM_PIVOTS] > bound) break;
+		iscc_pivot_nn_candidate(data_set, pivots, search_indices, query, k, radius_search, radius_sq,
+		                        query_dists, slack, i - 1, &bound, &found, cand_dists, cand_positions);
+	}
+
+	return found;
 }
 
 
@@ -334,6 +834,110 @@ bool iscc_imp_init_nn_search_object(void* const data_set,
 		.data_set = data_set,
 		.len_search_indices = len_search_indices,
 		.search_indices = search_indices,
+		.kd_tree = iscc_get_nn_index(data_set, len_search_indices, search_indices),
+		.owns_kd_tree = false,
+		.pivots = NULL,
+		.hnsw = NULL,
+	};
+
+	return true;
+}
+
+
+bool iscc_imp_init_kdtree_nn_search_object(void* const data_set,
+                                           const size_t len_search_indices,
+                                           const scc_PointIndex search_indices[const],
+                                           iscc_NNSearchObject** const out_nn_search_object)
+{
+	assert(iscc_imp_check_data_set(data_set));
+	assert(len_search_indices > 0);
+	assert(out_nn_search_object != NULL);
+
+	iscc_KDTree* kd_tree = iscc_get_nn_index(data_set, len_search_indices, search_indices);
+	const bool shared_kd_tree = (kd_tree != NULL);
+	if (!shared_kd_tree && !iscc_kdt_build_tree(data_set, len_search_indices, search_indices, ISCC_KDT_NN_LEAF_SIZE, false, &kd_tree)) return false;
+
+	*out_nn_search_object = malloc(sizeof(iscc_NNSearchObject));
+	if (*out_nn_search_object == NULL) {
+		if (!shared_kd_tree) iscc_kdt_free_tree(&kd_tree);
+		return false;
+	}
+
+	**out_nn_search_object = (iscc_NNSearchObject) {
+		.nn_search_version = ISCC_NN_SEARCH_STRUCT_VERSION,
+		.data_set = data_set,
+		.len_search_indices = len_search_indices,
+		.search_indices = search_indices,
+		.kd_tree = kd_tree,
+		.owns_kd_tree = !shared_kd_tree,
+		.pivots = NULL,
+		.hnsw = NULL,
+	};
+
+	return true;
+}
+
+
+bool iscc_imp_init_pivot_nn_search_object(void* const data_set,
+                                          const size_t len_search_indices,
+                                          const scc_PointIndex search_indices[const],
+                                          iscc_NNSearchObject** const out_nn_search_object)
+{
+	assert(iscc_imp_check_data_set(data_set));
+	assert(len_search_indices > 0);
+	assert(out_nn_search_object != NULL);
+
+	iscc_PivotTable* pivots;
+	if (!iscc_build_pivot_table(data_set, len_search_indices, search_indices, &pivots)) return false;
+
+	*out_nn_search_object = malloc(sizeof(iscc_NNSearchObject));
+	if (*out_nn_search_object == NULL) {
+		iscc_free_pivot_table(&pivots);
+		return false;
+	}
+
+	**out_nn_search_object = (iscc_NNSearchObject) {
+		.nn_search_version = ISCC_NN_SEARCH_STRUCT_VERSION,
+		.data_set = data_set,
+		.len_search_indices = len_search_indices,
+		.search_indices = search_indices,
+		.kd_tree = NULL,
+		.owns_kd_tree = false,
+		.pivots = pivots,
+		.hnsw = NULL,
+	};
+
+	return true;
+}
+
+
+bool iscc_imp_init_hnsw_nn_search_object(void* const data_set,
+                                         const size_t len_search_indices,
+                                         const scc_PointIndex search_indices[const],
+                                         iscc_NNSearchObject** const out_nn_search_object)
+{
+	assert(iscc_imp_check_data_set(data_set));
+	assert(len_search_indices > 0);
+	assert(out_nn_search_object != NULL);
+
+	iscc_HNSW* hnsw;
+	if (!iscc_hnsw_build_graph(data_set, len_search_indices, search_indices, &hnsw)) return false;
+
+	*out_nn_search_object = malloc(sizeof(iscc_NNSearchObject));
+	if (*out_nn_search_object == NULL) {
+		iscc_hnsw_free_graph(&hnsw);
+		return false;
+	}
+
+	**out_nn_search_object = (iscc_NNSearchObject) {
+		.nn_search_version = ISCC_NN_SEARCH_STRUCT_VERSION,
+		.data_set = data_set,
+		.len_search_indices = len_search_indices,
+		.search_indices = search_indices,
+		.kd_tree = NULL,
+		.owns_kd_tree = false,
+		.pivots = NULL,
+		.hnsw = hnsw,
 	};
 
 	return true;
@@ -352,59 +956,46 @@ bool iscc_imp_nearest_neighbor_search(iscc_NNSearchObject* const nn_search_objec
 {
 	assert(nn_search_object != NULL);
 	assert(nn_search_object->nn_search_version == ISCC_NN_SEARCH_STRUCT_VERSION);
-	scc_DataSet* const data_set = nn_search_object->data_set;
-	const size_t len_search_indices = nn_search_object->len_search_indices;
-	const scc_PointIndex* const search_indices = nn_search_object->search_indices;
-
-	assert(iscc_imp_check_data_set(data_set));
-	assert(len_search_indices > 0);
+	assert(iscc_imp_check_data_set(nn_search_object->data_set));
+	assert(nn_search_object->len_search_indices > 0);
 	assert(len_query_indices > 0);
 	assert(k > 0);
-	assert(k <= len_search_indices);
+	assert(k <= nn_search_object->len_search_indices);
 	assert(!radius_search || (radius > 0.0));
 	assert(out_num_ok_queries != NULL);
 	assert(out_nn_indices != NULL);
 
-	double tmp_dist;
-	size_t num_ok_queries = 0;
-	scc_PointIndex* index_write = out_nn_indices;
-	double* const sort_scratch = malloc(sizeof(double[k]));
-	if (sort_scratch == NULL) return false;
-	double* const sort_scratch_end = sort_scratch + k - 1;
+	uint32_t num_threads = iscc_get_num_threads();
+	if (len_query_indices < ISCC_NN_MIN_PARALLEL_QUERIES) {
+		num_threads = 1;
+	}
+
+	// Each thread gets its own scratch
+	iscc_NNQueryScratch* const scratch = malloc(sizeof(iscc_NNQueryScratch[num_threads]));
+	if (scratch == NULL) return false;
+	for (uint32_t t = 0; t < num_threads; ++t) {
+		if (!iscc_imp_init_nn_query_scratch(nn_search_object, k, &scratch[t])) {
+			while (t > 0) {
+				--t;
+				iscc_imp_free_nn_query_scratch(&scratch[t]);
+			}
+			free(scratch);
+			return false;
+		}
+	}
+
 	const double radius_sq = radius * radius;
+	size_t num_ok_queries = 0;
 
-	if (search_indices == NULL) {
+	if (num_threads == 1) {
+		scc_PointIndex* index_write = out_nn_indices;
 		for (size_t q = 0; q < len_query_indices; ++q) {
 			size_t query = q;
 			if (query_indices != NULL) {
 				query = (size_t) query_indices[q];
 			}
-			size_t s = 0;
-			uint32_t found;
-			scc_PointIndex* const index_write_end = index_write + k - 1;
-
-			if (radius_search) {
-				found = 0;
-				for (; (s < len_search_indices) && (found < k); ++s) {
-					tmp_dist = iscc_get_sq_dist(data_set, query, s);
-					if (tmp_dist > radius_sq) continue;
-					iscc_add_dist_to_list(tmp_dist, (scc_PointIndex) s, sort_scratch + found, index_write + found, sort_scratch);
-					++found;
-				}
-			} else {
-				for (; s < k; ++s) {
-					tmp_dist = iscc_get_sq_dist(data_set, query, s);
-					iscc_add_dist_to_list(tmp_dist, (scc_PointIndex) s, sort_scratch + s, index_write + s, sort_scratch);
-				}
-				found = k;
-			}
 
-			for (; s < len_search_indices; ++s) {
-				assert(found == k);
-				tmp_dist = iscc_get_sq_dist(data_set, query, s);
-				if (tmp_dist >= *sort_scratch_end) continue;
-				iscc_add_dist_to_list(tmp_dist, (scc_PointIndex) s, sort_scratch_end, index_write_end, sort_scratch);
-			}
+			const uint32_t found = iscc_imp_nn_query(nn_search_object, query, k, radius_search, radius_sq, scratch, index_write);
 
 			assert(found == k || out_query_indices != NULL);
 			if (found == k) {
@@ -415,65 +1006,544 @@ bool iscc_imp_nearest_neighbor_search(iscc_NNSearchObject* const nn_search_objec
 				index_write += k;
 			}
 		}
+
 	} else {
-		assert(search_indices != NULL);
+		// Each query writes to its own slice of `out_nn_indices`, which is
+		// compacted in query order afterwards so the output is deterministic
+		bool* const query_ok = malloc(sizeof(bool[len_query_indices]));
+		if (query_ok == NULL) {
+			for (uint32_t t = 0; t < num_threads; ++t) {
+				iscc_imp_free_nn_query_scratch(&scratch[t]);
+			}
+			free(scratch);
+			return false;
+		}
+
+		ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 16))
 		for (size_t q = 0; q < len_query_indices; ++q) {
 			size_t query = q;
 			if (query_indices != NULL) {
 				query = (size_t) query_indices[q];
 			}
-			size_t s = 0;
-			uint32_t found;
-			scc_PointIndex* const index_write_end = index_write + k - 1;
-
-			if (radius_search) {
-				found = 0;
-				for (; (s < len_search_indices) && (found < k); ++s) {
-					tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) search_indices[s]);
-					if (tmp_dist > radius_sq) continue;
-					iscc_add_dist_to_list(tmp_dist, search_indices[s], sort_scratch + found, index_write + found, sort_scratch);
-					++found;
+			const uint32_t found = iscc_imp_nn_query(nn_search_object, query, k, radius_search, radius_sq,
+			                                     &scratch[iscc_get_thread_num()], out_nn_indices + q * k);
+			query_ok[q] = (found == k);
+		}
+
+		for (size_t q = 0; q < len_query_indices; ++q) {
+			assert(query_ok[q] || out_query_indices != NULL);
+			if (query_ok[q]) {
+				if (out_query_indices != NULL) {
+					out_query_indices[num_ok_queries] = (query_indices == NULL) ? (scc_PointIndex) q : query_indices[q];
 				}
-			} else {
-				for (; s < k; ++s) {
-					tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) search_indices[s]);
-					iscc_add_dist_to_list(tmp_dist, search_indices[s], sort_scratch + s, index_write + s, sort_scratch);
+				if (num_ok_queries != q) {
+					memcpy(out_nn_indices + num_ok_queries * k, out_nn_indices + q * k, sizeof(scc_PointIndex[k]));
 				}
-				found = k;
+				++num_ok_queries;
 			}
+		}
+
+		free(query_ok);
+	}
+
+	*out_num_ok_queries = num_ok_queries;
 
+	for (uint32_t t = 0; t < num_threads; ++t) {
+		iscc_imp_free_nn_query_scratch(&scratch[t]);
+	}
+	free(scratch);
+
+	return true;
+}
+
+
+bool iscc_imp_close_nn_search_object(iscc_NNSearchObject** const nn_search_object)
+{
+	if (nn_search_object != NULL && *nn_search_object != NULL) {
+		assert((*nn_search_object)->nn_search_version == ISCC_NN_SEARCH_STRUCT_VERSION);
+		if ((*nn_search_object)->owns_kd_tree) {
+			iscc_kdt_free_tree(&(*nn_search_object)->kd_tree);
+		}
+		iscc_free_pivot_table(&(*nn_search_object)->pivots);
+		iscc_hnsw_free_graph(&(*nn_search_object)->hnsw);
+		free(*nn_search_object);
+		*nn_search_object = NULL;
+	}
+	return true;
+}
+
+
+bool iscc_imp_init_nn_query_scratch(const iscc_NNSearchObject* const nn_search_object,
+                                    const uint32_t k,
+                                    iscc_NNQueryScratch* const out_scratch)
+{
+	assert(nn_search_object != NULL);
+	assert(k > 0);
+	assert(out_scratch != NULL);
+
+	*out_scratch = (iscc_NNQueryScratch) {
+		.sort_scratch = NULL,
+		.kd_scratch = {
+			.k = 0,
+			.dists = NULL,
+			.positions = NULL,
+			.offsets = NULL,
+		},
+		.hnsw_scratch = {
+			.capacity = 0,
+			.visit_mark = 0,
+			.visited = NULL,
+			.open_dists = NULL,
+			.open_positions = NULL,
+			.best_dists = NULL,
+			.best_positions = NULL,
+			.sort_dists = NULL,
+			.sort_positions = NULL,
+		},
+	};
+
+	if (nn_search_object->kd_tree != NULL) {
+		return iscc_kdt_init_scratch(nn_search_object->kd_tree, k, &out_scratch->kd_scratch);
+	}
+
+	if (nn_search_object->hnsw != NULL) {
+		return iscc_hnsw_init_scratch(nn_search_object->hnsw, k, &out_scratch->hnsw_scratch);
+	}
+
+	out_scratch->sort_scratch = malloc(sizeof(double[k]));
+	return (out_scratch->sort_scratch != NULL);
+}
+
+
+void iscc_imp_free_nn_query_scratch(iscc_NNQueryScratch* const scratch)
+{
+	assert(scratch != NULL);
+	free(scratch->sort_scratch);
+	iscc_kdt_free_scratch(&scratch->kd_scratch);
+	iscc_hnsw_free_scratch(&scratch->hnsw_scratch);
+}
+
+
+uint32_t iscc_imp_nn_query(const iscc_NNSearchObject* const nn_search_object,
+                           const size_t query,
+                           const uint32_t k,
+                           const bool radius_search,
+                           const double radius_sq,
+                           iscc_NNQueryScratch* const scratch,
+                           scc_PointIndex out_nn_indices[const])
+{
+	if (nn_search_object->kd_tree != NULL) {
+		return iscc_kdt_nearest_neighbors(nn_search_object->kd_tree, query, k, radius_search,
+		                                  radius_sq, &scratch->kd_scratch, out_nn_indices);
+	}
+
+	if (nn_search_object->hnsw != NULL) {
+		return iscc_hnsw_nearest_neighbors(nn_search_object->hnsw, query, k, radius_search,
+		                                   radius_sq, &scratch->hnsw_scratch, out_nn_indices);
+	}
+
+	const scc_DataSet* const data_set = nn_search_object->data_set;
+	const size_t len_search_indices = nn_search_object->len_search_indices;
+	const scc_PointIndex* const search_indices = nn_search_object->search_indices;
+
+	// Positions in the search set are kept in `out_nn_indices` until the search is done.
+	// Pivot tables visit the points out of order, which only the heap supports.
+	const bool use_heap = (k >= ISCC_NN_HEAP_MIN_K) || (nn_search_object->pivots != NULL);
+	double* const cand_dists = scratch->sort_scratch;
+	scc_PointIndex* const cand_positions = out_nn_indices;
+	size_t s = 0;
+	uint32_t found = 0;
+
+	if (nn_search_object->pivots != NULL) {
+		found = iscc_pivot_nn_query(data_set, nn_search_object->pivots, len_search_indices, search_indices,
+		                            query, k, radius_search, radius_sq, cand_dists, cand_positions);
+
+	} else if (search_indices == NULL) {
+		for (; (s < len_search_indices) && (found < k); ++s) {
+			const double tmp_dist = iscc_get_sq_dist(data_set, query, s);
+			if (radius_search && (tmp_dist > radius_sq)) continue;
+			iscc_nn_add_candidate(use_heap, cand_dists, cand_positions, found, tmp_dist, (scc_PointIndex) s);
+			++found;
+		}
+
+		if (found == k) {
+			double max_dist = use_heap ? cand_dists[0] : cand_dists[k - 1];
 			for (; s < len_search_indices; ++s) {
-				assert(found == k);
-				tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) search_indices[s]);
-				if (tmp_dist >= *sort_scratch_end) continue;
-				iscc_add_dist_to_list(tmp_dist, search_indices[s], sort_scratch_end, index_write_end, sort_scratch);
+				const double tmp_dist = iscc_get_sq_dist(data_set, query, s);
+				if (tmp_dist >= max_dist) continue;
+				max_dist = iscc_nn_replace_candidate(use_heap, cand_dists, cand_positions, k, tmp_dist, (scc_PointIndex) s);
 			}
+		}
 
-			assert(found == k || out_query_indices != NULL);
-			if (found == k) {
+	} else {
+		for (; (s < len_search_indices) && (found < k); ++s) {
+			const double tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) search_indices[s]);
+			if (radius_search && (tmp_dist > radius_sq)) continue;
+			iscc_nn_add_candidate(use_heap, cand_dists, cand_positions, found, tmp_dist, (scc_PointIndex) s);
+			++found;
+		}
+
+		if (found == k) {
+			double max_dist = use_heap ? cand_dists[0] : cand_dists[k - 1];
+			for (; s < len_search_indices; ++s) {
+				const double tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) search_indices[s]);
+				if (tmp_dist >= max_dist) continue;
+				max_dist = iscc_nn_replace_candidate(use_heap, cand_dists, cand_positions, k, tmp_dist, (scc_PointIndex) s);
+			}
+		}
+	}
+
+	if (use_heap) {
+		iscc_nn_heap_sort(cand_dists, cand_positions, found);
+	}
+	if (search_indices != NULL) {
+		for (uint32_t i = 0; i < found; ++i) {
+			out_nn_indices[i] = search_indices[cand_positions[i]];
+		}
+	}
+
+	return found;
+}
+
+
+// Adds a candidate to a heap of `k` candidates that currently holds `*len`
+// candidates, or replaces the top if the candidate is ordered before it
+static inline void iscc_nn_heap_offer(double* const dists,
+                                      scc_PointIndex* const positions,
+                                      const uint32_t k,
+                                      uint32_t* const len,
+                                      const double dist,
+                                      const scc_PointIndex pos)
+{
+	if (*len < k) {
+		iscc_nn_heap_push(dists, positions, *len, dist, pos);
+		++(*len);
+	} else if (iscc_nn_heap_after(dists[0], positions[0], dist, pos)) {
+		iscc_nn_heap_replace_top(dists, positions, k, dist, pos);
+	}
+}
+
+
+// Finds the neighbors of `query` for `iscc_imp_multi_nearest_neighbor_search`.
+// Each search set is searched in the same way as the brute-force search, and
+// the distances are reused for the heap of neighbors among all points, which
+// starts at `buffer_offset[num_sets]`. Points in no search set are listed in
+// `other_points`. Returns whether all neighbors were found.
+static bool iscc_multi_nn_query(const scc_DataSet* const data_set,
+                                const uint_fast16_t num_sets,
+                                const size_t len_search_sets[const],
+                                const scc_PointIndex* const search_sets[const],
+                                const uint32_t buffer_k[const],
+                                const uint32_t buffer_offset[const],
+                                const size_t len_other_points,
+                                const scc_PointIndex other_points[const],
+                                const size_t query,
+                                const bool radius_search,
+                                const double radius_sq,
+                                double cand_dists[const],
+                                scc_PointIndex out_nn_indices[const])
+{
+	const uint32_t k_all = buffer_k[num_sets];
+	double* const all_dists = cand_dists + buffer_offset[num_sets];
+	scc_PointIndex* const all_positions = out_nn_indices + buffer_offset[num_sets];
+	uint32_t all_found = 0;
+
+	for (uint_fast16_t b = 0; b < num_sets; ++b) {
+		const scc_PointIndex* const search_set = search_sets[b];
+		const uint32_t k = buffer_k[b];
+		const bool use_heap = (k >= ISCC_NN_HEAP_MIN_K);
+		double* const set_dists = cand_dists + buffer_offset[b];
+		scc_PointIndex* const set_positions = out_nn_indices + buffer_offset[b];
+		uint32_t found = 0;
+		double max_dist = HUGE_VAL;
+
+		for (size_t s = 0; s < len_search_sets[b]; ++s) {
+			const double tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) search_set[s]);
+			if (radius_search && (tmp_dist > radius_sq)) continue;
+			if (found < k) {
+				iscc_nn_add_candidate(use_heap, set_dists, set_positions, found, tmp_dist, (scc_PointIndex) s);
+				++found;
+				if (found == k) max_dist = use_heap ? set_dists[0] : set_dists[k - 1];
+			} else if (tmp_dist < max_dist) {
+				max_dist = iscc_nn_replace_candidate(use_heap, set_dists, set_positions, k, tmp_dist, (scc_PointIndex) s);
+			}
+			if (k_all > 0) {
+				iscc_nn_heap_offer(all_dists, all_positions, k_all, &all_found, tmp_dist, search_set[s]);
+			}
+		}
+
+		if (found < k) return false;
+		if (use_heap) {
+			iscc_nn_heap_sort(set_dists, set_positions, k);
+		}
+		for (uint32_t i = 0; i < k; ++i) {
+			set_positions[i] = search_set[set_positions[i]];
+		}
+	}
+
+	if (k_all > 0) {
+		for (size_t s = 0; s < len_other_points; ++s) {
+			const double tmp_dist = iscc_get_sq_dist(data_set, query, (size_t) other_points[s]);
+			if (radius_search && (tmp_dist > radius_sq)) continue;
+			iscc_nn_heap_offer(all_dists, all_positions, k_all, &all_found, tmp_dist, other_points[s]);
+		}
+		if (all_found < k_all) return false;
+		iscc_nn_heap_sort(all_dists, all_positions, k_all);
+	}
+
+	return true;
+}
+
+
+bool iscc_imp_multi_nearest_neighbor_search(void* const data_set,
+                                            const uint_fast16_t num_sets,
+                                            const size_t len_search_sets[const],
+                                            const scc_PointIndex* const search_sets[const],
+                                            const uint32_t set_k[const],
+                                            const uint32_t k_all,
+                                            const size_t len_query_indices,
+                                            const scc_PointIndex query_indices[const],
+                                            const bool radius_search,
+                                            const double radius,
+                                            size_t* const out_num_ok_queries,
+                                            scc_PointIndex out_query_indices[const],
+                                            scc_PointIndex out_nn_indices[const])
+{
+	assert(iscc_imp_check_data_set(data_set));
+	assert((num_sets == 0) || (len_search_sets != NULL && search_sets != NULL && set_k != NULL));
+	assert(len_query_indices > 0);
+	assert(!radius_search || (radius > 0.0));
+	assert(out_num_ok_queries != NULL);
+	assert(out_nn_indices != NULL);
+
+	const scc_DataSet* const data_set_cast = (const scc_DataSet*) data_set;
+	const size_t num_data_points = data_set_cast->num_data_points;
+
+	uint32_t* const buffer_k = malloc(sizeof(uint32_t[num_sets + 1]));
+	uint32_t* const buffer_offset = malloc(sizeof(uint32_t[num_sets + 1]));
+	bool* const in_search_set = (k_all > 0) ? calloc(num_data_points, sizeof(bool)) : NULL;
+	if ((buffer_k == NULL) || (buffer_offset == NULL) || ((k_all > 0) && (in_search_set == NULL))) {
+		free(buffer_k);
+		free(buffer_offset);
+		free(in_search_set);
+		return false;
+	}
+
+	uint32_t k_total = 0;
+	size_t len_other_points = num_data_points;
+	for (uint_fast16_t b = 0; b < num_sets; ++b) {
+		assert(set_k[b] > 0);
+		assert(set_k[b] <= len_search_sets[b]);
+		buffer_k[b] = set_k[b];
+		buffer_offset[b] = k_total;
+		k_total += set_k[b];
+		len_other_points -= len_search_sets[b];
+	}
+	assert(k_all <= num_data_points);
+	buffer_k[num_sets] = k_all;
+	buffer_offset[num_sets] = k_total;
+	k_total += k_all;
+	assert(k_total > 0);
+
+	// Points in no search set are only needed when searching among all points
+	scc_PointIndex* other_points = NULL;
+	if (k_all > 0) {
+		for (uint_fast16_t b = 0; b < num_sets; ++b) {
+			for (size_t s = 0; s < len_search_sets[b]; ++s) {
+				assert(!in_search_set[search_sets[b][s]]);
+				in_search_set[search_sets[b][s]] = true;
+			}
+		}
+		other_points = malloc(sizeof(scc_PointIndex[len_other_points + 1]));
+		if (other_points == NULL) {
+			free(buffer_k);
+			free(buffer_offset);
+			free(in_search_set);
+			return false;
+		}
+		size_t o = 0;
+		for (size_t p = 0; p < num_data_points; ++p) {
+			if (!in_search_set[p]) {
+				other_points[o] = (scc_PointIndex) p;
+				++o;
+			}
+		}
+		assert(o == len_other_points);
+		free(in_search_set);
+	}
+
+	uint32_t num_threads = iscc_get_num_threads();
+	if (len_query_indices < ISCC_NN_MIN_PARALLEL_QUERIES) {
+		num_threads = 1;
+	}
+
+	// Each thread gets its own scratch
+	double* const cand_dists = malloc(sizeof(double[num_threads * k_total]));
+	bool* const query_ok = (num_threads > 1) ? malloc(sizeof(bool[len_query_indices])) : NULL;
+	if ((cand_dists == NULL) || ((num_threads > 1) && (query_ok == NULL))) {
+		free(buffer_k);
+		free(buffer_offset);
+		free(other_points);
+		free(cand_dists);
+		free(query_ok);
+		return false;
+	}
+
+	const double radius_sq = radius * radius;
+	size_t num_ok_queries = 0;
+
+	if (num_threads == 1) {
+		scc_PointIndex* index_write = out_nn_indices;
+		for (size_t q = 0; q < len_query_indices; ++q) {
+			const size_t query = iscc_get_point_index(query_indices, q);
+			const bool ok = iscc_multi_nn_query(data_set_cast, num_sets, len_search_sets, search_sets,
+			                                    buffer_k, buffer_offset, len_other_points, other_points,
+			                                    query, radius_search, radius_sq, cand_dists, index_write);
+
+			assert(ok || out_query_indices != NULL);
+			if (ok) {
 				if (out_query_indices != NULL) {
 					out_query_indices[num_ok_queries] = (scc_PointIndex) query;
 				}
 				++num_ok_queries;
-				index_write += k;
+				index_write += k_total;
+			}
+		}
+
+	} else {
+		// Compacted in query order afterwards, as in `iscc_imp_nearest_neighbor_search`
+		ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 16))
+		for (size_t q = 0; q < len_query_indices; ++q) {
+			const uint32_t thread = iscc_get_thread_num();
+			query_ok[q] = iscc_multi_nn_query(data_set_cast, num_sets, len_search_sets, search_sets,
+			                                  buffer_k, buffer_offset, len_other_points, other_points,
+			                                  iscc_get_point_index(query_indices, q), radius_search, radius_sq,
+			                                  cand_dists + thread * k_total, out_nn_indices + q * k_total);
+		}
+
+		for (size_t q = 0; q < len_query_indices; ++q) {
+			assert(query_ok[q] || out_query_indices != NULL);
+			if (query_ok[q]) {
+				if (out_query_indices != NULL) {
+					out_query_indices[num_ok_queries] = (scc_PointIndex) iscc_get_point_index(query_indices, q);
+				}
+				if (num_ok_queries != q) {
+					memcpy(out_nn_indices + num_ok_queries * k_total, out_nn_indices + q * k_total, sizeof(scc_PointIndex[k_total]));
+				}
+				++num_ok_queries;
 			}
 		}
 	}
 
 	*out_num_ok_queries = num_ok_queries;
 
-	free(sort_scratch);
+	free(buffer_k);
+	free(buffer_offset);
+	free(other_points);
+	free(cand_dists);
+	free(query_ok);
 
 	return true;
 }
 
 
-bool iscc_imp_close_nn_search_object(iscc_NNSearchObject** const nn_search_object)
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+static void iscc_get_dist_matrix_tiled(const scc_DataSet* const data_set,
+                                       const size_t len_point_indices,
+                                       const scc_PointIndex point_indices[const],
+                                       double output_dists[const])
 {
-	if (nn_search_object != NULL && *nn_search_object != NULL) {
-		assert((*nn_search_object)->nn_search_version == ISCC_NN_SEARCH_STRUCT_VERSION);
-		free(*nn_search_object);
-		*nn_search_object = NULL;
+	assert(data_set->sq_norms != NULL);
+
+	const size_t num_dimensions = data_set->num_dimensions;
+	size_t column_block = ISCC_DIST_COLUMN_BLOCK_DOUBLES / num_dimensions;
+	if (column_block < ISCC_DOT_TILE_COLUMNS) column_block = ISCC_DOT_TILE_COLUMNS;
+
+	size_t rows[ISCC_DOT_TILE_ROWS];
+	size_t cols[ISCC_DOT_TILE_COLUMNS];
+	const double* x[ISCC_DOT_TILE_ROWS];
+	const double* y[ISCC_DOT_TILE_COLUMNS];
+	double dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS];
+
+	for (size_t cb = 1; cb < len_point_indices; cb += column_block) {
+		const size_t cb_stop = (column_block < len_point_indices - cb) ? cb + column_block : len_point_indices;
+		for (size_t p = 0; p + 1 < cb_stop; p += ISCC_DOT_TILE_ROWS) {
+			// Incomplete tiles repeat the last point; those products are not written
+			for (size_t r = 0; r < ISCC_DOT_TILE_ROWS; ++r) {
+				rows[r] = iscc_get_point_index(point_indices, (p + r < len_point_indices) ? p + r : len_point_indices - 1);
+				x[r] = data_set->data_matrix + rows[r] * num_dimensions;
+			}
+
+			// Only pairs above the diagonal are needed
+			for (size_t c = (cb > p + 1) ? cb : p + 1; c < cb_stop; c += ISCC_DOT_TILE_COLUMNS) {
+				for (size_t t = 0; t < ISCC_DOT_TILE_COLUMNS; ++t) {
+					cols[t] = iscc_get_point_index(point_indices, (c + t < cb_stop) ? c + t : cb_stop - 1);
+					y[t] = data_set->data_matrix + cols[t] * num_dimensions;
+				}
+
+				iscc_dot_tile_kernel(x, y, num_dimensions, dots);
+
+				for (size_t r = 0; (r < ISCC_DOT_TILE_ROWS) && (p + r < len_point_indices); ++r) {
+					// The distances from point `p1` start at `(p1 * (2 * n - p1 - 1)) / 2`
+					const size_t p1 = p + r;
+					double* const output_row = output_dists + (p1 * (2 * len_point_indices - p1 - 1)) / 2;
+					for (size_t t = 0; (t < ISCC_DOT_TILE_COLUMNS) && (c + t < cb_stop); ++t) {
+						if (c + t <= p1) continue;
+						output_row[c + t - p1 - 1] = sqrt(iscc_sq_dist_from_dot(data_set, rows[r], cols[t], dots[r * ISCC_DOT_TILE_COLUMNS + t]));
+					}
+				}
+			}
+		}
+	}
+}
+
+
+static void iscc_get_dist_rows_tiled(const scc_DataSet* const data_set,
+                                     const size_t len_query_indices,
+                                     const scc_PointIndex query_indices[const],
+                                     const size_t len_column_indices,
+                                     const scc_PointIndex column_indices[const],
+                                     double output_dists[const])
+{
+	assert(data_set->sq_norms != NULL);
+
+	const size_t num_dimensions = data_set->num_dimensions;
+	size_t column_block = ISCC_DIST_COLUMN_BLOCK_DOUBLES / num_dimensions;
+	if (column_block < ISCC_DOT_TILE_COLUMNS) column_block = ISCC_DOT_TILE_COLUMNS;
+
+	size_t rows[ISCC_DOT_TILE_ROWS];
+	size_t cols[ISCC_DOT_TILE_COLUMNS];
+	const double* x[ISCC_DOT_TILE_ROWS];
+	const double* y[ISCC_DOT_TILE_COLUMNS];
+	double dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS];
+
+	for (size_t cb = 0; cb < len_column_indices; cb += column_block) {
+		const size_t cb_stop = (column_block < len_column_indices - cb) ? cb + column_block : len_column_indices;
+		for (size_t q = 0; q < len_query_indices; q += ISCC_DOT_TILE_ROWS) {
+			// Incomplete tiles repeat the last query; those products are not written
+			for (size_t r = 0; r < ISCC_DOT_TILE_ROWS; ++r) {
+				rows[r] = iscc_get_point_index(query_indices, (q + r < len_query_indices) ? q + r : len_query_indices - 1);
+				x[r] = data_set->data_matrix + rows[r] * num_dimensions;
+			}
+
+			for (size_t c = cb; c < cb_stop; c += ISCC_DOT_TILE_COLUMNS) {
+				for (size_t t = 0; t < ISCC_DOT_TILE_COLUMNS; ++t) {
+					cols[t] = iscc_get_point_index(column_indices, (c + t < cb_stop) ? c + t : cb_stop - 1);
+					y[t] = data_set->data_matrix + cols[t] * num_dimensions;
+				}
+
+				iscc_dot_tile_kernel(x, y, num_dimensions, dots);
+
+				for (size_t r = 0; (r < ISCC_DOT_TILE_ROWS) && (q + r < len_query_indices); ++r) {
+					double* const output_row = output_dists + (q + r) * len_column_indices;
+					for (size_t t = 0; (t < ISCC_DOT_TILE_COLUMNS) && (c + t < cb_stop); ++t) {
+						output_row[c + t] = sqrt(iscc_sq_dist_from_dot(data_set, rows[r], cols[t], dots[r * ISCC_DOT_TILE_COLUMNS + t]));
+					}
+				}
+			}
+		}
 	}
-	return true;
 }
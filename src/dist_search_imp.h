@@ -26,6 +26,8 @@
 #include <stdint.h>
 #include "../include/scclust.h"
 #include "../include/scclust_spi.h"
+#include "hnsw.h"
+#include "kdtree.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -62,12 +64,30 @@ bool iscc_imp_get_dist_rows(void* data_set,
 // Max dist functions
 // =============================================================================
 
+struct iscc_MaxDistObject {
+	int32_t max_dist_version;
+	scc_DataSet* data_set;
+	size_t len_search_indices;
+	const scc_PointIndex* search_indices;
+	iscc_KDTree* kd_tree;
+};
+
+
 bool iscc_imp_init_max_dist_object(void* data_set,
                                    size_t len_search_indices,
                                    const scc_PointIndex search_indices[],
                                    iscc_MaxDistObject** out_max_dist_object);
 
 
+// Builds a kd-tree over the search points when there are many of them and the
+// data has few dimensions. Queries with the resulting object give the same
+// results as with `iscc_imp_init_max_dist_object`.
+bool iscc_imp_init_kdtree_max_dist_object(void* data_set,
+                                          size_t len_search_indices,
+                                          const scc_PointIndex search_indices[],
+                                          iscc_MaxDistObject** out_max_dist_object);
+
+
 // `max_indices` and `max_dists` must be of length `n_query_points`
 bool iscc_imp_get_max_dist(iscc_MaxDistObject* max_dist_object,
                            size_t len_query_indices,
@@ -79,16 +99,54 @@ bool iscc_imp_get_max_dist(iscc_MaxDistObject* max_dist_object,
 bool iscc_imp_close_max_dist_object(iscc_MaxDistObject** max_dist_object);
 
 
+// Initializes a max dist object in memory provided by the caller, so that
+// objects can be made without allocating. Such objects must not be closed.
+void iscc_imp_set_max_dist_object(void* data_set,
+                                  size_t len_search_indices,
+                                  const scc_PointIndex search_indices[],
+                                  iscc_MaxDistObject* out_max_dist_object);
+
+
 // =============================================================================
 // Nearest neighbor search functions
 // =============================================================================
 
+// Searches over all points in a data set use its search index from
+// `scc_load_nn_search_index`, if one is loaded.
 bool iscc_imp_init_nn_search_object(void* data_set,
                                     size_t len_search_indices,
                                     const scc_PointIndex search_indices[],
                                     iscc_NNSearchObject** out_nn_search_object);
 
 
+// Builds a kd-tree over the search points, or uses the search index of the
+// data set as `iscc_imp_init_nn_search_object`. Searches with the resulting
+// object give the same results as with `iscc_imp_init_nn_search_object`.
+bool iscc_imp_init_kdtree_nn_search_object(void* data_set,
+                                           size_t len_search_indices,
+                                           const scc_PointIndex search_indices[],
+                                           iscc_NNSearchObject** out_nn_search_object);
+
+
+// Builds a pivot table over the search points when there are many of them and
+// the data has many dimensions. Searches with the resulting object give the
+// same results as with `iscc_imp_init_nn_search_object`.
+bool iscc_imp_init_pivot_nn_search_object(void* data_set,
+                                          size_t len_search_indices,
+                                          const scc_PointIndex search_indices[],
+                                          iscc_NNSearchObject** out_nn_search_object);
+
+
+// Builds a HNSW graph over the search points. Searches with the resulting
+// object are approximate: the neighbors may differ from those found with
+// `iscc_imp_init_nn_search_object`, but a query that is a search point is
+// found whenever an exact search would find it.
+bool iscc_imp_init_hnsw_nn_search_object(void* data_set,
+                                         size_t len_search_indices,
+                                         const scc_PointIndex search_indices[],
+                                         iscc_NNSearchObject** out_nn_search_object);
+
+
 // `out_nn_indices` must be of length `k * len_query_indices`
 bool iscc_imp_nearest_neighbor_search(iscc_NNSearchObject* nn_search_object,
                                       size_t len_query_indices,
@@ -104,6 +162,58 @@ bool iscc_imp_nearest_neighbor_search(iscc_NNSearchObject* nn_search_object,
 bool iscc_imp_close_nn_search_object(iscc_NNSearchObject** nn_search_object);
 
 
+// Scratch memory for single queries. Each thread that queries a search object
+// concurrently must use its own scratch.
+typedef struct iscc_NNQueryScratch {
+	double* sort_scratch;
+	iscc_KDTreeScratch kd_scratch;
+	iscc_HNSWScratch hnsw_scratch;
+} iscc_NNQueryScratch;
+
+
+// Allocates scratch for queries of at most `k` neighbors with `nn_search_object`
+bool iscc_imp_init_nn_query_scratch(const iscc_NNSearchObject* nn_search_object,
+                                    uint32_t k,
+                                    iscc_NNQueryScratch* out_scratch);
+
+
+void iscc_imp_free_nn_query_scratch(iscc_NNQueryScratch* scratch);
+
+
+// Finds the `k` nearest search points to `query`, in the same way as
+// `iscc_imp_nearest_neighbor_search`, without allocating memory. Returns the
+// number of neighbors found, which is always `k` unless `radius_search`.
+uint32_t iscc_imp_nn_query(const iscc_NNSearchObject* nn_search_object,
+                           size_t query,
+                           uint32_t k,
+                           bool radius_search,
+                           double radius_sq,
+                           iscc_NNQueryScratch* scratch,
+                           scc_PointIndex out_nn_indices[]);
+
+
+// Searches several disjoint search sets in one pass over the data points. For
+// each query, the result is the same as searching for `set_k[i]` neighbors
+// with `search_sets[i]` as search set for each set in turn, and, if
+// `k_all > 0`, for `k_all` neighbors among all data points. The neighbors are
+// written in that order, so `out_nn_indices` must be of length
+// `(sum(set_k) + k_all) * len_query_indices`. A query is only reported as
+// ok if all searches found their neighbors within `radius`.
+bool iscc_imp_multi_nearest_neighbor_search(void* data_set,
+                                            uint_fast16_t num_sets,
+                                            const size_t len_search_sets[],
+                                            const scc_PointIndex* const search_sets[],
+                                            const uint32_t set_k[],
+                                            uint32_t k_all,
+                                            size_t len_query_indices,
+                                            const scc_PointIndex query_indices[],
+                                            bool radius_search,
+                                            double radius,
+                                            size_t* out_num_ok_queries,
+                                            scc_PointIndex out_query_indices[],
+                                            scc_PointIndex out_nn_indices[]);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,16 +23,18 @@
 #include <assert.h>
 #include <stdio.h>
 #include "../include/scclust.h"
+#include "threads.h"
 
 
 // =============================================================================
 // Static variables
 // =============================================================================
 
-static scc_ErrorCode iscc_error_code = SCC_ER_OK;
-static const char* iscc_error_msg = NULL;
-static const char* iscc_error_file = "unknown file";
-static int iscc_error_line = -1;
+// Each thread has its own error state
+static ISCC_THREAD_LOCAL scc_ErrorCode iscc_error_code = SCC_ER_OK;
+static ISCC_THREAD_LOCAL const char* iscc_error_msg = NULL;
+static ISCC_THREAD_LOCAL const char* iscc_error_file = "unknown file";
+static ISCC_THREAD_LOCAL int iscc_error_line = -1;
 
 
 // =============================================================================
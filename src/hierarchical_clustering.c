@@ -26,25 +26,37 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "dist_search.h"
+#include "dist_search_imp.h"
 #include "clustering_struct.h"
 #include "error.h"
 #include "scclust_types.h"
+#include "threads.h"
 
 // Maximum number of data points to check when finding centers.
 static const uint_fast16_t ISCC_HI_NUM_TO_CHECK = 100;
 
+// Clusters smaller than this are broken by the thread that made them rather than in new tasks.
+static const size_t ISCC_HI_MIN_TASK_SIZE = 256;
+
+// Edge lists shorter than this are sorted by insertion rather than by radix.
+static const size_t ISCC_HI_MIN_RADIX_SORT = 64;
+
 
 // =============================================================================
 // Internal structs
 // =============================================================================
 
-typedef struct iscc_hi_DistanceEdge iscc_hi_DistanceEdge;
-struct iscc_hi_DistanceEdge {
-	scc_PointIndex head;
-	double distance;
-	iscc_hi_DistanceEdge* next_dist;
-};
+// The points of a cluster sorted by distance to one of its centers. All points
+// before `next` are assigned. Later points may also have been assigned, and
+// they are skipped when found.
+typedef struct iscc_hi_EdgeList {
+	size_t len;
+	size_t next;
+	scc_PointIndex* heads;
+	double* distances;
+} iscc_hi_EdgeList;
 
 
 typedef struct iscc_hi_ClusterItem {
@@ -67,11 +79,39 @@ typedef struct iscc_hi_WorkArea {
 	scc_PointIndex* const pointindex_array2;
 	double* const dist_array;
 	uint_fast16_t* const vertex_markers;
-	iscc_hi_DistanceEdge* const edge_store1;
-	iscc_hi_DistanceEdge* const edge_store2;
+	scc_PointIndex* const head_store1;
+	scc_PointIndex* const head_store2;
+	scc_PointIndex* const head_scratch;
+	double* const dist_scratch;
+	iscc_MaxDistObject* const max_dist_object; // If not `NULL`, used instead of allocating an object
 } iscc_hi_WorkArea;
 
 
+// Clusters are disjoint ranges of `pointindex_store`. In the parallel version,
+// the memory a cluster needs in `dist_array` and the head and scratch arrays is
+// taken at the same offset as its range, so concurrent tasks never overlap.
+// A cluster of size `s` uses at most `2 s` elements of `dist_array`, also when
+// finding centers as at most `(s + 1) / 2` points are checked at a time.
+typedef struct iscc_hi_ParallelContext {
+	void* data_set;
+	uint32_t size_constraint;
+	bool batch_assign;
+	const scc_PointIndex* pointindex_store;
+	double* dist_array;
+	uint_fast16_t* vertex_markers;
+	scc_PointIndex* head_store1;
+	scc_PointIndex* head_store2;
+	scc_PointIndex* head_scratch;
+	double* dist_scratch;
+	size_t size_pointindex_array;
+	scc_PointIndex* thread_pointindex_arrays;
+	// Brute-force objects for the tasks even with kd-tree dist functions, as trees cannot be built without allocating
+	iscc_MaxDistObject* thread_max_dist_objects;
+	bool* leaf_start;
+	scc_ErrorCode ec;
+} iscc_hi_ParallelContext;
+
+
 // =============================================================================
 // Static function prototypes
 // =============================================================================
@@ -93,6 +133,31 @@ static scc_ErrorCode iscc_hi_run_hierarchical_clustering(iscc_hi_ClusterStack* c
                                                          bool batch_assign);
 
 
+static inline bool iscc_hi_uses_imp_dist_functions(void);
+
+
+static scc_ErrorCode iscc_hi_run_parallel_hierarchical_clustering(iscc_hi_ClusterStack* cl_stack,
+                                                                  scc_Clustering* cl,
+                                                                  void* data_set,
+                                                                  uint32_t size_constraint,
+                                                                  bool batch_assign,
+                                                                  uint32_t num_threads);
+
+
+static scc_ErrorCode iscc_hi_break_leading_clusters(iscc_hi_ClusterStack* cl_stack,
+                                                    iscc_hi_ParallelContext* context);
+
+
+static void iscc_hi_break_cluster_task(iscc_hi_ClusterItem cluster,
+                                       iscc_hi_ParallelContext* context);
+
+
+static inline iscc_hi_WorkArea iscc_hi_get_work_area(const iscc_hi_ClusterItem* cluster,
+                                                     const iscc_hi_ParallelContext* context,
+                                                     uint32_t thread_num,
+                                                     iscc_MaxDistObject* max_dist_object);
+
+
 static scc_ErrorCode iscc_hi_check_capacity(iscc_hi_ClusterStack* cl_stack);
 
 
@@ -112,16 +177,16 @@ static inline uint_fast16_t iscc_hi_get_next_marker(iscc_hi_ClusterItem* cl,
                                                     uint_fast16_t vertex_markers[]);
 
 
-static inline iscc_hi_DistanceEdge* iscc_hi_get_next_k_nn(iscc_hi_DistanceEdge* prev_dist,
-                                                          uint32_t k,
-                                                          const uint_fast16_t vertex_markers[],
-                                                          uint_fast16_t curr_marker,
-                                                          scc_PointIndex out_dist_array[static k]);
+static inline size_t iscc_hi_get_next_k_nn(iscc_hi_EdgeList* edge_list,
+                                           uint32_t k,
+                                           const uint_fast16_t vertex_markers[],
+                                           uint_fast16_t curr_marker,
+                                           scc_PointIndex out_dist_array[static k]);
 
 
-static inline iscc_hi_DistanceEdge* iscc_hi_get_next_dist(iscc_hi_DistanceEdge* prev_dist,
-                                                          const uint_fast16_t vertex_markers[],
-                                                          uint_fast16_t curr_marker);
+static inline size_t iscc_hi_get_next_dist(iscc_hi_EdgeList* edge_list,
+                                           const uint_fast16_t vertex_markers[],
+                                           uint_fast16_t curr_marker);
 
 
 static inline void iscc_hi_move_point_to_cluster1(scc_PointIndex id,
@@ -161,17 +226,27 @@ static scc_ErrorCode iscc_hi_populate_edge_lists(const iscc_hi_ClusterItem* cl,
                                                  void* data_set,
                                                  scc_PointIndex center1,
                                                  scc_PointIndex center2,
-                                                 iscc_hi_WorkArea* work_area);
+                                                 iscc_hi_WorkArea* work_area,
+                                                 iscc_hi_EdgeList* out_edge_list1,
+                                                 iscc_hi_EdgeList* out_edge_list2);
+
+
+static inline iscc_hi_EdgeList iscc_hi_sort_edge_list(const iscc_hi_ClusterItem* cl,
+                                                      scc_PointIndex center,
+                                                      double row_dists[static cl->size],
+                                                      scc_PointIndex head_store[static cl->size],
+                                                      scc_PointIndex head_scratch[static cl->size],
+                                                      double dist_scratch[static cl->size]);
 
 
-static inline void iscc_hi_sort_edge_list(const iscc_hi_ClusterItem* cl,
-                                          scc_PointIndex center,
-                                          const double row_dists[static cl->size],
-                                          iscc_hi_DistanceEdge edge_store[static cl->size]);
+static void iscc_hi_sort_by_distance(size_t len_edges,
+                                     scc_PointIndex heads[static len_edges],
+                                     double distances[static len_edges],
+                                     scc_PointIndex head_scratch[static len_edges],
+                                     double dist_scratch[static len_edges]);
 
 
-static int iscc_hi_compare_dist_edges(const void* a,
-                                      const void* b);
+static inline uint64_t iscc_hi_distance_key(double distance);
 
 
 // =============================================================================
@@ -223,6 +298,21 @@ scc_ErrorCode scc_hierarchical_clustering(void* const data_set,
 	assert(cl_stack.clusters != NULL);
 	assert(cl_stack.pointindex_store != NULL);
 
+	// Clusters are broken in parallel only with the built-in distance functions,
+	// as other functions need not be thread-safe
+	const uint32_t num_threads = iscc_get_num_threads();
+	if ((num_threads > 1) && iscc_hi_uses_imp_dist_functions()) {
+		ec = iscc_hi_run_parallel_hierarchical_clustering(&cl_stack,
+		                                                  out_clustering,
+		                                                  data_set,
+		                                                  size_constraint,
+		                                                  batch_assign,
+		                                                  num_threads);
+		free(cl_stack.clusters);
+		free(cl_stack.pointindex_store);
+		return ec;
+	}
+
 	const size_t size_pointindex_array = (size_constraint > ISCC_HI_NUM_TO_CHECK) ? size_constraint : ISCC_HI_NUM_TO_CHECK;
 	const size_t size_dist_array = ((2 * size_largest_cluster) > ISCC_HI_NUM_TO_CHECK) ? (2 * size_largest_cluster) : ISCC_HI_NUM_TO_CHECK;
 	iscc_hi_WorkArea work_area = {
@@ -230,13 +320,17 @@ scc_ErrorCode scc_hierarchical_clustering(void* const data_set,
 		.pointindex_array2 = malloc(sizeof(scc_PointIndex[size_pointindex_array])),
 		.dist_array = malloc(sizeof(double[size_dist_array])),
 		.vertex_markers = calloc(out_clustering->num_data_points, sizeof(uint_fast16_t)),
-		.edge_store1 = malloc(sizeof(iscc_hi_DistanceEdge[size_largest_cluster])),
-		.edge_store2 = malloc(sizeof(iscc_hi_DistanceEdge[size_largest_cluster])),
+		.head_store1 = malloc(sizeof(scc_PointIndex[size_largest_cluster])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[size_largest_cluster])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[size_largest_cluster])),
+		.dist_scratch = malloc(sizeof(double[size_largest_cluster])),
+		.max_dist_object = NULL,
 	};
 
 	if ((work_area.pointindex_array1 == NULL) || (work_area.pointindex_array2 == NULL) ||
 	        (work_area.dist_array == NULL) || (work_area.vertex_markers == NULL) ||
-	        (work_area.edge_store1 == NULL) || (work_area.edge_store2 == NULL)) {
+	        (work_area.head_store1 == NULL) || (work_area.head_store2 == NULL) ||
+	        (work_area.head_scratch == NULL) || (work_area.dist_scratch == NULL)) {
 		ec = iscc_make_error(SCC_ER_NO_MEMORY);
 	}
 
@@ -253,8 +347,10 @@ scc_ErrorCode scc_hierarchical_clustering(void* const data_set,
 	free(work_area.pointindex_array2);
 	free(work_area.dist_array);
 	free(work_area.vertex_markers);
-	free(work_area.edge_store1);
-	free(work_area.edge_store2);
+	free(work_area.head_store1);
+	free(work_area.head_store2);
+	free(work_area.head_scratch);
+	free(work_area.dist_scratch);
 	free(cl_stack.clusters);
 	free(cl_stack.pointindex_store);
 
@@ -417,6 +513,279 @@ static scc_ErrorCode iscc_hi_run_hierarchical_clustering(iscc_hi_ClusterStack* c
 }
 
 
+static inline bool iscc_hi_uses_imp_dist_functions(void)
+{
+	const iscc_dist_functions_struct* const dist_functions = iscc_get_dist_functions();
+	return (dist_functions->get_dist_rows == iscc_imp_get_dist_rows) &&
+	       ((dist_functions->init_max_dist_object == iscc_imp_init_max_dist_object) ||
+	        (dist_functions->init_max_dist_object == iscc_imp_init_kdtree_max_dist_object)) &&
+	       (dist_functions->get_max_dist == iscc_imp_get_max_dist) &&
+	       (dist_functions->close_max_dist_object == iscc_imp_close_max_dist_object);
+}
+
+
+// Gives the same clustering as `iscc_hi_run_hierarchical_clustering`. The two
+// halves of a broken cluster are independent, so they are broken further in
+// separate tasks. Each thread has its own small work arrays, while larger
+// work memory is split between clusters by their ranges in `pointindex_store`.
+// The tasks only record where the final clusters start. The sequential version
+// labels clusters in the order they are popped from the stack, which is by
+// descending position in `pointindex_store`, so the final clusters are labeled
+// in that order afterwards.
+static scc_ErrorCode iscc_hi_run_parallel_hierarchical_clustering(iscc_hi_ClusterStack* const cl_stack,
+                                                                  scc_Clustering* const cl,
+                                                                  void* const data_set,
+                                                                  const uint32_t size_constraint,
+                                                                  const bool batch_assign,
+                                                                  const uint32_t num_threads)
+{
+	assert(cl_stack != NULL);
+	assert(cl_stack->items > 0);
+	assert(cl_stack->clusters != NULL);
+	assert(cl_stack->pointindex_store != NULL);
+	assert(iscc_check_input_clustering(cl));
+	assert(iscc_check_data_set(data_set));
+	assert(size_constraint >= 2);
+	assert(num_threads > 0);
+
+	size_t num_stored = 0;
+	for (size_t c = 0; c < cl_stack->items; ++c) {
+		num_stored += cl_stack->clusters[c].size;
+	}
+	if (num_stored == 0) {
+		cl->num_clusters = 0;
+		return iscc_no_error();
+	}
+
+	const size_t size_pointindex_array = (size_constraint > ISCC_HI_NUM_TO_CHECK) ? size_constraint : ISCC_HI_NUM_TO_CHECK;
+	iscc_hi_ParallelContext context = {
+		.data_set = data_set,
+		.size_constraint = size_constraint,
+		.batch_assign = batch_assign,
+		.pointindex_store = cl_stack->pointindex_store,
+		.dist_array = malloc(sizeof(double[2 * num_stored])),
+		.vertex_markers = calloc(cl->num_data_points, sizeof(uint_fast16_t)),
+		.head_store1 = malloc(sizeof(scc_PointIndex[num_stored])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[num_stored])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[num_stored])),
+		.dist_scratch = malloc(sizeof(double[num_stored])),
+		.size_pointindex_array = size_pointindex_array,
+		.thread_pointindex_arrays = malloc(sizeof(scc_PointIndex[2 * num_threads * size_pointindex_array])),
+		.thread_max_dist_objects = malloc(sizeof(iscc_MaxDistObject[num_threads])),
+		.leaf_start = calloc(num_stored, sizeof(bool)),
+		.ec = SCC_ER_OK,
+	};
+
+	if ((context.dist_array == NULL) || (context.vertex_markers == NULL) ||
+	        (context.head_store1 == NULL) || (context.head_store2 == NULL) ||
+	        (context.head_scratch == NULL) || (context.dist_scratch == NULL) ||
+	        (context.thread_pointindex_arrays == NULL) || (context.thread_max_dist_objects == NULL) ||
+	        (context.leaf_start == NULL)) {
+		context.ec = SCC_ER_NO_MEMORY;
+	}
+
+	// Errors in the calling thread are returned as made
+	scc_ErrorCode leading_ec = SCC_ER_OK;
+	if (context.ec == SCC_ER_OK) {
+		leading_ec = iscc_hi_break_leading_clusters(cl_stack, &context);
+		context.ec = leading_ec;
+	}
+
+	if (context.ec == SCC_ER_OK) {
+		// Worker threads must use the distance functions of the calling thread
+		const iscc_dist_functions_struct* const dist_functions = iscc_current_dist_functions;
+		ISCC_OMP_PRAGMA(omp parallel num_threads((int) num_threads))
+		{
+			const iscc_dist_functions_struct* const prev_dist_functions = iscc_current_dist_functions;
+			iscc_current_dist_functions = dist_functions;
+
+			ISCC_OMP_PRAGMA(omp single)
+			{
+				for (size_t c = 0; c < cl_stack->items; ++c) {
+					const iscc_hi_ClusterItem cluster = cl_stack->clusters[c];
+					if (cluster.size >= ISCC_HI_MIN_TASK_SIZE) {
+						ISCC_OMP_PRAGMA(omp task)
+						iscc_hi_break_cluster_task(cluster, &context);
+					} else {
+						iscc_hi_break_cluster_task(cluster, &context);
+					}
+				}
+			} // Tasks are finished at the barrier ending `single`
+
+			iscc_current_dist_functions = prev_dist_functions;
+		}
+	}
+
+	scc_Clabel current_label = 0;
+	if (context.ec == SCC_ER_OK) {
+		size_t leaf_stop = num_stored;
+		for (size_t i = num_stored; i > 0; --i) {
+			if (!context.leaf_start[i - 1]) continue;
+			if (current_label == SCC_CLABEL_MAX) {
+				context.ec = SCC_ER_TOO_LARGE_PROBLEM;
+				break;
+			}
+			for (size_t v = i - 1; v < leaf_stop; ++v) {
+				cl->cluster_label[cl_stack->pointindex_store[v]] = current_label;
+			}
+			++current_label;
+			leaf_stop = i - 1;
+		}
+		assert((context.ec != SCC_ER_OK) || (leaf_stop == 0));
+	}
+
+	free(context.dist_array);
+	free(context.vertex_markers);
+	free(context.head_store1);
+	free(context.head_store2);
+	free(context.head_scratch);
+	free(context.dist_scratch);
+	free(context.thread_pointindex_arrays);
+	free(context.thread_max_dist_objects);
+	free(context.leaf_start);
+
+	if (leading_ec != SCC_ER_OK) {
+		return leading_ec;
+	} else if (context.ec == SCC_ER_TOO_LARGE_PROBLEM) {
+		return iscc_make_error_msg(SCC_ER_TOO_LARGE_PROBLEM, "Too many clusters (adjust the `scc_Clabel` type).");
+	} else if (context.ec != SCC_ER_OK) {
+		// Errors in worker threads are reported in the calling thread
+		return iscc_make_error(context.ec);
+	}
+
+	cl->num_clusters = (size_t) current_label;
+
+	return iscc_no_error();
+}
+
+
+// As long as only one cluster is large enough for a task, breaking it is not
+// parallel anyway. Such clusters, e.g., the root cluster, are broken in the
+// calling thread before the parallel region, where the max-dist object can be
+// allocated. The splits then use the configured object (e.g., a kd-tree) rather
+// than the brute-force objects of the tasks.
+static scc_ErrorCode iscc_hi_break_leading_clusters(iscc_hi_ClusterStack* const cl_stack,
+                                                    iscc_hi_ParallelContext* const context)
+{
+	assert(cl_stack != NULL);
+	assert(cl_stack->clusters != NULL);
+	assert(context != NULL);
+
+	const size_t min_size = (ISCC_HI_MIN_TASK_SIZE > 2 * (size_t) context->size_constraint) ?
+	                        ISCC_HI_MIN_TASK_SIZE : 2 * (size_t) context->size_constraint;
+
+	scc_ErrorCode ec;
+	while (true) {
+		size_t num_large = 0;
+		size_t large_index = 0;
+		for (size_t c = 0; c < cl_stack->items; ++c) {
+			if (cl_stack->clusters[c].size >= min_size) {
+				++num_large;
+				large_index = c;
+			}
+		}
+		if (num_large != 1) break;
+
+		if ((ec = iscc_hi_check_capacity(cl_stack)) != SCC_ER_OK) {
+			return ec;
+		}
+
+		iscc_hi_ClusterItem* const current_cluster = &cl_stack->clusters[large_index];
+		iscc_hi_ClusterItem* new_cluster = NULL; // Initialize to avoid gcc warning
+		iscc_hi_push_to_stack(cl_stack, &new_cluster);
+		iscc_hi_WorkArea work_area = iscc_hi_get_work_area(current_cluster, context, 0, NULL);
+		if ((ec = iscc_hi_break_cluster_into_two(current_cluster,
+		                                         context->data_set,
+		                                         &work_area,
+		                                         context->size_constraint,
+		                                         context->batch_assign,
+		                                         new_cluster)) != SCC_ER_OK) {
+			return ec;
+		}
+	}
+
+	return iscc_no_error();
+}
+
+
+// Breaks `cluster` until it is smaller than `2 * size_constraint`. The smaller
+// half of each break is handed to a new task, or broken directly if it is small,
+// so the recursion depth is logarithmic in the cluster size.
+static void iscc_hi_break_cluster_task(iscc_hi_ClusterItem cluster,
+                                       iscc_hi_ParallelContext* const context)
+{
+	assert(context != NULL);
+
+	while (cluster.size >= 2 * context->size_constraint) {
+		scc_ErrorCode ec;
+		ISCC_OMP_PRAGMA(omp atomic read)
+		ec = context->ec;
+		if (ec != SCC_ER_OK) return;
+
+		// The work area is only used until the next task scheduling point,
+		// so tasks run on the same thread can share it
+		const uint32_t thread_num = iscc_get_thread_num();
+		iscc_hi_WorkArea work_area = iscc_hi_get_work_area(&cluster,
+		                                                   context,
+		                                                   thread_num,
+		                                                   &context->thread_max_dist_objects[thread_num]);
+
+		iscc_hi_ClusterItem new_cluster;
+		if ((ec = iscc_hi_break_cluster_into_two(&cluster,
+		                                         context->data_set,
+		                                         &work_area,
+		                                         context->size_constraint,
+		                                         context->batch_assign,
+		                                         &new_cluster)) != SCC_ER_OK) {
+			ISCC_OMP_PRAGMA(omp atomic write)
+			context->ec = ec;
+			return;
+		}
+
+		if (new_cluster.size > cluster.size) {
+			const iscc_hi_ClusterItem tmp_cluster = cluster;
+			cluster = new_cluster;
+			new_cluster = tmp_cluster;
+		}
+
+		if (new_cluster.size >= ISCC_HI_MIN_TASK_SIZE) {
+			ISCC_OMP_PRAGMA(omp task)
+			iscc_hi_break_cluster_task(new_cluster, context);
+		} else {
+			iscc_hi_break_cluster_task(new_cluster, context);
+		}
+	}
+
+	if (cluster.size > 0) {
+		context->leaf_start[cluster.members - context->pointindex_store] = true;
+	}
+}
+
+
+static inline iscc_hi_WorkArea iscc_hi_get_work_area(const iscc_hi_ClusterItem* const cluster,
+                                                     const iscc_hi_ParallelContext* const context,
+                                                     const uint32_t thread_num,
+                                                     iscc_MaxDistObject* const max_dist_object)
+{
+	assert(cluster != NULL);
+	assert(context != NULL);
+
+	const size_t offset = (size_t) (cluster->members - context->pointindex_store);
+	iscc_hi_WorkArea work_area = {
+		.pointindex_array1 = context->thread_pointindex_arrays + (2 * thread_num) * context->size_pointindex_array,
+		.pointindex_array2 = context->thread_pointindex_arrays + (2 * thread_num + 1) * context->size_pointindex_array,
+		.dist_array = context->dist_array + 2 * offset,
+		.vertex_markers = context->vertex_markers,
+		.head_store1 = context->head_store1 + offset,
+		.head_store2 = context->head_store2 + offset,
+		.head_scratch = context->head_scratch + offset,
+		.dist_scratch = context->dist_scratch + offset,
+		.max_dist_object = max_dist_object,
+	};
+	return work_area;
+}
+
+
 static scc_ErrorCode iscc_hi_check_capacity(iscc_hi_ClusterStack* const cl_stack)
 {
 	assert(cl_stack != NULL);
@@ -466,8 +835,6 @@ static scc_ErrorCode iscc_hi_break_cluster_into_two(iscc_hi_ClusterItem* const c
 	assert(work_area->pointindex_array1 != NULL);
 	assert(work_area->pointindex_array2 != NULL);
 	assert(work_area->vertex_markers != NULL);
-	assert(work_area->edge_store1 != NULL);
-	assert(work_area->edge_store2 != NULL);
 	assert(size_constraint >= 2);
 	assert(out_new_cluster != NULL);
 
@@ -483,11 +850,15 @@ static scc_ErrorCode iscc_hi_break_cluster_into_two(iscc_hi_ClusterItem* const c
 		return ec;
 	}
 
+	iscc_hi_EdgeList edge_list1 = { 0, 0, NULL, NULL };
+	iscc_hi_EdgeList edge_list2 = { 0, 0, NULL, NULL };
 	if ((ec = iscc_hi_populate_edge_lists(cluster_to_break,
 	                                      data_set,
 	                                      center1,
 	                                      center2,
-	                                      work_area)) != SCC_ER_OK) {
+	                                      work_area,
+	                                      &edge_list1,
+	                                      &edge_list2)) != SCC_ER_OK) {
 		return ec;
 	}
 
@@ -495,12 +866,8 @@ static scc_ErrorCode iscc_hi_break_cluster_into_two(iscc_hi_ClusterItem* const c
 	scc_PointIndex* const k_nn_array2 = work_area->pointindex_array2;
 	uint_fast16_t* const vertex_markers = work_area->vertex_markers;
 
-	// `edge_store1` and `edge_store2` have been populated by `iscc_hi_populate_edge_lists`
-	iscc_hi_DistanceEdge* last_assigned_edge1 = work_area->edge_store1;
-	iscc_hi_DistanceEdge* last_assigned_edge2 = work_area->edge_store2;
-
-	iscc_hi_DistanceEdge* temp_edge1;
-	iscc_hi_DistanceEdge* temp_edge2;
+	size_t temp_edge1;
+	size_t temp_edge2;
 
 	size_t num_unassigned = cluster_to_break->size;
 	const uint_fast16_t curr_marker = iscc_hi_get_next_marker(cluster_to_break, vertex_markers);
@@ -518,20 +885,19 @@ static scc_ErrorCode iscc_hi_break_cluster_into_two(iscc_hi_ClusterItem* const c
 	iscc_hi_move_point_to_cluster1(center1, cluster1, vertex_markers, curr_marker);
 	iscc_hi_move_point_to_cluster2(center2, cluster2, vertex_markers, curr_marker);
 
-	temp_edge1 = iscc_hi_get_next_k_nn(last_assigned_edge1, size_constraint - 1, vertex_markers, curr_marker, k_nn_array1);
-	temp_edge2 = iscc_hi_get_next_k_nn(last_assigned_edge2, size_constraint - 1, vertex_markers, curr_marker, k_nn_array2);
+	// Assigned points are skipped by later calls to `iscc_hi_get_next_k_nn` and `iscc_hi_get_next_dist`
+	temp_edge1 = iscc_hi_get_next_k_nn(&edge_list1, size_constraint - 1, vertex_markers, curr_marker, k_nn_array1);
+	temp_edge2 = iscc_hi_get_next_k_nn(&edge_list2, size_constraint - 1, vertex_markers, curr_marker, k_nn_array2);
 
-	if (temp_edge1->distance >= temp_edge2->distance) {
+	if (edge_list1.distances[temp_edge1] >= edge_list2.distances[temp_edge2]) {
 		iscc_hi_move_array_to_cluster1(size_constraint - 1, k_nn_array1, cluster1, vertex_markers, curr_marker);
-		last_assigned_edge1 = temp_edge1;
 
-		last_assigned_edge2 = iscc_hi_get_next_k_nn(last_assigned_edge2, size_constraint - 1, vertex_markers, curr_marker, k_nn_array2);
+		iscc_hi_get_next_k_nn(&edge_list2, size_constraint - 1, vertex_markers, curr_marker, k_nn_array2);
 		iscc_hi_move_array_to_cluster2(size_constraint - 1, k_nn_array2, cluster2, vertex_markers, curr_marker);
 	} else {
 		iscc_hi_move_array_to_cluster2(size_constraint - 1, k_nn_array2, cluster2, vertex_markers, curr_marker);
-		last_assigned_edge2 = temp_edge2;
 
-		last_assigned_edge1 = iscc_hi_get_next_k_nn(last_assigned_edge1, size_constraint - 1, vertex_markers, curr_marker, k_nn_array1);
+		iscc_hi_get_next_k_nn(&edge_list1, size_constraint - 1, vertex_markers, curr_marker, k_nn_array1);
 		iscc_hi_move_array_to_cluster1(size_constraint - 1, k_nn_array1, cluster1, vertex_markers, curr_marker);
 	}
 
@@ -545,29 +911,25 @@ static scc_ErrorCode iscc_hi_break_cluster_into_two(iscc_hi_ClusterItem* const c
 
 			if (num_assign_in_batch > num_unassigned) num_assign_in_batch = (uint32_t) num_unassigned;
 
-			temp_edge1 = iscc_hi_get_next_k_nn(last_assigned_edge1, num_assign_in_batch, vertex_markers, curr_marker, k_nn_array1);
-			temp_edge2 = iscc_hi_get_next_k_nn(last_assigned_edge2, num_assign_in_batch, vertex_markers, curr_marker, k_nn_array2);
+			temp_edge1 = iscc_hi_get_next_k_nn(&edge_list1, num_assign_in_batch, vertex_markers, curr_marker, k_nn_array1);
+			temp_edge2 = iscc_hi_get_next_k_nn(&edge_list2, num_assign_in_batch, vertex_markers, curr_marker, k_nn_array2);
 
-			if (temp_edge1->distance <= temp_edge2->distance) {
+			if (edge_list1.distances[temp_edge1] <= edge_list2.distances[temp_edge2]) {
 				iscc_hi_move_array_to_cluster1(num_assign_in_batch, k_nn_array1, cluster1, vertex_markers, curr_marker);
-				last_assigned_edge1 = temp_edge1;
 			} else {
 				iscc_hi_move_array_to_cluster2(num_assign_in_batch, k_nn_array2, cluster2, vertex_markers, curr_marker);
-				last_assigned_edge2 = temp_edge2;
 			}
 		}
 
 	} else {
 		for (; num_unassigned > 0; --num_unassigned) {
-			temp_edge1 = iscc_hi_get_next_dist(last_assigned_edge1, vertex_markers, curr_marker);
-			temp_edge2 = iscc_hi_get_next_dist(last_assigned_edge2, vertex_markers, curr_marker);
+			temp_edge1 = iscc_hi_get_next_dist(&edge_list1, vertex_markers, curr_marker);
+			temp_edge2 = iscc_hi_get_next_dist(&edge_list2, vertex_markers, curr_marker);
 
-			if (temp_edge1->distance <= temp_edge2->distance) {
-				iscc_hi_move_point_to_cluster1(temp_edge1->head, cluster1, vertex_markers, curr_marker);
-				last_assigned_edge1 = temp_edge1;
+			if (edge_list1.distances[temp_edge1] <= edge_list2.distances[temp_edge2]) {
+				iscc_hi_move_point_to_cluster1(edge_list1.heads[temp_edge1], cluster1, vertex_markers, curr_marker);
 			} else {
-				iscc_hi_move_point_to_cluster2(temp_edge2->head, cluster2, vertex_markers, curr_marker);
-				last_assigned_edge2 = temp_edge2;
+				iscc_hi_move_point_to_cluster2(edge_list2.heads[temp_edge2], cluster2, vertex_markers, curr_marker);
 			}
 		}
 	}
@@ -601,42 +963,70 @@ static inline uint_fast16_t iscc_hi_get_next_marker(iscc_hi_ClusterItem* const c
 }
 
 
-static inline iscc_hi_DistanceEdge* iscc_hi_get_next_k_nn(iscc_hi_DistanceEdge* prev_dist,
-                                                          const uint32_t k,
-                                                          const uint_fast16_t vertex_markers[const],
-                                                          const uint_fast16_t curr_marker,
-                                                          scc_PointIndex out_dist_array[const static k])
+// Finds the next `k` unassigned points in `edge_list` and returns the position
+// of the last of them. The points are not assigned. Assigned points passed on
+// the way are removed by moving the found points next to the returned position.
+static inline size_t iscc_hi_get_next_k_nn(iscc_hi_EdgeList* const edge_list,
+                                           const uint32_t k,
+                                           const uint_fast16_t vertex_markers[const],
+                                           const uint_fast16_t curr_marker,
+                                           scc_PointIndex out_dist_array[const static k])
 {
-	assert(prev_dist != NULL);
-	assert(prev_dist->next_dist != NULL); // We should never reach the end!
+	assert(edge_list != NULL);
+	assert(edge_list->next < edge_list->len); // We should never reach the end!
 	assert(k > 0);
 	assert(vertex_markers != NULL);
 	assert(out_dist_array != NULL);
 
-	for (uint32_t found = 0; found < k; ++found) {
-		prev_dist = iscc_hi_get_next_dist(prev_dist, vertex_markers, curr_marker);
-		out_dist_array[found] = prev_dist->head;
+	scc_PointIndex* const heads = edge_list->heads;
+	size_t read = edge_list->next;
+	for (uint32_t found = 0; found < k; ++read) {
+		assert(read < edge_list->len); // We should never reach the end!
+		if (vertex_markers[heads[read]] != curr_marker) {
+			out_dist_array[found] = heads[read];
+			++found;
+		}
+	}
+
+	if (read - edge_list->next > k) {
+		double* const distances = edge_list->distances;
+		size_t write = read;
+		for (uint32_t found = k; found > 0; ) {
+			--read;
+			if (vertex_markers[heads[read]] != curr_marker) {
+				--write;
+				--found;
+				heads[write] = heads[read];
+				distances[write] = distances[read];
+			}
+		}
+		read = write + k;
+		edge_list->next = write;
 	}
 
-	return prev_dist;
+	return read - 1;
 }
 
 
-static inline iscc_hi_DistanceEdge* iscc_hi_get_next_dist(iscc_hi_DistanceEdge* const prev_dist,
-                                                          const uint_fast16_t vertex_markers[const],
-                                                          const uint_fast16_t curr_marker)
+// Returns the position of the next unassigned point in `edge_list`.
+static inline size_t iscc_hi_get_next_dist(iscc_hi_EdgeList* const edge_list,
+                                           const uint_fast16_t vertex_markers[const],
+                                           const uint_fast16_t curr_marker)
 {
-	assert(prev_dist != NULL);
-	assert(prev_dist->next_dist != NULL); // We should never reach the end!
+	assert(edge_list != NULL);
+	assert(edge_list->next < edge_list->len); // We should never reach the end!
 	assert(vertex_markers != NULL);
 
-	while(vertex_markers[prev_dist->next_dist->head] == curr_marker) {
+	const scc_PointIndex* const heads = edge_list->heads;
+	size_t next = edge_list->next;
+	while (vertex_markers[heads[next]] == curr_marker) {
 		// Vertex has already been assigned to a new cluster, skip it
-		prev_dist->next_dist = prev_dist->next_dist->next_dist;
-		assert(prev_dist->next_dist != NULL); // We should never reach the end!
+		++next;
+		assert(next < edge_list->len); // We should never reach the end!
 	}
+	edge_list->next = next;
 
-	return prev_dist->next_dist;
+	return next;
 }
 
 
@@ -762,15 +1152,19 @@ static scc_ErrorCode iscc_hi_find_centers(iscc_hi_ClusterItem* const cl,
 		vertex_markers[to_check[i]] = curr_marker;
 	}
 
-	iscc_MaxDistObject* max_dist_object;
-	if (!iscc_init_max_dist_object(data_set, cl->size, cl->members, &max_dist_object)) {
+	iscc_MaxDistObject* max_dist_object = work_area->max_dist_object;
+	if (max_dist_object != NULL) {
+		iscc_imp_set_max_dist_object(data_set, cl->size, cl->members, max_dist_object);
+	} else if (!iscc_init_max_dist_object(data_set, cl->size, cl->members, &max_dist_object)) {
 		return iscc_make_error(SCC_ER_DIST_SEARCH_ERROR);
 	}
 
 	double max_dist = -1.0;
 	while (num_to_check > 0) {
 		if (!iscc_get_max_dist(max_dist_object, num_to_check, to_check, max_indices, max_dists)) {
-			iscc_close_max_dist_object(&max_dist_object);
+			if (work_area->max_dist_object == NULL) {
+				iscc_close_max_dist_object(&max_dist_object);
+			}
 			return iscc_make_error(SCC_ER_DIST_SEARCH_ERROR);
 		}
 
@@ -792,7 +1186,7 @@ static scc_ErrorCode iscc_hi_find_centers(iscc_hi_ClusterItem* const cl,
 		num_to_check = write_in_to_check;
 	}
 
-	if (!iscc_close_max_dist_object(&max_dist_object)) {
+	if ((work_area->max_dist_object == NULL) && !iscc_close_max_dist_object(&max_dist_object)) {
 		return iscc_make_error(SCC_ER_DIST_SEARCH_ERROR);
 	}
 
@@ -804,7 +1198,9 @@ static scc_ErrorCode iscc_hi_populate_edge_lists(const iscc_hi_ClusterItem* cons
                                                  void* const data_set,
                                                  const scc_PointIndex center1,
                                                  const scc_PointIndex center2,
-                                                 iscc_hi_WorkArea* const work_area)
+                                                 iscc_hi_WorkArea* const work_area,
+                                                 iscc_hi_EdgeList* const out_edge_list1,
+                                                 iscc_hi_EdgeList* const out_edge_list2)
 {
 	assert(cl != NULL);
 	assert(cl->size >= 4);
@@ -813,8 +1209,12 @@ static scc_ErrorCode iscc_hi_populate_edge_lists(const iscc_hi_ClusterItem* cons
 	assert(iscc_check_data_set(data_set));
 	assert(work_area != NULL);
 	assert(work_area->dist_array != NULL);
-	assert(work_area->edge_store1 != NULL);
-	assert(work_area->edge_store2 != NULL);
+	assert(work_area->head_store1 != NULL);
+	assert(work_area->head_store2 != NULL);
+	assert(work_area->head_scratch != NULL);
+	assert(work_area->dist_scratch != NULL);
+	assert(out_edge_list1 != NULL);
+	assert(out_edge_list2 != NULL);
 
 	double* const row_dists = work_area->dist_array;
 	const scc_PointIndex query_indices[2] = { center1, center2 };
@@ -828,51 +1228,137 @@ static scc_ErrorCode iscc_hi_populate_edge_lists(const iscc_hi_ClusterItem* cons
 		return iscc_make_error(SCC_ER_DIST_SEARCH_ERROR);
 	}
 
-	iscc_hi_sort_edge_list(cl, center1, row_dists, work_area->edge_store1);
-	iscc_hi_sort_edge_list(cl, center2, row_dists + cl->size, work_area->edge_store2);
+	// The distances are sorted in place in `row_dists`
+	*out_edge_list1 = iscc_hi_sort_edge_list(cl, center1, row_dists, work_area->head_store1,
+	                                         work_area->head_scratch, work_area->dist_scratch);
+	*out_edge_list2 = iscc_hi_sort_edge_list(cl, center2, row_dists + cl->size, work_area->head_store2,
+	                                         work_area->head_scratch, work_area->dist_scratch);
 
 	return iscc_no_error();
 }
 
 
-static inline void iscc_hi_sort_edge_list(const iscc_hi_ClusterItem* const cl,
-                                          const scc_PointIndex center,
-                                          const double row_dists[const static cl->size],
-                                          iscc_hi_DistanceEdge edge_store[const static cl->size])
+// Removes `center` from the list and sorts the remaining points by distance.
+// The returned list refers to `head_store` and `row_dists`.
+static inline iscc_hi_EdgeList iscc_hi_sort_edge_list(const iscc_hi_ClusterItem* const cl,
+                                                      const scc_PointIndex center,
+                                                      double row_dists[const static cl->size],
+                                                      scc_PointIndex head_store[const static cl->size],
+                                                      scc_PointIndex head_scratch[const static cl->size],
+                                                      double dist_scratch[const static cl->size])
 {
 	assert(cl != NULL);
 	assert(cl->size >= 4);
 	assert(cl->members != NULL);
 	assert(row_dists != NULL);
-	assert(edge_store != NULL);
+	assert(head_store != NULL);
+	assert(head_scratch != NULL);
+	assert(dist_scratch != NULL);
 
-	iscc_hi_DistanceEdge* write_edge = edge_store + 1;
+	size_t write = 0;
 	for (size_t i = 0; i < cl->size; ++i) {
 		if (cl->members[i] == center) continue;
-		write_edge->head = cl->members[i];
-		write_edge->distance = row_dists[i];
-		++write_edge;
+		head_store[write] = cl->members[i];
+		row_dists[write] = row_dists[i];
+		++write;
 	}
 
-	assert(write_edge == (edge_store + cl->size));
+	assert(write == cl->size - 1);
 
-	qsort(edge_store + 1, cl->size - 1, sizeof(iscc_hi_DistanceEdge), iscc_hi_compare_dist_edges);
+	iscc_hi_sort_by_distance(write, head_store, row_dists, head_scratch, dist_scratch);
 
-	iscc_hi_DistanceEdge* const edge_stop = edge_store + cl->size - 1;
-	for (iscc_hi_DistanceEdge* edge = edge_store; edge != edge_stop; ++edge) {
-		edge->next_dist = edge + 1;
-	}
-	edge_stop->next_dist = NULL;
+	return (iscc_hi_EdgeList) {
+		.len = write,
+		.next = 0,
+		.heads = head_store,
+		.distances = row_dists,
+	};
 }
 
 
-static int iscc_hi_compare_dist_edges(const void* const a,
-                                      const void* const b)
+// Stable sort of `heads` and `distances` by distance. Longer lists are sorted
+// by an LSD radix sort on the bit patterns of the distances, one byte at a time.
+// Bytes that are the same in all distances (e.g., the sign and most of the
+// exponent) are skipped.
+static void iscc_hi_sort_by_distance(const size_t len_edges,
+                                     scc_PointIndex heads[const static len_edges],
+                                     double distances[const static len_edges],
+                                     scc_PointIndex head_scratch[const static len_edges],
+                                     double dist_scratch[const static len_edges])
 {
-	const double dist_a = ((const iscc_hi_DistanceEdge*)a)->distance;
-	const double dist_b = ((const iscc_hi_DistanceEdge*)b)->distance;
+	assert(len_edges > 0);
+	assert(heads != NULL);
+	assert(distances != NULL);
+	assert(head_scratch != NULL);
+	assert(dist_scratch != NULL);
+
+	if (len_edges < ISCC_HI_MIN_RADIX_SORT) {
+		for (size_t i = 1; i < len_edges; ++i) {
+			const scc_PointIndex tmp_head = heads[i];
+			const double tmp_dist = distances[i];
+			size_t j = i;
+			for (; (j > 0) && (distances[j - 1] > tmp_dist); --j) {
+				heads[j] = heads[j - 1];
+				distances[j] = distances[j - 1];
+			}
+			heads[j] = tmp_head;
+			distances[j] = tmp_dist;
+		}
+		return;
+	}
+
+	size_t counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < len_edges; ++i) {
+		const uint64_t key = iscc_hi_distance_key(distances[i]);
+		for (size_t b = 0; b < 8; ++b) {
+			++counts[b][(key >> (8 * b)) & 0xFF];
+		}
+	}
+
+	const uint64_t first_key = iscc_hi_distance_key(distances[0]);
+	scc_PointIndex* from_heads = heads;
+	double* from_dists = distances;
+	scc_PointIndex* to_heads = head_scratch;
+	double* to_dists = dist_scratch;
+	for (size_t b = 0; b < 8; ++b) {
+		if (counts[b][(first_key >> (8 * b)) & 0xFF] == len_edges) continue;
+
+		size_t offsets[256];
+		size_t sum = 0;
+		for (size_t d = 0; d < 256; ++d) {
+			offsets[d] = sum;
+			sum += counts[b][d];
+		}
+
+		for (size_t i = 0; i < len_edges; ++i) {
+			const uint64_t key = iscc_hi_distance_key(from_dists[i]);
+			const size_t pos = offsets[(key >> (8 * b)) & 0xFF]++;
+			to_heads[pos] = from_heads[i];
+			to_dists[pos] = from_dists[i];
+		}
+
+		scc_PointIndex* const tmp_heads = from_heads;
+		from_heads = to_heads;
+		to_heads = tmp_heads;
+		double* const tmp_dists = from_dists;
+		from_dists = to_dists;
+		to_dists = tmp_dists;
+	}
+
+	if (from_heads != heads) {
+		memcpy(heads, from_heads, sizeof(scc_PointIndex[len_edges]));
+		memcpy(distances, from_dists, sizeof(double[len_edges]));
+	}
+}
 
-	if (dist_a < dist_b) return -1;
-	if (dist_a > dist_b) return 1;
-	return 0;
+
+// Non-negative doubles are ordered as their bit patterns read as unsigned integers
+static inline uint64_t iscc_hi_distance_key(const double distance)
+{
+	assert(sizeof(double) == sizeof(uint64_t));
+	if (!(distance > 0.0)) return 0; // Also maps negative zero to zero
+	uint64_t key;
+	memcpy(&key, &distance, sizeof(uint64_t));
+	return key;
 }
@@ -0,0 +1,1002 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "hnsw.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/scclust.h"
+#include "../include/scclust_spi.h"
+#include "data_set_struct.h"
+#include "dist_kernels.h"
+#include "scclust_types.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Internal structs and variables
+// =============================================================================
+
+// Levels are capped so that a level fits in a byte
+#define ISCC_HNSW_MAX_LEVEL 16
+
+
+// Points are inserted in batches of at most `ISCC_HNSW_MAX_BATCH` points, and
+// of at most one in `ISCC_HNSW_BATCH_FRACTION` of the points already in the
+// graph, so that few points are missing from the graph a batch is linked to
+#define ISCC_HNSW_MAX_BATCH 256
+#define ISCC_HNSW_BATCH_FRACTION 16
+
+
+// Batches smaller than this are not split between threads
+#define ISCC_HNSW_MIN_PARALLEL_BATCH 16
+
+
+typedef struct iscc_HNSWParameters {
+	uint32_t num_links;
+	uint32_t ef_construction;
+	uint32_t ef_search;
+} iscc_HNSWParameters;
+
+
+// Parameters set by `scc_set_hnsw_parameters` in this thread
+static ISCC_THREAD_LOCAL iscc_HNSWParameters iscc_hnsw_parameters = { 16, 100, 64 };
+
+
+struct iscc_HNSW {
+	int32_t hnsw_version;
+	const scc_DataSet* data_set;
+	size_t num_points;
+	const scc_PointIndex* search_indices;
+	// Position in the search set of each data point, `ISCC_POINTINDEX_MAX_PI` if
+	// not a search point. `NULL` when `search_indices` is `NULL`.
+	scc_PointIndex* positions;
+	iscc_HNSWParameters parameters;
+	size_t entry_point;
+	uint_fast16_t max_level;
+	uint8_t* levels;
+	// Links of position `p` on level 0 are stored from `links[p * (2 * num_links + 1)]`,
+	// and on level `l > 0` from `upper_links[upper_offsets[p] + (l - 1) * (num_links + 1)]`.
+	// Each list is the number of links followed by the linked positions.
+	scc_PointIndex* links;
+	size_t* upper_offsets;
+	scc_PointIndex* upper_links;
+};
+
+
+static const int32_t ISCC_HNSW_STRUCT_VERSION = 722917001;
+
+
+// Link from `position` to be added to the links of `neighbor` on `level`
+typedef struct iscc_HNSWReverseLink {
+	uint32_t level;
+	scc_PointIndex neighbor;
+	scc_PointIndex position;
+} iscc_HNSWReverseLink;
+
+
+// Reverse links of a batch grouped by the list they are added to
+typedef struct iscc_HNSWReverseLinks {
+	size_t capacity;
+	size_t num_links;
+	size_t num_groups;
+	iscc_HNSWReverseLink* links;
+	// Links of group `g` are `links[group_starts[g]]` to `links[group_starts[g + 1] - 1]`
+	size_t* group_starts;
+} iscc_HNSWReverseLinks;
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static uint_fast16_t iscc_hnsw_draw_level(size_t position,
+                                          double level_mult);
+
+static void iscc_hnsw_find_links(iscc_HNSW* graph,
+                                 size_t position,
+                                 size_t entry_point,
+                                 uint_fast16_t max_level,
+                                 iscc_HNSWScratch* scratch);
+
+static void iscc_hnsw_add_reverse_links(iscc_HNSW* graph,
+                                        size_t position,
+                                        uint_fast16_t max_level,
+                                        iscc_HNSWScratch* scratch);
+
+static bool iscc_hnsw_group_reverse_links(const iscc_HNSW* graph,
+                                          size_t begin,
+                                          size_t end,
+                                          uint_fast16_t max_level,
+                                          iscc_HNSWReverseLinks* reverse_links);
+
+static int iscc_hnsw_compare_reverse_links(const void* a,
+                                           const void* b);
+
+static void iscc_hnsw_add_reverse_link(iscc_HNSW* graph,
+                                       uint_fast16_t level,
+                                       size_t neighbor,
+                                       size_t position,
+                                       iscc_HNSWScratch* scratch);
+
+static uint32_t iscc_hnsw_select_links(const iscc_HNSW* graph,
+                                       uint32_t num_candidates,
+                                       const double cand_dists[],
+                                       scc_PointIndex cand_positions[],
+                                       uint32_t max_links,
+                                       scc_PointIndex out_links[]);
+
+static uint32_t iscc_hnsw_search_level(const iscc_HNSW* graph,
+                                       size_t query,
+                                       uint_fast16_t level,
+                                       uint32_t ef,
+                                       uint32_t num_best,
+                                       iscc_HNSWScratch* scratch);
+
+static size_t iscc_hnsw_drop_far_open(size_t num_open,
+                                      double open_dists[],
+                                      scc_PointIndex open_positions[],
+                                      double max_dist,
+                                      scc_PointIndex max_position);
+
+static uint32_t iscc_hnsw_scan_unvisited(const iscc_HNSW* graph,
+                                         size_t query,
+                                         uint32_t ef,
+                                         uint32_t num_best,
+                                         iscc_HNSWScratch* scratch);
+
+static void iscc_hnsw_sort(size_t len,
+                           double dists[],
+                           scc_PointIndex positions[]);
+
+static inline size_t iscc_hnsw_point(const iscc_HNSW* graph,
+                                     size_t position);
+
+static inline scc_PointIndex* iscc_hnsw_links(const iscc_HNSW* graph,
+                                              size_t position,
+                                              uint_fast16_t level);
+
+static inline bool iscc_hnsw_before(double dist1,
+                                    scc_PointIndex pos1,
+                                    double dist2,
+                                    scc_PointIndex pos2);
+
+static inline void iscc_hnsw_heap_push(bool max_heap,
+                                       double dists[],
+                                       scc_PointIndex positions[],
+                                       size_t len_heap,
+                                       double dist,
+                                       scc_PointIndex position);
+
+static inline void iscc_hnsw_heap_replace_top(bool max_heap,
+                                              double dists[],
+                                              scc_PointIndex positions[],
+                                              size_t len_heap,
+                                              double dist,
+                                              scc_PointIndex position);
+
+
+// =============================================================================
+// Public function implementations
+// =============================================================================
+
+bool scc_set_hnsw_parameters(const uint32_t num_links,
+                             const uint32_t ef_construction,
+                             const uint32_t ef_search)
+{
+	if ((num_links < 2) || (num_links > 1024)) return false;
+	if ((ef_construction == 0) || (ef_search == 0)) return false;
+
+	iscc_hnsw_parameters = (iscc_HNSWParameters) {
+		.num_links = num_links,
+		.ef_construction = ef_construction,
+		.ef_search = ef_search,
+	};
+
+	return true;
+}
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+bool iscc_hnsw_build_graph(const scc_DataSet* const data_set,
+                           const size_t len_search_indices,
+                           const scc_PointIndex search_indices[const],
+                           iscc_HNSW** const out_graph)
+{
+	assert(data_set != NULL);
+	assert(len_search_indices > 0);
+	assert(len_search_indices <= data_set->num_data_points);
+	assert(out_graph != NULL);
+
+	const iscc_HNSWParameters parameters = iscc_hnsw_parameters;
+	const size_t level0_stride = 2 * (size_t) parameters.num_links + 1;
+	const size_t upper_stride = (size_t) parameters.num_links + 1;
+
+	iscc_HNSW* graph = malloc(sizeof(iscc_HNSW));
+	if (graph == NULL) return false;
+
+	*graph = (iscc_HNSW) {
+		.hnsw_version = ISCC_HNSW_STRUCT_VERSION,
+		.data_set = data_set,
+		.num_points = len_search_indices,
+		.search_indices = search_indices,
+		.positions = NULL,
+		.parameters = parameters,
+		.entry_point = 0,
+		.max_level = 0,
+		.levels = malloc(sizeof(uint8_t[len_search_indices])),
+		.links = malloc(sizeof(scc_PointIndex[len_search_indices * level0_stride])),
+		.upper_offsets = malloc(sizeof(size_t[len_search_indices])),
+		.upper_links = NULL,
+	};
+
+	if ((graph->levels == NULL) || (graph->links == NULL) || (graph->upper_offsets == NULL)) {
+		iscc_hnsw_free_graph(&graph);
+		return false;
+	}
+
+	const double level_mult = 1.0 / log((double) parameters.num_links);
+	size_t len_upper_links = 0;
+	for (size_t p = 0; p < len_search_indices; ++p) {
+		graph->levels[p] = (uint8_t) iscc_hnsw_draw_level(p, level_mult);
+		graph->upper_offsets[p] = len_upper_links;
+		len_upper_links += graph->levels[p] * upper_stride;
+		graph->links[p * level0_stride] = 0;
+	}
+
+	graph->upper_links = malloc(sizeof(scc_PointIndex[len_upper_links + 1]));
+	if (graph->upper_links == NULL) {
+		iscc_hnsw_free_graph(&graph);
+		return false;
+	}
+	for (size_t i = 0; i < len_upper_links; i += upper_stride) {
+		graph->upper_links[i] = 0;
+	}
+
+	if (search_indices != NULL) {
+		graph->positions = malloc(sizeof(scc_PointIndex[data_set->num_data_points]));
+		if (graph->positions == NULL) {
+			iscc_hnsw_free_graph(&graph);
+			return false;
+		}
+		for (size_t i = 0; i < data_set->num_data_points; ++i) {
+			graph->positions[i] = ISCC_POINTINDEX_MAX_PI;
+		}
+		for (size_t p = 0; p < len_search_indices; ++p) {
+			assert(((size_t) search_indices[p]) < data_set->num_data_points);
+			graph->positions[search_indices[p]] = (scc_PointIndex) p;
+		}
+	}
+
+	graph->entry_point = 0;
+	graph->max_level = graph->levels[0];
+	if (len_search_indices == 1) {
+		*out_graph = graph;
+		return true;
+	}
+
+	uint32_t num_threads = iscc_get_num_threads();
+	if (len_search_indices < ISCC_HNSW_MIN_PARALLEL_BATCH * ISCC_HNSW_BATCH_FRACTION) {
+		num_threads = 1;
+	}
+
+	// Each thread gets its own scratch
+	iscc_HNSWScratch* const scratch = malloc(sizeof(iscc_HNSWScratch[num_threads]));
+	if (scratch == NULL) {
+		iscc_hnsw_free_graph(&graph);
+		return false;
+	}
+	for (uint32_t t = 0; t < num_threads; ++t) {
+		if (!iscc_hnsw_init_scratch(graph, 1, &scratch[t])) {
+			while (t > 0) {
+				--t;
+				iscc_hnsw_free_scratch(&scratch[t]);
+			}
+			free(scratch);
+			iscc_hnsw_free_graph(&graph);
+			return false;
+		}
+	}
+
+	iscc_HNSWReverseLinks reverse_links = { 0, 0, 0, NULL, NULL };
+
+	// Links are searched for in the graph built before the batch. Only the
+	// links of the new points are written while searching, and nothing links
+	// to them until the reverse links are added, so the searches can run in
+	// parallel. Reverse links are then grouped by the list they are added to,
+	// and each group is added in the order of the new points, so every list
+	// changes exactly as when the points are linked one by one. The batches
+	// do not depend on the number of threads.
+	bool built = true;
+	size_t begin = 1;
+	while (begin < len_search_indices) {
+		size_t len_batch = begin / ISCC_HNSW_BATCH_FRACTION;
+		if (len_batch < 1) len_batch = 1;
+		if (len_batch > ISCC_HNSW_MAX_BATCH) len_batch = ISCC_HNSW_MAX_BATCH;
+		const size_t end = (len_search_indices - begin < len_batch) ? len_search_indices : begin + len_batch;
+
+		const size_t entry_point = graph->entry_point;
+		const uint_fast16_t max_level = graph->max_level;
+
+		if ((num_threads == 1) || (end - begin < ISCC_HNSW_MIN_PARALLEL_BATCH)) {
+			for (size_t p = begin; p < end; ++p) {
+				iscc_hnsw_find_links(graph, p, entry_point, max_level, &scratch[0]);
+			}
+		} else {
+			ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 1))
+			for (size_t p = begin; p < end; ++p) {
+				iscc_hnsw_find_links(graph, p, entry_point, max_level, &scratch[iscc_get_thread_num()]);
+			}
+		}
+
+		if ((num_threads == 1) || (end - begin < ISCC_HNSW_MIN_PARALLEL_BATCH)) {
+			for (size_t p = begin; p < end; ++p) {
+				iscc_hnsw_add_reverse_links(graph, p, max_level, &scratch[0]);
+			}
+		} else {
+			if (!iscc_hnsw_group_reverse_links(graph, begin, end, max_level, &reverse_links)) {
+				built = false;
+				break;
+			}
+			const iscc_HNSWReverseLink* const links = reverse_links.links;
+			const size_t* const group_starts = reverse_links.group_starts;
+			ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 16))
+			for (size_t g = 0; g < reverse_links.num_groups; ++g) {
+				iscc_HNSWScratch* const thread_scratch = &scratch[iscc_get_thread_num()];
+				for (size_t i = group_starts[g]; i < group_starts[g + 1]; ++i) {
+					iscc_hnsw_add_reverse_link(graph, (uint_fast16_t) links[i].level, (size_t) links[i].neighbor,
+					                           (size_t) links[i].position, thread_scratch);
+				}
+			}
+		}
+
+		for (size_t p = begin; p < end; ++p) {
+			if (graph->levels[p] > graph->max_level) {
+				graph->entry_point = p;
+				graph->max_level = graph->levels[p];
+			}
+		}
+
+		begin = end;
+	}
+
+	free(reverse_links.links);
+	free(reverse_links.group_starts);
+	for (uint32_t t = 0; t < num_threads; ++t) {
+		iscc_hnsw_free_scratch(&scratch[t]);
+	}
+	free(scratch);
+
+	if (!built) {
+		iscc_hnsw_free_graph(&graph);
+		return false;
+	}
+
+	*out_graph = graph;
+
+	return true;
+}
+
+
+void iscc_hnsw_free_graph(iscc_HNSW** const graph)
+{
+	if ((graph != NULL) && (*graph != NULL)) {
+		assert((*graph)->hnsw_version == ISCC_HNSW_STRUCT_VERSION);
+		free((*graph)->positions);
+		free((*graph)->levels);
+		free((*graph)->links);
+		free((*graph)->upper_offsets);
+		free((*graph)->upper_links);
+		free(*graph);
+		*graph = NULL;
+	}
+}
+
+
+bool iscc_hnsw_init_scratch(const iscc_HNSW* const graph,
+                            const uint32_t k,
+                            iscc_HNSWScratch* const out_scratch)
+{
+	assert(graph != NULL);
+	assert(graph->hnsw_version == ISCC_HNSW_STRUCT_VERSION);
+	assert(k > 0);
+	assert(out_scratch != NULL);
+
+	// Large enough for queries and for building the graph
+	uint32_t capacity = 2 * graph->parameters.num_links + 1;
+	if (capacity < k) capacity = k;
+	if (capacity < graph->parameters.ef_search) capacity = graph->parameters.ef_search;
+	if (capacity < graph->parameters.ef_construction) capacity = graph->parameters.ef_construction;
+
+	*out_scratch = (iscc_HNSWScratch) {
+		.capacity = capacity,
+		.visit_mark = 0,
+		.visited = calloc(graph->num_points, sizeof(uint32_t)),
+		.open_dists = malloc(sizeof(double[2 * (size_t) capacity])),
+		.open_positions = malloc(sizeof(scc_PointIndex[2 * (size_t) capacity])),
+		.best_dists = malloc(sizeof(double[capacity])),
+		.best_positions = malloc(sizeof(scc_PointIndex[capacity])),
+		.sort_dists = malloc(sizeof(double[capacity])),
+		.sort_positions = malloc(sizeof(scc_PointIndex[capacity])),
+	};
+
+	if ((out_scratch->visited == NULL) ||
+	        (out_scratch->open_dists == NULL) || (out_scratch->open_positions == NULL) ||
+	        (out_scratch->best_dists == NULL) || (out_scratch->best_positions == NULL) ||
+	        (out_scratch->sort_dists == NULL) || (out_scratch->sort_positions == NULL)) {
+		iscc_hnsw_free_scratch(out_scratch);
+		return false;
+	}
+
+	return true;
+}
+
+
+void iscc_hnsw_free_scratch(iscc_HNSWScratch* const scratch)
+{
+	if (scratch != NULL) {
+		free(scratch->visited);
+		free(scratch->open_dists);
+		free(scratch->open_positions);
+		free(scratch->best_dists);
+		free(scratch->best_positions);
+		free(scratch->sort_dists);
+		free(scratch->sort_positions);
+		*scratch = (iscc_HNSWScratch) {
+			.capacity = 0,
+			.visit_mark = 0,
+			.visited = NULL,
+			.open_dists = NULL,
+			.open_positions = NULL,
+			.best_dists = NULL,
+			.best_positions = NULL,
+			.sort_dists = NULL,
+			.sort_positions = NULL,
+		};
+	}
+}
+
+
+uint32_t iscc_hnsw_nearest_neighbors(const iscc_HNSW* const graph,
+                                     const size_t query,
+                                     const uint32_t k,
+                                     const bool radius_search,
+                                     const double radius_sq,
+                                     iscc_HNSWScratch* const scratch,
+                                     scc_PointIndex out_nn_indices[const])
+{
+	assert(graph != NULL);
+	assert(graph->hnsw_version == ISCC_HNSW_STRUCT_VERSION);
+	assert(query < graph->data_set->num_data_points);
+	assert(k > 0);
+	assert(k <= graph->num_points);
+	assert(scratch != NULL);
+	assert(k <= scratch->capacity);
+	assert(out_nn_indices != NULL);
+
+	const uint32_t ef = (graph->parameters.ef_search > k) ? graph->parameters.ef_search : k;
+
+	scratch->best_dists[0] = iscc_get_sq_dist(graph->data_set, query, iscc_hnsw_point(graph, graph->entry_point));
+	scratch->best_positions[0] = (scc_PointIndex) graph->entry_point;
+	uint32_t num_best = 1;
+	for (uint_fast16_t level = graph->max_level; level > 0; --level) {
+		num_best = iscc_hnsw_search_level(graph, query, level, 1, num_best, scratch);
+	}
+	num_best = iscc_hnsw_search_level(graph, query, 0, ef, num_best, scratch);
+
+	// The search stops early only when the candidate list is full, so a shorter
+	// list holds all points that could be reached (e.g., if the graph is
+	// disconnected or `ef` exceeds the number of points). The remaining points
+	// are then scanned, which makes the search exact when `ef` is large enough.
+	if ((num_best < ef) && (num_best < graph->num_points)) {
+		num_best = iscc_hnsw_scan_unvisited(graph, query, ef, num_best, scratch);
+	}
+	assert(num_best >= k);
+
+	iscc_hnsw_sort(num_best, scratch->best_dists, scratch->best_positions);
+
+	// A query that is a search point must be among its neighbors (see
+	// `iscc_ensure_self_match`). If it was not reached, it is inserted where an
+	// exact search would place it. It is then only left out if there are `k`
+	// other points at zero distance, as in exact searches.
+	size_t query_position = ISCC_POINTINDEX_MAX_PI;
+	if (graph->search_indices == NULL) {
+		if (query < graph->num_points) query_position = query;
+	} else {
+		query_position = (size_t) graph->positions[query];
+	}
+	if (query_position != ISCC_POINTINDEX_MAX_PI) {
+		uint32_t i = 0;
+		for (; (i < num_best) && (((size_t) scratch->best_positions[i]) != query_position); ++i);
+		if (i == num_best) {
+			uint32_t insert = 0;
+			for (; (insert < k) && iscc_hnsw_before(scratch->best_dists[insert], scratch->best_positions[insert],
+			                                        0.0, (scc_PointIndex) query_position); ++insert);
+			if (insert < k) {
+				for (i = k - 1; i > insert; --i) {
+					scratch->best_dists[i] = scratch->best_dists[i - 1];
+					scratch->best_positions[i] = scratch->best_positions[i - 1];
+				}
+				scratch->best_dists[insert] = 0.0;
+				scratch->best_positions[insert] = (scc_PointIndex) query_position;
+			}
+		}
+	}
+
+	uint32_t found = 0;
+	for (; found < k; ++found) {
+		if (radius_search && (scratch->best_dists[found] > radius_sq)) break;
+		out_nn_indices[found] = (scc_PointIndex) iscc_hnsw_point(graph, scratch->best_positions[found]);
+	}
+
+	return found;
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+// Level drawn from a geometric distribution, using a hash of the position
+// (SplitMix64) so that every build draws the same levels
+static uint_fast16_t iscc_hnsw_draw_level(const size_t position,
+                                          const double level_mult)
+{
+	uint64_t z = (uint64_t) position + UINT64_C(0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+	z ^= z >> 31;
+
+	// Uniform in (0, 1]
+	const double uniform = ((double) ((z >> 11) + 1)) / 9007199254740992.0;
+	const double level = -log(uniform) * level_mult;
+	if (level >= (double) ISCC_HNSW_MAX_LEVEL) return ISCC_HNSW_MAX_LEVEL;
+	return (uint_fast16_t) level;
+}
+
+
+// Writes the links of `position` on each of its levels, searching the graph
+// from `entry_point` on `max_level`
+static void iscc_hnsw_find_links(iscc_HNSW* const graph,
+                                 const size_t position,
+                                 const size_t entry_point,
+                                 const uint_fast16_t max_level,
+                                 iscc_HNSWScratch* const scratch)
+{
+	const size_t query = iscc_hnsw_point(graph, position);
+	const uint_fast16_t level = graph->levels[position];
+	const uint32_t ef = graph->parameters.ef_construction;
+
+	scratch->best_dists[0] = iscc_get_sq_dist(graph->data_set, query, iscc_hnsw_point(graph, entry_point));
+	scratch->best_positions[0] = (scc_PointIndex) entry_point;
+	uint32_t num_best = 1;
+	for (uint_fast16_t l = max_level; l > level; --l) {
+		num_best = iscc_hnsw_search_level(graph, query, l, 1, num_best, scratch);
+	}
+
+	// The closest points on each level are the entry points on the level below
+	for (uint_fast16_t l = (level < max_level) ? level : max_level; ; --l) {
+		num_best = iscc_hnsw_search_level(graph, query, l, ef, num_best, scratch);
+		memcpy(scratch->sort_dists, scratch->best_dists, sizeof(double[num_best]));
+		memcpy(scratch->sort_positions, scratch->best_positions, sizeof(scc_PointIndex[num_best]));
+		iscc_hnsw_sort(num_best, scratch->sort_dists, scratch->sort_positions);
+
+		scc_PointIndex* const links = iscc_hnsw_links(graph, position, l);
+		const uint32_t max_links = (l == 0) ? 2 * graph->parameters.num_links : graph->parameters.num_links;
+		links[0] = (scc_PointIndex) iscc_hnsw_select_links(graph, num_best, scratch->sort_dists,
+		                                                   scratch->sort_positions, max_links, links + 1);
+		if (l == 0) break;
+	}
+}
+
+
+// Links the neighbors of `position` back to it
+static void iscc_hnsw_add_reverse_links(iscc_HNSW* const graph,
+                                        const size_t position,
+                                        const uint_fast16_t max_level,
+                                        iscc_HNSWScratch* const scratch)
+{
+	const uint_fast16_t top_level = (graph->levels[position] < max_level) ? graph->levels[position] : max_level;
+	for (uint_fast16_t l = 0; l <= top_level; ++l) {
+		const scc_PointIndex* const links = iscc_hnsw_links(graph, position, l);
+		const size_t num_links = (size_t) links[0];
+		for (size_t i = 1; i <= num_links; ++i) {
+			iscc_hnsw_add_reverse_link(graph, l, (size_t) links[i], position, scratch);
+		}
+	}
+}
+
+
+// Collects the reverse links of the points from `begin` to `end - 1`, sorted
+// by level, neighbor and position, and finds the groups of links to the same list
+static bool iscc_hnsw_group_reverse_links(const iscc_HNSW* const graph,
+                                          const size_t begin,
+                                          const size_t end,
+                                          const uint_fast16_t max_level,
+                                          iscc_HNSWReverseLinks* const reverse_links)
+{
+	size_t num_links = 0;
+	for (size_t p = begin; p < end; ++p) {
+		const uint_fast16_t top_level = (graph->levels[p] < max_level) ? graph->levels[p] : max_level;
+		for (uint_fast16_t l = 0; l <= top_level; ++l) {
+			num_links += (size_t) iscc_hnsw_links(graph, p, l)[0];
+		}
+	}
+
+	if (num_links > reverse_links->capacity) {
+		free(reverse_links->links);
+		free(reverse_links->group_starts);
+		reverse_links->capacity = num_links;
+		reverse_links->links = malloc(sizeof(iscc_HNSWReverseLink[num_links]));
+		reverse_links->group_starts = malloc(sizeof(size_t[num_links + 1]));
+		if ((reverse_links->links == NULL) || (reverse_links->group_starts == NULL)) {
+			reverse_links->capacity = 0;
+			return false;
+		}
+	}
+
+	iscc_HNSWReverseLink* const links = reverse_links->links;
+	size_t i = 0;
+	for (size_t p = begin; p < end; ++p) {
+		const uint_fast16_t top_level = (graph->levels[p] < max_level) ? graph->levels[p] : max_level;
+		for (uint_fast16_t l = 0; l <= top_level; ++l) {
+			const scc_PointIndex* const p_links = iscc_hnsw_links(graph, p, l);
+			for (size_t j = 1; j <= (size_t) p_links[0]; ++j) {
+				links[i] = (iscc_HNSWReverseLink) {
+					.level = (uint32_t) l,
+					.neighbor = p_links[j],
+					.position = (scc_PointIndex) p,
+				};
+				++i;
+			}
+		}
+	}
+	assert(i == num_links);
+	qsort(links, num_links, sizeof(iscc_HNSWReverseLink), iscc_hnsw_compare_reverse_links);
+
+	size_t num_groups = 0;
+	for (i = 0; i < num_links; ++i) {
+		if ((i == 0) || (links[i].level != links[i - 1].level) || (links[i].neighbor != links[i - 1].neighbor)) {
+			reverse_links->group_starts[num_groups] = i;
+			++num_groups;
+		}
+	}
+	reverse_links->group_starts[num_groups] = num_links;
+	reverse_links->num_links = num_links;
+	reverse_links->num_groups = num_groups;
+
+	return true;
+}
+
+
+static int iscc_hnsw_compare_reverse_links(const void* const a,
+                                           const void* const b)
+{
+	const iscc_HNSWReverseLink* const link1 = (const iscc_HNSWReverseLink*) a;
+	const iscc_HNSWReverseLink* const link2 = (const iscc_HNSWReverseLink*) b;
+	if (link1->level != link2->level) return (link1->level > link2->level) - (link1->level < link2->level);
+	if (link1->neighbor != link2->neighbor) return (link1->neighbor > link2->neighbor) - (link1->neighbor < link2->neighbor);
+	return (link1->position > link2->position) - (link1->position < link2->position);
+}
+
+
+// Links `neighbor` back to `position` on `level`. If the list of `neighbor` is
+// full, its links are selected again among its old links and `position`. Only
+// the list of `neighbor` is written.
+static void iscc_hnsw_add_reverse_link(iscc_HNSW* const graph,
+                                       const uint_fast16_t level,
+                                       const size_t neighbor,
+                                       const size_t position,
+                                       iscc_HNSWScratch* const scratch)
+{
+	const uint32_t max_links = (level == 0) ? 2 * graph->parameters.num_links : graph->parameters.num_links;
+	scc_PointIndex* const neighbor_links = iscc_hnsw_links(graph, neighbor, level);
+	const uint32_t num_neighbor_links = (uint32_t) neighbor_links[0];
+
+	if (num_neighbor_links < max_links) {
+		neighbor_links[num_neighbor_links + 1] = (scc_PointIndex) position;
+		neighbor_links[0] = (scc_PointIndex) (num_neighbor_links + 1);
+		return;
+	}
+
+	const scc_DataSet* const data_set = graph->data_set;
+	const size_t neighbor_point = iscc_hnsw_point(graph, neighbor);
+	for (uint32_t j = 0; j < num_neighbor_links; ++j) {
+		scratch->sort_dists[j] = iscc_get_sq_dist(data_set, neighbor_point, iscc_hnsw_point(graph, neighbor_links[j + 1]));
+		scratch->sort_positions[j] = neighbor_links[j + 1];
+	}
+	scratch->sort_dists[num_neighbor_links] = iscc_get_sq_dist(data_set, neighbor_point, iscc_hnsw_point(graph, position));
+	scratch->sort_positions[num_neighbor_links] = (scc_PointIndex) position;
+	iscc_hnsw_sort(num_neighbor_links + 1, scratch->sort_dists, scratch->sort_positions);
+
+	neighbor_links[0] = (scc_PointIndex) iscc_hnsw_select_links(graph, num_neighbor_links + 1, scratch->sort_dists,
+	                                                            scratch->sort_positions, max_links, neighbor_links + 1);
+}
+
+
+// Selects at most `max_links` of the candidates, which must be sorted by
+// distance to the point being linked. A candidate is skipped if it is closer
+// to an already selected candidate than to the point, so that links spread
+// out in different directions. Skipped candidates fill any remaining links.
+// `cand_positions` is overwritten.
+static uint32_t iscc_hnsw_select_links(const iscc_HNSW* const graph,
+                                       const uint32_t num_candidates,
+                                       const double cand_dists[const],
+                                       scc_PointIndex cand_positions[const],
+                                       const uint32_t max_links,
+                                       scc_PointIndex out_links[const])
+{
+	uint32_t num_selected = 0;
+	uint32_t num_skipped = 0;
+	for (uint32_t c = 0; (c < num_candidates) && (num_selected < max_links); ++c) {
+		const size_t cand_point = iscc_hnsw_point(graph, cand_positions[c]);
+		bool keep = true;
+		for (uint32_t s = 0; keep && (s < num_selected); ++s) {
+			keep = !(iscc_get_sq_dist(graph->data_set, cand_point, iscc_hnsw_point(graph, out_links[s])) < cand_dists[c]);
+		}
+		if (keep) {
+			out_links[num_selected] = cand_positions[c];
+			++num_selected;
+		} else {
+			cand_positions[num_skipped] = cand_positions[c];
+			++num_skipped;
+		}
+	}
+
+	for (uint32_t c = 0; (c < num_skipped) && (num_selected < max_links); ++c) {
+		out_links[num_selected] = cand_positions[c];
+		++num_selected;
+	}
+
+	return num_selected;
+}
+
+
+// Searches `level` starting from the `num_best` points in the heap of best
+// points, which is left with the `ef` closest points found. Returns the
+// number of points in the heap.
+//
+// Points left to visit that are farther than all best points would end the
+// search when reached, so they can be dropped. The remaining points to visit
+// are also among the best points, so when the heap of points to visit is
+// full, dropping the far points leaves at most `ef` of them.
+static uint32_t iscc_hnsw_search_level(const iscc_HNSW* const graph,
+                                       const size_t query,
+                                       const uint_fast16_t level,
+                                       const uint32_t ef,
+                                       uint32_t num_best,
+                                       iscc_HNSWScratch* const scratch)
+{
+	assert(ef <= scratch->capacity);
+	assert(num_best > 0);
+
+	++(scratch->visit_mark);
+	if (scratch->visit_mark == 0) {
+		memset(scratch->visited, 0, sizeof(uint32_t[graph->num_points]));
+		scratch->visit_mark = 1;
+	}
+	const uint32_t mark = scratch->visit_mark;
+	uint32_t* const visited = scratch->visited;
+	double* const open_dists = scratch->open_dists;
+	scc_PointIndex* const open_positions = scratch->open_positions;
+	double* const best_dists = scratch->best_dists;
+	scc_PointIndex* const best_positions = scratch->best_positions;
+	const size_t open_capacity = 2 * (size_t) scratch->capacity;
+
+	// Entry points beyond `ef` are dropped
+	while (num_best > ef) {
+		--num_best;
+		iscc_hnsw_heap_replace_top(true, best_dists, best_positions, num_best,
+		                           best_dists[num_best], best_positions[num_best]);
+	}
+
+	size_t num_open = 0;
+	for (uint32_t i = 0; i < num_best; ++i) {
+		visited[best_positions[i]] = mark;
+		iscc_hnsw_heap_push(false, open_dists, open_positions, num_open, best_dists[i], best_positions[i]);
+		++num_open;
+	}
+
+	while (num_open > 0) {
+		const double dist = open_dists[0];
+		const scc_PointIndex position = open_positions[0];
+		--num_open;
+		iscc_hnsw_heap_replace_top(false, open_dists, open_positions, num_open,
+		                           open_dists[num_open], open_positions[num_open]);
+
+		// All remaining points are farther than the best points
+		if ((num_best == ef) && iscc_hnsw_before(best_dists[0], best_positions[0], dist, position)) break;
+
+		const scc_PointIndex* const links = iscc_hnsw_links(graph, position, level);
+		const size_t num_links = (size_t) links[0];
+		for (size_t i = 1; i <= num_links; ++i) {
+			const scc_PointIndex neighbor = links[i];
+			if (visited[neighbor] == mark) continue;
+			visited[neighbor] = mark;
+
+			const double neighbor_dist = iscc_get_sq_dist(graph->data_set, query, iscc_hnsw_point(graph, neighbor));
+			if (num_best < ef) {
+				iscc_hnsw_heap_push(true, best_dists, best_positions, num_best, neighbor_dist, neighbor);
+				++num_best;
+			} else if (iscc_hnsw_before(neighbor_dist, neighbor, best_dists[0], best_positions[0])) {
+				iscc_hnsw_heap_replace_top(true, best_dists, best_positions, num_best, neighbor_dist, neighbor);
+			} else {
+				continue;
+			}
+			if (num_open == open_capacity) {
+				num_open = iscc_hnsw_drop_far_open(num_open, open_dists, open_positions, best_dists[0], best_positions[0]);
+				assert(num_open < open_capacity);
+			}
+			iscc_hnsw_heap_push(false, open_dists, open_positions, num_open, neighbor_dist, neighbor);
+			++num_open;
+		}
+	}
+
+	return num_best;
+}
+
+
+// Removes the points ordered after (`max_dist`, `max_position`) from the
+// min-heap of `num_open` points to visit. Returns the number of points left.
+static size_t iscc_hnsw_drop_far_open(const size_t num_open,
+                                      double open_dists[const],
+                                      scc_PointIndex open_positions[const],
+                                      const double max_dist,
+                                      const scc_PointIndex max_position)
+{
+	size_t num_kept = 0;
+	for (size_t i = 0; i < num_open; ++i) {
+		if (!iscc_hnsw_before(max_dist, max_position, open_dists[i], open_positions[i])) {
+			iscc_hnsw_heap_push(false, open_dists, open_positions, num_kept, open_dists[i], open_positions[i]);
+			++num_kept;
+		}
+	}
+	return num_kept;
+}
+
+
+// Adds the points not visited by the last search to the heap of best points
+static uint32_t iscc_hnsw_scan_unvisited(const iscc_HNSW* const graph,
+                                         const size_t query,
+                                         const uint32_t ef,
+                                         uint32_t num_best,
+                                         iscc_HNSWScratch* const scratch)
+{
+	for (size_t p = 0; p < graph->num_points; ++p) {
+		if (scratch->visited[p] == scratch->visit_mark) continue;
+		const double dist = iscc_get_sq_dist(graph->data_set, query, iscc_hnsw_point(graph, p));
+		if (num_best < ef) {
+			iscc_hnsw_heap_push(true, scratch->best_dists, scratch->best_positions, num_best, dist, (scc_PointIndex) p);
+			++num_best;
+		} else if (iscc_hnsw_before(dist, (scc_PointIndex) p, scratch->best_dists[0], scratch->best_positions[0])) {
+			iscc_hnsw_heap_replace_top(true, scratch->best_dists, scratch->best_positions, num_best, dist, (scc_PointIndex) p);
+		}
+	}
+	return num_best;
+}
+
+
+// Sorts by distance and then by position
+static void iscc_hnsw_sort(const size_t len,
+                           double dists[const],
+                           scc_PointIndex positions[const])
+{
+	for (size_t i = 1; i < len; ++i) {
+		iscc_hnsw_heap_push(true, dists, positions, i, dists[i], positions[i]);
+	}
+	for (size_t i = len; i > 1; --i) {
+		const double max_dist = dists[0];
+		const scc_PointIndex max_position = positions[0];
+		iscc_hnsw_heap_replace_top(true, dists, positions, i - 1, dists[i - 1], positions[i - 1]);
+		dists[i - 1] = max_dist;
+		positions[i - 1] = max_position;
+	}
+}
+
+
+static inline size_t iscc_hnsw_point(const iscc_HNSW* const graph,
+                                     const size_t position)
+{
+	return (graph->search_indices == NULL) ? position : (size_t) graph->search_indices[position];
+}
+
+
+static inline scc_PointIndex* iscc_hnsw_links(const iscc_HNSW* const graph,
+                                              const size_t position,
+                                              const uint_fast16_t level)
+{
+	const size_t num_links = graph->parameters.num_links;
+	if (level == 0) {
+		return graph->links + position * (2 * num_links + 1);
+	}
+	return graph->upper_links + graph->upper_offsets[position] + (level - 1) * (num_links + 1);
+}
+
+
+// Whether (dist1, pos1) is ordered before (dist2, pos2)
+static inline bool iscc_hnsw_before(const double dist1,
+                                    const scc_PointIndex pos1,
+                                    const double dist2,
+                                    const scc_PointIndex pos2)
+{
+	return (dist1 < dist2) || (!(dist1 > dist2) && (pos1 < pos2));
+}
+
+
+// Adds an item to a heap of `len_heap` items. The first item of a max-heap
+// is ordered last, and the first item of a min-heap is ordered first.
+static inline void iscc_hnsw_heap_push(const bool max_heap,
+                                       double dists[const],
+                                       scc_PointIndex positions[const],
+                                       size_t len_heap,
+                                       const double dist,
+                                       const scc_PointIndex position)
+{
+	size_t i = len_heap;
+	while (i > 0) {
+		const size_t parent = (i - 1) / 2;
+		const bool above = max_heap ? iscc_hnsw_before(dists[parent], positions[parent], dist, position)
+		                            : iscc_hnsw_before(dist, position, dists[parent], positions[parent]);
+		if (!above) break;
+		dists[i] = dists[parent];
+		positions[i] = positions[parent];
+		i = parent;
+	}
+	dists[i] = dist;
+	positions[i] = position;
+}
+
+
+// Replaces the first item of a heap of `len_heap` items
+static inline void iscc_hnsw_heap_replace_top(const bool max_heap,
+                                              double dists[const],
+                                              scc_PointIndex positions[const],
+                                              const size_t len_heap,
+                                              const double dist,
+                                              const scc_PointIndex position)
+{
+	if (len_heap == 0) return;
+	size_t i = 0;
+	for (;;) {
+		size_t child = 2 * i + 1;
+		if (child >= len_heap) break;
+		if (child + 1 < len_heap) {
+			const bool right_above = max_heap ? iscc_hnsw_before(dists[child], positions[child], dists[child + 1], positions[child + 1])
+			                                  : iscc_hnsw_before(dists[child + 1], positions[child + 1], dists[child], positions[child]);
+			if (right_above) ++child;
+		}
+		const bool child_above = max_heap ? iscc_hnsw_before(dist, position, dists[child], positions[child])
+		                                  : iscc_hnsw_before(dists[child], positions[child], dist, position);
+		if (!child_above) break;
+		dists[i] = dists[child];
+		positions[i] = positions[child];
+		i = child;
+	}
+	dists[i] = dist;
+	positions[i] = position;
+}
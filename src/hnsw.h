@@ -0,0 +1,153 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+/** @file
+ *
+ *  Hierarchical navigable small world (HNSW) graphs for approximate nearest
+ *  neighbor search in `scc_DataSet`s.
+ *
+ *  Each search point is a vertex on a random number of levels, and is linked
+ *  to nearby points on each of its levels. Queries walk greedily from the top
+ *  level down, and search the bottom level with a bounded candidate list. The
+ *  returned neighbors are therefore approximate: they are ordered by distance,
+ *  but some of the exact nearest neighbors may be missing.
+ *
+ *  Graphs are built in batches. The points of a batch are linked to the graph
+ *  built before the batch, so they can be searched in parallel, and the graph
+ *  does not depend on the number of threads. The levels of the points are
+ *  drawn from a hash of their positions, so the graph is the same in every
+ *  build.
+ */
+
+#ifndef SCC_HNSW_HG
+#define SCC_HNSW_HG
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/scclust.h"
+#include "data_set_struct.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Structs, types and variables
+// =============================================================================
+
+/// Opaque HNSW graph struct.
+typedef struct iscc_HNSW iscc_HNSW;
+
+
+/** Scratch memory for HNSW queries.
+ *
+ *  Each thread that queries a graph must use its own scratch.
+ */
+typedef struct iscc_HNSWScratch {
+	/// Maximum length of the candidate list.
+	uint32_t capacity;
+
+	/// Current mark in #visited.
+	uint32_t visit_mark;
+
+	/// Search points visited in the current search have the current mark. Of length `num_points`.
+	uint32_t* visited;
+
+	/// Min-heap of points left to visit. Of length `2 * capacity`.
+	double* open_dists;
+	scc_PointIndex* open_positions;
+
+	/// Max-heap of the closest points found. Of length #capacity.
+	double* best_dists;
+	scc_PointIndex* best_positions;
+
+	/// Points being sorted. Of length #capacity.
+	double* sort_dists;
+	scc_PointIndex* sort_positions;
+} iscc_HNSWScratch;
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/** Builds a HNSW graph.
+ *
+ *  The graph is built with the parameters set by `scc_set_hnsw_parameters`.
+ *
+ *  \param[in] data_set the data set. Must outlive the graph.
+ *  \param len_search_indices number of search points.
+ *  \param[in] search_indices the search points. If `NULL`, the first \p len_search_indices
+ *                            points in \p data_set are used. Must outlive the graph.
+ *  \param[out] out_graph the built graph.
+ *
+ *  \return `true` if the graph was built, `false` if out of memory.
+ */
+bool iscc_hnsw_build_graph(const scc_DataSet* data_set,
+                           size_t len_search_indices,
+                           const scc_PointIndex search_indices[],
+                           iscc_HNSW** out_graph);
+
+
+/// Frees a HNSW graph. Sets `*graph` to `NULL`.
+void iscc_hnsw_free_graph(iscc_HNSW** graph);
+
+
+/// Allocates scratch for queries of at most `k` neighbors. Returns `false` if out of memory.
+bool iscc_hnsw_init_scratch(const iscc_HNSW* graph,
+                            uint32_t k,
+                            iscc_HNSWScratch* out_scratch);
+
+
+/// Frees scratch allocated with #iscc_hnsw_init_scratch.
+void iscc_hnsw_free_scratch(iscc_HNSWScratch* scratch);
+
+
+/** Finds approximate nearest search points to a query.
+ *
+ *  If the query is itself a search point, it is among the neighbors unless
+ *  \p k other search points are at zero distance from it, as in exact searches.
+ *
+ *  \param[in] graph the HNSW graph.
+ *  \param query the data point to query.
+ *  \param k number of neighbors to find. Must be at most `scratch->capacity`.
+ *  \param radius_search if `true`, only neighbors within \p radius are found.
+ *  \param radius_sq the squared radius.
+ *  \param[in,out] scratch query scratch.
+ *  \param[out] out_nn_indices the found neighbors sorted by distance. Must be of length \p k.
+ *
+ *  \return number of neighbors found. Always \p k unless \p radius_search is `true`.
+ */
+uint32_t iscc_hnsw_nearest_neighbors(const iscc_HNSW* graph,
+                                     size_t query,
+                                     uint32_t k,
+                                     bool radius_search,
+                                     double radius_sq,
+                                     iscc_HNSWScratch* scratch,
+                                     scc_PointIndex out_nn_indices[]);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_HNSW_HG
@@ -0,0 +1,915 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+// Memory-mapped files require POSIX; must be set before any system header
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+	#define ISCC_HAS_MMAP
+	#ifndef _POSIX_C_SOURCE
+		#define _POSIX_C_SOURCE 200112L
+	#endif
+#endif
+
+#include "kdtree.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/scclust.h"
+#include "data_set_struct.h"
+#include "dist_kernels.h"
+#include "error.h"
+#include "scclust_types.h"
+
+#ifdef ISCC_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+// =============================================================================
+// Internal structs and variables
+// =============================================================================
+
+// Relative slack when pruning cells, to guard against rounding errors in the
+// incremental cell distances. Cells are only visited, never wrongly skipped,
+// so the slack does not affect the results.
+#define ISCC_KDT_PRUNE_SLACK 1e-9
+
+
+// Nodes are written as is to search index files, so all fields have fixed width
+typedef struct iscc_kdt_Node {
+	// Points in node are `point_indices[begin]` to `point_indices[end - 1]`
+	uint64_t begin;
+	uint64_t end;
+	// Child node indices, `left == 0` indicates leaf (the root is never a child)
+	uint64_t left;
+	uint64_t right;
+	uint32_t split_dim;
+	uint32_t reserved;
+	double split_value;
+} iscc_kdt_Node;
+
+
+struct iscc_KDTree {
+	int32_t kdtree_version;
+	const scc_DataSet* data_set;
+	size_t num_points;
+	size_t leaf_size;
+	scc_PointIndex* point_indices;
+	scc_PointIndex* positions;
+	size_t num_nodes;
+	size_t max_nodes;
+	iscc_kdt_Node* nodes;
+	// Bounding box of node `i` is `bounds[2 * i * num_dimensions]` to
+	// `bounds[(2 * i + 1) * num_dimensions - 1]` (lower) followed by the upper bounds.
+	// Only farthest point searches use the boxes, so they are `NULL` in other trees.
+	double* bounds;
+	// Trees loaded from a file point into the mapping rather than owning their arrays
+	void* file_mapping;
+	size_t len_file_mapping;
+};
+
+
+static const int32_t ISCC_KDTREE_STRUCT_VERSION = 722816001;
+
+
+#define ISCC_INDEX_FILE_HEADER_SIZE 64
+#define ISCC_INDEX_FILE_VERSION 2
+#define ISCC_INDEX_FILE_DOUBLE 1
+#define ISCC_INDEX_FILE_FLOAT 2
+
+static const char ISCC_INDEX_FILE_MAGIC[8] = "SCCKDTR";
+
+
+typedef struct iscc_kdt_QueryState {
+	const iscc_KDTree* tree;
+	size_t query;
+	uint32_t k;
+	uint32_t found;
+	bool radius_search;
+	double radius_sq;
+	double* dists;
+	scc_PointIndex* positions;
+	double* offsets;
+	scc_PointIndex* out_nn_indices;
+} iscc_kdt_QueryState;
+
+
+typedef struct iscc_kdt_FarthestState {
+	const iscc_KDTree* tree;
+	size_t query;
+	double max_dist;
+	scc_PointIndex max_position;
+	scc_PointIndex max_point;
+} iscc_kdt_FarthestState;
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static size_t iscc_kdt_build_node(iscc_KDTree* tree,
+                                  size_t begin,
+                                  size_t end);
+
+static void iscc_kdt_select(iscc_KDTree* tree,
+                            size_t begin,
+                            size_t end,
+                            size_t nth,
+                            uint_fast16_t dim);
+
+static void iscc_kdt_search_node(iscc_kdt_QueryState* state,
+                                 size_t node_index,
+                                 double cell_dist);
+
+static void iscc_kdt_farthest_node(iscc_kdt_FarthestState* state,
+                                   size_t node_index);
+
+static uint64_t iscc_kdt_data_set_checksum(const scc_DataSet* data_set);
+
+#ifdef ISCC_HAS_MMAP
+
+static scc_ErrorCode iscc_kdt_init_tree_from_mapping(const scc_DataSet* data_set,
+                                                     void* mapping,
+                                                     size_t len_mapping,
+                                                     iscc_KDTree** out_tree);
+
+#endif // ifdef ISCC_HAS_MMAP
+
+static inline double iscc_kdt_max_cell_dist(const iscc_KDTree* tree,
+                                            size_t query,
+                                            size_t node_index);
+
+static inline bool iscc_kdt_before(double dist1,
+                                   scc_PointIndex pos1,
+                                   double dist2,
+                                   scc_PointIndex pos2);
+
+static inline void iscc_kdt_add_candidate(iscc_kdt_QueryState* state,
+                                          double dist,
+                                          scc_PointIndex position,
+                                          scc_PointIndex point);
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+bool iscc_kdt_build_tree(const scc_DataSet* const data_set,
+                         const size_t len_search_indices,
+                         const scc_PointIndex search_indices[const],
+                         const size_t leaf_size,
+                         const bool bounding_boxes,
+                         iscc_KDTree** const out_tree)
+{
+	assert(data_set != NULL);
+	assert(len_search_indices > 0);
+	assert(leaf_size > 0);
+	assert(out_tree != NULL);
+
+	iscc_KDTree* tree = malloc(sizeof(iscc_KDTree));
+	if (tree == NULL) return false;
+
+	// Split nodes have more than `leaf_size` points, so all leaves
+	// except a lone root have at least `(leaf_size + 1) / 2` points
+	const size_t max_nodes = 2 * (len_search_indices / ((leaf_size + 1) / 2)) + 1;
+
+	*tree = (iscc_KDTree) {
+		.kdtree_version = ISCC_KDTREE_STRUCT_VERSION,
+		.data_set = data_set,
+		.num_points = len_search_indices,
+		.leaf_size = leaf_size,
+		.point_indices = malloc(sizeof(scc_PointIndex[len_search_indices])),
+		.positions = malloc(sizeof(scc_PointIndex[len_search_indices])),
+		.num_nodes = 0,
+		.max_nodes = max_nodes,
+		.nodes = malloc(sizeof(iscc_kdt_Node[max_nodes])),
+		.bounds = NULL,
+		.file_mapping = NULL,
+		.len_file_mapping = 0,
+	};
+
+	if (bounding_boxes) {
+		tree->bounds = malloc(sizeof(double[2 * max_nodes * data_set->num_dimensions]));
+	}
+
+	if ((tree->point_indices == NULL) || (tree->positions == NULL) ||
+	        (tree->nodes == NULL) || (bounding_boxes && (tree->bounds == NULL))) {
+		iscc_kdt_free_tree(&tree);
+		return false;
+	}
+
+	for (size_t i = 0; i < len_search_indices; ++i) {
+		tree->positions[i] = (scc_PointIndex) i;
+		if (search_indices == NULL) {
+			tree->point_indices[i] = (scc_PointIndex) i;
+		} else {
+			assert(((size_t) search_indices[i]) < data_set->num_data_points);
+			tree->point_indices[i] = search_indices[i];
+		}
+	}
+
+	iscc_kdt_build_node(tree, 0, len_search_indices);
+	assert(tree->num_nodes <= tree->max_nodes);
+
+	*out_tree = tree;
+
+	return true;
+}
+
+
+void iscc_kdt_free_tree(iscc_KDTree** const tree)
+{
+	if ((tree != NULL) && (*tree != NULL)) {
+		assert((*tree)->kdtree_version == ISCC_KDTREE_STRUCT_VERSION);
+		if ((*tree)->file_mapping == NULL) {
+			free((*tree)->point_indices);
+			free((*tree)->positions);
+			free((*tree)->nodes);
+			free((*tree)->bounds);
+		} else {
+			#ifdef ISCC_HAS_MMAP
+				munmap((*tree)->file_mapping, (*tree)->len_file_mapping);
+			#endif
+		}
+		free(*tree);
+		*tree = NULL;
+	}
+}
+
+
+scc_ErrorCode iscc_kdt_save_tree(const iscc_KDTree* const tree,
+                                 const char* const file_path)
+{
+	assert(tree != NULL);
+	assert(tree->kdtree_version == ISCC_KDTREE_STRUCT_VERSION);
+	assert(tree->num_points == tree->data_set->num_data_points);
+	assert(file_path != NULL);
+
+	const scc_DataSet* const data_set = tree->data_set;
+	const uint32_t version = ISCC_INDEX_FILE_VERSION;
+	const uint32_t element_type = (data_set->float_matrix != NULL) ? ISCC_INDEX_FILE_FLOAT : ISCC_INDEX_FILE_DOUBLE;
+	const uint64_t num_data_points = (uint64_t) data_set->num_data_points;
+	const uint32_t num_dimensions = (uint32_t) data_set->num_dimensions;
+	const uint32_t leaf_size = (uint32_t) tree->leaf_size;
+	const uint64_t checksum = iscc_kdt_data_set_checksum(data_set);
+	const uint64_t num_nodes = (uint64_t) tree->num_nodes;
+	const uint32_t node_size = (uint32_t) sizeof(iscc_kdt_Node);
+	const uint32_t point_index_size = (uint32_t) sizeof(scc_PointIndex);
+
+	unsigned char header[ISCC_INDEX_FILE_HEADER_SIZE] = { 0 };
+	memcpy(header, ISCC_INDEX_FILE_MAGIC, sizeof(ISCC_INDEX_FILE_MAGIC));
+	memcpy(header + 8, &version, sizeof(uint32_t));
+	memcpy(header + 12, &element_type, sizeof(uint32_t));
+	memcpy(header + 16, &num_data_points, sizeof(uint64_t));
+	memcpy(header + 24, &num_dimensions, sizeof(uint32_t));
+	memcpy(header + 28, &leaf_size, sizeof(uint32_t));
+	memcpy(header + 32, &checksum, sizeof(uint64_t));
+	memcpy(header + 40, &num_nodes, sizeof(uint64_t));
+	memcpy(header + 48, &node_size, sizeof(uint32_t));
+	memcpy(header + 52, &point_index_size, sizeof(uint32_t));
+
+	FILE* const file = fopen(file_path, "wb");
+	if (file == NULL) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Cannot open search index file.");
+	}
+
+	// Positions equal the point indices when the tree is built over all points,
+	// so they are not written. Bounding boxes are only used by farthest point searches.
+	bool written = (fwrite(header, 1, ISCC_INDEX_FILE_HEADER_SIZE, file) == ISCC_INDEX_FILE_HEADER_SIZE);
+	written = written && (fwrite(tree->nodes, sizeof(iscc_kdt_Node), tree->num_nodes, file) == tree->num_nodes);
+	written = written && (fwrite(tree->point_indices, sizeof(scc_PointIndex), tree->num_points, file) == tree->num_points);
+	written = (fclose(file) == 0) && written;
+
+	if (!written) {
+		remove(file_path);
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Cannot write search index file.");
+	}
+
+	return iscc_no_error();
+}
+
+
+scc_ErrorCode iscc_kdt_load_tree(const scc_DataSet* const data_set,
+                                 const char* const file_path,
+                                 iscc_KDTree** const out_tree)
+{
+	assert(data_set != NULL);
+	assert(file_path != NULL);
+	assert(out_tree != NULL);
+
+	*out_tree = NULL;
+
+#ifdef ISCC_HAS_MMAP
+
+	const int fd = open(file_path, O_RDONLY);
+	if (fd == -1) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Cannot open search index file.");
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Cannot read search index file.");
+	}
+	if (file_stat.st_size < ISCC_INDEX_FILE_HEADER_SIZE) {
+		close(fd);
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid search index file.");
+	}
+	if ((uintmax_t) file_stat.st_size > SIZE_MAX) {
+		close(fd);
+		return iscc_make_error_msg(SCC_ER_TOO_LARGE_PROBLEM, "Search index file too large to map.");
+	}
+	const size_t len_mapping = (size_t) file_stat.st_size;
+
+	// The mapping stays valid after the descriptor is closed
+	void* const mapping = mmap(NULL, len_mapping, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return iscc_make_error_msg(SCC_ER_NO_MEMORY, "Cannot map search index file.");
+	}
+
+	const scc_ErrorCode ec = iscc_kdt_init_tree_from_mapping(data_set, mapping, len_mapping, out_tree);
+	if (ec != SCC_ER_OK) {
+		munmap(mapping, len_mapping);
+	}
+	return ec;
+
+#else // ifdef ISCC_HAS_MMAP
+
+	return iscc_make_error_msg(SCC_ER_NOT_IMPLEMENTED, "Memory-mapped files are not supported on this platform.");
+
+#endif // ifdef ISCC_HAS_MMAP
+}
+
+
+bool iscc_kdt_init_scratch(const iscc_KDTree* const tree,
+                           const uint32_t k,
+                           iscc_KDTreeScratch* const out_scratch)
+{
+	assert(tree != NULL);
+	assert(tree->kdtree_version == ISCC_KDTREE_STRUCT_VERSION);
+	assert(k > 0);
+	assert(out_scratch != NULL);
+
+	*out_scratch = (iscc_KDTreeScratch) {
+		.k = k,
+		.dists = malloc(sizeof(double[k])),
+		.positions = malloc(sizeof(scc_PointIndex[k])),
+		.offsets = malloc(sizeof(double[tree->data_set->num_dimensions])),
+	};
+
+	if ((out_scratch->dists == NULL) || (out_scratch->positions == NULL) || (out_scratch->offsets == NULL)) {
+		iscc_kdt_free_scratch(out_scratch);
+		return false;
+	}
+
+	return true;
+}
+
+
+void iscc_kdt_free_scratch(iscc_KDTreeScratch* const scratch)
+{
+	if (scratch != NULL) {
+		free(scratch->dists);
+		free(scratch->positions);
+		free(scratch->offsets);
+		*scratch = (iscc_KDTreeScratch) {
+			.k = 0,
+			.dists = NULL,
+			.positions = NULL,
+			.offsets = NULL,
+		};
+	}
+}
+
+
+uint32_t iscc_kdt_nearest_neighbors(const iscc_KDTree* const tree,
+                                    const size_t query,
+                                    const uint32_t k,
+                                    const bool radius_search,
+                                    const double radius_sq,
+                                    iscc_KDTreeScratch* const scratch,
+                                    scc_PointIndex out_nn_indices[const])
+{
+	assert(tree != NULL);
+	assert(tree->kdtree_version == ISCC_KDTREE_STRUCT_VERSION);
+	assert(query < tree->data_set->num_data_points);
+	assert(k > 0);
+	assert(k <= tree->num_points);
+	assert(scratch != NULL);
+	assert(k <= scratch->k);
+	assert(out_nn_indices != NULL);
+
+	const size_t num_dimensions = tree->data_set->num_dimensions;
+	for (size_t i = 0; i < num_dimensions; ++i) {
+		scratch->offsets[i] = 0.0;
+	}
+
+	iscc_kdt_QueryState state = {
+		.tree = tree,
+		.query = query,
+		.k = k,
+		.found = 0,
+		.radius_search = radius_search,
+		.radius_sq = radius_sq,
+		.dists = scratch->dists,
+		.positions = scratch->positions,
+		.offsets = scratch->offsets,
+		.out_nn_indices = out_nn_indices,
+	};
+
+	iscc_kdt_search_node(&state, 0, 0.0);
+
+	return state.found;
+}
+
+
+scc_PointIndex iscc_kdt_farthest_point(const iscc_KDTree* const tree,
+                                       const size_t query,
+                                       double* const out_max_dist_sq)
+{
+	assert(tree != NULL);
+	assert(tree->kdtree_version == ISCC_KDTREE_STRUCT_VERSION);
+	assert(tree->bounds != NULL);
+	assert(query < tree->data_set->num_data_points);
+	assert(out_max_dist_sq != NULL);
+
+	iscc_kdt_FarthestState state = {
+		.tree = tree,
+		.query = query,
+		.max_dist = -1.0,
+		.max_position = 0,
+		.max_point = 0,
+	};
+
+	iscc_kdt_farthest_node(&state, 0);
+	assert(state.max_dist >= 0.0);
+
+	*out_max_dist_sq = state.max_dist;
+	return state.max_point;
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+// FNV-1a over the data matrix in 64-bit words. Each step also folds the high
+// bits into the low bits, so that changes anywhere in a word are carried on.
+static uint64_t iscc_kdt_data_set_checksum(const scc_DataSet* const data_set)
+{
+	const size_t num_elements = data_set->num_data_points * data_set->num_dimensions;
+	const unsigned char* bytes;
+	size_t len_bytes;
+	if (data_set->float_matrix != NULL) {
+		bytes = (const unsigned char*) data_set->float_matrix;
+		len_bytes = sizeof(float) * num_elements;
+	} else {
+		bytes = (const unsigned char*) data_set->data_matrix;
+		len_bytes = sizeof(double) * num_elements;
+	}
+
+	const uint64_t prime = UINT64_C(1099511628211);
+	uint64_t checksum = UINT64_C(14695981039346656037);
+	checksum = (checksum ^ (uint64_t) data_set->num_data_points) * prime;
+	checksum = (checksum ^ (uint64_t) data_set->num_dimensions) * prime;
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len_bytes; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(uint64_t));
+		checksum = (checksum ^ word) * prime;
+		checksum ^= checksum >> 32;
+	}
+	for (; i < len_bytes; ++i) {
+		checksum = (checksum ^ (uint64_t) bytes[i]) * prime;
+	}
+
+	return checksum;
+}
+
+
+#ifdef ISCC_HAS_MMAP
+
+static scc_ErrorCode iscc_kdt_init_tree_from_mapping(const scc_DataSet* const data_set,
+                                                     void* const mapping,
+                                                     const size_t len_mapping,
+                                                     iscc_KDTree** const out_tree)
+{
+	assert(len_mapping >= ISCC_INDEX_FILE_HEADER_SIZE);
+	unsigned char* const header = mapping;
+
+	// Copy fields out of the header to avoid unaligned reads
+	uint32_t version;
+	uint32_t element_type;
+	uint64_t num_data_points;
+	uint32_t num_dimensions;
+	uint32_t leaf_size;
+	uint64_t checksum;
+	uint64_t num_nodes;
+	uint32_t node_size;
+	uint32_t point_index_size;
+	uint64_t reserved;
+	memcpy(&version, header + 8, sizeof(uint32_t));
+	memcpy(&element_type, header + 12, sizeof(uint32_t));
+	memcpy(&num_data_points, header + 16, sizeof(uint64_t));
+	memcpy(&num_dimensions, header + 24, sizeof(uint32_t));
+	memcpy(&leaf_size, header + 28, sizeof(uint32_t));
+	memcpy(&checksum, header + 32, sizeof(uint64_t));
+	memcpy(&num_nodes, header + 40, sizeof(uint64_t));
+	memcpy(&node_size, header + 48, sizeof(uint32_t));
+	memcpy(&point_index_size, header + 52, sizeof(uint32_t));
+	memcpy(&reserved, header + 56, sizeof(uint64_t));
+
+	if (memcmp(header, ISCC_INDEX_FILE_MAGIC, sizeof(ISCC_INDEX_FILE_MAGIC)) != 0) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid search index file.");
+	}
+	if ((version != ISCC_INDEX_FILE_VERSION) || (reserved != 0) ||
+	        (node_size != sizeof(iscc_kdt_Node)) || (point_index_size != sizeof(scc_PointIndex))) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Unsupported search index file version or platform.");
+	}
+
+	const uint32_t data_set_element_type = (data_set->float_matrix != NULL) ? ISCC_INDEX_FILE_FLOAT : ISCC_INDEX_FILE_DOUBLE;
+	if ((element_type != data_set_element_type) ||
+	        (num_data_points != (uint64_t) data_set->num_data_points) ||
+	        (num_dimensions != (uint32_t) data_set->num_dimensions) ||
+	        (checksum != iscc_kdt_data_set_checksum(data_set))) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Search index file does not match the data set.");
+	}
+
+	// A tree has fewer than two nodes per point
+	if ((leaf_size == 0) || (num_nodes == 0) || (num_nodes > 2 * num_data_points)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid search index file.");
+	}
+	const uint64_t len_nodes = sizeof(iscc_kdt_Node) * num_nodes;
+	const uint64_t len_point_indices = sizeof(scc_PointIndex) * num_data_points;
+	if ((uint64_t) len_mapping != ISCC_INDEX_FILE_HEADER_SIZE + len_nodes + len_point_indices) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid search index file.");
+	}
+
+	// All sections are 8-byte aligned, as the mapping is page aligned
+	const size_t num_points = data_set->num_data_points;
+	iscc_kdt_Node* const nodes = (iscc_kdt_Node*) (header + ISCC_INDEX_FILE_HEADER_SIZE);
+	scc_PointIndex* const point_indices = (scc_PointIndex*) (header + ISCC_INDEX_FILE_HEADER_SIZE + (size_t) len_nodes);
+
+	// Check that the nodes partition the points, so that a damaged file cannot
+	// make searches read out of bounds or loop. Nodes must be split at the
+	// median as when built, which bounds the depth of the tree (and of the
+	// recursion in searches) by the logarithm of the number of points.
+	bool valid = (nodes[0].begin == 0) && (nodes[0].end == num_points);
+	for (size_t i = 0; valid && (i < num_nodes); ++i) {
+		const iscc_kdt_Node* const node = &nodes[i];
+		valid = (node->begin < node->end);
+		if (valid && (node->left != 0)) {
+			valid = (node->left > i) && (node->left < num_nodes) &&
+			        (node->right > i) && (node->right < num_nodes) &&
+			        (node->split_dim < num_dimensions) &&
+			        (node->end - node->begin > leaf_size) &&
+			        (nodes[node->left].begin == node->begin) &&
+			        (nodes[node->left].end == node->begin + (node->end - node->begin) / 2) &&
+			        (nodes[node->right].begin == nodes[node->left].end) &&
+			        (nodes[node->right].end == node->end);
+		}
+	}
+
+	// Point indices must be a permutation of the points, so that no point is
+	// repeated or missing in searches
+	if (valid) {
+		bool* const seen = calloc(num_points, sizeof(bool));
+		if (seen == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+		for (size_t i = 0; valid && (i < num_points); ++i) {
+			const size_t index = (size_t) point_indices[i];
+			valid = (index < num_points) && !seen[index];
+			if (valid) seen[index] = true;
+		}
+		free(seen);
+	}
+
+	if (!valid) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid search index file.");
+	}
+
+	iscc_KDTree* tree = malloc(sizeof(iscc_KDTree));
+	if (tree == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+
+	*tree = (iscc_KDTree) {
+		.kdtree_version = ISCC_KDTREE_STRUCT_VERSION,
+		.data_set = data_set,
+		.num_points = num_points,
+		.leaf_size = (size_t) leaf_size,
+		.point_indices = point_indices,
+		.positions = point_indices,
+		.num_nodes = (size_t) num_nodes,
+		.max_nodes = (size_t) num_nodes,
+		.nodes = nodes,
+		.bounds = NULL,
+		.file_mapping = mapping,
+		.len_file_mapping = len_mapping,
+	};
+
+	*out_tree = tree;
+
+	return iscc_no_error();
+}
+
+#endif // ifdef ISCC_HAS_MMAP
+
+
+static size_t iscc_kdt_build_node(iscc_KDTree* const tree,
+                                  const size_t begin,
+                                  const size_t end)
+{
+	assert(tree->num_nodes < tree->max_nodes);
+	assert(begin < end);
+
+	const size_t node_index = tree->num_nodes;
+	++(tree->num_nodes);
+	tree->nodes[node_index] = (iscc_kdt_Node) {
+		.begin = begin,
+		.end = end,
+		.left = 0,
+		.right = 0,
+		.split_dim = 0,
+		.reserved = 0,
+		.split_value = 0.0,
+	};
+
+	// Find the bounding box, stored if the tree keeps boxes, and split along dimension with largest spread
+	const uint_fast16_t num_dimensions = tree->data_set->num_dimensions;
+	const scc_DataSet* const data_set = tree->data_set;
+	double* const lower = (tree->bounds == NULL) ? NULL : &tree->bounds[2 * node_index * num_dimensions];
+	double* const upper = (tree->bounds == NULL) ? NULL : lower + num_dimensions;
+	uint_fast16_t split_dim = 0;
+	double max_spread = 0.0;
+	for (uint_fast16_t dim = 0; dim < num_dimensions; ++dim) {
+		double min_value = HUGE_VAL;
+		double max_value = -HUGE_VAL;
+		for (size_t i = begin; i < end; ++i) {
+			const double value = iscc_get_coordinate(data_set, (size_t) tree->point_indices[i], dim);
+			if (value < min_value) min_value = value;
+			if (value > max_value) max_value = value;
+		}
+		if (lower != NULL) {
+			lower[dim] = min_value;
+			upper[dim] = max_value;
+		}
+		if (max_value - min_value > max_spread) {
+			max_spread = max_value - min_value;
+			split_dim = dim;
+		}
+	}
+
+	if (end - begin <= tree->leaf_size) return node_index;
+
+	// All points identical
+	if (!(max_spread > 0.0)) return node_index;
+
+	const size_t mid = begin + (end - begin) / 2;
+	iscc_kdt_select(tree, begin, end, mid, split_dim);
+	// Must be read before children are built, as they reorder the points
+	const double split_value = iscc_get_coordinate(data_set, (size_t) tree->point_indices[mid], split_dim);
+
+	const size_t left = iscc_kdt_build_node(tree, begin, mid);
+	const size_t right = iscc_kdt_build_node(tree, mid, end);
+
+	tree->nodes[node_index].left = left;
+	tree->nodes[node_index].right = right;
+	tree->nodes[node_index].split_dim = (uint32_t) split_dim;
+	tree->nodes[node_index].split_value = split_value;
+
+	return node_index;
+}
+
+
+// Partial sort so that `nth` has the right value and points before (after)
+// have less (greater) or equal coordinates along `dim`
+static void iscc_kdt_select(iscc_KDTree* const tree,
+                            size_t begin,
+                            size_t end,
+                            const size_t nth,
+                            const uint_fast16_t dim)
+{
+	assert(begin <= nth);
+	assert(nth < end);
+
+	const scc_DataSet* const data_set = tree->data_set;
+	scc_PointIndex* const point_indices = tree->point_indices;
+	scc_PointIndex* const positions = tree->positions;
+
+	#define ISCC_KDT_COORD(i) (iscc_get_coordinate(data_set, (size_t) point_indices[(i)], dim))
+	#define ISCC_KDT_SWAP(i, j) do { \
+		const scc_PointIndex tmp_index = point_indices[(i)]; \
+		point_indices[(i)] = point_indices[(j)]; \
+		point_indices[(j)] = tmp_index; \
+		const scc_PointIndex tmp_pos = positions[(i)]; \
+		positions[(i)] = positions[(j)]; \
+		positions[(j)] = tmp_pos; \
+	} while (0)
+
+	while (end - begin > 1) {
+		// Median of three
+		const double a = ISCC_KDT_COORD(begin);
+		const double b = ISCC_KDT_COORD(begin + (end - begin) / 2);
+		const double c = ISCC_KDT_COORD(end - 1);
+		double pivot;
+		if (a < b) {
+			pivot = (b < c) ? b : ((a < c) ? c : a);
+		} else {
+			pivot = (a < c) ? a : ((b < c) ? c : b);
+		}
+
+		// Three-way partition: [begin, lt) < pivot, [lt, gt) == pivot, [gt, end) > pivot
+		size_t lt = begin;
+		size_t i = begin;
+		size_t gt = end;
+		while (i < gt) {
+			const double value = ISCC_KDT_COORD(i);
+			if (value < pivot) {
+				ISCC_KDT_SWAP(lt, i);
+				++lt;
+				++i;
+			} else if (value > pivot) {
+				--gt;
+				ISCC_KDT_SWAP(i, gt);
+			} else {
+				++i;
+			}
+		}
+
+		if (nth < lt) {
+			end = lt;
+		} else if (nth >= gt) {
+			begin = gt;
+		} else {
+			break;
+		}
+	}
+
+	#undef ISCC_KDT_COORD
+	#undef ISCC_KDT_SWAP
+}
+
+
+static void iscc_kdt_search_node(iscc_kdt_QueryState* const state,
+                                 const size_t node_index,
+                                 const double cell_dist)
+{
+	const iscc_KDTree* const tree = state->tree;
+	const iscc_kdt_Node* const node = &tree->nodes[node_index];
+
+	if (node->left == 0) {
+		for (size_t i = (size_t) node->begin; i < (size_t) node->end; ++i) {
+			const scc_PointIndex point = tree->point_indices[i];
+			const double dist = iscc_get_sq_dist(tree->data_set, state->query, (size_t) point);
+			if (state->found < state->k) {
+				if (state->radius_search && (dist > state->radius_sq)) continue;
+				iscc_kdt_add_candidate(state, dist, tree->positions[i], point);
+			} else if (iscc_kdt_before(dist, tree->positions[i],
+			                           state->dists[state->k - 1], state->positions[state->k - 1])) {
+				iscc_kdt_add_candidate(state, dist, tree->positions[i], point);
+			}
+		}
+		return;
+	}
+
+	const uint_fast16_t dim = (uint_fast16_t) node->split_dim;
+	const double diff = iscc_get_coordinate(tree->data_set, state->query, dim) - node->split_value;
+	const size_t near_child = (size_t) ((diff < 0.0) ? node->left : node->right);
+	const size_t far_child = (size_t) ((diff < 0.0) ? node->right : node->left);
+
+	iscc_kdt_search_node(state, near_child, cell_dist);
+
+	const double old_offset = state->offsets[dim];
+	const double far_dist = cell_dist - old_offset * old_offset + diff * diff;
+
+	double bound = HUGE_VAL;
+	if (state->found == state->k) {
+		bound = state->dists[state->k - 1];
+	} else if (state->radius_search) {
+		bound = state->radius_sq;
+	}
+
+	// Points at exactly `bound` may win on position, so only prune strictly farther cells
+	if (far_dist > bound * (1.0 + ISCC_KDT_PRUNE_SLACK)) return;
+
+	state->offsets[dim] = diff;
+	iscc_kdt_search_node(state, far_child, far_dist);
+	state->offsets[dim] = old_offset;
+}
+
+
+// Visits the child with the farthest bounding box first, and skips children whose
+// bounding boxes cannot contain points farther away than the current candidate
+static void iscc_kdt_farthest_node(iscc_kdt_FarthestState* const state,
+                                   const size_t node_index)
+{
+	const iscc_KDTree* const tree = state->tree;
+	const iscc_kdt_Node* const node = &tree->nodes[node_index];
+
+	if (node->left == 0) {
+		for (size_t i = (size_t) node->begin; i < (size_t) node->end; ++i) {
+			const double dist = iscc_get_sq_dist(tree->data_set, state->query, (size_t) tree->point_indices[i]);
+			// Brute-force search keeps the first point in the search set among ties
+			if ((dist > state->max_dist) ||
+			        (!(dist < state->max_dist) && (tree->positions[i] < state->max_position))) {
+				state->max_dist = dist;
+				state->max_position = tree->positions[i];
+				state->max_point = tree->point_indices[i];
+			}
+		}
+		return;
+	}
+
+	const double left_bound = iscc_kdt_max_cell_dist(tree, state->query, (size_t) node->left);
+	const double right_bound = iscc_kdt_max_cell_dist(tree, state->query, (size_t) node->right);
+	const size_t first_child = (size_t) ((left_bound < right_bound) ? node->right : node->left);
+	const size_t second_child = (size_t) ((left_bound < right_bound) ? node->left : node->right);
+	const double second_bound = (left_bound < right_bound) ? left_bound : right_bound;
+
+	iscc_kdt_farthest_node(state, first_child);
+
+	// Points at exactly the current distance may win on position, so only prune strictly closer cells
+	if (second_bound * (1.0 + ISCC_KDT_PRUNE_SLACK) < state->max_dist) return;
+
+	iscc_kdt_farthest_node(state, second_child);
+}
+
+
+// Largest squared distance between `query` and any point in the bounding box of a node
+static inline double iscc_kdt_max_cell_dist(const iscc_KDTree* const tree,
+                                            const size_t query,
+                                            const size_t node_index)
+{
+	const size_t num_dimensions = tree->data_set->num_dimensions;
+	const double* const lower = &tree->bounds[2 * node_index * num_dimensions];
+	const double* const upper = lower + num_dimensions;
+
+	double max_dist = 0.0;
+	for (size_t dim = 0; dim < num_dimensions; ++dim) {
+		const double value = iscc_get_coordinate(tree->data_set, query, dim);
+		const double lower_diff = value - lower[dim];
+		const double upper_diff = upper[dim] - value;
+		const double max_diff = (lower_diff > upper_diff) ? lower_diff : upper_diff;
+		max_dist += max_diff * max_diff;
+	}
+	return max_dist;
+}
+
+
+// Order candidates by distance and then by position in the search set
+static inline bool iscc_kdt_before(const double dist1,
+                                   const scc_PointIndex pos1,
+                                   const double dist2,
+                                   const scc_PointIndex pos2)
+{
+	return (dist1 < dist2) || (!(dist1 > dist2) && (pos1 < pos2));
+}
+
+
+static inline void iscc_kdt_add_candidate(iscc_kdt_QueryState* const state,
+                                          const double dist,
+                                          const scc_PointIndex position,
+                                          const scc_PointIndex point)
+{
+	// If list is full, the last candidate is dropped
+	size_t i = state->found;
+	if (state->found < state->k) {
+		++(state->found);
+	} else {
+		--i;
+	}
+
+	for (; (i > 0) && iscc_kdt_before(dist, position, state->dists[i - 1], state->positions[i - 1]); --i) {
+		state->dists[i] = state->dists[i - 1];
+		state->positions[i] = state->positions[i - 1];
+		state->out_nn_indices[i] = state->out_nn_indices[i - 1];
+	}
+	state->dists[i] = dist;
+	state->positions[i] = position;
+	state->out_nn_indices[i] = point;
+}
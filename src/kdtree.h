@@ -0,0 +1,193 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+/** @file
+ *
+ *  kd-tree for nearest neighbor and farthest point search in `scc_DataSet`s.
+ *
+ *  The tree is built over a set of search points, and returns exactly the same
+ *  points as the brute-force searches in `dist_search_imp.c`. In particular,
+ *  ties in distance are broken by the position of the points in the search set,
+ *  so that points appearing earlier are preferred.
+ */
+
+#ifndef SCC_KDTREE_HG
+#define SCC_KDTREE_HG
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/scclust.h"
+#include "data_set_struct.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Macros
+// =============================================================================
+
+/// Leaf size of trees used for nearest neighbor search.
+#define ISCC_KDT_NN_LEAF_SIZE 16
+
+
+// =============================================================================
+// Structs, types and variables
+// =============================================================================
+
+/// Opaque kd-tree struct.
+typedef struct iscc_KDTree iscc_KDTree;
+
+
+/** Scratch memory for kd-tree queries.
+ *
+ *  Each thread that queries a tree must use its own scratch.
+ */
+typedef struct iscc_KDTreeScratch {
+	/// Maximum number of neighbors that can be searched for.
+	uint32_t k;
+
+	/// Squared distances of current candidates. Of length #k.
+	double* dists;
+
+	/// Search set positions of current candidates. Of length #k.
+	scc_PointIndex* positions;
+
+	/// Distances to the splitting planes of the current cell. Of length `num_dimensions`.
+	double* offsets;
+} iscc_KDTreeScratch;
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/** Builds a kd-tree.
+ *
+ *  \param[in] data_set the data set. Must outlive the tree.
+ *  \param len_search_indices number of search points.
+ *  \param[in] search_indices the search points. If `NULL`, the first \p len_search_indices
+ *                            points in \p data_set are used.
+ *  \param leaf_size nodes with at most this many points are not split.
+ *  \param bounding_boxes if `true`, the bounding boxes of the nodes are kept, which
+ *                        #iscc_kdt_farthest_point requires. They take `2 * num_dimensions`
+ *                        doubles per node.
+ *  \param[out] out_tree the built tree.
+ *
+ *  \return `true` if the tree was built, `false` if out of memory.
+ */
+bool iscc_kdt_build_tree(const scc_DataSet* data_set,
+                         size_t len_search_indices,
+                         const scc_PointIndex search_indices[],
+                         size_t leaf_size,
+                         bool bounding_boxes,
+                         iscc_KDTree** out_tree);
+
+
+/// Frees a kd-tree. Sets `*tree` to `NULL`.
+void iscc_kdt_free_tree(iscc_KDTree** tree);
+
+
+/** Saves a kd-tree to a search index file.
+ *
+ *  The file format is described with `scc_save_nn_search_index`.
+ *
+ *  \param[in] tree a kd-tree built over all points in its data set.
+ *  \param[in] file_path path to the file.
+ *
+ *  \return #scc_ErrorCode describing eventual error.
+ */
+scc_ErrorCode iscc_kdt_save_tree(const iscc_KDTree* tree,
+                                 const char* file_path);
+
+
+/** Loads a kd-tree from a search index file.
+ *
+ *  The file is memory-mapped, and the tree points into the mapping, so that
+ *  loading only reads the parts of the file that are checked. The mapping is
+ *  released by #iscc_kdt_free_tree.
+ *
+ *  \param[in] data_set the data set the tree was built over. Must outlive the tree.
+ *  \param[in] file_path path to the file.
+ *  \param[out] out_tree the loaded tree.
+ *
+ *  \return #scc_ErrorCode describing eventual error. Returns #SCC_ER_INVALID_INPUT
+ *          if the file was not saved from \p data_set, and #SCC_ER_NOT_IMPLEMENTED
+ *          on platforms without memory-mapped files.
+ */
+scc_ErrorCode iscc_kdt_load_tree(const scc_DataSet* data_set,
+                                 const char* file_path,
+                                 iscc_KDTree** out_tree);
+
+
+/// Allocates scratch for queries of at most `k` neighbors. Returns `false` if out of memory.
+bool iscc_kdt_init_scratch(const iscc_KDTree* tree,
+                           uint32_t k,
+                           iscc_KDTreeScratch* out_scratch);
+
+
+/// Frees scratch allocated with #iscc_kdt_init_scratch.
+void iscc_kdt_free_scratch(iscc_KDTreeScratch* scratch);
+
+
+/** Finds the nearest search points to a query.
+ *
+ *  \param[in] tree the kd-tree.
+ *  \param query the data point to query.
+ *  \param k number of neighbors to find. Must be at most `scratch->k`.
+ *  \param radius_search if `true`, only neighbors within \p radius are found.
+ *  \param radius_sq the squared radius.
+ *  \param[in,out] scratch query scratch.
+ *  \param[out] out_nn_indices the found neighbors sorted by distance. Must be of length \p k.
+ *
+ *  \return number of neighbors found. Always \p k unless \p radius_search is `true`.
+ */
+uint32_t iscc_kdt_nearest_neighbors(const iscc_KDTree* tree,
+                                    size_t query,
+                                    uint32_t k,
+                                    bool radius_search,
+                                    double radius_sq,
+                                    iscc_KDTreeScratch* scratch,
+                                    scc_PointIndex out_nn_indices[]);
+
+
+/** Finds the search point farthest from a query.
+ *
+ *  Nodes are pruned using their bounding boxes, so no scratch is needed and the
+ *  tree can be queried concurrently.
+ *
+ *  \param[in] tree a kd-tree built with bounding boxes.
+ *  \param query the data point to query.
+ *  \param[out] out_max_dist_sq the squared distance to the farthest point.
+ *
+ *  \return the farthest search point.
+ */
+scc_PointIndex iscc_kdt_farthest_point(const iscc_KDTree* tree,
+                                       size_t query,
+                                       double* out_max_dist_sq);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_KDTREE_HG
@@ -0,0 +1,278 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "nn_search_cache.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/scclust.h"
+#include "../include/scclust_spi.h"
+#include "dist_search.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Internal structs & variables
+// =============================================================================
+
+// Maximum number of data sets that can be pinned at the same time in a thread
+#define ISCC_NN_CACHE_MAX_PINNED 8
+
+
+// Maximum number of search objects cached in a thread. When the cache is full,
+// the least recently used object that is not in use is closed.
+#define ISCC_NN_CACHE_MAX_OBJECTS 16
+
+
+typedef struct iscc_NNCacheEntry {
+	void* data_set;
+	scc_init_nn_search_object init_nn_search_object;
+	scc_close_nn_search_object close_nn_search_object;
+	size_t len_search_indices;
+	scc_PointIndex* search_indices;
+	iscc_NNSearchObject* nn_search_object;
+	uint32_t num_users;
+	uint64_t last_used;
+} iscc_NNCacheEntry;
+
+
+// Data sets pinned by `scc_pin_nn_search_cache` in this thread
+static ISCC_THREAD_LOCAL const void* iscc_pinned_data_sets[ISCC_NN_CACHE_MAX_PINNED];
+static ISCC_THREAD_LOCAL size_t iscc_num_pinned_data_sets = 0;
+
+
+// Cached search objects in this thread. Empty entries have `data_set == NULL`.
+static ISCC_THREAD_LOCAL iscc_NNCacheEntry iscc_nn_cache[ISCC_NN_CACHE_MAX_OBJECTS];
+static ISCC_THREAD_LOCAL uint64_t iscc_nn_cache_clock = 0;
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static bool iscc_nn_cache_entry_matches(const iscc_NNCacheEntry* entry,
+                                        const void* data_set,
+                                        const iscc_dist_functions_struct* dist_functions,
+                                        size_t len_search_indices,
+                                        const scc_PointIndex search_indices[]);
+
+
+static bool iscc_close_nn_cache_entry(iscc_NNCacheEntry* entry);
+
+
+// =============================================================================
+// Public function implementations
+// =============================================================================
+
+bool scc_pin_nn_search_cache(void* const data_set)
+{
+	if (data_set == NULL) return false;
+	if (iscc_nn_search_cache_is_pinned(data_set)) return true;
+	if (iscc_num_pinned_data_sets == ISCC_NN_CACHE_MAX_PINNED) return false;
+
+	iscc_pinned_data_sets[iscc_num_pinned_data_sets] = data_set;
+	++iscc_num_pinned_data_sets;
+
+	return true;
+}
+
+
+bool scc_invalidate_nn_search_cache(void* const data_set)
+{
+	if (!iscc_nn_search_cache_is_pinned(data_set)) return false;
+
+	bool all_closed = true;
+	for (size_t i = 0; i < ISCC_NN_CACHE_MAX_OBJECTS; ++i) {
+		if (iscc_nn_cache[i].data_set == data_set) {
+			// Objects in use by a clustering call in this thread cannot be closed
+			if (iscc_nn_cache[i].num_users > 0) {
+				all_closed = false;
+			} else if (!iscc_close_nn_cache_entry(&iscc_nn_cache[i])) {
+				all_closed = false;
+			}
+		}
+	}
+
+	return all_closed;
+}
+
+
+bool scc_unpin_nn_search_cache(void* const data_set)
+{
+	if (!scc_invalidate_nn_search_cache(data_set)) return false;
+
+	for (size_t i = 0; i < iscc_num_pinned_data_sets; ++i) {
+		if (iscc_pinned_data_sets[i] == data_set) {
+			--iscc_num_pinned_data_sets;
+			iscc_pinned_data_sets[i] = iscc_pinned_data_sets[iscc_num_pinned_data_sets];
+			iscc_pinned_data_sets[iscc_num_pinned_data_sets] = NULL;
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+bool iscc_nn_search_cache_is_pinned(const void* const data_set)
+{
+	for (size_t i = 0; i < iscc_num_pinned_data_sets; ++i) {
+		if (iscc_pinned_data_sets[i] == data_set) return true;
+	}
+	return false;
+}
+
+
+bool iscc_nn_search_cache_get(void* const data_set,
+                              const size_t len_search_indices,
+                              const scc_PointIndex search_indices[const],
+                              iscc_NNSearchObject** const out_nn_search_object)
+{
+	assert(iscc_nn_search_cache_is_pinned(data_set));
+	assert(len_search_indices > 0);
+	assert(out_nn_search_object != NULL);
+
+	const iscc_dist_functions_struct* const dist_functions = iscc_get_dist_functions();
+	++iscc_nn_cache_clock;
+
+	// Look for the object, and otherwise for an empty entry or the least recently used unused entry
+	iscc_NNCacheEntry* replace = NULL;
+	for (size_t i = 0; i < ISCC_NN_CACHE_MAX_OBJECTS; ++i) {
+		iscc_NNCacheEntry* const entry = &iscc_nn_cache[i];
+		if (entry->data_set == NULL) {
+			if ((replace == NULL) || (replace->data_set != NULL)) replace = entry;
+		} else if (iscc_nn_cache_entry_matches(entry, data_set, dist_functions, len_search_indices, search_indices)) {
+			++entry->num_users;
+			entry->last_used = iscc_nn_cache_clock;
+			*out_nn_search_object = entry->nn_search_object;
+			return true;
+		} else if ((entry->num_users == 0) &&
+		               ((replace == NULL) || ((replace->data_set != NULL) && (entry->last_used < replace->last_used)))) {
+			replace = entry;
+		}
+	}
+
+	if (replace == NULL) {
+		// All cached objects are in use; the caller gets an uncached object
+		return dist_functions->init_nn_search_object(data_set, len_search_indices, search_indices, out_nn_search_object);
+	}
+
+	// Search objects may keep a pointer to the search indices, so the cache keeps its own copy
+	scc_PointIndex* search_indices_copy = NULL;
+	if (search_indices != NULL) {
+		search_indices_copy = malloc(sizeof(scc_PointIndex[len_search_indices]));
+		if (search_indices_copy == NULL) return false;
+		memcpy(search_indices_copy, search_indices, sizeof(scc_PointIndex[len_search_indices]));
+	}
+
+	iscc_NNSearchObject* nn_search_object;
+	if (!dist_functions->init_nn_search_object(data_set, len_search_indices, search_indices_copy, &nn_search_object)) {
+		free(search_indices_copy);
+		return false;
+	}
+
+	if (replace->data_set != NULL) {
+		iscc_close_nn_cache_entry(replace);
+	}
+
+	*replace = (iscc_NNCacheEntry) {
+		.data_set = data_set,
+		.init_nn_search_object = dist_functions->init_nn_search_object,
+		.close_nn_search_object = dist_functions->close_nn_search_object,
+		.len_search_indices = len_search_indices,
+		.search_indices = search_indices_copy,
+		.nn_search_object = nn_search_object,
+		.num_users = 1,
+		.last_used = iscc_nn_cache_clock,
+	};
+
+	*out_nn_search_object = nn_search_object;
+	return true;
+}
+
+
+bool iscc_nn_search_cache_release(iscc_NNSearchObject** const nn_search_object)
+{
+	if ((iscc_num_pinned_data_sets == 0) || (nn_search_object == NULL) || (*nn_search_object == NULL)) return false;
+
+	for (size_t i = 0; i < ISCC_NN_CACHE_MAX_OBJECTS; ++i) {
+		if ((iscc_nn_cache[i].data_set != NULL) && (iscc_nn_cache[i].nn_search_object == *nn_search_object)) {
+			assert(iscc_nn_cache[i].num_users > 0);
+			--iscc_nn_cache[i].num_users;
+			*nn_search_object = NULL;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+static bool iscc_nn_cache_entry_matches(const iscc_NNCacheEntry* const entry,
+                                        const void* const data_set,
+                                        const iscc_dist_functions_struct* const dist_functions,
+                                        const size_t len_search_indices,
+                                        const scc_PointIndex search_indices[const])
+{
+	if ((entry->data_set != data_set) ||
+	        (entry->init_nn_search_object != dist_functions->init_nn_search_object) ||
+	        (entry->close_nn_search_object != dist_functions->close_nn_search_object) ||
+	        (entry->len_search_indices != len_search_indices)) {
+		return false;
+	}
+	if ((entry->search_indices == NULL) || (search_indices == NULL)) {
+		return (entry->search_indices == NULL) && (search_indices == NULL);
+	}
+	return (memcmp(entry->search_indices, search_indices, sizeof(scc_PointIndex[len_search_indices])) == 0);
+}
+
+
+static bool iscc_close_nn_cache_entry(iscc_NNCacheEntry* const entry)
+{
+	assert(entry->data_set != NULL);
+	assert(entry->num_users == 0);
+
+	const bool closed = entry->close_nn_search_object(&entry->nn_search_object);
+	free(entry->search_indices);
+	*entry = (iscc_NNCacheEntry) {
+		.data_set = NULL,
+		.init_nn_search_object = NULL,
+		.close_nn_search_object = NULL,
+		.len_search_indices = 0,
+		.search_indices = NULL,
+		.nn_search_object = NULL,
+		.num_users = 0,
+		.last_used = 0,
+	};
+
+	return closed;
+}
@@ -0,0 +1,81 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+
+/** @file
+ *
+ *  Cache of nearest neighbor search objects, set up by `scc_pin_nn_search_cache`.
+ *
+ *  While a data set is pinned, #iscc_init_nn_search_object hands out cached
+ *  search objects over it, and #iscc_close_nn_search_object returns them to the
+ *  cache rather than closing them. Objects are cached with a copy of their
+ *  search indices, and are only reused with the same data set, search indices
+ *  and nearest neighbor functions. All state is stored with #ISCC_THREAD_LOCAL,
+ *  so only the thread that pinned a data set uses its cache.
+ */
+
+#ifndef SCC_NN_SEARCH_CACHE_HG
+#define SCC_NN_SEARCH_CACHE_HG
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../include/scclust.h"
+#include "../include/scclust_spi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/// Returns whether `data_set` is pinned in this thread.
+bool iscc_nn_search_cache_is_pinned(const void* data_set);
+
+
+/** Gets a search object from the cache, or builds and caches a new one.
+ *
+ *  \param data_set a pinned data set.
+ *  \param len_search_indices number of search points.
+ *  \param search_indices the search points, or `NULL` for all points.
+ *  \param[out] out_nn_search_object the search object.
+ *
+ *  \return `true` on success.
+ *
+ *  The object must be given back with #iscc_nn_search_cache_release. If the
+ *  cache is full and all its objects are in use, an uncached object is built.
+ */
+bool iscc_nn_search_cache_get(void* data_set,
+                              size_t len_search_indices,
+                              const scc_PointIndex search_indices[],
+                              iscc_NNSearchObject** out_nn_search_object);
+
+
+/// Gives back an object from #iscc_nn_search_cache_get and sets it to `NULL`. Returns `false` if the object is not cached.
+bool iscc_nn_search_cache_release(iscc_NNSearchObject** nn_search_object);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_NN_SEARCH_CACHE_HG
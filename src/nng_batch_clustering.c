@@ -17,7 +17,6 @@
  * You should have received a copy of the GNU Lesser General Public
  * License along with this library. If not, see http://www.gnu.org/licenses/
  * ========================================================================== */
-
 #include "nng_batch_clustering.h"
 
 #include <assert.h>
@@ -28,8 +27,28 @@
 #include "../include/scclust.h"
 #include "clustering_struct.h"
 #include "dist_search.h"
+#include "dist_search_imp.h"
 #include "error.h"
+#include "profile.h"
 #include "scclust_types.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Internal structs and macros
+// =============================================================================
+
+// Number of queries a thread claims at a time in the pipelined search
+#define ISCC_NNG_BATCH_QUERY_BLOCK 16
+
+
+// A batch of queries and their search results in the pipelined version
+typedef struct iscc_NNGBatch {
+	size_t num_queries;
+	scc_PointIndex* query_indices;
+	scc_PointIndex* nn_indices;
+	bool* query_ok;
+} iscc_NNGBatch;
 
 
 // =============================================================================
@@ -43,6 +62,9 @@ static int iscc_compare_PointIndex(const void* a, const void* b);
 #endif // ifdef SCC_STABLE_NNG
 
 
+static inline bool iscc_uses_imp_nn_search(void);
+
+
 static scc_ErrorCode iscc_run_nng_batches(scc_Clustering* clustering,
                                           iscc_NNSearchObject* nn_search_object,
                                           uint32_t size_constraint,
@@ -56,6 +78,56 @@ static scc_ErrorCode iscc_run_nng_batches(scc_Clustering* clustering,
                                           bool* assigned);
 
 
+static scc_ErrorCode iscc_run_nng_batches_pipelined(scc_Clustering* clustering,
+                                                    iscc_NNSearchObject* nn_search_object,
+                                                    uint32_t size_constraint,
+                                                    bool ignore_unassigned,
+                                                    bool radius_constraint,
+                                                    double radius,
+                                                    const bool primary_data_points[],
+                                                    uint32_t batch_size,
+                                                    uint32_t num_threads,
+                                                    scc_PointIndex* batch_indices,
+                                                    scc_PointIndex* out_indices,
+                                                    bool* assigned);
+
+
+static scc_PointIndex iscc_nng_form_batch(scc_Clustering* clustering,
+                                          const bool primary_data_points[],
+                                          const bool assigned[],
+                                          uint32_t batch_size,
+                                          scc_PointIndex curr_point,
+                                          scc_PointIndex* out_batch_indices,
+                                          size_t* out_in_batch);
+
+
+static scc_ErrorCode iscc_nng_assign_batch(scc_Clustering* clustering,
+                                           uint32_t size_constraint,
+                                           bool ignore_unassigned,
+                                           size_t num_queries,
+                                           const scc_PointIndex query_indices[],
+                                           const scc_PointIndex nn_indices[],
+                                           const bool query_ok[],
+                                           bool* assigned,
+                                           scc_Clabel* next_cluster_label);
+
+
+static void iscc_nng_search_batch(const iscc_NNSearchObject* nn_search_object,
+                                  uint32_t size_constraint,
+                                  bool radius_constraint,
+                                  double radius_sq,
+                                  iscc_NNQueryScratch* scratch,
+                                  size_t* next_block,
+                                  iscc_NNGBatch* batch);
+
+
+static scc_ErrorCode iscc_nng_finish_batches(scc_Clustering* clustering,
+                                             bool radius_constraint,
+                                             const bool primary_data_points[],
+                                             bool search_done,
+                                             scc_Clabel next_cluster_label);
+
+
 // =============================================================================
 // External function implementations
 // =============================================================================
@@ -146,17 +218,39 @@ scc_ErrorCode scc_nng_clustering_batches(scc_Clustering* const clustering,
 		}
 	}
 
-	scc_ErrorCode ec = iscc_run_nng_batches(clustering,
-	                                        nn_search_object,
-	                                        size_constraint,
-	                                        (unassigned_method == SCC_UM_IGNORE),
-	                                        radius_constraint,
-	                                        radius,
-	                                        tmp_primary_data_points,
-	                                        batch_size,
-	                                        batch_indices,
-	                                        out_indices,
-	                                        assigned);
+	// The pipelined version queries the built-in search objects directly
+	uint32_t num_threads = iscc_get_num_threads();
+	if (!iscc_uses_imp_nn_search()) {
+		num_threads = 1;
+	}
+
+	scc_ErrorCode ec;
+	if (num_threads > 1) {
+		ec = iscc_run_nng_batches_pipelined(clustering,
+		                                    nn_search_object,
+		                                    size_constraint,
+		                                    (unassigned_method == SCC_UM_IGNORE),
+		                                    radius_constraint,
+		                                    radius,
+		                                    tmp_primary_data_points,
+		                                    batch_size,
+		                                    num_threads,
+		                                    batch_indices,
+		                                    out_indices,
+		                                    assigned);
+	} else {
+		ec = iscc_run_nng_batches(clustering,
+		                          nn_search_object,
+		                          size_constraint,
+		                          (unassigned_method == SCC_UM_IGNORE),
+		                          radius_constraint,
+		                          radius,
+		                          tmp_primary_data_points,
+		                          batch_size,
+		                          batch_indices,
+		                          out_indices,
+		                          assigned);
+	}
 
 	free(batch_indices);
 	free(out_indices);
@@ -168,6 +262,8 @@ scc_ErrorCode scc_nng_clustering_batches(scc_Clustering* const clustering,
 }
 
 
+
+
 // =============================================================================
 // Static function implementations
 // =============================================================================
@@ -184,6 +280,17 @@ static int iscc_compare_PointIndex(const void* const a, const void* const b)
 #endif // ifdef SCC_STABLE_NNG
 
 
+static inline bool iscc_uses_imp_nn_search(void)
+{
+	const iscc_dist_functions_struct* const dist_functions = iscc_get_dist_functions();
+	return ((dist_functions->init_nn_search_object == iscc_imp_init_nn_search_object) ||
+	        (dist_functions->init_nn_search_object == iscc_imp_init_kdtree_nn_search_object) ||
+	        (dist_functions->init_nn_search_object == iscc_imp_init_pivot_nn_search_object) ||
+	        (dist_functions->init_nn_search_object == iscc_imp_init_hnsw_nn_search_object)) &&
+	       (dist_functions->nearest_neighbor_search == iscc_imp_nearest_neighbor_search);
+}
+
+
 static scc_ErrorCode iscc_run_nng_batches(scc_Clustering* const clustering,
                                           iscc_NNSearchObject* const nn_search_object,
                                           const uint32_t size_constraint,
@@ -215,26 +322,14 @@ static scc_ErrorCode iscc_run_nng_batches(scc_Clustering* const clustering,
 
 	for (scc_PointIndex curr_point = 0; curr_point < num_data_points; ) {
 
-		size_t in_batch = 0;
-		if (primary_data_points == NULL) {
-			for (; (in_batch < batch_size) && (curr_point < num_data_points); ++curr_point) {
-				if (!assigned[curr_point]) {
-					clustering->cluster_label[curr_point] = SCC_CLABEL_NA;
-					batch_indices[in_batch] = curr_point;
-					++in_batch;
-				}
-			}
-		} else {
-			for (; (in_batch < batch_size) && (curr_point < num_data_points); ++curr_point) {
-				if (!assigned[curr_point]) {
-					clustering->cluster_label[curr_point] = SCC_CLABEL_NA;
-					if (primary_data_points[curr_point]) {
-						batch_indices[in_batch] = curr_point;
-						++in_batch;
-					}
-				}
-			}
-		}
+		size_t in_batch;
+		curr_point = iscc_nng_form_batch(clustering,
+		                                 primary_data_points,
+		                                 assigned,
+		                                 batch_size,
+		                                 curr_point,
+		                                 batch_indices,
+		                                 &in_batch);
 
 		if (in_batch == 0) {
 			assert(curr_point == num_data_points);
@@ -261,54 +356,340 @@ static scc_ErrorCode iscc_run_nng_batches(scc_Clustering* const clustering,
 		}
 		#endif // ifdef SCC_STABLE_NNG
 
-		const scc_PointIndex* check_indices = out_indices;
-		for (size_t i = 0; i < num_ok_in_batch; ++i) {
-			const scc_PointIndex* const stop_check_indices = check_indices + size_constraint;
-			if (!assigned[batch_indices[i]]) {
-				for (; (check_indices != stop_check_indices) && !assigned[*check_indices]; ++check_indices) {}
-				if (check_indices == stop_check_indices) {
-					// `i` has no assigned neighbors and can be seed
-					if (next_cluster_label == SCC_CLABEL_MAX) {
-						return iscc_make_error_msg(SCC_ER_TOO_LARGE_PROBLEM, "Too many clusters (adjust the `scc_Clabel` type).");
-					}
-
-					assert(!assigned[batch_indices[i]]);
-					const scc_PointIndex* const stop_assign_indices = stop_check_indices - 1;
-					for (check_indices -= size_constraint; check_indices != stop_assign_indices; ++check_indices) {
-						assert(!assigned[*check_indices]);
-						assigned[*check_indices] = true;
-						clustering->cluster_label[*check_indices] = next_cluster_label;
-					}
-					if (assigned[batch_indices[i]]) {
-						// Self-loop from `batch_indices[i]` to `batch_indices[i]` existed among NN
-						assert(!assigned[*check_indices]);
-						assigned[*check_indices] = true;
-						clustering->cluster_label[*check_indices] = next_cluster_label;
-					} else {
-						// Self-loop did not exist
-						assert(!assigned[batch_indices[i]]);
-						assigned[batch_indices[i]] = true;
-						clustering->cluster_label[batch_indices[i]] = next_cluster_label;
-					}
-
-					assert(clustering->cluster_label[batch_indices[i]] == next_cluster_label);
-					++next_cluster_label;
-				} else {
-					// `i` has assigned neighbors and cannot be seed
-					if (!ignore_unassigned) {
-						// Assign `batch_indices[i]` to a preliminary cluster.
-						// If a future seed wants it as neighbor, it switches cluster.
-						assert(assigned[*check_indices]);
-						assert(clustering->cluster_label[batch_indices[i]] == SCC_CLABEL_NA);
-						assert(clustering->cluster_label[*check_indices] != SCC_CLABEL_NA);
-						assert(!assigned[batch_indices[i]]);
-						clustering->cluster_label[batch_indices[i]] = clustering->cluster_label[*check_indices];
-					}
+		const scc_ErrorCode ec = iscc_nng_assign_batch(clustering,
+		                                               size_constraint,
+		                                               ignore_unassigned,
+		                                               num_ok_in_batch,
+		                                               batch_indices,
+		                                               out_indices,
+		                                               NULL,
+		                                               assigned,
+		                                               &next_cluster_label);
+		if (ec != SCC_ER_OK) return ec;
+	} // Loop between batches
+
+	return iscc_nng_finish_batches(clustering,
+	                               radius_constraint,
+	                               primary_data_points,
+	                               search_done,
+	                               next_cluster_label);
+}
+
+
+// Gives the same clustering as `iscc_run_nng_batches`. The batches are
+// processed in order exactly as above, but the nearest neighbors of the next
+// batch are searched for while the current batch is assigned. The next batch
+// is therefore formed before the current batch is assigned, so some of its
+// queries may be assigned when it is processed. Those are skipped just like
+// points that were assigned earlier in the same batch. As the search results
+// do not depend on which points are assigned, each point is processed in the
+// same order and with the same neighbors as in the sequential version.
+static scc_ErrorCode iscc_run_nng_batches_pipelined(scc_Clustering* const clustering,
+                                                    iscc_NNSearchObject* const nn_search_object,
+                                                    const uint32_t size_constraint,
+                                                    const bool ignore_unassigned,
+                                                    const bool radius_constraint,
+                                                    const double radius,
+                                                    const bool primary_data_points[const],
+                                                    const uint32_t batch_size,
+                                                    const uint32_t num_threads,
+                                                    scc_PointIndex* const batch_indices,
+                                                    scc_PointIndex* const out_indices,
+                                                    bool* const assigned)
+{
+	assert(iscc_check_input_clustering(clustering));
+	assert(clustering->cluster_label != NULL);
+	assert(clustering->num_clusters == 0);
+	assert(nn_search_object != NULL);
+	assert(size_constraint >= 2);
+	assert(clustering->num_data_points >= size_constraint);
+	assert(!radius_constraint || (radius > 0.0));
+	assert(batch_size > 0);
+	assert(num_threads > 0);
+	assert(batch_indices != NULL);
+	assert(out_indices != NULL);
+	assert(assigned != NULL);
+
+	// Two batches: one is assigned while the other is searched
+	iscc_NNGBatch batches[2] = {
+		{
+			.num_queries = 0,
+			.query_indices = batch_indices,
+			.nn_indices = out_indices,
+			.query_ok = malloc(sizeof(bool[batch_size])),
+		},
+		{
+			.num_queries = 0,
+			.query_indices = malloc(sizeof(scc_PointIndex[batch_size])),
+			.nn_indices = malloc(sizeof(scc_PointIndex[size_constraint * batch_size])),
+			.query_ok = malloc(sizeof(bool[batch_size])),
+		},
+	};
+
+	// Each thread gets its own scratch
+	uint32_t num_scratch = 0;
+	iscc_NNQueryScratch* const scratch = malloc(sizeof(iscc_NNQueryScratch[num_threads]));
+	if ((batches[0].query_ok != NULL) &&
+	        (batches[1].query_indices != NULL) &&
+	        (batches[1].nn_indices != NULL) &&
+	        (batches[1].query_ok != NULL) &&
+	        (scratch != NULL)) {
+		for (; num_scratch < num_threads; ++num_scratch) {
+			if (!iscc_imp_init_nn_query_scratch(nn_search_object, size_constraint, &scratch[num_scratch])) break;
+		}
+	}
+
+	scc_ErrorCode ec = SCC_ER_OK;
+	if (num_scratch < num_threads) {
+		ec = iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+
+	bool search_done = false;
+	scc_Clabel next_cluster_label = 0;
+	const double radius_sq = radius * radius;
+	size_t current = 0;
+	size_t next_block = 0;
+	scc_PointIndex curr_point = 0;
+
+	if (ec == SCC_ER_OK) {
+		// First batch is searched by all threads
+		curr_point = iscc_nng_form_batch(clustering,
+		                                 primary_data_points,
+		                                 assigned,
+		                                 batch_size,
+		                                 curr_point,
+		                                 batches[0].query_indices,
+		                                 &batches[0].num_queries);
+		// Queries bypass `iscc_nearest_neighbor_search`, so they are counted here
+		iscc_profile_count_queries((uint64_t) batches[0].num_queries);
+		ISCC_OMP_PRAGMA(omp parallel num_threads((int) num_threads))
+		{
+			iscc_nng_search_batch(nn_search_object,
+			                      size_constraint,
+			                      radius_constraint,
+			                      radius_sq,
+			                      &scratch[iscc_get_thread_num()],
+			                      &next_block,
+			                      &batches[0]);
+		}
+	}
+
+	while ((ec == SCC_ER_OK) && (batches[current].num_queries > 0)) {
+		search_done = true;
+		iscc_NNGBatch* const batch = &batches[current];
+		iscc_NNGBatch* const next_batch = &batches[1 - current];
+
+		curr_point = iscc_nng_form_batch(clustering,
+		                                 primary_data_points,
+		                                 assigned,
+		                                 batch_size,
+		                                 curr_point,
+		                                 next_batch->query_indices,
+		                                 &next_batch->num_queries);
+		iscc_profile_count_queries((uint64_t) next_batch->num_queries);
+
+		// Thread 0 assigns the current batch and then helps search the next
+		next_block = 0;
+		ISCC_OMP_PRAGMA(omp parallel num_threads((int) num_threads))
+		{
+			const uint32_t thread_num = iscc_get_thread_num();
+			if (thread_num == 0) {
+				ec = iscc_nng_assign_batch(clustering,
+				                           size_constraint,
+				                           ignore_unassigned,
+				                           batch->num_queries,
+				                           batch->query_indices,
+				                           batch->nn_indices,
+				                           batch->query_ok,
+				                           assigned,
+				                           &next_cluster_label);
+			}
+			iscc_nng_search_batch(nn_search_object,
+			                      size_constraint,
+			                      radius_constraint,
+			                      radius_sq,
+			                      &scratch[thread_num],
+			                      &next_block,
+			                      next_batch);
+		}
+
+		current = 1 - current;
+	}
+
+	for (uint32_t t = 0; t < num_scratch; ++t) {
+		iscc_imp_free_nn_query_scratch(&scratch[t]);
+	}
+	free(scratch);
+	free(batches[0].query_ok);
+	free(batches[1].query_indices);
+	free(batches[1].nn_indices);
+	free(batches[1].query_ok);
+
+	if (ec != SCC_ER_OK) return ec;
+
+	return iscc_nng_finish_batches(clustering,
+	                               radius_constraint,
+	                               primary_data_points,
+	                               search_done,
+	                               next_cluster_label);
+}
+
+
+// Collects the next `batch_size` unassigned primary data points starting
+// with `curr_point`, and resets the labels of all unassigned points passed.
+// Returns the point after the last one passed.
+static scc_PointIndex iscc_nng_form_batch(scc_Clustering* const clustering,
+                                          const bool primary_data_points[const],
+                                          const bool assigned[const],
+                                          const uint32_t batch_size,
+                                          scc_PointIndex curr_point,
+                                          scc_PointIndex* const out_batch_indices,
+                                          size_t* const out_in_batch)
+{
+	assert(clustering->num_data_points <= ISCC_POINTINDEX_MAX);
+	const scc_PointIndex num_data_points = (scc_PointIndex) clustering->num_data_points; // If `scc_PointIndex` is signed
+
+	size_t in_batch = 0;
+	if (primary_data_points == NULL) {
+		for (; (in_batch < batch_size) && (curr_point < num_data_points); ++curr_point) {
+			if (!assigned[curr_point]) {
+				clustering->cluster_label[curr_point] = SCC_CLABEL_NA;
+				out_batch_indices[in_batch] = curr_point;
+				++in_batch;
+			}
+		}
+	} else {
+		for (; (in_batch < batch_size) && (curr_point < num_data_points); ++curr_point) {
+			if (!assigned[curr_point]) {
+				clustering->cluster_label[curr_point] = SCC_CLABEL_NA;
+				if (primary_data_points[curr_point]) {
+					out_batch_indices[in_batch] = curr_point;
+					++in_batch;
 				}
 			}
-			check_indices = stop_check_indices;
-		} // Loop in batch
-	} // Loop between batches
+		}
+	}
+
+	*out_in_batch = in_batch;
+	return curr_point;
+}
+
+
+// Assigns the queries in a batch given their nearest neighbors. Queries with
+// `query_ok[i] == false` have too few neighbors and are skipped. If `query_ok`
+// is `NULL`, all queries have neighbors.
+static scc_ErrorCode iscc_nng_assign_batch(scc_Clustering* const clustering,
+                                           const uint32_t size_constraint,
+                                           const bool ignore_unassigned,
+                                           const size_t num_queries,
+                                           const scc_PointIndex query_indices[const],
+                                           const scc_PointIndex nn_indices[const],
+                                           const bool query_ok[const],
+                                           bool* const assigned,
+                                           scc_Clabel* const next_cluster_label)
+{
+	for (size_t i = 0; i < num_queries; ++i) {
+		if ((query_ok != NULL) && !query_ok[i]) continue;
+		if (assigned[query_indices[i]]) continue;
+
+		const scc_PointIndex* check_indices = nn_indices + i * size_constraint;
+		const scc_PointIndex* const stop_check_indices = check_indices + size_constraint;
+		for (; (check_indices != stop_check_indices) && !assigned[*check_indices]; ++check_indices) {}
+		if (check_indices == stop_check_indices) {
+			// `i` has no assigned neighbors and can be seed
+			if (*next_cluster_label == SCC_CLABEL_MAX) {
+				return iscc_make_error_msg(SCC_ER_TOO_LARGE_PROBLEM, "Too many clusters (adjust the `scc_Clabel` type).");
+			}
+
+			assert(!assigned[query_indices[i]]);
+			const scc_PointIndex* const stop_assign_indices = stop_check_indices - 1;
+			for (check_indices -= size_constraint; check_indices != stop_assign_indices; ++check_indices) {
+				assert(!assigned[*check_indices]);
+				assigned[*check_indices] = true;
+				clustering->cluster_label[*check_indices] = *next_cluster_label;
+			}
+			if (assigned[query_indices[i]]) {
+				// Self-loop from `query_indices[i]` to `query_indices[i]` existed among NN
+				assert(!assigned[*check_indices]);
+				assigned[*check_indices] = true;
+				clustering->cluster_label[*check_indices] = *next_cluster_label;
+			} else {
+				// Self-loop did not exist
+				assert(!assigned[query_indices[i]]);
+				assigned[query_indices[i]] = true;
+				clustering->cluster_label[query_indices[i]] = *next_cluster_label;
+			}
+
+			assert(clustering->cluster_label[query_indices[i]] == *next_cluster_label);
+			++(*next_cluster_label);
+		} else {
+			// `i` has assigned neighbors and cannot be seed
+			if (!ignore_unassigned) {
+				// Assign `query_indices[i]` to a preliminary cluster.
+				// If a future seed wants it as neighbor, it switches cluster.
+				assert(assigned[*check_indices]);
+				assert(clustering->cluster_label[query_indices[i]] == SCC_CLABEL_NA);
+				assert(clustering->cluster_label[*check_indices] != SCC_CLABEL_NA);
+				assert(!assigned[query_indices[i]]);
+				clustering->cluster_label[query_indices[i]] = clustering->cluster_label[*check_indices];
+			}
+		}
+	}
+
+	return SCC_ER_OK;
+}
+
+
+// Searches for the nearest neighbors of the queries in `batch`. Called by all
+// threads in a parallel region; each thread claims blocks of queries until
+// none are left. Does not allocate memory.
+static void iscc_nng_search_batch(const iscc_NNSearchObject* const nn_search_object,
+                                  const uint32_t size_constraint,
+                                  const bool radius_constraint,
+                                  const double radius_sq,
+                                  iscc_NNQueryScratch* const scratch,
+                                  size_t* const next_block,
+                                  iscc_NNGBatch* const batch)
+{
+	while (true) {
+		size_t block;
+		ISCC_OMP_PRAGMA(omp atomic capture)
+		block = (*next_block)++;
+
+		const size_t start = block * ISCC_NNG_BATCH_QUERY_BLOCK;
+		if (start >= batch->num_queries) break;
+		size_t stop = start + ISCC_NNG_BATCH_QUERY_BLOCK;
+		if (stop > batch->num_queries) stop = batch->num_queries;
+
+		for (size_t i = start; i < stop; ++i) {
+			scc_PointIndex* const nn_write = batch->nn_indices + i * size_constraint;
+			const uint32_t found = iscc_imp_nn_query(nn_search_object,
+			                                         (size_t) batch->query_indices[i],
+			                                         size_constraint,
+			                                         radius_constraint,
+			                                         radius_sq,
+			                                         scratch,
+			                                         nn_write);
+			batch->query_ok[i] = (found == size_constraint);
+
+			#ifdef SCC_STABLE_NNG
+			if (batch->query_ok[i]) {
+				qsort(nn_write, size_constraint, sizeof(scc_PointIndex), iscc_compare_PointIndex);
+			}
+			#endif // ifdef SCC_STABLE_NNG
+		}
+	}
+}
+
+
+static scc_ErrorCode iscc_nng_finish_batches(scc_Clustering* const clustering,
+                                             const bool radius_constraint,
+                                             const bool primary_data_points[const],
+                                             const bool search_done,
+                                             const scc_Clabel next_cluster_label)
+{
+	(void) radius_constraint; // Only used in assertions
+	(void) primary_data_points;
 
 	if (next_cluster_label == 0) {
 		if (!search_done) {
@@ -32,6 +32,7 @@
 #include "nng_batch_clustering.h"
 #include "nng_core.h"
 #include "nng_findseeds.h"
+#include "profile.h"
 #include "utilities.h"
 
 
@@ -39,6 +40,11 @@
 // Static function prototypes
 // =============================================================================
 
+static scc_ErrorCode iscc_sc_clustering(void* data_set,
+                                        const scc_ClusterOptions* options,
+                                        scc_Clustering* out_clustering);
+
+
 static scc_ErrorCode iscc_make_clustering_from_nng(scc_Clustering* clustering,
                                                    void* data_set,
                                                    iscc_Digraph* nng,
@@ -52,6 +58,21 @@ static scc_ErrorCode iscc_make_clustering_from_nng(scc_Clustering* clustering,
 scc_ErrorCode scc_sc_clustering(void* const data_set,
                                 const scc_ClusterOptions* const options,
                                 scc_Clustering* const out_clustering)
+{
+	iscc_profile_begin();
+	const scc_ErrorCode ec = iscc_sc_clustering(data_set, options, out_clustering);
+	iscc_profile_end();
+	return ec;
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+static scc_ErrorCode iscc_sc_clustering(void* const data_set,
+                                        const scc_ClusterOptions* const options,
+                                        scc_Clustering* const out_clustering)
 {
 	if (!iscc_check_input_clustering(out_clustering)) {
 		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid clustering object.");
@@ -71,6 +92,7 @@ scc_ErrorCode scc_sc_clustering(void* const data_set,
 	}
 
 	if (options->seed_method == SCC_SM_BATCHES) {
+		iscc_profile_enter(SCC_PH_NNG);
 		return scc_nng_clustering_batches(out_clustering,
 		                                  data_set,
 		                                  options->size_constraint,
@@ -82,6 +104,7 @@ scc_ErrorCode scc_sc_clustering(void* const data_set,
 		                                  options->batch_size);
 	}
 
+	iscc_profile_enter(SCC_PH_NNG);
 	iscc_Digraph nng;
 	if (options->num_types < 2) {
 		if ((ec = iscc_get_nng_with_size_constraint(data_set,
@@ -118,16 +141,13 @@ scc_ErrorCode scc_sc_clustering(void* const data_set,
 	                                   &nng,
 	                                   options);
 
+	iscc_profile_enter(SCC_PH_OTHER);
 	iscc_free_digraph(&nng);
 
 	return ec;
 }
 
 
-// =============================================================================
-// Static function implementations
-// =============================================================================
-
 static scc_ErrorCode iscc_make_clustering_from_nng(scc_Clustering* const clustering,
                                                    void* const data_set,
                                                    iscc_Digraph* const nng,
@@ -146,6 +166,7 @@ static scc_ErrorCode iscc_make_clustering_from_nng(scc_Clustering* const cluster
 	};
 
 	scc_ErrorCode ec;
+	iscc_profile_enter(SCC_PH_SEEDS);
 	if ((ec = iscc_find_seeds(nng, options->seed_method, &seed_result)) != SCC_ER_OK) {
 		return ec;
 	}
@@ -178,6 +199,7 @@ static scc_ErrorCode iscc_make_clustering_from_nng(scc_Clustering* const cluster
 	// Estimate assign radius if we need to, and modify options
 	if ((primary_radius == SCC_RM_USE_ESTIMATED) ||
 	        (secondary_radius == SCC_RM_USE_ESTIMATED)) {
+		iscc_profile_enter(SCC_PH_RADIUS);
 		double avg_seed_dist;
 		if ((ec = iscc_estimate_avg_seed_dist(data_set,
 		                                      &seed_result,
@@ -212,6 +234,8 @@ static scc_ErrorCode iscc_make_clustering_from_nng(scc_Clustering* const cluster
 	assert((primary_radius == SCC_RM_NO_RADIUS) || (primary_radius == SCC_RM_USE_SUPPLIED));
 	assert((secondary_radius == SCC_RM_NO_RADIUS) || (secondary_radius == SCC_RM_USE_SUPPLIED));
 
+	iscc_profile_enter(SCC_PH_ASSIGN);
+
 	// Initialize cluster labels
 	if (clustering->cluster_label == NULL) {
 		clustering->external_labels = false;
@@ -31,8 +31,11 @@
 #include "digraph_core.h"
 #include "digraph_operations.h"
 #include "dist_search.h"
+#include "dist_search_imp.h"
 #include "error.h"
+#include "nng_descent.h"
 #include "nng_findseeds.h"
+#include "profile.h"
 #include "scclust_types.h"
 
 
@@ -94,6 +97,23 @@ static scc_ErrorCode iscc_type_count(size_t num_data_points,
                                      iscc_TypeCount* out_type_result);
 
 
+static inline bool iscc_uses_brute_force_nn_search(void);
+
+
+static scc_ErrorCode iscc_make_fused_type_nng(void* data_set,
+                                              size_t num_data_points,
+                                              uint32_t size_constraint,
+                                              uint_fast16_t num_types,
+                                              const uint32_t type_constraints[static num_types],
+                                              const scc_TypeLabel type_labels[static num_data_points],
+                                              const iscc_TypeCount* tc,
+                                              size_t len_query_indices,
+                                              const scc_PointIndex query_indices[],
+                                              bool radius_constraint,
+                                              double radius,
+                                              iscc_Digraph* out_nng);
+
+
 static size_t iscc_assign_seeds_and_neighbors(scc_Clustering* clustering,
                                               const iscc_SeedResult* seed_result,
                                               iscc_Digraph* nng);
@@ -147,18 +167,25 @@ scc_ErrorCode iscc_get_nng_with_size_constraint(void* const data_set,
 	}
 
 	scc_ErrorCode ec;
-	if ((ec = iscc_make_nng(data_set,
-	                        num_data_points,
-	                        num_data_points,
-	                        NULL,
-	                        num_queries,
-	                        primary_data_points,
-	                        size_constraint,
-	                        radius_constraint,
-	                        radius,
-	                        NULL,
-	                        NULL,
-	                        out_nng)) != SCC_ER_OK) {
+	if ((primary_data_points == NULL) && !radius_constraint && iscc_nnd_is_enabled()) {
+		if ((ec = iscc_nnd_make_nng(data_set,
+		                            num_data_points,
+		                            size_constraint,
+		                            out_nng)) != SCC_ER_OK) {
+			return ec;
+		}
+	} else if ((ec = iscc_make_nng(data_set,
+	                               num_data_points,
+	                               num_data_points,
+	                               NULL,
+	                               num_queries,
+	                               primary_data_points,
+	                               size_constraint,
+	                               radius_constraint,
+	                               radius,
+	                               NULL,
+	                               NULL,
+	                               out_nng)) != SCC_ER_OK) {
 		return ec;
 	}
 
@@ -213,6 +240,45 @@ scc_ErrorCode iscc_get_nng_with_type_constraint(void* const data_set,
 		num_queries = len_primary_data_points;
 	}
 
+	// The brute-force search can find the neighbors of all types in one pass
+	if (iscc_uses_brute_force_nn_search()) {
+		scc_ErrorCode ec;
+		iscc_TypeCount tc;
+		if ((ec = iscc_type_count(num_data_points,
+		                          size_constraint,
+		                          num_types,
+		                          type_constraints,
+		                          type_labels,
+		                          &tc)) != SCC_ER_OK) {
+			return ec;
+		}
+
+		ec = iscc_make_fused_type_nng(data_set,
+		                              num_data_points,
+		                              size_constraint,
+		                              num_types,
+		                              type_constraints,
+		                              type_labels,
+		                              &tc,
+		                              num_queries,
+		                              primary_data_points,
+		                              radius_constraint,
+		                              radius,
+		                              out_nng);
+
+		free(tc.type_group_size);
+		free(tc.point_store);
+		free(tc.type_groups);
+
+		if (ec != SCC_ER_OK) return ec;
+
+		#ifdef SCC_STABLE_NNG
+			iscc_sort_nng(out_nng);
+		#endif // ifdef SCC_STABLE_NNG
+
+		return iscc_no_error();
+	}
+
 	scc_PointIndex* seedable;
 	const scc_PointIndex* seedable_const;
 	if (radius_constraint) {
@@ -282,6 +348,7 @@ scc_ErrorCode iscc_get_nng_with_type_constraint(void* const data_set,
 	free(tc.point_store);
 	free(tc.type_groups);
 
+	const scc_ProfilePhase prev_phase = iscc_profile_enter(SCC_PH_TYPE_UNION);
 	if (ec == SCC_ER_OK) {
 		if (size_constraint > tc.sum_type_constraints) {
 			// If general size constaint (besides type constraints), we need to keep self-loops
@@ -295,6 +362,7 @@ scc_ErrorCode iscc_get_nng_with_type_constraint(void* const data_set,
 		iscc_free_digraph(&nng_by_type[i]);
 	}
 	free(nng_by_type);
+	iscc_profile_enter(prev_phase);
 
 	if (ec != SCC_ER_OK) {
 		// When `ec != SCC_ER_OK`, error is from `iscc_digraph_union_and_delete` so `out_nng` is already freed
@@ -324,6 +392,7 @@ scc_ErrorCode iscc_get_nng_with_type_constraint(void* const data_set,
 			return ec;
 		}
 
+		iscc_profile_enter(SCC_PH_TYPE_UNION);
 		if (iscc_digraph_is_empty(&nng_sum[1])) {
 			ec = iscc_make_error_msg(SCC_ER_NO_SOLUTION, "Infeasible radius constraint.");
 		} else {
@@ -336,6 +405,7 @@ scc_ErrorCode iscc_get_nng_with_type_constraint(void* const data_set,
 
 		iscc_free_digraph(&nng_sum[0]);
 		iscc_free_digraph(&nng_sum[1]);
+		iscc_profile_enter(prev_phase);
 
 		if (ec != SCC_ER_OK) {
 			free(seedable);
@@ -912,6 +982,196 @@ static scc_ErrorCode iscc_type_count(const size_t num_data_points,
 }
 
 
+static inline bool iscc_uses_brute_force_nn_search(void)
+{
+	const iscc_dist_functions_struct* const dist_functions = iscc_get_dist_functions();
+	return (dist_functions->init_nn_search_object == iscc_imp_init_nn_search_object) &&
+	       (dist_functions->nearest_neighbor_search == iscc_imp_nearest_neighbor_search);
+}
+
+
+static scc_ErrorCode iscc_make_fused_type_nng(void* const data_set,
+                                              const size_t num_data_points,
+                                              const uint32_t size_constraint,
+                                              const uint_fast16_t num_types,
+                                              const uint32_t type_constraints[const static num_types],
+                                              const scc_TypeLabel type_labels[const static num_data_points],
+                                              const iscc_TypeCount* const tc,
+                                              const size_t len_query_indices,
+                                              const scc_PointIndex query_indices[const],
+                                              const bool radius_constraint,
+                                              const double radius,
+                                              iscc_Digraph* const out_nng)
+{
+	assert(iscc_uses_brute_force_nn_search());
+	assert(iscc_check_data_set(data_set));
+	assert(num_types >= 2);
+	assert(tc != NULL);
+	assert(tc->sum_type_constraints <= size_constraint);
+	assert(len_query_indices > 0);
+	assert(!radius_constraint || (radius > 0.0));
+	assert(out_nng != NULL);
+
+	// Types without constraints are not searched
+	size_t* const len_search_sets = malloc(sizeof(size_t[num_types]));
+	const scc_PointIndex** const search_sets = malloc(sizeof(const scc_PointIndex*[num_types]));
+	uint32_t* const set_k = malloc(sizeof(uint32_t[num_types]));
+	uint_fast16_t* const type_set = malloc(sizeof(uint_fast16_t[num_types]));
+	if ((len_search_sets == NULL) || (search_sets == NULL) || (set_k == NULL) || (type_set == NULL)) {
+		free(len_search_sets);
+		free(search_sets);
+		free(set_k);
+		free(type_set);
+		return iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+
+	uint_fast16_t num_sets = 0;
+	for (uint_fast16_t i = 0; i < num_types; ++i) {
+		type_set[i] = UINT_FAST16_MAX;
+		if (type_constraints[i] > 0) {
+			len_search_sets[num_sets] = tc->type_group_size[i];
+			search_sets[num_sets] = tc->type_groups[i];
+			set_k[num_sets] = type_constraints[i];
+			type_set[i] = num_sets;
+			++num_sets;
+		}
+	}
+
+	// The general size constraint is filled with the nearest points not already
+	// found for the type constraints, as `iscc_digraph_difference` would do
+	const uint32_t k_all = (size_constraint > tc->sum_type_constraints) ? size_constraint : 0;
+	const uint32_t additional_nn_needed = size_constraint - tc->sum_type_constraints;
+	const size_t k_total = ((size_t) tc->sum_type_constraints) + k_all;
+
+	scc_PointIndex* const ok_queries = malloc(sizeof(scc_PointIndex[len_query_indices]));
+	scc_PointIndex* const nn_indices = malloc(sizeof(scc_PointIndex[len_query_indices * k_total]));
+	scc_PointIndex* const row_markers = malloc(sizeof(scc_PointIndex[num_data_points]));
+	if ((ok_queries == NULL) || (nn_indices == NULL) || (row_markers == NULL)) {
+		free(len_search_sets);
+		free(search_sets);
+		free(set_k);
+		free(type_set);
+		free(ok_queries);
+		free(nn_indices);
+		free(row_markers);
+		return iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+
+	// Counted as one query per search, as if the types were searched separately
+	iscc_profile_count_queries(((uint64_t) len_query_indices) * (num_sets + (k_all > 0)));
+	size_t num_ok_queries = 0;
+	const bool search_ok = iscc_imp_multi_nearest_neighbor_search(data_set,
+	                                                              num_sets,
+	                                                              len_search_sets,
+	                                                              search_sets,
+	                                                              set_k,
+	                                                              k_all,
+	                                                              len_query_indices,
+	                                                              query_indices,
+	                                                              radius_constraint,
+	                                                              radius,
+	                                                              &num_ok_queries,
+	                                                              ok_queries,
+	                                                              nn_indices);
+
+	free(len_search_sets);
+	free(search_sets);
+
+	scc_ErrorCode ec = SCC_ER_OK;
+	if (!search_ok) {
+		ec = iscc_make_error(SCC_ER_DIST_SEARCH_ERROR);
+	} else if (num_ok_queries == 0) {
+		ec = iscc_make_error_msg(SCC_ER_NO_SOLUTION, "Infeasible radius constraint.");
+	}
+
+	const scc_ProfilePhase prev_phase = iscc_profile_enter(SCC_PH_TYPE_UNION);
+	if (ec == SCC_ER_OK) {
+		ec = iscc_init_digraph(num_data_points, num_ok_queries * size_constraint, out_nng);
+	}
+
+	if (ec != SCC_ER_OK) {
+		free(set_k);
+		free(type_set);
+		free(ok_queries);
+		free(nn_indices);
+		free(row_markers);
+		iscc_profile_enter(prev_phase);
+		return ec;
+	}
+
+	for (size_t v = 0; v < num_data_points; ++v) {
+		row_markers[v] = ISCC_POINTINDEX_MAX_PI;
+	}
+
+	iscc_ArcIndex arcs_write = 0;
+	out_nng->tail_ptr[0] = 0;
+	size_t v = 0;
+	for (size_t q = 0; q < num_ok_queries; ++q) {
+		const scc_PointIndex query = ok_queries[q];
+		assert((q == 0) || (ok_queries[q - 1] < query));
+		for (; v < (size_t) query; ++v) {
+			out_nng->tail_ptr[v + 1] = arcs_write;
+		}
+
+		// Union of the type searches, as `iscc_digraph_union_and_delete` would do after
+		// `iscc_ensure_self_match`. Self-loops are kept out of the digraph, but a query
+		// that found itself should not be counted towards the general size constraint.
+		scc_PointIndex* nn = nn_indices + q * k_total;
+		const uint_fast16_t query_set = type_set[type_labels[query]];
+		bool self_in_union = false;
+		for (uint_fast16_t s = 0; s < num_sets; ++s) {
+			if (s == query_set) {
+				uint32_t i = 0;
+				for (; (i < set_k[s]) && (nn[i] != query); ++i);
+				if (i == set_k[s]) nn[i - 1] = query;
+				self_in_union = true;
+			}
+			for (uint32_t i = 0; i < set_k[s]; ++i) {
+				if ((nn[i] != query) && (row_markers[nn[i]] != query)) {
+					row_markers[nn[i]] = query;
+					out_nng->head[arcs_write] = nn[i];
+					++arcs_write;
+				}
+			}
+			nn += set_k[s];
+		}
+
+		uint32_t num_added = 0;
+		for (uint32_t i = 0; (i < k_all) && (num_added < additional_nn_needed); ++i) {
+			if (nn[i] == query) {
+				if (!self_in_union) ++num_added;
+			} else if (row_markers[nn[i]] != query) {
+				row_markers[nn[i]] = query;
+				out_nng->head[arcs_write] = nn[i];
+				++arcs_write;
+				++num_added;
+			}
+		}
+
+		out_nng->tail_ptr[v + 1] = arcs_write;
+		++v;
+	}
+	for (; v < num_data_points; ++v) {
+		out_nng->tail_ptr[v + 1] = arcs_write;
+	}
+
+	free(set_k);
+	free(type_set);
+	free(ok_queries);
+	free(nn_indices);
+	free(row_markers);
+
+	ec = iscc_change_arc_storage(out_nng, arcs_write);
+	iscc_profile_enter(prev_phase);
+	if (ec != SCC_ER_OK) {
+		iscc_free_digraph(out_nng);
+		return ec;
+	}
+
+	return iscc_no_error();
+}
+
+
 static size_t iscc_assign_seeds_and_neighbors(scc_Clustering* const clustering,
                                               const iscc_SeedResult* const seed_result,
                                               iscc_Digraph* const nng)
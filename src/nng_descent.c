@@ -0,0 +1,760 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "nng_descent.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/scclust.h"
+#include "../include/scclust_spi.h"
+#include "digraph_core.h"
+#include "dist_search.h"
+#include "dist_search_imp.h"
+#include "error.h"
+#include "profile.h"
+#include "scclust_types.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Internal structs and variables
+// =============================================================================
+
+typedef struct iscc_NNDParameters {
+	uint32_t max_iterations;
+	double recall_target;
+	bool exact_refinement;
+} iscc_NNDParameters;
+
+
+// Parameters set by `scc_set_nn_descent` in this thread. NN-descent is off when `max_iterations` is zero.
+static ISCC_THREAD_LOCAL iscc_NNDParameters iscc_nnd_parameters = { 0, 1.0, false };
+
+
+// Recall is estimated from the neighbors of this many points
+#define ISCC_NND_RECALL_SAMPLE 100
+
+
+// Distances from the sampled points are calculated in blocks of this many columns
+#define ISCC_NND_SAMPLE_BLOCK 4096
+
+
+// Points keep at least this many neighbors while the graph is improved, as
+// short neighbor lists give few neighbors of neighbors to compare with
+#define ISCC_NND_MIN_LIST_LENGTH 12
+
+
+// Graphs with fewer points than this are not updated in parallel
+#define ISCC_NND_MIN_PARALLEL_POINTS 1024
+
+
+// Neighbors of each point sorted by distance and then by index. `is_new`
+// marks neighbors that have not yet been compared with the neighbors of the point.
+typedef struct iscc_NNDGraph {
+	scc_PointIndex* nn;
+	double* dists;
+	bool* is_new;
+} iscc_NNDGraph;
+
+
+// Points that are compared with the neighbors of each point
+typedef struct iscc_NNDJoinLists {
+	uint32_t* len_rev_new;
+	uint32_t* len_rev_old;
+	scc_PointIndex* rev_new;
+	scc_PointIndex* rev_old;
+} iscc_NNDJoinLists;
+
+
+typedef struct iscc_NNDScratch {
+	size_t num_data_points;
+	uint32_t visit_mark;
+	uint32_t* visited;
+	scc_PointIndex* candidates;
+	double* cand_dists;
+	size_t num_updates;
+	uint64_t num_dists;
+} iscc_NNDScratch;
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static uint64_t iscc_nnd_hash(uint64_t x);
+
+
+static bool iscc_nnd_init_graph(void* data_set,
+                                scc_get_dist_rows get_dist_rows,
+                                size_t num_data_points,
+                                uint32_t k,
+                                size_t num_threads,
+                                iscc_NNDGraph* graph);
+
+
+static bool iscc_nnd_init_point(void* data_set,
+                                scc_get_dist_rows get_dist_rows,
+                                size_t num_data_points,
+                                size_t point,
+                                uint32_t k,
+                                iscc_NNDGraph* graph);
+
+
+static void iscc_nnd_make_join_lists(size_t num_data_points,
+                                     uint32_t k,
+                                     const iscc_NNDGraph* graph,
+                                     iscc_NNDJoinLists* join_lists);
+
+
+static bool iscc_nnd_update_graph(void* data_set,
+                                  scc_get_dist_rows get_dist_rows,
+                                  size_t num_data_points,
+                                  uint32_t k,
+                                  bool refinement,
+                                  size_t num_threads,
+                                  const iscc_NNDGraph* graph,
+                                  iscc_NNDJoinLists* join_lists,
+                                  iscc_NNDScratch scratch[],
+                                  iscc_NNDGraph* out_graph,
+                                  size_t* out_num_updates);
+
+
+static bool iscc_nnd_update_point(void* data_set,
+                                  scc_get_dist_rows get_dist_rows,
+                                  size_t point,
+                                  uint32_t k,
+                                  bool refinement,
+                                  const iscc_NNDGraph* graph,
+                                  const iscc_NNDJoinLists* join_lists,
+                                  iscc_NNDScratch* scratch,
+                                  iscc_NNDGraph* out_graph);
+
+
+static inline size_t iscc_nnd_add_candidates(const scc_PointIndex list[],
+                                             size_t len_list,
+                                             const bool is_new[],
+                                             bool only_new,
+                                             iscc_NNDScratch* scratch,
+                                             size_t num_candidates);
+
+
+static bool iscc_nnd_sample_kth_dists(void* data_set,
+                                      scc_get_dist_rows get_dist_rows,
+                                      size_t num_data_points,
+                                      uint32_t k,
+                                      size_t num_samples,
+                                      double out_kth_dists[]);
+
+
+static double iscc_nnd_estimate_recall(size_t num_data_points,
+                                       uint32_t len_nn,
+                                       uint32_t k,
+                                       size_t num_samples,
+                                       const double kth_dists[],
+                                       const iscc_NNDGraph* graph);
+
+
+static inline bool iscc_nnd_before(double dist1,
+                                   scc_PointIndex index1,
+                                   double dist2,
+                                   scc_PointIndex index2);
+
+
+// =============================================================================
+// Public function implementations
+// =============================================================================
+
+bool scc_set_nn_descent(const uint32_t max_iterations,
+                        const double recall_target,
+                        const bool exact_refinement)
+{
+	if (!(recall_target > 0.0) || (recall_target > 1.0)) return false;
+
+	iscc_nnd_parameters = (iscc_NNDParameters) {
+		.max_iterations = max_iterations,
+		.recall_target = recall_target,
+		.exact_refinement = exact_refinement,
+	};
+
+	return true;
+}
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+bool iscc_nnd_is_enabled(void)
+{
+	return (iscc_nnd_parameters.max_iterations > 0);
+}
+
+
+scc_ErrorCode iscc_nnd_make_nng(void* const data_set,
+                                const size_t num_data_points,
+                                const uint32_t k,
+                                iscc_Digraph* const out_nng)
+{
+	assert(iscc_check_data_set(data_set));
+	assert(iscc_num_data_points(data_set) == num_data_points);
+	assert(k >= 2);
+	assert(k <= num_data_points);
+	assert(out_nng != NULL);
+
+	const iscc_NNDParameters parameters = iscc_nnd_parameters;
+
+	// Points are their own first neighbors, so `k - 1` neighbors are searched for.
+	// The first `num_nn` points in lists of `len_nn` points are used.
+	const uint32_t num_nn = k - 1;
+	uint32_t len_nn = num_nn;
+	if (len_nn < ISCC_NND_MIN_LIST_LENGTH) {
+		len_nn = (num_data_points - 1 < ISCC_NND_MIN_LIST_LENGTH) ? (uint32_t) (num_data_points - 1) : ISCC_NND_MIN_LIST_LENGTH;
+	}
+	const size_t len_lists = num_data_points * len_nn;
+
+	// The built-in distance functions can be called from several threads
+	const scc_get_dist_rows get_dist_rows = iscc_get_dist_functions()->get_dist_rows;
+	size_t num_threads = 1;
+	if ((get_dist_rows == iscc_imp_get_dist_rows) && (num_data_points >= ISCC_NND_MIN_PARALLEL_POINTS)) {
+		num_threads = iscc_get_num_threads();
+	}
+
+	// Each point is compared with at most `3 len_nn` neighbors of at most
+	// `3 len_nn` of its neighbors (see `iscc_nnd_make_join_lists`)
+	size_t max_candidates = num_data_points;
+	if ((len_nn < 0x10000) && (9 * ((size_t) len_nn) * ((size_t) len_nn) < max_candidates)) {
+		max_candidates = 9 * ((size_t) len_nn) * ((size_t) len_nn);
+	}
+
+	const size_t num_samples = (num_data_points < ISCC_NND_RECALL_SAMPLE) ? num_data_points : ISCC_NND_RECALL_SAMPLE;
+
+	iscc_NNDGraph graphs[2] = {
+		{
+			.nn = malloc(sizeof(scc_PointIndex[len_lists])),
+			.dists = malloc(sizeof(double[len_lists])),
+			.is_new = malloc(sizeof(bool[len_lists])),
+		},
+		{
+			.nn = malloc(sizeof(scc_PointIndex[len_lists])),
+			.dists = malloc(sizeof(double[len_lists])),
+			.is_new = malloc(sizeof(bool[len_lists])),
+		},
+	};
+	iscc_NNDJoinLists join_lists = {
+		.len_rev_new = malloc(sizeof(uint32_t[num_data_points])),
+		.len_rev_old = malloc(sizeof(uint32_t[num_data_points])),
+		.rev_new = malloc(sizeof(scc_PointIndex[len_lists])),
+		.rev_old = malloc(sizeof(scc_PointIndex[len_lists])),
+	};
+	iscc_NNDScratch* const scratch = calloc(num_threads, sizeof(iscc_NNDScratch));
+	double* const sample_kth_dists = malloc(sizeof(double[num_samples]));
+
+	bool ok = (graphs[0].nn != NULL) && (graphs[0].dists != NULL) && (graphs[0].is_new != NULL) &&
+	          (graphs[1].nn != NULL) && (graphs[1].dists != NULL) && (graphs[1].is_new != NULL) &&
+	          (join_lists.len_rev_new != NULL) && (join_lists.len_rev_old != NULL) &&
+	          (join_lists.rev_new != NULL) && (join_lists.rev_old != NULL) &&
+	          (scratch != NULL) && (sample_kth_dists != NULL);
+	for (size_t t = 0; ok && (t < num_threads); ++t) {
+		scratch[t] = (iscc_NNDScratch) {
+			.num_data_points = num_data_points,
+			.visit_mark = 0,
+			.visited = calloc(num_data_points, sizeof(uint32_t)),
+			.candidates = malloc(sizeof(scc_PointIndex[max_candidates])),
+			.cand_dists = malloc(sizeof(double[max_candidates])),
+			.num_updates = 0,
+			.num_dists = 0,
+		};
+		ok = (scratch[t].visited != NULL) && (scratch[t].candidates != NULL) && (scratch[t].cand_dists != NULL);
+	}
+
+	scc_ErrorCode ec = ok ? SCC_ER_OK : SCC_ER_NO_MEMORY;
+	size_t current = 0;
+
+	if ((ec == SCC_ER_OK) &&
+	        (!iscc_nnd_init_graph(data_set, get_dist_rows, num_data_points, len_nn, num_threads, &graphs[0]) ||
+	         !iscc_nnd_sample_kth_dists(data_set, get_dist_rows, num_data_points, num_nn, num_samples, sample_kth_dists))) {
+		ec = SCC_ER_DIST_SEARCH_ERROR;
+	}
+
+	for (uint32_t iteration = 0; (ec == SCC_ER_OK) && (iteration < parameters.max_iterations); ++iteration) {
+		if (!(iscc_nnd_estimate_recall(num_data_points, len_nn, num_nn, num_samples, sample_kth_dists,
+		                               &graphs[current]) < parameters.recall_target)) break;
+
+		size_t num_updates;
+		if (!iscc_nnd_update_graph(data_set, get_dist_rows, num_data_points, len_nn, false, num_threads,
+		                           &graphs[current], &join_lists, scratch, &graphs[1 - current], &num_updates)) {
+			ec = SCC_ER_DIST_SEARCH_ERROR;
+		}
+		current = 1 - current;
+
+		// No neighbor can change in later iterations
+		if (num_updates == 0) break;
+	}
+
+	if ((ec == SCC_ER_OK) && parameters.exact_refinement) {
+		size_t num_updates;
+		if (!iscc_nnd_update_graph(data_set, get_dist_rows, num_data_points, len_nn, true, num_threads,
+		                           &graphs[current], &join_lists, scratch, &graphs[1 - current], &num_updates)) {
+			ec = SCC_ER_DIST_SEARCH_ERROR;
+		}
+		current = 1 - current;
+	}
+
+	if ((ec == SCC_ER_OK) && ((ec = iscc_init_digraph(num_data_points, num_data_points * k, out_nng)) == SCC_ER_OK)) {
+		const iscc_NNDGraph* const graph = &graphs[current];
+		out_nng->tail_ptr[0] = 0;
+		scc_PointIndex* head = out_nng->head;
+		for (size_t p = 0; p < num_data_points; ++p) {
+			*head = (scc_PointIndex) p;
+			memcpy(head + 1, graph->nn + p * len_nn, sizeof(scc_PointIndex[num_nn]));
+			head += k;
+			out_nng->tail_ptr[p + 1] = (iscc_ArcIndex) ((p + 1) * k);
+		}
+	}
+
+	if (scratch != NULL) {
+		for (size_t t = 0; t < num_threads; ++t) {
+			free(scratch[t].visited);
+			free(scratch[t].candidates);
+			free(scratch[t].cand_dists);
+		}
+	}
+	free(scratch);
+	free(sample_kth_dists);
+	free(join_lists.len_rev_new);
+	free(join_lists.len_rev_old);
+	free(join_lists.rev_new);
+	free(join_lists.rev_old);
+	for (size_t g = 0; g < 2; ++g) {
+		free(graphs[g].nn);
+		free(graphs[g].dists);
+		free(graphs[g].is_new);
+	}
+
+	if (ec != SCC_ER_OK) return iscc_make_error(ec);
+	return iscc_no_error();
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+// SplitMix64
+static uint64_t iscc_nnd_hash(uint64_t x)
+{
+	x += UINT64_C(0x9E3779B97F4A7C15);
+	x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return x ^ (x >> 31);
+}
+
+
+// Links each point to `k` other points, chosen by hashing the point index so
+// that every build starts from the same graph
+static bool iscc_nnd_init_graph(void* const data_set,
+                                const scc_get_dist_rows get_dist_rows,
+                                const size_t num_data_points,
+                                const uint32_t k,
+                                const size_t num_threads,
+                                iscc_NNDGraph* const graph)
+{
+	bool dist_ok = true;
+	if (num_threads == 1) {
+		for (size_t p = 0; dist_ok && (p < num_data_points); ++p) {
+			dist_ok = iscc_nnd_init_point(data_set, get_dist_rows, num_data_points, p, k, graph);
+		}
+	} else {
+		ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(static) reduction(&&:dist_ok))
+		for (size_t p = 0; p < num_data_points; ++p) {
+			dist_ok = iscc_nnd_init_point(data_set, get_dist_rows, num_data_points, p, k, graph) && dist_ok;
+		}
+	}
+
+	iscc_profile_count_dists(((uint64_t) num_data_points) * k);
+
+	return dist_ok;
+}
+
+
+// The neighbors are spaced by a step that is coprime with `num_data_points - 1`,
+// so they are distinct
+static bool iscc_nnd_init_point(void* const data_set,
+                                const scc_get_dist_rows get_dist_rows,
+                                const size_t num_data_points,
+                                const size_t point,
+                                const uint32_t k,
+                                iscc_NNDGraph* const graph)
+{
+	const size_t num_others = num_data_points - 1;
+	const uint64_t hash = iscc_nnd_hash((uint64_t) point);
+	size_t step = 1 + (size_t) (hash % num_others);
+	for (;;) {
+		size_t a = step;
+		size_t b = num_others;
+		while (b != 0) {
+			const size_t tmp = a % b;
+			a = b;
+			b = tmp;
+		}
+		if (a == 1) break;
+		step = (step == num_others) ? 1 : step + 1;
+	}
+
+	scc_PointIndex* const nn = graph->nn + point * k;
+	double* const dists = graph->dists + point * k;
+	size_t offset = (size_t) (iscc_nnd_hash(hash) % num_others);
+	for (uint32_t i = 0; i < k; ++i) {
+		nn[i] = (scc_PointIndex) ((point + 1 + offset) % num_data_points);
+		graph->is_new[point * k + i] = true;
+		offset = (offset + step) % num_others;
+	}
+
+	const scc_PointIndex query = (scc_PointIndex) point;
+	if (!get_dist_rows(data_set, 1, &query, k, nn, dists)) return false;
+
+	// Insertion sort, the lists are short
+	for (uint32_t i = 1; i < k; ++i) {
+		const scc_PointIndex tmp_nn = nn[i];
+		const double tmp_dist = dists[i];
+		uint32_t j = i;
+		for (; (j > 0) && iscc_nnd_before(tmp_dist, tmp_nn, dists[j - 1], nn[j - 1]); --j) {
+			nn[j] = nn[j - 1];
+			dists[j] = dists[j - 1];
+		}
+		nn[j] = tmp_nn;
+		dists[j] = tmp_dist;
+	}
+
+	return true;
+}
+
+
+// A point is compared with the points that it links to and that link to it.
+// At most `k` points that link to each point are kept, so that points that
+// are neighbors of many points do not make the joins slow.
+static void iscc_nnd_make_join_lists(const size_t num_data_points,
+                                     const uint32_t k,
+                                     const iscc_NNDGraph* const graph,
+                                     iscc_NNDJoinLists* const join_lists)
+{
+	memset(join_lists->len_rev_new, 0, sizeof(uint32_t[num_data_points]));
+	memset(join_lists->len_rev_old, 0, sizeof(uint32_t[num_data_points]));
+
+	for (size_t p = 0; p < num_data_points; ++p) {
+		for (size_t i = p * k; i < (p + 1) * k; ++i) {
+			const size_t q = (size_t) graph->nn[i];
+			if (graph->is_new[i]) {
+				if (join_lists->len_rev_new[q] < k) {
+					join_lists->rev_new[q * k + join_lists->len_rev_new[q]] = (scc_PointIndex) p;
+					++(join_lists->len_rev_new[q]);
+				}
+			} else if (join_lists->len_rev_old[q] < k) {
+				join_lists->rev_old[q * k + join_lists->len_rev_old[q]] = (scc_PointIndex) p;
+				++(join_lists->len_rev_old[q]);
+			}
+		}
+	}
+}
+
+
+// Writes the graph of the next iteration to `out_graph`. Each point's
+// neighbors depend only on `graph`, so the points are updated in parallel.
+static bool iscc_nnd_update_graph(void* const data_set,
+                                  const scc_get_dist_rows get_dist_rows,
+                                  const size_t num_data_points,
+                                  const uint32_t k,
+                                  const bool refinement,
+                                  const size_t num_threads,
+                                  const iscc_NNDGraph* const graph,
+                                  iscc_NNDJoinLists* const join_lists,
+                                  iscc_NNDScratch scratch[const],
+                                  iscc_NNDGraph* const out_graph,
+                                  size_t* const out_num_updates)
+{
+	iscc_nnd_make_join_lists(num_data_points, k, graph, join_lists);
+
+	for (size_t t = 0; t < num_threads; ++t) {
+		scratch[t].num_updates = 0;
+		scratch[t].num_dists = 0;
+	}
+
+	bool dist_ok = true;
+	if (num_threads == 1) {
+		for (size_t p = 0; dist_ok && (p < num_data_points); ++p) {
+			dist_ok = iscc_nnd_update_point(data_set, get_dist_rows, p, k, refinement, graph,
+			                                join_lists, &scratch[0], out_graph);
+		}
+	} else {
+		ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 64) reduction(&&:dist_ok))
+		for (size_t p = 0; p < num_data_points; ++p) {
+			dist_ok = iscc_nnd_update_point(data_set, get_dist_rows, p, k, refinement, graph,
+			                                join_lists, &scratch[iscc_get_thread_num()], out_graph) && dist_ok;
+		}
+	}
+
+	*out_num_updates = 0;
+	uint64_t num_dists = 0;
+	for (size_t t = 0; t < num_threads; ++t) {
+		*out_num_updates += scratch[t].num_updates;
+		num_dists += scratch[t].num_dists;
+	}
+	iscc_profile_count_dists(num_dists);
+
+	return dist_ok;
+}
+
+
+// Writes the neighbors of `point` in the next iteration to `out_graph`. The
+// point is compared with the neighbors of its neighbors: with all neighbors of
+// its new neighbors, and with the new neighbors of its old neighbors, as pairs
+// of old neighbors were compared in earlier iterations. In the refinement,
+// the point is compared with all neighbors of its neighbors.
+static bool iscc_nnd_update_point(void* const data_set,
+                                  const scc_get_dist_rows get_dist_rows,
+                                  const size_t point,
+                                  const uint32_t k,
+                                  const bool refinement,
+                                  const iscc_NNDGraph* const graph,
+                                  const iscc_NNDJoinLists* const join_lists,
+                                  iscc_NNDScratch* const scratch,
+                                  iscc_NNDGraph* const out_graph)
+{
+	++(scratch->visit_mark);
+	if (scratch->visit_mark == 0) {
+		memset(scratch->visited, 0, sizeof(uint32_t[scratch->num_data_points]));
+		scratch->visit_mark = 1;
+	}
+
+	// The point and its current neighbors are not candidates
+	scratch->visited[point] = scratch->visit_mark;
+	const scc_PointIndex* const nn = graph->nn + point * k;
+	const bool* const nn_is_new = graph->is_new + point * k;
+	for (uint32_t i = 0; i < k; ++i) {
+		scratch->visited[nn[i]] = scratch->visit_mark;
+	}
+
+	size_t num_candidates = 0;
+	for (size_t side = 0; side < 3; ++side) {
+		// Own neighbors, and points linking to the point with new and old links
+		const scc_PointIndex* list = nn;
+		size_t len_list = k;
+		if (side == 1) {
+			list = join_lists->rev_new + point * k;
+			len_list = join_lists->len_rev_new[point];
+		} else if (side == 2) {
+			list = join_lists->rev_old + point * k;
+			len_list = join_lists->len_rev_old[point];
+		}
+
+		for (size_t i = 0; i < len_list; ++i) {
+			const size_t u = (size_t) list[i];
+			const bool u_is_new = refinement || ((side == 0) ? nn_is_new[i] : (side == 1));
+			const bool only_new = !u_is_new;
+
+			num_candidates = iscc_nnd_add_candidates(graph->nn + u * k, k, graph->is_new + u * k,
+			                                         only_new, scratch, num_candidates);
+			num_candidates = iscc_nnd_add_candidates(join_lists->rev_new + u * k, join_lists->len_rev_new[u], NULL,
+			                                         false, scratch, num_candidates);
+			if (!only_new) {
+				num_candidates = iscc_nnd_add_candidates(join_lists->rev_old + u * k, join_lists->len_rev_old[u], NULL,
+				                                         false, scratch, num_candidates);
+			}
+		}
+	}
+
+	scc_PointIndex* const out_nn = out_graph->nn + point * k;
+	double* const out_dists = out_graph->dists + point * k;
+	bool* const out_is_new = out_graph->is_new + point * k;
+	memcpy(out_nn, nn, sizeof(scc_PointIndex[k]));
+	memcpy(out_dists, graph->dists + point * k, sizeof(double[k]));
+	// The current neighbors have now been compared with each other
+	for (uint32_t i = 0; i < k; ++i) {
+		out_is_new[i] = false;
+	}
+
+	if (num_candidates == 0) return true;
+
+	const scc_PointIndex query = (scc_PointIndex) point;
+	if (!get_dist_rows(data_set, 1, &query, num_candidates, scratch->candidates, scratch->cand_dists)) return false;
+	scratch->num_dists += num_candidates;
+
+	for (size_t c = 0; c < num_candidates; ++c) {
+		const scc_PointIndex candidate = scratch->candidates[c];
+		const double dist = scratch->cand_dists[c];
+		if (!iscc_nnd_before(dist, candidate, out_dists[k - 1], out_nn[k - 1])) continue;
+
+		uint32_t j = k - 1;
+		for (; (j > 0) && iscc_nnd_before(dist, candidate, out_dists[j - 1], out_nn[j - 1]); --j) {
+			out_nn[j] = out_nn[j - 1];
+			out_dists[j] = out_dists[j - 1];
+			out_is_new[j] = out_is_new[j - 1];
+		}
+		out_nn[j] = candidate;
+		out_dists[j] = dist;
+		out_is_new[j] = true;
+		++(scratch->num_updates);
+	}
+
+	return true;
+}
+
+
+// Adds the points in `list` that are not yet visited as candidates. If
+// `only_new`, only points marked in `is_new` are added; if `is_new` is `NULL`,
+// all points are new.
+static inline size_t iscc_nnd_add_candidates(const scc_PointIndex list[const],
+                                             const size_t len_list,
+                                             const bool is_new[const],
+                                             const bool only_new,
+                                             iscc_NNDScratch* const scratch,
+                                             size_t num_candidates)
+{
+	for (size_t i = 0; i < len_list; ++i) {
+		if (only_new && (is_new != NULL) && !is_new[i]) continue;
+		const scc_PointIndex candidate = list[i];
+		if (scratch->visited[candidate] == scratch->visit_mark) continue;
+		scratch->visited[candidate] = scratch->visit_mark;
+		scratch->candidates[num_candidates] = candidate;
+		++num_candidates;
+	}
+	return num_candidates;
+}
+
+
+// Finds the exact distance to the `k`th nearest other point of each sampled
+// point. Points are sampled evenly over the data set.
+static bool iscc_nnd_sample_kth_dists(void* const data_set,
+                                      const scc_get_dist_rows get_dist_rows,
+                                      const size_t num_data_points,
+                                      const uint32_t k,
+                                      const size_t num_samples,
+                                      double out_kth_dists[const])
+{
+	const size_t block_size = (num_data_points < ISCC_NND_SAMPLE_BLOCK) ? num_data_points : ISCC_NND_SAMPLE_BLOCK;
+
+	scc_PointIndex* const samples = malloc(sizeof(scc_PointIndex[num_samples]));
+	scc_PointIndex* const columns = malloc(sizeof(scc_PointIndex[block_size]));
+	double* const block_dists = malloc(sizeof(double[num_samples * block_size]));
+	// The `k` smallest distances of each sample are kept in a max-heap
+	double* const heaps = malloc(sizeof(double[num_samples * k]));
+	size_t* const len_heaps = calloc(num_samples, sizeof(size_t));
+	if ((samples == NULL) || (columns == NULL) || (block_dists == NULL) || (heaps == NULL) || (len_heaps == NULL)) {
+		free(samples);
+		free(columns);
+		free(block_dists);
+		free(heaps);
+		free(len_heaps);
+		return false;
+	}
+
+	for (size_t s = 0; s < num_samples; ++s) {
+		samples[s] = (scc_PointIndex) ((s * num_data_points) / num_samples);
+	}
+
+	bool dist_ok = true;
+	for (size_t begin = 0; dist_ok && (begin < num_data_points); begin += block_size) {
+		const size_t len_block = (num_data_points - begin < block_size) ? num_data_points - begin : block_size;
+		for (size_t c = 0; c < len_block; ++c) {
+			columns[c] = (scc_PointIndex) (begin + c);
+		}
+		dist_ok = get_dist_rows(data_set, num_samples, samples, len_block, columns, block_dists);
+
+		for (size_t s = 0; dist_ok && (s < num_samples); ++s) {
+			double* const heap = heaps + s * k;
+			size_t len_heap = len_heaps[s];
+			for (size_t c = 0; c < len_block; ++c) {
+				if (begin + c == (size_t) samples[s]) continue;
+				const double dist = block_dists[s * len_block + c];
+				if (len_heap == k) {
+					if (!(dist < heap[0])) continue;
+					// Replace the largest distance
+					size_t i = 0;
+					for (;;) {
+						size_t child = 2 * i + 1;
+						if (child >= k) break;
+						if ((child + 1 < k) && (heap[child + 1] > heap[child])) ++child;
+						if (!(heap[child] > dist)) break;
+						heap[i] = heap[child];
+						i = child;
+					}
+					heap[i] = dist;
+				} else {
+					size_t i = len_heap;
+					++len_heap;
+					while ((i > 0) && (heap[(i - 1) / 2] < dist)) {
+						heap[i] = heap[(i - 1) / 2];
+						i = (i - 1) / 2;
+					}
+					heap[i] = dist;
+				}
+			}
+			len_heaps[s] = len_heap;
+		}
+	}
+
+	iscc_profile_count_dists(((uint64_t) num_samples) * num_data_points);
+
+	for (size_t s = 0; s < num_samples; ++s) {
+		out_kth_dists[s] = heaps[s * k];
+	}
+
+	free(samples);
+	free(columns);
+	free(block_dists);
+	free(heaps);
+	free(len_heaps);
+
+	return dist_ok;
+}
+
+
+// Share of the first `k` neighbors of the sampled points that are at most as
+// far away as their `k`th nearest other points
+static double iscc_nnd_estimate_recall(const size_t num_data_points,
+                                       const uint32_t len_nn,
+                                       const uint32_t k,
+                                       const size_t num_samples,
+                                       const double kth_dists[const],
+                                       const iscc_NNDGraph* const graph)
+{
+	size_t num_found = 0;
+	for (size_t s = 0; s < num_samples; ++s) {
+		const size_t point = (s * num_data_points) / num_samples;
+		for (size_t i = point * len_nn; i < point * len_nn + k; ++i) {
+			if (!(graph->dists[i] > kth_dists[s])) ++num_found;
+		}
+	}
+	return ((double) num_found) / ((double) (num_samples * k));
+}
+
+
+// Whether (dist1, index1) is ordered before (dist2, index2)
+static inline bool iscc_nnd_before(const double dist1,
+                                   const scc_PointIndex index1,
+                                   const double dist2,
+                                   const scc_PointIndex index2)
+{
+	return (dist1 < dist2) || (!(dist1 > dist2) && (index1 < index2));
+}
@@ -0,0 +1,78 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+/** @file
+ *
+ *  Approximate nearest neighbor graphs by NN-descent.
+ *
+ *  NN-descent starts from a random graph and improves it by comparing each
+ *  point with the neighbors of its neighbors. Distances are calculated with
+ *  the `get_dist_rows` distance function, so no search object is built, and
+ *  the method works with any data set. Each point's new neighbors depend only
+ *  on the graph of the previous iteration, so the points are updated in
+ *  parallel and the graph does not depend on the number of threads.
+ */
+
+#ifndef SCC_NNG_DESCENT_HG
+#define SCC_NNG_DESCENT_HG
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/scclust.h"
+#include "digraph_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/// Whether NN-descent is turned on with `scc_set_nn_descent`.
+bool iscc_nnd_is_enabled(void);
+
+
+/** Builds an approximate nearest neighbor graph of all data points by NN-descent.
+ *
+ *  Each point has an arc to itself and to `k - 1` other points, as in the graphs
+ *  made by nearest neighbor searches with the data points as both queries and
+ *  search points.
+ *
+ *  \param[in] data_set the data set.
+ *  \param num_data_points number of data points in \p data_set.
+ *  \param k number of arcs of each point. Must be between 2 and \p num_data_points.
+ *  \param[out] out_nng the graph.
+ *
+ *  \return #SCC_ER_OK if the graph was built, otherwise an error code.
+ */
+scc_ErrorCode iscc_nnd_make_nng(void* data_set,
+                                size_t num_data_points,
+                                uint32_t k,
+                                iscc_Digraph* out_nng);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_NNG_DESCENT_HG
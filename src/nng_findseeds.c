@@ -23,12 +23,27 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "../include/scclust.h"
 #include "digraph_core.h"
 #include "digraph_operations.h"
 #include "error.h"
 #include "scclust_types.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Internal variables
+// =============================================================================
+
+// Independent sets of graphs with fewer vertices than this are found by one thread
+#define ISCC_FS_MIN_PARALLEL_VERTICES 512
+
+// Vertex states when finding independent sets
+#define ISCC_FS_MIS_ACTIVE 0
+#define ISCC_FS_MIS_EXCLUDED 1
+#define ISCC_FS_MIS_SEED 2
 
 
 // =============================================================================
@@ -61,6 +76,41 @@ static scc_ErrorCode iscc_findseeds_exclusion(const iscc_Digraph* nng,
                                               iscc_SeedResult* out_seeds);
 
 
+static scc_ErrorCode iscc_findseeds_exclusion_implicit(const iscc_Digraph* nng,
+                                                       bool updating,
+                                                       iscc_SeedResult* out_seeds);
+
+
+static inline size_t iscc_fs_implicit_exclusion_row(scc_PointIndex v,
+                                                    const iscc_Digraph* nng,
+                                                    const iscc_Digraph* nng_transpose,
+                                                    scc_PointIndex row_markers[restrict],
+                                                    scc_PointIndex out_row[restrict]);
+
+
+static scc_ErrorCode iscc_findseeds_parallel_mis(const iscc_Digraph* nng,
+                                                 iscc_SeedResult* out_seeds);
+
+
+static inline uint64_t iscc_fs_mis_priority(scc_PointIndex v);
+
+
+static inline bool iscc_fs_mis_neighbor_blocks(scc_PointIndex w,
+                                               scc_PointIndex v,
+                                               uint64_t v_priority,
+                                               const unsigned char status[],
+                                               const bool selected[],
+                                               bool after_selection);
+
+
+static inline bool iscc_fs_mis_blocked(scc_PointIndex v,
+                                       const iscc_Digraph* nng,
+                                       const iscc_Digraph* nng_transpose,
+                                       const unsigned char status[],
+                                       const bool selected[],
+                                       bool after_selection);
+
+
 static scc_ErrorCode iscc_fs_exclusion_graph(const iscc_Digraph* nng,
                                              size_t len_not_excluded,
                                              const scc_PointIndex not_excluded[],
@@ -89,6 +139,12 @@ static scc_ErrorCode iscc_fs_sort_by_inwards(const iscc_Digraph* nng,
                                              iscc_fs_SortResult* out_sort);
 
 
+static scc_ErrorCode iscc_fs_sort_by_count(size_t vertices,
+                                           scc_PointIndex inwards_count[],
+                                           bool make_indices,
+                                           iscc_fs_SortResult* out_sort);
+
+
 static inline void iscc_fs_decrease_v_in_sort(scc_PointIndex v_to_decrease,
                                               scc_PointIndex inwards_count[restrict],
                                               scc_PointIndex* vertex_index[restrict],
@@ -153,6 +209,18 @@ scc_ErrorCode iscc_find_seeds(const iscc_Digraph* const nng,
 			ec = iscc_findseeds_exclusion(nng, true, out_seeds);
 			break;
 
+		case SCC_SM_EXCLUSION_ORDER_IMPLICIT:
+			ec = iscc_findseeds_exclusion_implicit(nng, false, out_seeds);
+			break;
+
+		case SCC_SM_EXCLUSION_UPDATING_IMPLICIT:
+			ec = iscc_findseeds_exclusion_implicit(nng, true, out_seeds);
+			break;
+
+		case SCC_SM_PARALLEL_MIS:
+			ec = iscc_findseeds_parallel_mis(nng, out_seeds);
+			break;
+
 		default:
 			assert(false);
 			ec = iscc_make_error(SCC_ER_UNKNOWN_ERROR);
@@ -437,6 +505,372 @@ static scc_ErrorCode iscc_findseeds_exclusion(const iscc_Digraph* const nng,
 }
 
 
+/* Same seeds as `iscc_findseeds_exclusion`, but the exclusion graph is never
+ * stored. Instead, rows of the graph are derived from the NNG and its transpose
+ * when needed, in the same order as in `iscc_fs_exclusion_graph`. Besides the
+ * NNG, memory use is thus a transpose of the NNG and a few arrays of length
+ * `vertices`. Each row is derived twice (once when counting and once when
+ * finding seeds), so this is slower when the exclusion graph fits in memory.
+ */
+static scc_ErrorCode iscc_findseeds_exclusion_implicit(const iscc_Digraph* const nng,
+                                                       const bool updating,
+                                                       iscc_SeedResult* const out_seeds)
+{
+	assert(iscc_digraph_is_valid(nng));
+	assert(!iscc_digraph_is_empty(nng));
+	assert(nng->vertices > 1);
+	assert(out_seeds != NULL);
+	assert(out_seeds->capacity > 0);
+	assert(out_seeds->count == 0);
+	assert(out_seeds->seeds == NULL);
+
+	const size_t vertices = nng->vertices;
+	assert(vertices <= ISCC_POINTINDEX_MAX);
+	const scc_PointIndex vertices_pi = (scc_PointIndex) vertices; // If `scc_PointIndex` is signed
+
+	scc_ErrorCode ec;
+	iscc_Digraph nng_transpose;
+	if ((ec = iscc_digraph_transpose(nng, &nng_transpose)) != SCC_ER_OK) return ec;
+
+	bool* const not_excluded = malloc(sizeof(bool[vertices]));
+	scc_PointIndex* const row_markers = malloc(sizeof(scc_PointIndex[vertices]));
+	scc_PointIndex* const row = malloc(sizeof(scc_PointIndex[vertices]));
+	scc_PointIndex* const inwards_count = calloc(vertices, sizeof(scc_PointIndex));
+	if ((not_excluded == NULL) || (row_markers == NULL) || (row == NULL) || (inwards_count == NULL)) {
+		iscc_free_digraph(&nng_transpose);
+		free(not_excluded);
+		free(row_markers);
+		free(row);
+		free(inwards_count);
+		return iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+
+	// Vertices without arcs are excluded from the beginning, and their rows
+	// in the exclusion graph are empty
+	for (scc_PointIndex v = 0; v < vertices_pi; ++v) {
+		not_excluded[v] = (nng->tail_ptr[v] != nng->tail_ptr[v + 1]);
+		row_markers[v] = ISCC_POINTINDEX_MAX_PI;
+	}
+
+	for (scc_PointIndex v = 0; v < vertices_pi; ++v) {
+		if (not_excluded[v]) {
+			const size_t row_length = iscc_fs_implicit_exclusion_row(v, nng, &nng_transpose, row_markers, row);
+			for (size_t i = 0; i < row_length; ++i) {
+				++inwards_count[row[i]];
+			}
+		}
+	}
+
+	// Each row is derived at most once below, so the markers must be reset
+	for (scc_PointIndex v = 0; v < vertices_pi; ++v) {
+		row_markers[v] = ISCC_POINTINDEX_MAX_PI;
+	}
+
+	iscc_fs_SortResult sort;
+	if ((ec = iscc_fs_sort_by_count(vertices, inwards_count, updating, &sort)) != SCC_ER_OK) {
+		iscc_free_digraph(&nng_transpose);
+		free(not_excluded);
+		free(row_markers);
+		free(row);
+		return ec;
+	}
+
+	// Vertices excluded by the current seed, whose counts must be updated
+	scc_PointIndex* newly_excluded = NULL;
+	if (updating) {
+		newly_excluded = malloc(sizeof(scc_PointIndex[vertices]));
+	}
+	out_seeds->seeds = malloc(sizeof(scc_PointIndex[out_seeds->capacity]));
+	if ((updating && (newly_excluded == NULL)) || (out_seeds->seeds == NULL)) {
+		iscc_free_digraph(&nng_transpose);
+		free(not_excluded);
+		free(row_markers);
+		free(row);
+		iscc_fs_free_sort_result(&sort);
+		free(newly_excluded);
+		free(out_seeds->seeds);
+		out_seeds->seeds = NULL;
+		return iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+
+	const scc_PointIndex* const sorted_v_stop = sort.sorted_vertices + vertices;
+	for (scc_PointIndex* sorted_v = sort.sorted_vertices;
+	        sorted_v != sorted_v_stop; ++sorted_v) {
+
+		#if defined(SCC_STABLE_FINDSEED) && !defined(NDEBUG)
+			if (updating) iscc_fs_debug_check_sort(sorted_v, sorted_v_stop - 1, sort.inwards_count);
+		#endif
+
+		if (not_excluded[*sorted_v]) {
+			assert(nng->tail_ptr[*sorted_v] != nng->tail_ptr[*sorted_v + 1]);
+
+			if ((ec = iscc_fs_add_seed(*sorted_v, out_seeds)) != SCC_ER_OK) {
+				iscc_free_digraph(&nng_transpose);
+				free(not_excluded);
+				free(row_markers);
+				free(row);
+				iscc_fs_free_sort_result(&sort);
+				free(newly_excluded);
+				free(out_seeds->seeds);
+				return ec;
+			}
+
+			not_excluded[*sorted_v] = false;
+
+			const size_t row_length = iscc_fs_implicit_exclusion_row(*sorted_v, nng, &nng_transpose, row_markers, row);
+
+			if (!updating) {
+				for (size_t i = 0; i < row_length; ++i) {
+					not_excluded[row[i]] = false;
+				}
+
+			} else {
+				// See `iscc_findseeds_exclusion`
+				size_t num_newly_excluded = 0;
+				for (size_t i = 0; i < row_length; ++i) {
+					if (not_excluded[row[i]]) {
+						newly_excluded[num_newly_excluded] = row[i];
+						++num_newly_excluded;
+					}
+					not_excluded[row[i]] = false;
+				}
+
+				for (size_t e = 0; e < num_newly_excluded; ++e) {
+					const size_t ex_row_length = iscc_fs_implicit_exclusion_row(newly_excluded[e], nng, &nng_transpose, row_markers, row);
+					for (size_t i = 0; i < ex_row_length; ++i) {
+						if (not_excluded[row[i]]) {
+							iscc_fs_decrease_v_in_sort(row[i], sort.inwards_count, sort.vertex_index, sort.bucket_index, sorted_v);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	iscc_free_digraph(&nng_transpose);
+	free(not_excluded);
+	free(row_markers);
+	free(row);
+	iscc_fs_free_sort_result(&sort);
+	free(newly_excluded);
+
+	return iscc_no_error();
+}
+
+
+static inline size_t iscc_fs_implicit_exclusion_row(const scc_PointIndex v,
+                                                    const iscc_Digraph* const nng,
+                                                    const iscc_Digraph* const nng_transpose,
+                                                    scc_PointIndex row_markers[restrict const],
+                                                    scc_PointIndex out_row[restrict const])
+{
+	// Arcs are visited in the order `iscc_fs_exclusion_graph` writes them: first
+	// `nng`, then `nng * nng_transpose` with forced loops. `row_markers[x] == v`
+	// if `x` already is in the row.
+	size_t count = 0;
+	row_markers[v] = v;
+
+	const scc_PointIndex* const v_arc_stop = nng->head + nng->tail_ptr[v + 1];
+	for (const scc_PointIndex* v_arc = nng->head + nng->tail_ptr[v];
+	        v_arc != v_arc_stop; ++v_arc) {
+		if (row_markers[*v_arc] != v) {
+			row_markers[*v_arc] = v;
+			out_row[count] = *v_arc;
+			++count;
+		}
+	}
+
+	const scc_PointIndex* const v_arc_t_stop = nng_transpose->head + nng_transpose->tail_ptr[v + 1];
+	for (const scc_PointIndex* v_arc_t = nng_transpose->head + nng_transpose->tail_ptr[v];
+	        v_arc_t != v_arc_t_stop; ++v_arc_t) {
+		if (row_markers[*v_arc_t] != v) {
+			row_markers[*v_arc_t] = v;
+			out_row[count] = *v_arc_t;
+			++count;
+		}
+	}
+
+	for (const scc_PointIndex* v_arc = nng->head + nng->tail_ptr[v];
+	        v_arc != v_arc_stop; ++v_arc) {
+		const scc_PointIndex* const arc_t_stop = nng_transpose->head + nng_transpose->tail_ptr[*v_arc + 1];
+		for (const scc_PointIndex* arc_t = nng_transpose->head + nng_transpose->tail_ptr[*v_arc];
+		        arc_t != arc_t_stop; ++arc_t) {
+			if (row_markers[*arc_t] != v) {
+				row_markers[*arc_t] = v;
+				out_row[count] = *arc_t;
+				++count;
+			}
+		}
+	}
+
+	return count;
+}
+
+
+/* Finds a maximal independent set in the exclusion graph in rounds. Each vertex
+ * has a fixed pseudo-random priority derived from its ID. In each round, every
+ * active vertex whose active neighbors all have lower priority (i.e., higher
+ * `iscc_fs_mis_priority`) becomes a seed, and the neighbors of the new seeds are
+ * excluded. The result is the same as adding seeds greedily in priority order,
+ * so it does not depend on the number of threads.
+ *
+ * Each round is two passes over the vertices. In the first, vertices only write
+ * to `selected`, and in the second, they only write to `status` and only read
+ * `selected` of other vertices. Rows of the exclusion graph are derived from the
+ * NNG as in `iscc_findseeds_exclusion_implicit`, but without removing duplicates.
+ */
+static scc_ErrorCode iscc_findseeds_parallel_mis(const iscc_Digraph* const nng,
+                                                 iscc_SeedResult* const out_seeds)
+{
+	assert(iscc_digraph_is_valid(nng));
+	assert(!iscc_digraph_is_empty(nng));
+	assert(nng->vertices > 1);
+	assert(out_seeds != NULL);
+	assert(out_seeds->capacity > 0);
+	assert(out_seeds->count == 0);
+	assert(out_seeds->seeds == NULL);
+
+	const size_t vertices = nng->vertices;
+	assert(vertices <= ISCC_POINTINDEX_MAX);
+
+	uint32_t num_threads = iscc_get_num_threads();
+	if (vertices < ISCC_FS_MIN_PARALLEL_VERTICES) {
+		num_threads = 1;
+	}
+	(void) num_threads; // Unused without OpenMP
+
+	scc_ErrorCode ec;
+	iscc_Digraph nng_transpose;
+	if ((ec = iscc_digraph_transpose(nng, &nng_transpose)) != SCC_ER_OK) return ec;
+
+	unsigned char* const status = malloc(sizeof(unsigned char[vertices]));
+	bool* const selected = malloc(sizeof(bool[vertices]));
+	out_seeds->seeds = malloc(sizeof(scc_PointIndex[out_seeds->capacity]));
+	if ((status == NULL) || (selected == NULL) || (out_seeds->seeds == NULL)) {
+		iscc_free_digraph(&nng_transpose);
+		free(status);
+		free(selected);
+		free(out_seeds->seeds);
+		out_seeds->seeds = NULL;
+		return iscc_make_error(SCC_ER_NO_MEMORY);
+	}
+
+	size_t num_active = 0;
+	for (size_t v = 0; v < vertices; ++v) {
+		if (nng->tail_ptr[v] != nng->tail_ptr[v + 1]) {
+			status[v] = ISCC_FS_MIS_ACTIVE;
+			++num_active;
+		} else {
+			status[v] = ISCC_FS_MIS_EXCLUDED;
+		}
+		selected[v] = false;
+	}
+
+	while (num_active > 0) {
+		ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 256))
+		for (size_t v = 0; v < vertices; ++v) {
+			selected[v] = (status[v] == ISCC_FS_MIS_ACTIVE) &&
+			              !iscc_fs_mis_blocked((scc_PointIndex) v, nng, &nng_transpose, status, selected, false);
+		}
+
+		num_active = 0;
+		ISCC_OMP_PRAGMA(omp parallel for num_threads((int) num_threads) schedule(dynamic, 256) reduction(+:num_active))
+		for (size_t v = 0; v < vertices; ++v) {
+			if (status[v] == ISCC_FS_MIS_ACTIVE) {
+				if (selected[v]) {
+					status[v] = ISCC_FS_MIS_SEED;
+				} else if (iscc_fs_mis_blocked((scc_PointIndex) v, nng, &nng_transpose, status, selected, true)) {
+					status[v] = ISCC_FS_MIS_EXCLUDED;
+				} else {
+					++num_active;
+				}
+			}
+		}
+	}
+
+	iscc_free_digraph(&nng_transpose);
+	free(selected);
+
+	for (size_t v = 0; v < vertices; ++v) {
+		if (status[v] == ISCC_FS_MIS_SEED) {
+			if ((ec = iscc_fs_add_seed((scc_PointIndex) v, out_seeds)) != SCC_ER_OK) {
+				free(status);
+				free(out_seeds->seeds);
+				return ec;
+			}
+		}
+	}
+
+	free(status);
+
+	return iscc_no_error();
+}
+
+
+// SplitMix64 finalizer; lower values have higher priority
+static inline uint64_t iscc_fs_mis_priority(const scc_PointIndex v)
+{
+	uint64_t z = ((uint64_t) v) + UINT64_C(0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return z ^ (z >> 31);
+}
+
+
+// Returns `true` if neighbor `w` blocks `v`; see `iscc_fs_mis_blocked`
+static inline bool iscc_fs_mis_neighbor_blocks(const scc_PointIndex w,
+                                               const scc_PointIndex v,
+                                               const uint64_t v_priority,
+                                               const unsigned char status[const],
+                                               const bool selected[const],
+                                               const bool after_selection)
+{
+	if (w == v) return false;
+	if (after_selection) return selected[w];
+	if (status[w] != ISCC_FS_MIS_ACTIVE) return false;
+	const uint64_t w_priority = iscc_fs_mis_priority(w);
+	return (w_priority < v_priority) || ((w_priority == v_priority) && (w < v));
+}
+
+
+/* Checks the neighbors of `v` in the exclusion graph. Before selection, `v` is
+ * blocked if an active neighbor has higher priority. After selection, `v` is
+ * blocked (i.e., excluded) if a neighbor was selected.
+ */
+static inline bool iscc_fs_mis_blocked(const scc_PointIndex v,
+                                       const iscc_Digraph* const nng,
+                                       const iscc_Digraph* const nng_transpose,
+                                       const unsigned char status[const],
+                                       const bool selected[const],
+                                       const bool after_selection)
+{
+	const uint64_t v_priority = after_selection ? 0 : iscc_fs_mis_priority(v);
+
+	const scc_PointIndex* const v_arc_stop = nng->head + nng->tail_ptr[v + 1];
+	for (const scc_PointIndex* v_arc = nng->head + nng->tail_ptr[v];
+	        v_arc != v_arc_stop; ++v_arc) {
+		if (iscc_fs_mis_neighbor_blocks(*v_arc, v, v_priority, status, selected, after_selection)) return true;
+	}
+
+	const scc_PointIndex* const v_arc_t_stop = nng_transpose->head + nng_transpose->tail_ptr[v + 1];
+	for (const scc_PointIndex* v_arc_t = nng_transpose->head + nng_transpose->tail_ptr[v];
+	        v_arc_t != v_arc_t_stop; ++v_arc_t) {
+		if (iscc_fs_mis_neighbor_blocks(*v_arc_t, v, v_priority, status, selected, after_selection)) return true;
+	}
+
+	for (const scc_PointIndex* v_arc = nng->head + nng->tail_ptr[v];
+	        v_arc != v_arc_stop; ++v_arc) {
+		const scc_PointIndex* const arc_t_stop = nng_transpose->head + nng_transpose->tail_ptr[*v_arc + 1];
+		for (const scc_PointIndex* arc_t = nng_transpose->head + nng_transpose->tail_ptr[*v_arc];
+		        arc_t != arc_t_stop; ++arc_t) {
+			if (iscc_fs_mis_neighbor_blocks(*arc_t, v, v_priority, status, selected, after_selection)) return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
 Exclusion graph does not give one arc optimality
 
@@ -575,23 +1009,40 @@ static scc_ErrorCode iscc_fs_sort_by_inwards(const iscc_Digraph* const nng,
 
 	const size_t vertices = nng->vertices;
 
+	scc_PointIndex* const inwards_count = calloc(vertices, sizeof(scc_PointIndex));
+	if (inwards_count == NULL) return iscc_make_error(SCC_ER_NO_MEMORY);
+
+	const scc_PointIndex* const arc_stop = nng->head + nng->tail_ptr[vertices];
+	for (const scc_PointIndex* arc = nng->head; arc != arc_stop; ++arc) {
+		++inwards_count[*arc];
+	}
+
+	return iscc_fs_sort_by_count(vertices, inwards_count, make_indices, out_sort);
+}
+
+
+// Takes ownership of `inwards_count`, which is freed on error
+static scc_ErrorCode iscc_fs_sort_by_count(const size_t vertices,
+                                           scc_PointIndex inwards_count[const],
+                                           const bool make_indices,
+                                           iscc_fs_SortResult* const out_sort)
+{
+	assert(vertices > 1);
+	assert(inwards_count != NULL);
+	assert(out_sort != NULL);
+
 	*out_sort = (iscc_fs_SortResult) {
-		.inwards_count = calloc(vertices, sizeof(scc_PointIndex)),
+		.inwards_count = inwards_count,
 		.sorted_vertices = malloc(sizeof(scc_PointIndex[vertices])),
 		.vertex_index = NULL,
 		.bucket_index = NULL,
 	};
 
-	if ((out_sort->inwards_count == NULL) || (out_sort->sorted_vertices == NULL)) {
+	if (out_sort->sorted_vertices == NULL) {
 		iscc_fs_free_sort_result(out_sort);
 		return iscc_make_error(SCC_ER_NO_MEMORY);
 	}
 
-	const scc_PointIndex* const arc_stop = nng->head + nng->tail_ptr[vertices];
-	for (const scc_PointIndex* arc = nng->head; arc != arc_stop; ++arc) {
-		++out_sort->inwards_count[*arc];
-	}
-
 	// Dynamic alloc is slightly faster but more error-prone
 	// Add if turns out to be bottleneck
 	scc_PointIndex max_inwards_tmp = 0;
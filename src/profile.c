@@ -0,0 +1,160 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+// Monotonic clock requires POSIX; must be set before any system header
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+	#ifndef _POSIX_C_SOURCE
+		#define _POSIX_C_SOURCE 200112L
+	#endif
+#endif
+
+#include "profile.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../include/scclust.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Static variables
+// =============================================================================
+
+// Profile set by `scc_set_clustering_profile` in this thread
+static ISCC_THREAD_LOCAL scc_ClusteringProfile* iscc_profile_target = NULL;
+
+
+// =============================================================================
+// External variables
+// =============================================================================
+
+ISCC_THREAD_LOCAL iscc_ProfileState iscc_profile_state = { NULL, SCC_PH_OTHER, 0.0, 0.0, 0 };
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static double iscc_profile_time(void);
+
+
+static void iscc_profile_update_peak(void);
+
+
+// =============================================================================
+// Public function implementations
+// =============================================================================
+
+void scc_set_clustering_profile(scc_ClusteringProfile* const profile)
+{
+	iscc_profile_target = profile;
+}
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+void iscc_profile_begin(void)
+{
+	assert(iscc_profile_state.profile == NULL);
+	if (iscc_profile_target == NULL) return;
+
+	memset(iscc_profile_target, 0, sizeof(scc_ClusteringProfile));
+	const double now = iscc_profile_time();
+	iscc_profile_state = (iscc_ProfileState) {
+		.profile = iscc_profile_target,
+		.phase = SCC_PH_OTHER,
+		.phase_start = now,
+		.profile_start = now,
+		.scratch_bytes = 0,
+	};
+}
+
+
+void iscc_profile_end(void)
+{
+	if (iscc_profile_state.profile == NULL) return;
+
+	const double now = iscc_profile_time();
+	scc_ClusteringProfile* const profile = iscc_profile_state.profile;
+	profile->phases[iscc_profile_state.phase].wall_time += now - iscc_profile_state.phase_start;
+	profile->wall_time = now - iscc_profile_state.profile_start;
+	iscc_profile_state.profile = NULL;
+}
+
+
+scc_ProfilePhase iscc_profile_enter(const scc_ProfilePhase phase)
+{
+	assert(phase < SCC_PH_NUM_PHASES);
+	const scc_ProfilePhase prev_phase = iscc_profile_state.phase;
+	if (iscc_profile_state.profile == NULL) return prev_phase;
+
+	const double now = iscc_profile_time();
+	iscc_profile_state.profile->phases[prev_phase].wall_time += now - iscc_profile_state.phase_start;
+	iscc_profile_state.phase = phase;
+	iscc_profile_state.phase_start = now;
+	// Graphs from earlier phases are still held
+	iscc_profile_update_peak();
+
+	return prev_phase;
+}
+
+
+void iscc_profile_add_scratch__(const uint64_t bytes)
+{
+	assert(iscc_profile_state.profile != NULL);
+	iscc_profile_state.scratch_bytes += bytes;
+	iscc_profile_update_peak();
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+// Wall clock time in seconds from an arbitrary starting point
+static double iscc_profile_time(void)
+{
+	#if defined(_OPENMP)
+		return omp_get_wtime();
+	#elif defined(CLOCK_MONOTONIC)
+		struct timespec ts;
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+			return ((double) ts.tv_sec) + 1e-9 * ((double) ts.tv_nsec);
+		}
+		return ((double) clock()) / ((double) CLOCKS_PER_SEC);
+	#else
+		// Processor time; equals wall time for single-threaded calls
+		return ((double) clock()) / ((double) CLOCKS_PER_SEC);
+	#endif
+}
+
+
+static void iscc_profile_update_peak(void)
+{
+	scc_PhaseProfile* const phase_profile = &iscc_profile_state.profile->phases[iscc_profile_state.phase];
+	if (phase_profile->peak_scratch_bytes < iscc_profile_state.scratch_bytes) {
+		phase_profile->peak_scratch_bytes = iscc_profile_state.scratch_bytes;
+	}
+}
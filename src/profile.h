@@ -0,0 +1,144 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+/** @file
+ *
+ *  Recording of #scc_ClusteringProfile.
+ *
+ *  A profile is active between #iscc_profile_begin and #iscc_profile_end if the
+ *  user has set one with `scc_set_clustering_profile`. All state is stored with
+ *  #ISCC_THREAD_LOCAL. When no profile is active, the counting functions only
+ *  test a pointer, so they can be called unconditionally. They must only be
+ *  called by the thread that began the profile, never from parallel regions.
+ */
+
+#ifndef SCC_PROFILE_HG
+#define SCC_PROFILE_HG
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/scclust.h"
+#include "threads.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Structs, types and variables
+// =============================================================================
+
+/// State of the active profile.
+typedef struct iscc_ProfileState {
+	/// The profile being recorded, `NULL` when profiling is inactive.
+	scc_ClusteringProfile* profile;
+
+	/// Phase currently recorded.
+	scc_ProfilePhase phase;
+
+	/// Time when #phase was entered.
+	double phase_start;
+
+	/// Time when the profile was begun.
+	double profile_start;
+
+	/// Bytes currently held in graphs.
+	uint64_t scratch_bytes;
+} iscc_ProfileState;
+
+
+/// Profile state of this thread.
+extern ISCC_THREAD_LOCAL iscc_ProfileState iscc_profile_state;
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/// Starts recording to the profile set by the user, if any, in phase #SCC_PH_OTHER.
+void iscc_profile_begin(void);
+
+
+/// Stops recording and writes the total time.
+void iscc_profile_end(void);
+
+
+/** Switches the recorded phase.
+ *
+ *  \param phase the phase to enter.
+ *
+ *  \return the phase that was left, so that it can be restored.
+ */
+scc_ProfilePhase iscc_profile_enter(scc_ProfilePhase phase);
+
+
+/// Records that a graph has allocated `bytes` bytes.
+void iscc_profile_add_scratch__(uint64_t bytes);
+
+
+// =============================================================================
+// Inline function implementations
+// =============================================================================
+
+/// Records `num_dists` distance evaluations.
+static inline void iscc_profile_count_dists(const uint64_t num_dists)
+{
+	if (iscc_profile_state.profile != NULL) {
+		iscc_profile_state.profile->phases[iscc_profile_state.phase].dist_evaluations += num_dists;
+	}
+}
+
+
+/// Records `num_queries` nearest neighbor or farthest point queries.
+static inline void iscc_profile_count_queries(const uint64_t num_queries)
+{
+	if (iscc_profile_state.profile != NULL) {
+		iscc_profile_state.profile->phases[iscc_profile_state.phase].nn_queries += num_queries;
+	}
+}
+
+
+/// Records that a graph has allocated storage for `num_arcs` arcs and `bytes` bytes in total.
+static inline void iscc_profile_count_alloc(const uint64_t num_arcs,
+                                            const uint64_t bytes)
+{
+	if (iscc_profile_state.profile != NULL) {
+		iscc_profile_state.profile->phases[iscc_profile_state.phase].arcs_allocated += num_arcs;
+		iscc_profile_add_scratch__(bytes);
+	}
+}
+
+
+/// Records that a graph has freed `bytes` bytes.
+static inline void iscc_profile_count_free(const uint64_t bytes)
+{
+	if (iscc_profile_state.profile != NULL) {
+		// Graphs allocated before the profile began are not counted
+		iscc_profile_state.scratch_bytes -= (bytes < iscc_profile_state.scratch_bytes) ? bytes : iscc_profile_state.scratch_bytes;
+	}
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_PROFILE_HG
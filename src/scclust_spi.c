@@ -20,9 +20,40 @@
 
 #include "../include/scclust_spi.h"
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "../include/scclust.h"
 #include "dist_search.h"
 #include "dist_search_imp.h"
+#include "error.h"
+#include "threads.h"
+
+
+// =============================================================================
+// Default nearest neighbor search
+// =============================================================================
+
+#ifdef SCC_KDTREE_DEFAULT
+	#define ISCC_DEFAULT_INIT_MAX_DIST_OBJECT iscc_imp_init_kdtree_max_dist_object
+	#define ISCC_DEFAULT_INIT_NN_SEARCH_OBJECT iscc_imp_init_kdtree_nn_search_object
+#else
+	#define ISCC_DEFAULT_INIT_MAX_DIST_OBJECT iscc_imp_init_max_dist_object
+	#define ISCC_DEFAULT_INIT_NN_SEARCH_OBJECT iscc_imp_init_nn_search_object
+#endif
+
+#define ISCC_DEFAULT_DIST_FUNCTIONS { \
+	.check_data_set = iscc_imp_check_data_set, \
+	.num_data_points = iscc_imp_num_data_points, \
+	.get_dist_matrix = iscc_imp_get_dist_matrix, \
+	.get_dist_rows = iscc_imp_get_dist_rows, \
+	.init_max_dist_object = ISCC_DEFAULT_INIT_MAX_DIST_OBJECT, \
+	.get_max_dist = iscc_imp_get_max_dist, \
+	.close_max_dist_object = iscc_imp_close_max_dist_object, \
+	.init_nn_search_object = ISCC_DEFAULT_INIT_NN_SEARCH_OBJECT, \
+	.nearest_neighbor_search = iscc_imp_nearest_neighbor_search, \
+	.close_nn_search_object = iscc_imp_close_nn_search_object, \
+}
 
 
 // =============================================================================
@@ -30,18 +61,18 @@
 // =============================================================================
 
 // See "dist_search.h" for definition
-iscc_dist_functions_struct iscc_dist_functions = {
-	.check_data_set = iscc_imp_check_data_set,
-	.num_data_points = iscc_imp_num_data_points,
-	.get_dist_matrix = iscc_imp_get_dist_matrix,
-	.get_dist_rows = iscc_imp_get_dist_rows,
-	.init_max_dist_object = iscc_imp_init_max_dist_object,
-	.get_max_dist = iscc_imp_get_max_dist,
-	.close_max_dist_object = iscc_imp_close_max_dist_object,
-	.init_nn_search_object = iscc_imp_init_nn_search_object,
-	.nearest_neighbor_search = iscc_imp_nearest_neighbor_search,
-	.close_nn_search_object = iscc_imp_close_nn_search_object,
-};
+iscc_dist_functions_struct iscc_dist_functions = ISCC_DEFAULT_DIST_FUNCTIONS;
+
+
+// See "dist_search.h" for definition
+ISCC_THREAD_LOCAL const iscc_dist_functions_struct* iscc_current_dist_functions = NULL;
+
+
+// =============================================================================
+// Static function prototypes
+// =============================================================================
+
+static bool iscc_check_dist_functions(const scc_DistFunctions* dist_functions);
 
 
 // =============================================================================
@@ -50,18 +81,7 @@ iscc_dist_functions_struct iscc_dist_functions = {
 
 bool scc_reset_dist_functions(void)
 {
-	iscc_dist_functions = (iscc_dist_functions_struct) {
-		.check_data_set = iscc_imp_check_data_set,
-		.num_data_points = iscc_imp_num_data_points,
-		.get_dist_matrix = iscc_imp_get_dist_matrix,
-		.get_dist_rows = iscc_imp_get_dist_rows,
-		.init_max_dist_object = iscc_imp_init_max_dist_object,
-		.get_max_dist = iscc_imp_get_max_dist,
-		.close_max_dist_object = iscc_imp_close_max_dist_object,
-		.init_nn_search_object = iscc_imp_init_nn_search_object,
-		.nearest_neighbor_search = iscc_imp_nearest_neighbor_search,
-		.close_nn_search_object = iscc_imp_close_nn_search_object,
-	};
+	iscc_dist_functions = (iscc_dist_functions_struct) ISCC_DEFAULT_DIST_FUNCTIONS;
 
 	return true;
 }
@@ -120,3 +140,161 @@ bool scc_set_dist_functions(scc_check_data_set check_data_set,
 
 	return true;
 }
+
+
+bool scc_set_kdtree_nn_search(void)
+{
+	return scc_set_dist_functions(NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              iscc_imp_init_kdtree_max_dist_object,
+	                              iscc_imp_get_max_dist,
+	                              iscc_imp_close_max_dist_object,
+	                              iscc_imp_init_kdtree_nn_search_object,
+	                              iscc_imp_nearest_neighbor_search,
+	                              iscc_imp_close_nn_search_object);
+}
+
+
+bool scc_set_pivot_nn_search(void)
+{
+	return scc_set_dist_functions(NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              iscc_imp_init_pivot_nn_search_object,
+	                              iscc_imp_nearest_neighbor_search,
+	                              iscc_imp_close_nn_search_object);
+}
+
+
+bool scc_set_hnsw_nn_search(void)
+{
+	return scc_set_dist_functions(NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              NULL,
+	                              iscc_imp_init_hnsw_nn_search_object,
+	                              iscc_imp_nearest_neighbor_search,
+	                              iscc_imp_close_nn_search_object);
+}
+
+
+scc_DistFunctions scc_get_default_dist_functions(void)
+{
+	return (scc_DistFunctions) ISCC_DEFAULT_DIST_FUNCTIONS;
+}
+
+
+scc_DistFunctions scc_get_kdtree_dist_functions(void)
+{
+	scc_DistFunctions dist_functions = ISCC_DEFAULT_DIST_FUNCTIONS;
+	dist_functions.init_max_dist_object = iscc_imp_init_kdtree_max_dist_object;
+	dist_functions.init_nn_search_object = iscc_imp_init_kdtree_nn_search_object;
+	return dist_functions;
+}
+
+
+scc_DistFunctions scc_get_pivot_dist_functions(void)
+{
+	scc_DistFunctions dist_functions = ISCC_DEFAULT_DIST_FUNCTIONS;
+	dist_functions.init_nn_search_object = iscc_imp_init_pivot_nn_search_object;
+	return dist_functions;
+}
+
+
+scc_DistFunctions scc_get_hnsw_dist_functions(void)
+{
+	scc_DistFunctions dist_functions = ISCC_DEFAULT_DIST_FUNCTIONS;
+	dist_functions.init_nn_search_object = iscc_imp_init_hnsw_nn_search_object;
+	return dist_functions;
+}
+
+
+scc_DistFunctions scc_get_dist_functions(void)
+{
+	return iscc_dist_functions;
+}
+
+
+scc_ErrorCode scc_sc_clustering_with_dist_functions(void* const data_set,
+                                                    const scc_ClusterOptions* const options,
+                                                    scc_Clustering* const out_clustering,
+                                                    const scc_DistFunctions* const dist_functions)
+{
+	if (!iscc_check_dist_functions(dist_functions)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid distance functions.");
+	}
+
+	// Restore previous functions afterwards so that calls can be nested
+	const iscc_dist_functions_struct* const prev_dist_functions = iscc_current_dist_functions;
+	iscc_current_dist_functions = dist_functions;
+	const scc_ErrorCode ec = scc_sc_clustering(data_set, options, out_clustering);
+	iscc_current_dist_functions = prev_dist_functions;
+
+	return ec;
+}
+
+
+scc_ErrorCode scc_hierarchical_clustering_with_dist_functions(void* const data_set,
+                                                              const uint32_t size_constraint,
+                                                              const bool batch_assign,
+                                                              scc_Clustering* const out_clustering,
+                                                              const scc_DistFunctions* const dist_functions)
+{
+	if (!iscc_check_dist_functions(dist_functions)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid distance functions.");
+	}
+
+	const iscc_dist_functions_struct* const prev_dist_functions = iscc_current_dist_functions;
+	iscc_current_dist_functions = dist_functions;
+	const scc_ErrorCode ec = scc_hierarchical_clustering(data_set, size_constraint, batch_assign, out_clustering);
+	iscc_current_dist_functions = prev_dist_functions;
+
+	return ec;
+}
+
+
+scc_ErrorCode scc_get_clustering_stats_with_dist_functions(void* const data_set,
+                                                           const scc_Clustering* const clustering,
+                                                           scc_ClusteringStats* const out_stats,
+                                                           const scc_DistFunctions* const dist_functions)
+{
+	if (!iscc_check_dist_functions(dist_functions)) {
+		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Invalid distance functions.");
+	}
+
+	const iscc_dist_functions_struct* const prev_dist_functions = iscc_current_dist_functions;
+	iscc_current_dist_functions = dist_functions;
+	const scc_ErrorCode ec = scc_get_clustering_stats(data_set, clustering, out_stats);
+	iscc_current_dist_functions = prev_dist_functions;
+
+	return ec;
+}
+
+
+// =============================================================================
+// Static function implementations
+// =============================================================================
+
+static bool iscc_check_dist_functions(const scc_DistFunctions* const dist_functions)
+{
+	if (dist_functions == NULL) return false;
+	return (dist_functions->check_data_set != NULL) &&
+	       (dist_functions->num_data_points != NULL) &&
+	       (dist_functions->get_dist_matrix != NULL) &&
+	       (dist_functions->get_dist_rows != NULL) &&
+	       (dist_functions->init_max_dist_object != NULL) &&
+	       (dist_functions->get_max_dist != NULL) &&
+	       (dist_functions->close_max_dist_object != NULL) &&
+	       (dist_functions->init_nn_search_object != NULL) &&
+	       (dist_functions->nearest_neighbor_search != NULL) &&
+	       (dist_functions->close_nn_search_object != NULL);
+}
@@ -0,0 +1,67 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "threads.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "../include/scclust.h"
+
+
+// =============================================================================
+// Static variables
+// =============================================================================
+
+// Zero indicates OpenMP default. Set per thread, like `omp_set_num_threads`.
+static ISCC_THREAD_LOCAL uint32_t iscc_num_threads = 0;
+
+
+// =============================================================================
+// Public function implementations
+// =============================================================================
+
+void scc_set_num_threads(const uint32_t num_threads)
+{
+	// Counts are passed to OpenMP as `int`
+	iscc_num_threads = (num_threads > INT_MAX) ? (uint32_t) INT_MAX : num_threads;
+}
+
+
+uint32_t scc_get_num_threads(void)
+{
+	return iscc_get_num_threads();
+}
+
+
+// =============================================================================
+// External function implementations
+// =============================================================================
+
+uint32_t iscc_get_num_threads(void)
+{
+	#ifdef _OPENMP
+		if (iscc_num_threads > 0) return iscc_num_threads;
+		const int max_threads = omp_get_max_threads();
+		return (max_threads > 1) ? (uint32_t) max_threads : 1;
+	#else
+		return 1;
+	#endif
+}
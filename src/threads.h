@@ -0,0 +1,96 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+/** @file
+ *
+ *  Multi-threading support.
+ *
+ *  Threading is implemented with OpenMP and is only compiled in when the library
+ *  is configured with `--enable-openmp`. Otherwise all pragmas expand to nothing
+ *  and #iscc_get_num_threads always returns one.
+ *
+ *  Library state that is written during calls (e.g., the error state) is stored
+ *  with #ISCC_THREAD_LOCAL, so that calls from different threads do not race.
+ *
+ *  Parallel regions in the library never allocate memory. All scratch memory is
+ *  allocated by the calling thread before a region is entered, so that allocation
+ *  failures are reported in the usual way.
+ */
+
+#ifndef SCC_THREADS_HG
+#define SCC_THREADS_HG
+
+#include <stdint.h>
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// =============================================================================
+// Macros
+// =============================================================================
+
+#ifdef _OPENMP
+	#define ISCC_OMP_PRAGMA(x) _Pragma(#x)
+#else
+	#define ISCC_OMP_PRAGMA(x)
+#endif
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+	#define ISCC_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__) || defined(__clang__)
+	#define ISCC_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+	#define ISCC_THREAD_LOCAL __declspec(thread)
+#else
+	// Without thread-local storage, the state would be shared by all threads
+	#error "scclust requires thread-local storage (C11 `_Thread_local`, `__thread` or `__declspec(thread)`)."
+#endif
+
+
+// =============================================================================
+// Function prototypes
+// =============================================================================
+
+/// Number of threads to use in parallel regions. Always at least one.
+uint32_t iscc_get_num_threads(void);
+
+
+/// Index of the calling thread in the current parallel region, zero outside regions.
+static inline uint32_t iscc_get_thread_num(void)
+{
+	#ifdef _OPENMP
+		return (uint32_t) omp_get_thread_num();
+	#else
+		return 0;
+	#endif
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef SCC_THREADS_HG
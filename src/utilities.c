@@ -373,7 +373,10 @@ scc_ErrorCode iscc_check_cluster_options(const scc_ClusterOptions* const options
 			(options->seed_method != SCC_SM_INWARDS_ORDER) &&
 			(options->seed_method != SCC_SM_INWARDS_UPDATING) &&
 			(options->seed_method != SCC_SM_EXCLUSION_ORDER) &&
-			(options->seed_method != SCC_SM_EXCLUSION_UPDATING)) {
+			(options->seed_method != SCC_SM_EXCLUSION_UPDATING) &&
+			(options->seed_method != SCC_SM_EXCLUSION_ORDER_IMPLICIT) &&
+			(options->seed_method != SCC_SM_EXCLUSION_UPDATING_IMPLICIT) &&
+			(options->seed_method != SCC_SM_PARALLEL_MIS)) {
 		return iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Unknown seed method.");
 	}
 	if ((options->primary_data_points != NULL) && (options->len_primary_data_points == 0)) {
@@ -62,6 +62,35 @@ void scc_get_compiled_version(uint32_t* out_major,
                               uint32_t* out_patch);
 
 
+// =============================================================================
+// Threading
+// =============================================================================
+
+/** Set the number of threads used by the library.
+ *
+ *  The library only uses multiple threads when it was configured with
+ *  `--enable-openmp`. Otherwise, this function has no effect. Results do not
+ *  depend on the number of threads.
+ *
+ *  Like `omp_set_num_threads`, the setting is kept per thread: it applies to
+ *  library calls made from the calling thread and does not affect calls made
+ *  from other threads.
+ *
+ *  \param num_threads number of threads to use. If zero, the OpenMP default is
+ *                     used (e.g., as set by the `OMP_NUM_THREADS` environment variable).
+ *                     Values above `INT_MAX` are treated as `INT_MAX`.
+ */
+void scc_set_num_threads(uint32_t num_threads);
+
+
+/** Get the number of threads used by the library.
+ *
+ *  \return the number of threads used by calls from the calling thread, which is
+ *          always one if the library was configured without `--enable-openmp`.
+ */
+uint32_t scc_get_num_threads(void);
+
+
 // =============================================================================
 // Error handling
 // =============================================================================
@@ -98,7 +127,8 @@ typedef enum scc_ErrorCode {
 /** Get latest scclust error.
  *
  *  Writes a description of the latest error prroduced by the library to the
- *  supplied buffer.
+ *  supplied buffer. The error state is kept per thread, so the function reports
+ *  the latest error in the calling thread.
  *
  *  \param[in] len_error_message_buffer the length of the buffer #error_message_buffer.
  *  \param[out] error_message_buffer the buffer to write to.
@@ -169,7 +199,10 @@ typedef struct scc_DataSet scc_DataSet;
 
 /** Construct new data set from raw data.
  *
- *  Creates a #scc_DataSet based on supplied raw data.
+ *  Creates a #scc_DataSet based on supplied raw data. The data is not copied,
+ *  and must not be changed or freed while the data set is in use. For data with
+ *  many dimensions, the squared norms of the data points are computed and stored
+ *  in the data set.
  *
  *  \param[in] num_data_points the number of data points in the data set.
  *  \param[in] num_dimensions the number of dimensions for each data point.
@@ -189,9 +222,85 @@ scc_ErrorCode scc_init_data_set(uint64_t num_data_points,
                                 scc_DataSet** out_data_set);
 
 
+/** Construct new data set from single precision raw data.
+ *
+ *  Creates a #scc_DataSet based on supplied raw data stored as `float`. The
+ *  data set can be used with all functions that accept data sets. Coordinates
+ *  are converted to `double` before distances are calculated, so distances
+ *  are the same (up to rounding) as for a `double` copy of the data, but the
+ *  data matrix takes half the memory.
+ *
+ *  \param[in] num_data_points the number of data points in the data set.
+ *  \param[in] num_dimensions the number of dimensions for each data point.
+ *  \param[in] len_data_matrix the length of #data_matrix.
+ *  \param[in] data_matrix the raw data, ordered as in #scc_init_data_set.
+ *  \param[out] out_data_set double pointer to where to write the data set reference.
+ *
+ *  \return #scc_ErrorCode describing eventual error.
+ */
+scc_ErrorCode scc_init_data_set_float(uint64_t num_data_points,
+                                      uint32_t num_dimensions,
+                                      size_t len_data_matrix,
+                                      const float data_matrix[],
+                                      scc_DataSet** out_data_set);
+
+
+/// Enum to specify the expected access pattern of a memory-mapped data set.
+typedef enum scc_AccessPattern {
+	/// No particular access pattern.
+	SCC_AP_NORMAL,
+
+	/// Data points are read in order (e.g., with the brute-force nearest neighbor search).
+	SCC_AP_SEQUENTIAL,
+
+	/// Data points are read in random order (e.g., with the kd-tree nearest neighbor search).
+	SCC_AP_RANDOM,
+
+	/// All data points will be needed soon, so the file should be read ahead.
+	SCC_AP_WILL_NEED,
+} scc_AccessPattern;
+
+
+/** Construct new data set from a binary file.
+ *
+ *  Creates a #scc_DataSet by memory-mapping a binary file. The data is not
+ *  copied or read into memory up front; pages are read on demand and are
+ *  shared with other processes mapping the same file. The file must not be
+ *  changed while the data set is in use. The mapping is released by
+ *  #scc_free_data_set. Unlike #scc_init_data_set, norms of the data points
+ *  are never computed, so that initialization does not read the file.
+ *
+ *  The file consists of a 32 byte header followed by the data matrix ordered
+ *  as in #scc_init_data_set. All fields are in the byte order of the machine:
+ *
+ *  | Offset | Type        | Field                                         |
+ *  | ------ | ----------- | --------------------------------------------- |
+ *  | 0      | `char[8]`   | The string `"SCCDATA"` including terminating null. |
+ *  | 8      | `uint32_t`  | Format version. Must be 1.                    |
+ *  | 12     | `uint32_t`  | Element type: 1 for `double`, 2 for `float`.  |
+ *  | 16     | `uint64_t`  | Number of data points.                        |
+ *  | 24     | `uint32_t`  | Number of dimensions.                         |
+ *  | 28     | `uint32_t`  | Reserved. Must be 0.                          |
+ *  | 32     |             | Data matrix.                                  |
+ *
+ *  \param[in] file_path path to the file.
+ *  \param[in] access_pattern the expected access pattern, passed on to the
+ *                            operating system as a hint.
+ *  \param[out] out_data_set double pointer to where to write the data set reference.
+ *
+ *  \return #scc_ErrorCode describing eventual error. Returns #SCC_ER_NOT_IMPLEMENTED
+ *          on platforms without memory-mapped files.
+ */
+scc_ErrorCode scc_init_data_set_from_file(const char* file_path,
+                                          scc_AccessPattern access_pattern,
+                                          scc_DataSet** out_data_set);
+
+
 /** Free data set.
  *
- *  Frees a #scc_DataSet previously allocated by #scc_init_data_set.
+ *  Frees a #scc_DataSet previously allocated by #scc_init_data_set,
+ *  #scc_init_data_set_float or #scc_init_data_set_from_file, together with
+ *  any search index loaded by #scc_load_nn_search_index.
  *
  *  \param[in,out] data_set double pointer to a #scc_DataSet objec to free.
  */
@@ -213,6 +322,64 @@ void scc_free_data_set(scc_DataSet** data_set);
 bool scc_is_initialized_data_set(const scc_DataSet* data_set);
 
 
+/** Save nearest neighbor search index.
+ *
+ *  Builds a kd-tree over all points in the data set, and saves it to a binary
+ *  file that #scc_load_nn_search_index can map back into memory. If the data
+ *  set already has a loaded index, that index is saved.
+ *
+ *  The file consists of a 64 byte header followed by the tree. All fields are
+ *  in the byte order of the machine, and all sections are 8-byte aligned:
+ *
+ *  | Offset | Type        | Field                                         |
+ *  | ------ | ----------- | --------------------------------------------- |
+ *  | 0      | `char[8]`   | The string `"SCCKDTR"` including terminating null. |
+ *  | 8      | `uint32_t`  | Format version. Must be 2.                    |
+ *  | 12     | `uint32_t`  | Element type of the data set: 1 for `double`, 2 for `float`. |
+ *  | 16     | `uint64_t`  | Number of data points.                        |
+ *  | 24     | `uint32_t`  | Number of dimensions.                         |
+ *  | 28     | `uint32_t`  | Leaf size of the tree.                        |
+ *  | 32     | `uint64_t`  | Checksum of the data matrix.                  |
+ *  | 40     | `uint64_t`  | Number of tree nodes.                         |
+ *  | 48     | `uint32_t`  | Size of a tree node. Must be 48.              |
+ *  | 52     | `uint32_t`  | Size of #scc_PointIndex.                      |
+ *  | 56     | `uint64_t`  | Reserved. Must be 0.                          |
+ *  | 64     |             | Tree nodes followed by the points ordered by node.|
+ *
+ *  \param[in] data_set the data set.
+ *  \param[in] file_path path to the file. Existing files are overwritten.
+ *
+ *  \return #scc_ErrorCode describing eventual error.
+ */
+scc_ErrorCode scc_save_nn_search_index(const scc_DataSet* data_set,
+                                       const char* file_path);
+
+
+/** Load nearest neighbor search index.
+ *
+ *  Memory-maps an index saved by #scc_save_nn_search_index and attaches it to
+ *  the data set. Subsequent nearest neighbor searches over all data points
+ *  with the built-in brute-force or kd-tree search functions use the index
+ *  rather than building their own, and give the same results. Loading only
+ *  reads the header, the nodes and the point order; the rest of the file is
+ *  read on demand. The index is released by #scc_free_data_set.
+ *
+ *  The file is rejected unless it was saved from a data set with exactly the
+ *  same data matrix, as recorded by a checksum in the file. An index cannot be
+ *  replaced once loaded, as search objects cached in any thread (see
+ *  `scc_pin_nn_search_cache`) may use it. Loading must not run concurrently
+ *  with calls using the data set in other threads.
+ *
+ *  \param[in,out] data_set the data set.
+ *  \param[in] file_path path to the file.
+ *
+ *  \return #scc_ErrorCode describing eventual error. Returns #SCC_ER_NOT_IMPLEMENTED
+ *          on platforms without memory-mapped files.
+ */
+scc_ErrorCode scc_load_nn_search_index(scc_DataSet* data_set,
+                                       const char* file_path);
+
+
 // =============================================================================
 // Clustering object
 // =============================================================================
@@ -273,7 +440,13 @@ typedef enum scc_SeedMethod {
 	 */
 	SCC_SM_LEXICAL,
 
-
+	/** Find seeds lexically by vertex ID, searching for nearest neighbors in batches.
+	 *
+	 *  This method checks vertices in the same order as #SCC_SM_LEXICAL but never stores the NNG. Only the neighbors of the points in the current
+	 *  batch are kept in memory (see `batch_size` in #scc_ClusterOptions). With the built-in distance functions and multiple threads
+	 *  (see #scc_set_num_threads), the neighbors of the next batch are searched for while the current batch is processed. The
+	 *  clustering does not depend on the number of threads.
+	 */
 	SCC_SM_BATCHES,
 
 	/** Find seeds ordered by inwards pointing arcs.
@@ -310,7 +483,32 @@ typedef enum scc_SeedMethod {
 	 *  and find seeds in ascending order by this count. Unlike the #SCC_SM_EXCLUSION_ORDER, this method updates the edge count after finding a
 	 *  seed so that only edges where the tails that still can become seeds are counted.
 	 */
-	SCC_SM_EXCLUSION_UPDATING
+	SCC_SM_EXCLUSION_UPDATING,
+
+	/** Find seeds ordered by edge count in the exclusion graph without storing the graph.
+	 *
+	 *  This method finds the same seeds as #SCC_SM_EXCLUSION_ORDER. The exclusion graph can be much larger than the NNG, and this method
+	 *  does not construct it. Instead, the edges of a vertex are derived from the NNG when needed. Memory use is thus proportional to the
+	 *  size of the NNG, but the method is slower when the exclusion graph fits in memory.
+	 */
+	SCC_SM_EXCLUSION_ORDER_IMPLICIT,
+
+	/** Find seeds ordered by edge count in the exclusion graph from non-excluded vertices without storing the graph.
+	 *
+	 *  This method finds the same seeds as #SCC_SM_EXCLUSION_UPDATING, but does not construct the exclusion graph.
+	 *  See #SCC_SM_EXCLUSION_ORDER_IMPLICIT.
+	 */
+	SCC_SM_EXCLUSION_UPDATING_IMPLICIT,
+
+	/** Find seeds as a maximal independent set of the exclusion graph using multiple threads.
+	 *
+	 *  Each vertex is given a fixed pseudo-random priority, and seeds are found in rounds. In each round, all vertices that are not excluded
+	 *  and have higher priority than all their non-excluded neighbors in the exclusion graph become seeds. The seeds are the same as if
+	 *  vertices were picked one by one in priority order, and they do not depend on the number of threads. The method tends to find
+	 *  fewer seeds than #SCC_SM_EXCLUSION_UPDATING, but unlike the other exclusion graph methods, it runs in parallel (see #scc_set_num_threads).
+	 *  The exclusion graph is not stored.
+	 */
+	SCC_SM_PARALLEL_MIS
 
 } scc_SeedMethod;
 
@@ -372,6 +570,83 @@ scc_ErrorCode scc_hierarchical_clustering(void* data_set,
                                           scc_Clustering* out_clustering);
 
 
+// =============================================================================
+// Profiling
+// =============================================================================
+
+/// Enum of the phases of #scc_sc_clustering recorded in #scc_ClusteringProfile.
+typedef enum scc_ProfilePhase {
+	/** Construction of the nearest neighbor graph.
+	 *
+	 *  With #SCC_SM_BATCHES, the graph is never stored and the whole clustering is recorded in this phase.
+	 */
+	SCC_PH_NNG,
+
+	/// Merging of the nearest neighbor graphs of the types when `type_constraints` are used.
+	SCC_PH_TYPE_UNION,
+
+	/// Finding seeds in the nearest neighbor graph.
+	SCC_PH_SEEDS,
+
+	/// Estimating the assignment radius (#SCC_RM_USE_ESTIMATED).
+	SCC_PH_RADIUS,
+
+	/// Forming clusters from the seeds and assigning the remaining data points.
+	SCC_PH_ASSIGN,
+
+	/// Input checking and everything else.
+	SCC_PH_OTHER,
+
+	/// Number of phases.
+	SCC_PH_NUM_PHASES,
+} scc_ProfilePhase;
+
+
+/// Measurements of one phase.
+typedef struct scc_PhaseProfile {
+	/// Wall clock time in seconds.
+	double wall_time;
+
+	/// Number of distances requested with the `get_dist_matrix` and `get_dist_rows` distance functions.
+	uint64_t dist_evaluations;
+
+	/// Number of nearest neighbor and farthest point queries issued to the distance functions.
+	uint64_t nn_queries;
+
+	/// Number of arcs allocated in graphs.
+	uint64_t arcs_allocated;
+
+	/// Largest number of bytes held in graphs at any point during the phase, including graphs allocated in earlier phases.
+	uint64_t peak_scratch_bytes;
+} scc_PhaseProfile;
+
+
+/// Struct to report where #scc_sc_clustering spends its time.
+typedef struct scc_ClusteringProfile {
+	/// Total wall clock time in seconds.
+	double wall_time;
+
+	/// Measurements of each phase, indexed by #scc_ProfilePhase.
+	scc_PhaseProfile phases[SCC_PH_NUM_PHASES];
+} scc_ClusteringProfile;
+
+
+/** Set profile to record calls to #scc_sc_clustering.
+ *
+ *  When a profile is set, each subsequent call to #scc_sc_clustering from the
+ *  same thread resets \p profile and records its phases in it. The profile is
+ *  also written when the call fails. Calls from other threads are unaffected.
+ *  Profiling does not change the clustering.
+ *
+ *  Distances and queries are counted where the library calls the distance
+ *  functions (see `scclust_spi.h`), so the counts do not depend on the number
+ *  of threads or on how the functions search.
+ *
+ *  \param profile profile to write to. If `NULL`, profiling is disabled, which is the default.
+ */
+void scc_set_clustering_profile(scc_ClusteringProfile* profile);
+
+
 // =============================================================================
 // Utility functions
 // =============================================================================
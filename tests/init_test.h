@@ -31,6 +31,13 @@
 		return scc_set_ann_dist_search();
 	}
 
+#elif defined(SCC_UT_KDTREE)
+	#include <include/scclust_spi.h>
+
+	static bool scc_ut_init_tests() {
+		return scc_set_kdtree_nn_search();
+	}
+
 #else
 
 	#define scc_ut_init_tests() (true)
@@ -14,6 +14,8 @@ run_test()
 
 STRESS="false"
 ANN="N"
+KDTREE="N"
+OPENMP="N"
 KEEP_SCC_BUILD="false"
 
 while [ "$1" != "" ]; do
@@ -22,8 +24,16 @@ while [ "$1" != "" ]; do
 			ANN="Y"
 			printf "${REDCOLOR}Running ANN search tests.${NOCOLOR}\n"
 			;;
+		-o )
+			OPENMP="Y"
+			printf "${REDCOLOR}Running OpenMP tests.${NOCOLOR}\n"
+			;;
 		-k )
 			KEEP_SCC_BUILD="true" ;;
+		-t )
+			KDTREE="Y"
+			printf "${REDCOLOR}Running kd-tree search tests.${NOCOLOR}\n"
+			;;
 		-s )
 			STRESS="true"
 			printf "${REDCOLOR}Running stress tests.${NOCOLOR}\n"
@@ -40,17 +50,21 @@ make clean
 if [ "$KEEP_SCC_BUILD" = "false" ]; then
 	rm -rf scc_build
 fi
-make all ANN_SEARCH=$ANN
+make all ANN_SEARCH=$ANN KDTREE_SEARCH=$KDTREE OPENMP=$OPENMP
 
 run_test test_data_set
 run_test test_digraph_core
 run_test test_digraph_debug
 run_test test_digraph_operations_internal
 run_test test_digraph_operations
+run_test test_dist_kernels
 run_test test_dist_search
 run_test test_error
 run_test test_hierarchical_clustering_internal
 run_test test_hierarchical_clustering
+run_test test_hnsw
+run_test test_kdtree
+run_test test_nn_search_cache
 run_test test_nng_clustering_batches_internal
 run_test test_nng_clustering_batches
 run_test test_nng_clustering_internal
@@ -58,10 +72,14 @@ run_test test_nng_clustering
 run_test test_nng_core_internal
 run_test test_nng_core_stable
 run_test test_nng_core
+run_test test_nng_descent
 run_test test_nng_findseeds_internal
 run_test test_nng_findseeds_stable
 run_test test_nng_findseeds
+run_test test_profile
 run_test test_scclust
+run_test test_scclust_spi
+run_test test_threads
 
 if [ "$STRESS" = "true" ]; then
 	run_test stress_hierarchical_clustering
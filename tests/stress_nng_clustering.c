@@ -152,7 +152,7 @@ void scc_ut_stress_nng_clustering(void** state)
 		assert_int_equal(ec, SCC_ER_OK);
 
 		const uint32_t size_constraint = scc_rand_uint(2, 10);
-		const scc_SeedMethod seed_method = scc_rand_uint(SCC_SM_LEXICAL, SCC_SM_EXCLUSION_UPDATING);
+		const scc_SeedMethod seed_method = scc_rand_uint(SCC_SM_LEXICAL, SCC_SM_PARALLEL_MIS);
 		const scc_UnassignedMethod unassigned_method = scc_rand_uint(SCC_UM_IGNORE, SCC_UM_CLOSEST_SEED);
 		const scc_UnassignedMethod secondary_unassigned_method = scc_rand_uint(SCC_UM_IGNORE, SCC_UM_CLOSEST_SEED);
 
@@ -419,7 +419,7 @@ void scc_ut_stress_nng_clustering_with_types(void** state)
 			sum_type_constraints += type_constraints[t];
 		}
 		const uint32_t size_constraint = sum_type_constraints + scc_rand_uint(0, 2);
-		const scc_SeedMethod seed_method = scc_rand_uint(SCC_SM_LEXICAL, SCC_SM_EXCLUSION_UPDATING);
+		const scc_SeedMethod seed_method = scc_rand_uint(SCC_SM_LEXICAL, SCC_SM_PARALLEL_MIS);
 		const scc_UnassignedMethod unassigned_method = scc_rand_uint(SCC_UM_IGNORE, SCC_UM_CLOSEST_SEED);
 		const scc_UnassignedMethod secondary_unassigned_method = scc_rand_uint(SCC_UM_IGNORE, SCC_UM_CLOSEST_SEED);
 
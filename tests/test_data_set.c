@@ -19,14 +19,19 @@
  * ========================================================================== */
 
 #include "init_test.h"
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <include/scclust.h>
+#include <include/scclust_spi.h>
 #include <src/data_set_struct.h>
 #include <src/scclust_types.h>
 #include "data_object_test.h"
+#include "rand.h"
 
 
 void scc_ut_free_data_set(void** state)
@@ -161,6 +166,281 @@ void scc_ut_is_initialized_data_set(void** state)
 }
 
 
+void scc_ut_data_set_sq_norms(void** state)
+{
+	(void) state;
+
+	double coord[40];
+	for (size_t i = 0; i < 40; ++i) {
+		coord[i] = (double) i;
+	}
+
+	scc_DataSet* dso1;
+	assert_int_equal(scc_init_data_set(20, 2, 40, coord, &dso1), SCC_ER_OK);
+	assert_null(dso1->sq_norms);
+	scc_free_data_set(&dso1);
+
+	scc_DataSet* dso2;
+	assert_int_equal(scc_init_data_set(2, 20, 40, coord, &dso2), SCC_ER_OK);
+	assert_non_null(dso2->sq_norms);
+	double ref_norms[2] = { 0.0, 0.0 };
+	for (size_t i = 0; i < 40; ++i) {
+		ref_norms[i / 20] += coord[i] * coord[i];
+	}
+	assert_memory_equal(dso2->sq_norms, ref_norms, 2 * sizeof(double));
+	scc_free_data_set(&dso2);
+	assert_null(dso2);
+}
+
+
+void scc_ut_get_data_set_float(void** state)
+{
+	(void) state;
+
+	float coord[10] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f };
+
+	scc_ErrorCode ec1 = scc_init_data_set_float(5, 2, 10, coord, NULL);
+	assert_int_equal(ec1, SCC_ER_INVALID_INPUT);
+
+	scc_DataSet* dso2;
+	scc_ErrorCode ec2 = scc_init_data_set_float(0, 2, 10, coord, &dso2);
+	assert_null(dso2);
+	assert_int_equal(ec2, SCC_ER_INVALID_INPUT);
+
+	scc_DataSet* dso3;
+	scc_ErrorCode ec3 = scc_init_data_set_float(5, 2, 8, coord, &dso3);
+	assert_null(dso3);
+	assert_int_equal(ec3, SCC_ER_INVALID_INPUT);
+
+	scc_DataSet* dso4;
+	scc_ErrorCode ec4 = scc_init_data_set_float(5, 2, 10, NULL, &dso4);
+	assert_null(dso4);
+	assert_int_equal(ec4, SCC_ER_INVALID_INPUT);
+
+	scc_DataSet* dso5;
+	scc_ErrorCode ec5 = scc_init_data_set_float(5, 2, 10, coord, &dso5);
+	assert_int_equal(ec5, SCC_ER_OK);
+	assert_non_null(dso5);
+	assert_int_equal(dso5->num_data_points, 5);
+	assert_int_equal(dso5->num_dimensions, 2);
+	assert_null(dso5->data_matrix);
+	assert_true(dso5->float_matrix == coord);
+	assert_null(dso5->sq_norms);
+	assert_true(scc_is_initialized_data_set(dso5));
+
+	// Both matrices set is invalid
+	const double dcoord[10] = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10.0 };
+	dso5->data_matrix = dcoord;
+	assert_false(scc_is_initialized_data_set(dso5));
+	dso5->data_matrix = NULL;
+
+	scc_free_data_set(&dso5);
+	assert_null(dso5);
+}
+
+
+void scc_ut_float_data_set_clustering(void** state)
+{
+	(void) state;
+
+	srand(424242);
+
+	const size_t num_points = 500;
+	const uint32_t dimensions[3] = { 2, 3, 12 };
+	float* const fcoord = malloc(sizeof(float[num_points * 12]));
+	double* const dcoord = malloc(sizeof(double[num_points * 12]));
+
+	for (size_t dim_i = 0; dim_i < 3; ++dim_i) {
+		const uint32_t num_dimensions = dimensions[dim_i];
+		for (size_t i = 0; i < num_points * num_dimensions; ++i) {
+			fcoord[i] = (float) scc_rand_double(-10.0, 10.0);
+			dcoord[i] = (double) fcoord[i];
+		}
+
+		scc_DataSet* fdata;
+		scc_DataSet* ddata;
+		assert_int_equal(scc_init_data_set_float(num_points, num_dimensions, num_points * num_dimensions, fcoord, &fdata), SCC_ER_OK);
+		assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, dcoord, &ddata), SCC_ER_OK);
+
+		scc_ClusterOptions options = scc_get_default_options();
+		options.size_constraint = 4;
+
+		scc_Clabel flabels[500];
+		scc_Clabel dlabels[500];
+		scc_Clustering* clustering;
+
+		assert_int_equal(scc_init_empty_clustering(num_points, flabels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(fdata, &options, clustering), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+		assert_int_equal(scc_init_empty_clustering(num_points, dlabels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(ddata, &options, clustering), SCC_ER_OK);
+		assert_memory_equal(flabels, dlabels, num_points * sizeof(scc_Clabel));
+
+		scc_ClusteringStats fstats;
+		scc_ClusteringStats dstats;
+		assert_int_equal(scc_get_clustering_stats(fdata, clustering, &fstats), SCC_ER_OK);
+		assert_int_equal(scc_get_clustering_stats(ddata, clustering, &dstats), SCC_ER_OK);
+		assert_true(fabs(fstats.sum_dists - dstats.sum_dists) <= 1e-9 * dstats.sum_dists);
+		scc_free_clustering(&clustering);
+
+		const scc_DistFunctions kdtree = scc_get_kdtree_dist_functions();
+		assert_int_equal(scc_init_empty_clustering(num_points, flabels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering_with_dist_functions(fdata, &options, clustering, &kdtree), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+		assert_memory_equal(flabels, dlabels, num_points * sizeof(scc_Clabel));
+
+		assert_int_equal(scc_init_empty_clustering(num_points, flabels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_hierarchical_clustering(fdata, 4, true, clustering), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+		assert_int_equal(scc_init_empty_clustering(num_points, dlabels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_hierarchical_clustering(ddata, 4, true, clustering), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+		assert_memory_equal(flabels, dlabels, num_points * sizeof(scc_Clabel));
+
+		scc_free_data_set(&fdata);
+		scc_free_data_set(&ddata);
+	}
+
+	free(fcoord);
+	free(dcoord);
+}
+
+
+#define SCC_UT_DATA_FILE "test_data_set_file.bin"
+
+
+static void scc_ut_write_data_file(const char magic[8],
+                                   const uint32_t version,
+                                   const uint32_t element_type,
+                                   const uint64_t num_data_points,
+                                   const uint32_t num_dimensions,
+                                   const void* const data,
+                                   const size_t len_data_bytes)
+{
+	const uint32_t reserved = 0;
+	FILE* const file = fopen(SCC_UT_DATA_FILE, "wb");
+	assert_non_null(file);
+	assert_int_equal(fwrite(magic, 1, 8, file), 8);
+	assert_int_equal(fwrite(&version, sizeof(uint32_t), 1, file), 1);
+	assert_int_equal(fwrite(&element_type, sizeof(uint32_t), 1, file), 1);
+	assert_int_equal(fwrite(&num_data_points, sizeof(uint64_t), 1, file), 1);
+	assert_int_equal(fwrite(&num_dimensions, sizeof(uint32_t), 1, file), 1);
+	assert_int_equal(fwrite(&reserved, sizeof(uint32_t), 1, file), 1);
+	if (len_data_bytes > 0) {
+		assert_int_equal(fwrite(data, 1, len_data_bytes, file), len_data_bytes);
+	}
+	assert_int_equal(fclose(file), 0);
+}
+
+
+void scc_ut_data_set_from_file(void** state)
+{
+	(void) state;
+
+	scc_DataSet* data_set;
+
+	#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+
+	srand(313131);
+
+	const size_t num_points = 300;
+	const uint32_t num_dimensions = 20;
+	double* const dcoord = malloc(sizeof(double[num_points * num_dimensions]));
+	float* const fcoord = malloc(sizeof(float[num_points * num_dimensions]));
+	for (size_t i = 0; i < num_points * num_dimensions; ++i) {
+		dcoord[i] = scc_rand_double(-10.0, 10.0);
+		fcoord[i] = (float) dcoord[i];
+	}
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	scc_Clabel labels[300];
+	scc_Clabel ref_labels[300];
+	scc_Clustering* clustering;
+
+	// Double data
+	scc_DataSet* ref_data_set;
+	assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, dcoord, &ref_data_set), SCC_ER_OK);
+	assert_int_equal(scc_init_empty_clustering(num_points, ref_labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(ref_data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	scc_free_data_set(&ref_data_set);
+
+	scc_ut_write_data_file("SCCDATA", 1, 1, num_points, num_dimensions, dcoord, sizeof(double[num_points * num_dimensions]));
+	const scc_AccessPattern patterns[4] = { SCC_AP_NORMAL, SCC_AP_SEQUENTIAL, SCC_AP_RANDOM, SCC_AP_WILL_NEED };
+	for (size_t p = 0; p < 4; ++p) {
+		assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, patterns[p], &data_set), SCC_ER_OK);
+		assert_true(scc_is_initialized_data_set(data_set));
+		assert_int_equal(data_set->num_data_points, num_points);
+		assert_int_equal(data_set->num_dimensions, num_dimensions);
+		assert_null(data_set->float_matrix);
+		assert_null(data_set->sq_norms);
+		assert_memory_equal(data_set->data_matrix, dcoord, sizeof(double[num_points * num_dimensions]));
+		assert_int_equal(scc_init_empty_clustering(num_points, labels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+		assert_memory_equal(labels, ref_labels, num_points * sizeof(scc_Clabel));
+		scc_free_data_set(&data_set);
+		assert_null(data_set);
+	}
+
+	// Float data
+	assert_int_equal(scc_init_data_set_float(num_points, num_dimensions, num_points * num_dimensions, fcoord, &ref_data_set), SCC_ER_OK);
+	assert_int_equal(scc_init_empty_clustering(num_points, ref_labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(ref_data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	scc_free_data_set(&ref_data_set);
+
+	scc_ut_write_data_file("SCCDATA", 1, 2, num_points, num_dimensions, fcoord, sizeof(float[num_points * num_dimensions]));
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_RANDOM, &data_set), SCC_ER_OK);
+	assert_null(data_set->data_matrix);
+	assert_memory_equal(data_set->float_matrix, fcoord, sizeof(float[num_points * num_dimensions]));
+	assert_int_equal(scc_init_empty_clustering(num_points, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_memory_equal(labels, ref_labels, num_points * sizeof(scc_Clabel));
+	scc_free_data_set(&data_set);
+
+	// Invalid files
+	scc_ut_write_data_file("SCCDATX", 1, 1, num_points, num_dimensions, dcoord, sizeof(double[num_points * num_dimensions]));
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	assert_null(data_set);
+	scc_ut_write_data_file("SCCDATA", 2, 1, num_points, num_dimensions, dcoord, sizeof(double[num_points * num_dimensions]));
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	scc_ut_write_data_file("SCCDATA", 1, 3, num_points, num_dimensions, dcoord, sizeof(double[num_points * num_dimensions]));
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	scc_ut_write_data_file("SCCDATA", 1, 1, num_points, num_dimensions, dcoord, sizeof(double[num_points * num_dimensions - 1]));
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	scc_ut_write_data_file("SCCDATA", 1, 1, 0, num_dimensions, NULL, 0);
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	scc_ut_write_data_file("SCCDATA", 1, 1, num_points, 0, NULL, 0);
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	assert_null(data_set);
+	// Number of elements wraps to zero in 64 bits
+	scc_ut_write_data_file("SCCDATA", 1, 1, UINT64_C(1) << 62, 4, dcoord, sizeof(double[num_points * num_dimensions]));
+	assert_true(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set) != SCC_ER_OK);
+	assert_null(data_set);
+
+	FILE* const file = fopen(SCC_UT_DATA_FILE, "wb");
+	assert_int_equal(fwrite("SCCDATA", 1, 8, file), 8);
+	assert_int_equal(fclose(file), 0);
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+
+	assert_int_equal(remove(SCC_UT_DATA_FILE), 0);
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	assert_null(data_set);
+
+	free(dcoord);
+	free(fcoord);
+
+	#endif
+
+	assert_int_equal(scc_init_data_set_from_file(NULL, SCC_AP_NORMAL, &data_set), SCC_ER_INVALID_INPUT);
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, SCC_AP_NORMAL, NULL), SCC_ER_INVALID_INPUT);
+	assert_int_equal(scc_init_data_set_from_file(SCC_UT_DATA_FILE, (scc_AccessPattern) 99, &data_set), SCC_ER_INVALID_INPUT);
+}
+
+
 int main(void)
 {
 	if(!scc_ut_init_tests()) return 1;
@@ -169,6 +449,10 @@ int main(void)
 		cmocka_unit_test(scc_ut_free_data_set),
 		cmocka_unit_test(scc_ut_get_data_set),
 		cmocka_unit_test(scc_ut_is_initialized_data_set),
+		cmocka_unit_test(scc_ut_data_set_sq_norms),
+		cmocka_unit_test(scc_ut_get_data_set_float),
+		cmocka_unit_test(scc_ut_float_data_set_clustering),
+		cmocka_unit_test(scc_ut_data_set_from_file),
 	};
 
 	return cmocka_run_group_tests_name("data_set.c", test_cases, NULL, NULL);
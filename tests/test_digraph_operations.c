@@ -22,6 +22,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <include/scclust.h>
 #include <src/digraph_core.h>
 #include <src/digraph_debug.h>
 #include <src/digraph_operations.h>
@@ -1262,6 +1264,56 @@ void scc_ut_adjacency_product(void** state)
 }
 
 
+void scc_ut_parallel_adjacency_product(void** state)
+{
+	(void) state;
+
+	srand(171717);
+
+	// Large enough to be split between threads when OpenMP is enabled
+	const size_t vertices = 5000;
+	iscc_Digraph dg;
+	assert_int_equal(iscc_init_digraph(vertices, 4 * vertices, &dg), SCC_ER_OK);
+	dg.tail_ptr[0] = 0;
+	for (size_t v = 0; v < vertices; ++v) {
+		const iscc_ArcIndex out_degree = (iscc_ArcIndex) (rand() % 5);
+		for (iscc_ArcIndex a = 0; a < out_degree; ++a) {
+			dg.head[dg.tail_ptr[v] + a] = (scc_PointIndex) (rand() % (int) vertices);
+		}
+		dg.tail_ptr[v + 1] = dg.tail_ptr[v] + out_degree;
+	}
+	iscc_Digraph dg_transpose;
+	assert_int_equal(iscc_digraph_transpose(&dg, &dg_transpose), SCC_ER_OK);
+
+	for (int loops = 0; loops < 2; ++loops) {
+		scc_set_num_threads(1);
+		iscc_Digraph serial_prod;
+		assert_int_equal(iscc_adjacency_product(&dg, &dg_transpose, (loops == 1), &serial_prod), SCC_ER_OK);
+		iscc_Digraph serial_square;
+		assert_int_equal(iscc_adjacency_product(&dg, &dg, (loops == 1), &serial_square), SCC_ER_OK);
+
+		scc_set_num_threads(4);
+		iscc_Digraph parallel_prod;
+		assert_int_equal(iscc_adjacency_product(&dg, &dg_transpose, (loops == 1), &parallel_prod), SCC_ER_OK);
+		iscc_Digraph parallel_square;
+		assert_int_equal(iscc_adjacency_product(&dg, &dg, (loops == 1), &parallel_square), SCC_ER_OK);
+
+		assert_valid_digraph(&parallel_prod, vertices);
+		assert_identical_digraph(&parallel_prod, &serial_prod);
+		assert_identical_digraph(&parallel_square, &serial_square);
+
+		assert_free_digraph(&serial_prod);
+		assert_free_digraph(&serial_square);
+		assert_free_digraph(&parallel_prod);
+		assert_free_digraph(&parallel_square);
+	}
+
+	scc_set_num_threads(0);
+	assert_free_digraph(&dg);
+	assert_free_digraph(&dg_transpose);
+}
+
+
 int main(void)
 {
 	if(!scc_ut_init_tests()) return 1;
@@ -1277,6 +1329,7 @@ int main(void)
 		cmocka_unit_test(scc_ut_digraph_difference),
 		cmocka_unit_test(scc_ut_digraph_transpose),
 		cmocka_unit_test(scc_ut_adjacency_product),
+		cmocka_unit_test(scc_ut_parallel_adjacency_product),
 	};
 
 	return cmocka_run_group_tests_name("digraph_operations.c", test_cases, NULL, NULL);
@@ -0,0 +1,176 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <include/scclust.h>
+#include <src/dist_kernels.h>
+#include "double_assert.h"
+#include "rand.h"
+
+
+void scc_ut_get_sq_dist_kernel(void** state)
+{
+	(void) state;
+
+	assert_non_null(iscc_get_sq_dist_kernel(ISCC_SQ_DIST_SCALAR));
+	assert_null(iscc_get_sq_dist_kernel(ISCC_SQ_DIST_NUM_KERNELS));
+	assert_non_null(iscc_sq_dist_kernel);
+
+	bool found_selected = false;
+	for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+		if (iscc_get_sq_dist_kernel((iscc_SqDistKernelType) kt) == iscc_sq_dist_kernel) {
+			found_selected = true;
+		}
+	}
+	assert_true(found_selected);
+
+	assert_string_equal(iscc_get_sq_dist_kernel_name(ISCC_SQ_DIST_SCALAR), "scalar");
+	assert_string_equal(iscc_get_sq_dist_kernel_name(ISCC_SQ_DIST_AVX2), "avx2");
+}
+
+
+void scc_ut_sq_dist_kernels(void** state)
+{
+	(void) state;
+
+	srand(12345);
+	double x[130];
+	double y[130];
+	scc_rand_double_array(-100.0, 100.0, 130, x);
+	scc_rand_double_array(-100.0, 100.0, 130, y);
+
+	const iscc_SqDistKernel scalar = iscc_get_sq_dist_kernel(ISCC_SQ_DIST_SCALAR);
+
+	for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+		const iscc_SqDistKernel kernel = iscc_get_sq_dist_kernel((iscc_SqDistKernelType) kt);
+		if (kernel == NULL) continue;
+
+		assert_double_equal(kernel(x, x, 130), 0.0);
+		assert_double_equal(kernel(x, y, 1), (x[0] - y[0]) * (x[0] - y[0]));
+
+		// Test all tail lengths, with and without unaligned start
+		for (size_t offset = 0; offset < 2; ++offset) {
+			for (size_t d = 1; d <= 128; ++d) {
+				const double ref = scalar(x + offset, y + offset, d);
+				const double res = kernel(x + offset, y + offset, d);
+				const double tol = ISCC_SQ_DIST_TOLERANCE_FACTOR * ((double) d) * DBL_EPSILON * ref;
+				assert_true(fabs(res - ref) <= tol);
+			}
+		}
+	}
+}
+
+
+void scc_ut_sq_dist_float_kernels(void** state)
+{
+	(void) state;
+
+	srand(23456);
+	float x[130];
+	float y[130];
+	double xd[130];
+	double yd[130];
+	for (size_t i = 0; i < 130; ++i) {
+		x[i] = (float) scc_rand_double(-100.0, 100.0);
+		y[i] = (float) scc_rand_double(-100.0, 100.0);
+		xd[i] = (double) x[i];
+		yd[i] = (double) y[i];
+	}
+
+	assert_non_null(iscc_get_sq_dist_float_kernel(ISCC_SQ_DIST_SCALAR));
+	assert_null(iscc_get_sq_dist_float_kernel(ISCC_SQ_DIST_NUM_KERNELS));
+	assert_non_null(iscc_sq_dist_float_kernel);
+
+	const iscc_SqDistKernel scalar = iscc_get_sq_dist_kernel(ISCC_SQ_DIST_SCALAR);
+
+	for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+		const iscc_SqDistFloatKernel kernel = iscc_get_sq_dist_float_kernel((iscc_SqDistKernelType) kt);
+		if (kernel == NULL) continue;
+
+		assert_double_equal(kernel(x, x, 130), 0.0);
+
+		for (size_t offset = 0; offset < 2; ++offset) {
+			for (size_t d = 1; d <= 128; ++d) {
+				const double ref = scalar(xd + offset, yd + offset, d);
+				const double res = kernel(x + offset, y + offset, d);
+				const double tol = ISCC_SQ_DIST_TOLERANCE_FACTOR * ((double) d) * DBL_EPSILON * ref;
+				assert_true(fabs(res - ref) <= tol);
+			}
+		}
+	}
+}
+
+
+void scc_ut_dot_tile_kernels(void** state)
+{
+	(void) state;
+
+	srand(54321);
+	double data[6 * 130];
+	scc_rand_double_array(-100.0, 100.0, 6 * 130, data);
+
+	const double* const x[ISCC_DOT_TILE_ROWS] = { data, data + 130, data + 260, data + 390 };
+	const double* const y[ISCC_DOT_TILE_COLUMNS] = { data + 520, data + 651 };
+
+	assert_non_null(iscc_get_dot_tile_kernel(ISCC_SQ_DIST_SCALAR));
+	assert_null(iscc_get_dot_tile_kernel(ISCC_SQ_DIST_NUM_KERNELS));
+
+	for (int kt = 0; kt < ISCC_SQ_DIST_NUM_KERNELS; ++kt) {
+		const iscc_DotTileKernel kernel = iscc_get_dot_tile_kernel((iscc_SqDistKernelType) kt);
+		if (kernel == NULL) continue;
+
+		for (size_t d = 1; d <= 128; ++d) {
+			double dots[ISCC_DOT_TILE_ROWS * ISCC_DOT_TILE_COLUMNS];
+			kernel(x, y, d, dots);
+			for (size_t r = 0; r < ISCC_DOT_TILE_ROWS; ++r) {
+				for (size_t c = 0; c < ISCC_DOT_TILE_COLUMNS; ++c) {
+					double ref = 0.0;
+					double abs_sum = 0.0;
+					for (size_t i = 0; i < d; ++i) {
+						ref += x[r][i] * y[c][i];
+						abs_sum += fabs(x[r][i] * y[c][i]);
+					}
+					const double tol = ISCC_SQ_DIST_TOLERANCE_FACTOR * ((double) d) * DBL_EPSILON * abs_sum;
+					assert_true(fabs(dots[r * ISCC_DOT_TILE_COLUMNS + c] - ref) <= tol);
+				}
+			}
+		}
+	}
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_get_sq_dist_kernel),
+		cmocka_unit_test(scc_ut_sq_dist_kernels),
+		cmocka_unit_test(scc_ut_sq_dist_float_kernels),
+		cmocka_unit_test(scc_ut_dot_tile_kernels),
+	};
+
+	return cmocka_run_group_tests_name("dist_kernels.c", test_cases, NULL, NULL);
+}
@@ -19,12 +19,18 @@
  * ========================================================================== */
 
 #include "init_test.h"
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <include/scclust.h>
 #include <src/dist_search.h>
+#include <src/dist_search_imp.h>
 #include <src/scclust_types.h>
 #include "data_object_test.h"
 #include "double_assert.h"
+#include "rand.h"
 
 
 void scc_ut_check_data_set(void** state)
@@ -1255,6 +1261,276 @@ void scc_ut_nearest_neighbor_search_radius(void** state)
 }
 
 
+static double scc_ut_exact_dist(const double* const data_matrix,
+                                const size_t num_dimensions,
+                                const size_t index1,
+                                const size_t index2)
+{
+	double sq_dist = 0.0;
+	for (size_t i = 0; i < num_dimensions; ++i) {
+		const double diff = data_matrix[index1 * num_dimensions + i] - data_matrix[index2 * num_dimensions + i];
+		sq_dist += diff * diff;
+	}
+	return sqrt(sq_dist);
+}
+
+
+void scc_ut_tiled_dists(void** state)
+{
+	(void) state;
+
+	srand(98765);
+
+	const size_t num_points = 37;
+	const uint32_t dimensions[3] = { 16, 33, 100 };
+	double* const data_matrix = malloc(sizeof(double[num_points * 100]));
+	double* const output = malloc(sizeof(double[num_points * num_points]));
+	scc_PointIndex indices[num_points];
+	for (size_t i = 0; i < num_points; ++i) {
+		indices[i] = (scc_PointIndex) ((i * 11) % num_points);
+	}
+
+	for (size_t dim_i = 0; dim_i < 3; ++dim_i) {
+		const size_t num_dimensions = dimensions[dim_i];
+		for (int far = 0; far < 2; ++far) {
+			// Far from origin, all distances are recomputed from the coordinates
+			const double shift = (far == 0) ? 0.0 : 10000.0;
+			for (size_t i = 0; i < num_points * num_dimensions; ++i) {
+				data_matrix[i] = shift + scc_rand_double(-5.0, 5.0);
+			}
+			// Duplicate points
+			for (size_t i = 0; i < num_dimensions; ++i) {
+				data_matrix[5 * num_dimensions + i] = data_matrix[4 * num_dimensions + i];
+			}
+
+			scc_DataSet* data_set;
+			assert_int_equal(scc_init_data_set(num_points, (uint32_t) num_dimensions, num_points * num_dimensions, data_matrix, &data_set), SCC_ER_OK);
+			assert_non_null(data_set->sq_norms);
+
+			for (size_t len = 2; len <= num_points; len += 7) {
+				const scc_PointIndex* const point_indices = (len % 2 == 0) ? NULL : indices;
+				assert_true(iscc_get_dist_matrix(data_set, len, point_indices, output));
+				size_t o = 0;
+				for (size_t p1 = 0; p1 < len; ++p1) {
+					for (size_t p2 = p1 + 1; p2 < len; ++p2) {
+						const size_t i1 = (point_indices == NULL) ? p1 : point_indices[p1];
+						const size_t i2 = (point_indices == NULL) ? p2 : point_indices[p2];
+						assert_double_equal(output[o], scc_ut_exact_dist(data_matrix, num_dimensions, i1, i2));
+						++o;
+					}
+				}
+			}
+
+			for (size_t len_q = 1; len_q <= num_points; len_q += 6) {
+				for (size_t len_c = 1; len_c <= num_points; len_c += 9) {
+					const scc_PointIndex* const query_indices = (len_q % 2 == 0) ? NULL : indices;
+					const scc_PointIndex* const column_indices = (len_c % 2 == 0) ? indices + 1 : NULL;
+					assert_true(iscc_get_dist_rows(data_set, len_q, query_indices, len_c, column_indices, output));
+					for (size_t q = 0; q < len_q; ++q) {
+						for (size_t c = 0; c < len_c; ++c) {
+							const size_t i1 = (query_indices == NULL) ? q : query_indices[q];
+							const size_t i2 = (column_indices == NULL) ? c : column_indices[c];
+							assert_double_equal(output[q * len_c + c], scc_ut_exact_dist(data_matrix, num_dimensions, i1, i2));
+						}
+					}
+				}
+			}
+
+			scc_free_data_set(&data_set);
+		}
+	}
+
+	free(data_matrix);
+	free(output);
+}
+
+
+void scc_ut_nearest_neighbor_search_large_k(void** state)
+{
+	(void) state;
+
+	srand(271828);
+
+	// Few distinct coordinates, so there are many ties in distance
+	const size_t num_points = 300;
+	double data_matrix[300 * 2];
+	for (size_t i = 0; i < num_points * 2; ++i) {
+		data_matrix[i] = (double) (rand() % 6);
+	}
+	scc_PointIndex search_indices[200];
+	for (size_t i = 0; i < 200; ++i) {
+		search_indices[i] = (scc_PointIndex) ((i * 7) % num_points);
+	}
+	scc_PointIndex query_indices[50];
+	for (size_t i = 0; i < 50; ++i) {
+		query_indices[i] = (scc_PointIndex) ((i * 13) % num_points);
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, 2, num_points * 2, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex out_query_indices[50];
+	scc_PointIndex out_nn_indices[50 * 150];
+	scc_PointIndex ref_nn_indices[150];
+	bool taken[300];
+
+	const uint32_t k_values[5] = { 1, 7, 63, 64, 150 };
+	for (size_t k_i = 0; k_i < 5; ++k_i) {
+		const uint32_t k = k_values[k_i];
+		for (int use_search_indices = 0; use_search_indices < 2; ++use_search_indices) {
+			const size_t len_search = use_search_indices ? 200 : num_points;
+			const scc_PointIndex* const search = use_search_indices ? search_indices : NULL;
+			for (int radius_search = 0; radius_search < 2; ++radius_search) {
+				const double radius = 2.0;
+
+				iscc_NNSearchObject* nn_search_object;
+				assert_true(iscc_init_nn_search_object(data_set, len_search, search, &nn_search_object));
+				size_t num_ok = 0;
+				assert_true(iscc_nearest_neighbor_search(nn_search_object, 50, query_indices, k, radius_search, radius,
+				                                         &num_ok, out_query_indices, out_nn_indices));
+				assert_true(iscc_close_nn_search_object(&nn_search_object));
+
+				// Reference: repeatedly take the closest point, preferring earlier search points
+				size_t ref_num_ok = 0;
+				for (size_t q = 0; q < 50; ++q) {
+					const size_t query = (size_t) query_indices[q];
+					for (size_t s = 0; s < len_search; ++s) taken[s] = false;
+					bool query_ok = true;
+					for (uint32_t j = 0; (j < k) && query_ok; ++j) {
+						size_t best = len_search;
+						double best_dist = 0.0;
+						for (size_t s = 0; s < len_search; ++s) {
+							const size_t point = (search == NULL) ? s : (size_t) search[s];
+							const double dist = scc_ut_exact_dist(data_matrix, 2, query, point);
+							if (!taken[s] && ((best == len_search) || (dist < best_dist))) {
+								best = s;
+								best_dist = dist;
+							}
+						}
+						taken[best] = true;
+						ref_nn_indices[j] = (search == NULL) ? (scc_PointIndex) best : search[best];
+						query_ok = !radius_search || !(best_dist > radius);
+					}
+					if (!query_ok) continue;
+
+					assert_true(ref_num_ok < num_ok);
+					assert_int_equal(out_query_indices[ref_num_ok], query);
+					assert_memory_equal(out_nn_indices + ref_num_ok * k, ref_nn_indices, k * sizeof(scc_PointIndex));
+					++ref_num_ok;
+				}
+				assert_int_equal(num_ok, ref_num_ok);
+			}
+		}
+	}
+
+	scc_free_data_set(&data_set);
+}
+
+
+static void scc_ut_compare_pivot_with_brute_force(scc_DataSet* const data_set,
+                                                  const size_t len_search_indices,
+                                                  const scc_PointIndex* const search_indices,
+                                                  const size_t len_query_indices,
+                                                  const scc_PointIndex* const query_indices,
+                                                  const uint32_t k,
+                                                  const bool radius_search,
+                                                  const double radius)
+{
+	scc_PointIndex* const ref_query_out = malloc(sizeof(scc_PointIndex[len_query_indices]));
+	scc_PointIndex* const ref_nn_out = malloc(sizeof(scc_PointIndex[len_query_indices * k]));
+	scc_PointIndex* const piv_query_out = malloc(sizeof(scc_PointIndex[len_query_indices]));
+	scc_PointIndex* const piv_nn_out = malloc(sizeof(scc_PointIndex[len_query_indices * k]));
+
+	size_t ref_num_ok = 0;
+	iscc_NNSearchObject* ref_search;
+	assert_true(iscc_imp_init_nn_search_object(data_set, len_search_indices, search_indices, &ref_search));
+	assert_true(iscc_imp_nearest_neighbor_search(ref_search, len_query_indices, query_indices, k, radius_search, radius,
+	                                             &ref_num_ok, ref_query_out, ref_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&ref_search));
+
+	size_t piv_num_ok = 0;
+	iscc_NNSearchObject* piv_search;
+	assert_true(iscc_imp_init_pivot_nn_search_object(data_set, len_search_indices, search_indices, &piv_search));
+	assert_true(iscc_imp_nearest_neighbor_search(piv_search, len_query_indices, query_indices, k, radius_search, radius,
+	                                             &piv_num_ok, piv_query_out, piv_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&piv_search));
+	assert_null(piv_search);
+
+	assert_int_equal(piv_num_ok, ref_num_ok);
+	if (ref_num_ok > 0) {
+		assert_memory_equal(piv_query_out, ref_query_out, ref_num_ok * sizeof(scc_PointIndex));
+		assert_memory_equal(piv_nn_out, ref_nn_out, ref_num_ok * k * sizeof(scc_PointIndex));
+	}
+
+	free(ref_query_out);
+	free(ref_nn_out);
+	free(piv_query_out);
+	free(piv_nn_out);
+}
+
+
+void scc_ut_pivot_nearest_neighbor_search(void** state)
+{
+	(void) state;
+
+	srand(314159);
+
+	// Clusters of points on an integer grid, so there are many ties in distance
+	const size_t num_points = 600;
+	const uint32_t num_dimensions = 12;
+	double data_matrix[600 * 12];
+	double centers[10 * 12];
+	for (size_t i = 0; i < 10 * num_dimensions; ++i) {
+		centers[i] = (double) (rand() % 50);
+	}
+	for (size_t i = 0; i < num_points; ++i) {
+		const size_t center = (size_t) (rand() % 10);
+		for (size_t d = 0; d < num_dimensions; ++d) {
+			data_matrix[i * num_dimensions + d] = centers[center * num_dimensions + d] + (double) (rand() % 3);
+		}
+	}
+	// Duplicate points
+	for (size_t i = 0; i < 20; ++i) {
+		for (size_t d = 0; d < num_dimensions; ++d) {
+			data_matrix[(i + 100) * num_dimensions + d] = data_matrix[i * num_dimensions + d];
+		}
+	}
+
+	scc_PointIndex search_indices[400];
+	for (size_t i = 0; i < 400; ++i) {
+		search_indices[i] = (scc_PointIndex) ((i * 7) % num_points);
+	}
+	scc_PointIndex query_indices[600];
+	for (size_t i = 0; i < num_points; ++i) {
+		query_indices[i] = (scc_PointIndex) i;
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, data_matrix, &data_set), SCC_ER_OK);
+
+	const uint32_t k_values[4] = { 1, 5, 30, 100 };
+	for (size_t k_i = 0; k_i < 4; ++k_i) {
+		const uint32_t k = k_values[k_i];
+		scc_ut_compare_pivot_with_brute_force(data_set, num_points, NULL, num_points, query_indices, k, false, 0.0);
+		scc_ut_compare_pivot_with_brute_force(data_set, 400, search_indices, 150, query_indices + 3, k, false, 0.0);
+		scc_ut_compare_pivot_with_brute_force(data_set, num_points, NULL, num_points, query_indices, k, true, 4.0);
+		scc_ut_compare_pivot_with_brute_force(data_set, 400, search_indices, num_points, query_indices, k, true, 3.0);
+	}
+
+	// Search sets too small for a pivot table
+	scc_ut_compare_pivot_with_brute_force(data_set, 100, search_indices, 50, query_indices, 5, false, 0.0);
+
+	// All points coincide
+	for (size_t i = 0; i < num_points * num_dimensions; ++i) {
+		data_matrix[i] = 1.0;
+	}
+	scc_ut_compare_pivot_with_brute_force(data_set, num_points, NULL, 50, query_indices, 10, false, 0.0);
+	scc_ut_compare_pivot_with_brute_force(data_set, num_points, NULL, 50, query_indices, 10, true, 1.0);
+
+	scc_free_data_set(&data_set);
+}
+
+
 int main(void)
 {
 	if(!scc_ut_init_tests()) return 1;
@@ -1264,11 +1540,14 @@ int main(void)
 		cmocka_unit_test(scc_ut_num_data_points),
 		cmocka_unit_test(scc_ut_get_dist_matrix),
 		cmocka_unit_test(scc_ut_get_dist_rows),
+		cmocka_unit_test(scc_ut_tiled_dists),
 		cmocka_unit_test(scc_ut_init_close_max_dist_object),
 		cmocka_unit_test(scc_ut_get_max_dist),
 		cmocka_unit_test(scc_ut_init_close_nn_search_object),
 		cmocka_unit_test(scc_ut_nearest_neighbor_search),
 		cmocka_unit_test(scc_ut_nearest_neighbor_search_radius),
+		cmocka_unit_test(scc_ut_nearest_neighbor_search_large_k),
+		cmocka_unit_test(scc_ut_pivot_nearest_neighbor_search),
 	};
 
 	return cmocka_run_group_tests_name("dist_search.c", test_cases, NULL, NULL);
@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <include/scclust.h>
 #include <src/error.h>
+#include <src/threads.h>
 
 
 void scc_ut_get_error_message(void** state)
@@ -49,13 +50,13 @@ void scc_ut_get_error_message(void** state)
 	bool err_res4 = scc_get_latest_error(buffer_size, text_buffer);
 	assert_true(err_res4);
 	assert_int_equal(ec4, SCC_ER_INVALID_INPUT);
-	assert_string_equal(text_buffer, "(scclust:test_error.c:48) Function parameters are invalid.");
+	assert_string_equal(text_buffer, "(scclust:test_error.c:49) Function parameters are invalid.");
 
 	scc_ErrorCode ec4b = iscc_make_error_msg(SCC_ER_INVALID_INPUT, "Test message 12345.");
 	bool err_res4b = scc_get_latest_error(buffer_size, text_buffer);
 	assert_true(err_res4b);
 	assert_int_equal(ec4b, SCC_ER_INVALID_INPUT);
-	assert_string_equal(text_buffer, "(scclust:test_error.c:54) Test message 12345.");
+	assert_string_equal(text_buffer, "(scclust:test_error.c:55) Test message 12345.");
 
 	iscc_reset_error();
 	bool err_res5 = scc_get_latest_error(buffer_size, text_buffer);
@@ -112,12 +113,55 @@ void scc_ut_get_error_message(void** state)
 }
 
 
+void scc_ut_thread_local_error(void** state)
+{
+	(void) state;
+
+	iscc_reset_error();
+
+	#ifdef _OPENMP
+		char text_buffer[2][256];
+		bool err_res[2] = { false, false };
+
+		ISCC_OMP_PRAGMA(omp parallel num_threads(2))
+		{
+			const uint32_t thread = iscc_get_thread_num();
+			if (thread == 0) {
+				iscc_make_error__(SCC_ER_NO_MEMORY, NULL, "dummy9.c", 9);
+			}
+			ISCC_OMP_PRAGMA(omp barrier)
+			if (thread < 2) {
+				err_res[thread] = scc_get_latest_error(256, text_buffer[thread]);
+			}
+		}
+
+		assert_true(err_res[0]);
+		assert_string_equal(text_buffer[0], "(scclust:dummy9.c:9) Cannot allocate required memory.");
+		if (err_res[1]) {
+			assert_string_equal(text_buffer[1], "(scclust) No error.");
+		}
+	#endif
+
+	char main_buffer[256];
+	assert_true(scc_get_latest_error(256, main_buffer));
+	#ifdef _OPENMP
+		// The master thread made the error in the region
+		assert_string_equal(main_buffer, "(scclust:dummy9.c:9) Cannot allocate required memory.");
+	#else
+		assert_string_equal(main_buffer, "(scclust) No error.");
+	#endif
+
+	iscc_reset_error();
+}
+
+
 int main(void)
 {
 	if(!scc_ut_init_tests()) return 1;
 
 	const struct CMUnitTest test_cases[] = {
 		cmocka_unit_test(scc_ut_get_error_message),
+		cmocka_unit_test(scc_ut_thread_local_error),
 	};
 
 	return cmocka_run_group_tests_name("error.c", test_cases, NULL, NULL);
@@ -19,6 +19,7 @@
  * ========================================================================== */
 
 #include "init_test.h"
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -184,8 +185,10 @@ void scc_ut_hi_run_hierarchical_clustering(void** state)
 		.pointindex_array2 = malloc(sizeof(scc_PointIndex[100])),
 		.dist_array = malloc(sizeof(double[200])),
 		.vertex_markers = calloc(100, sizeof(uint_fast16_t)),
-		.edge_store1 = malloc(sizeof(iscc_hi_DistanceEdge[100])),
-		.edge_store2 = malloc(sizeof(iscc_hi_DistanceEdge[100])),
+		.head_store1 = malloc(sizeof(scc_PointIndex[100])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[100])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[100])),
+		.dist_scratch = malloc(sizeof(double[100])),
 	};
 
 	scc_Clustering cl1 = {
@@ -314,8 +317,10 @@ void scc_ut_hi_run_hierarchical_clustering(void** state)
 	free(wa.pointindex_array2);
 	free(wa.dist_array);
 	free(wa.vertex_markers);
-	free(wa.edge_store1);
-	free(wa.edge_store2);
+	free(wa.head_store1);
+	free(wa.head_store2);
+	free(wa.head_scratch);
+	free(wa.dist_scratch);
 }
 
 
@@ -391,8 +396,10 @@ void scc_ut_hi_break_cluster_into_two(void** state)
 		.pointindex_array2 = malloc(sizeof(scc_PointIndex[100])),
 		.dist_array = malloc(sizeof(double[100])),
 		.vertex_markers = calloc(100, sizeof(uint_fast16_t)),
-		.edge_store1 = malloc(sizeof(iscc_hi_DistanceEdge[40])),
-		.edge_store2 = malloc(sizeof(iscc_hi_DistanceEdge[40])),
+		.head_store1 = malloc(sizeof(scc_PointIndex[40])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[40])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[40])),
+		.dist_scratch = malloc(sizeof(double[40])),
 	};
 
 	scc_PointIndex members1[10] = { 2, 4, 6, 8, 10, 12, 14, 16, 18, 20 };
@@ -547,8 +554,10 @@ void scc_ut_hi_break_cluster_into_two(void** state)
 	free(wa.pointindex_array2);
 	free(wa.dist_array);
 	free(wa.vertex_markers);
-	free(wa.edge_store1);
-	free(wa.edge_store2);
+	free(wa.head_store1);
+	free(wa.head_store2);
+	free(wa.head_scratch);
+	free(wa.dist_scratch);
 }
 
 
@@ -626,91 +635,104 @@ void scc_ut_hi_get_next_k_nn(void** state)
 		.pointindex_array2 = NULL,
 		.dist_array = malloc(sizeof(double[20])),
 		.vertex_markers = calloc(100, sizeof(uint_fast16_t)),
-		.edge_store1 = malloc(sizeof(iscc_hi_DistanceEdge[10])),
-		.edge_store2 = malloc(sizeof(iscc_hi_DistanceEdge[10])),
+		.head_store1 = malloc(sizeof(scc_PointIndex[10])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[10])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[10])),
+		.dist_scratch = malloc(sizeof(double[10])),
 	};
 
-	assert_int_equal(iscc_hi_populate_edge_lists(&cl, scc_ut_test_data_large, 6, 16, &wa), SCC_ER_OK);
+	iscc_hi_EdgeList list1;
+	iscc_hi_EdgeList list2;
+	assert_int_equal(iscc_hi_populate_edge_lists(&cl, scc_ut_test_data_large, 6, 16, &wa, &list1, &list2), SCC_ER_OK);
 
+	// list1: 12, 16, 18, 4, 10, 14, 20, 8, 2
 	scc_PointIndex out_dist_array0[4];
 	const scc_PointIndex ref_dist_array0[4] = { 12, 16, 18, 4 };
-	iscc_hi_DistanceEdge* prev_dist0 = iscc_hi_get_next_k_nn(wa.edge_store1, 4, wa.vertex_markers, 1, out_dist_array0);
+	size_t pos0 = iscc_hi_get_next_k_nn(&list1, 4, wa.vertex_markers, 1, out_dist_array0);
 	assert_memory_equal(out_dist_array0, ref_dist_array0, 4 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_dist0->head, 4);
-	assert_double_equal(prev_dist0->distance, 72.125847);
-	assert_ptr_equal(prev_dist0->next_dist, prev_dist0 + 1);
-
-	scc_PointIndex out_dist_array1[4];
-	const scc_PointIndex ref_dist_array1[4] = { 18, 4, 10, 14 };
-	iscc_hi_DistanceEdge* prev_dist1 = iscc_hi_get_next_k_nn(&wa.edge_store1[2], 4, wa.vertex_markers, 1, out_dist_array1);
-	assert_memory_equal(out_dist_array1, ref_dist_array1, 4 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_dist1->head, 14);
-	assert_double_equal(prev_dist1->distance, 80.566800);
-	assert_ptr_equal(prev_dist1->next_dist, prev_dist1 + 1);
+	assert_int_equal(pos0, 3);
+	assert_int_equal(list1.heads[pos0], 4);
+	assert_double_equal(list1.distances[pos0], 72.125847);
+	assert_int_equal(list1.next, 0);
 
 	wa.vertex_markers[18] = 1;
 	wa.vertex_markers[4] = 1;
 	wa.vertex_markers[8] = 1;
 
-	scc_PointIndex out_dist_arrayY[4];
-	const scc_PointIndex ref_dist_arrayY[4] = { 12, 16, 10, 14 };
-	iscc_hi_DistanceEdge* prev_distY = iscc_hi_get_next_k_nn(wa.edge_store1, 4, wa.vertex_markers, 1, out_dist_arrayY);
-	assert_memory_equal(out_dist_arrayY, ref_dist_arrayY, 4 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_distY->head, 14);
-	assert_double_equal(prev_distY->distance, 80.566800);
-	assert_ptr_equal(prev_distY->next_dist, prev_distY + 1);
-
-	scc_PointIndex out_dist_arrayX[2];
-	const scc_PointIndex ref_dist_arrayX[2] = { 12, 16 };
-	iscc_hi_DistanceEdge* prev_distX = iscc_hi_get_next_k_nn(wa.edge_store1, 2, wa.vertex_markers, 1, out_dist_arrayX);
-	assert_memory_equal(out_dist_arrayX, ref_dist_arrayX, 2 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_distX->head, 16);
-	assert_double_equal(prev_distX->distance, 43.918798);
-	assert_ptr_equal(prev_distX->next_dist, prev_distX + 3);
-
-	scc_PointIndex out_dist_array2[4];
-	const scc_PointIndex ref_dist_array2[4] = { 10, 14, 20, 2 };
-	iscc_hi_DistanceEdge* prev_dist2 = iscc_hi_get_next_k_nn(&wa.edge_store1[2], 4, wa.vertex_markers, 1, out_dist_array2);
-	assert_memory_equal(out_dist_array2, ref_dist_array2, 4 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_dist2->head, 2);
-	assert_double_equal(prev_dist2->distance, 103.030113);
-	assert_null(prev_dist2->next_dist);
+	scc_PointIndex out_dist_array1[4];
+	const scc_PointIndex ref_dist_array1[4] = { 12, 16, 10, 14 };
+	size_t pos1 = iscc_hi_get_next_k_nn(&list1, 4, wa.vertex_markers, 1, out_dist_array1);
+	assert_memory_equal(out_dist_array1, ref_dist_array1, 4 * sizeof(scc_PointIndex));
+	assert_int_equal(pos1, 5);
+	assert_int_equal(list1.heads[pos1], 14);
+	assert_double_equal(list1.distances[pos1], 80.566800);
+	// Assigned points are compacted away
+	assert_int_equal(list1.next, 2);
+	assert_memory_equal(&list1.heads[2], ref_dist_array1, 4 * sizeof(scc_PointIndex));
+	assert_double_equal(list1.distances[2], 30.550623);
+	assert_double_equal(list1.distances[3], 43.918798);
+	assert_double_equal(list1.distances[4], 76.285875);
+
+	scc_PointIndex out_dist_array2[2];
+	const scc_PointIndex ref_dist_array2[2] = { 12, 16 };
+	size_t pos2 = iscc_hi_get_next_k_nn(&list1, 2, wa.vertex_markers, 1, out_dist_array2);
+	assert_memory_equal(out_dist_array2, ref_dist_array2, 2 * sizeof(scc_PointIndex));
+	assert_int_equal(pos2, 3);
+	assert_int_equal(list1.heads[pos2], 16);
+	assert_double_equal(list1.distances[pos2], 43.918798);
+	assert_int_equal(list1.next, 2);
+
+	wa.vertex_markers[12] = 1;
+	wa.vertex_markers[16] = 1;
+
+	scc_PointIndex out_dist_array3[3];
+	const scc_PointIndex ref_dist_array3[3] = { 10, 14, 20 };
+	size_t pos3 = iscc_hi_get_next_k_nn(&list1, 3, wa.vertex_markers, 1, out_dist_array3);
+	assert_memory_equal(out_dist_array3, ref_dist_array3, 3 * sizeof(scc_PointIndex));
+	assert_int_equal(pos3, 6);
+	assert_int_equal(list1.heads[pos3], 20);
+	assert_double_equal(list1.distances[pos3], 81.300565);
+	assert_int_equal(list1.next, 4);
 
 	wa.vertex_markers[20] = 1;
 
-	scc_PointIndex out_dist_array3[4];
-	const scc_PointIndex ref_dist_array3[4] = { 16, 10, 14, 2 };
-	iscc_hi_DistanceEdge* prev_dist3 = iscc_hi_get_next_k_nn(&wa.edge_store1[1], 4, wa.vertex_markers, 1, out_dist_array3);
-	assert_memory_equal(out_dist_array3, ref_dist_array3, 4 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_dist3->head, 2);
-	assert_double_equal(prev_dist3->distance, 103.030113);
-	assert_null(prev_dist3->next_dist);
-
-
-	scc_PointIndex out_dist_array4[1];
-	const scc_PointIndex ref_dist_array4[1] = { 8 };
-	iscc_hi_DistanceEdge* prev_dist4 = iscc_hi_get_next_k_nn(&wa.edge_store2[4], 1, wa.vertex_markers, 2, out_dist_array4);
-	assert_memory_equal(out_dist_array4, ref_dist_array4, 1 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_dist4->head, 8);
-	assert_double_equal(prev_dist4->distance, 62.616031);
-	assert_ptr_equal(prev_dist4->next_dist, prev_dist4 + 1);
-
-	wa.vertex_markers[4] = 2;
+	scc_PointIndex out_dist_array4[3];
+	const scc_PointIndex ref_dist_array4[3] = { 10, 14, 2 };
+	size_t pos4 = iscc_hi_get_next_k_nn(&list1, 3, wa.vertex_markers, 1, out_dist_array4);
+	assert_memory_equal(out_dist_array4, ref_dist_array4, 3 * sizeof(scc_PointIndex));
+	assert_int_equal(pos4, 8);
+	assert_int_equal(list1.heads[pos4], 2);
+	assert_double_equal(list1.distances[pos4], 103.030113);
+	assert_int_equal(list1.next, 6);
+	assert_memory_equal(&list1.heads[6], ref_dist_array4, 3 * sizeof(scc_PointIndex));
+
+	// list2: 12, 6, 14, 20, 8, 10, 4, 2, 18
+	scc_PointIndex out_dist_array5[1];
+	const scc_PointIndex ref_dist_array5[1] = { 12 };
+	size_t pos5 = iscc_hi_get_next_k_nn(&list2, 1, wa.vertex_markers, 2, out_dist_array5);
+	assert_memory_equal(out_dist_array5, ref_dist_array5, 1 * sizeof(scc_PointIndex));
+	assert_int_equal(pos5, 0);
+	assert_double_equal(list2.distances[pos5], 43.831474);
+
+	wa.vertex_markers[12] = 2;
 	wa.vertex_markers[14] = 2;
 	wa.vertex_markers[20] = 2;
 
-	scc_PointIndex out_dist_array5[3];
-	const scc_PointIndex ref_dist_array5[3] = { 8, 10, 2 };
-	iscc_hi_DistanceEdge* prev_dist5 = iscc_hi_get_next_k_nn(&wa.edge_store2[2], 3, wa.vertex_markers, 2, out_dist_array5);
-	assert_memory_equal(out_dist_array5, ref_dist_array5, 3 * sizeof(scc_PointIndex));
-	assert_int_equal(prev_dist5->head, 2);
-	assert_double_equal(prev_dist5->distance, 83.120587);
-	assert_ptr_equal(prev_dist5->next_dist, prev_dist5 + 1);
+	scc_PointIndex out_dist_array6[3];
+	const scc_PointIndex ref_dist_array6[3] = { 6, 8, 10 };
+	size_t pos6 = iscc_hi_get_next_k_nn(&list2, 3, wa.vertex_markers, 2, out_dist_array6);
+	assert_memory_equal(out_dist_array6, ref_dist_array6, 3 * sizeof(scc_PointIndex));
+	assert_int_equal(pos6, 5);
+	assert_int_equal(list2.heads[pos6], 10);
+	assert_double_equal(list2.distances[pos6], 73.970019);
+	assert_int_equal(list2.next, 3);
 
 	free(wa.dist_array);
 	free(wa.vertex_markers);
-	free(wa.edge_store1);
-	free(wa.edge_store2);
+	free(wa.head_store1);
+	free(wa.head_store2);
+	free(wa.head_scratch);
+	free(wa.dist_scratch);
 }
 
 
@@ -730,113 +752,76 @@ void scc_ut_hi_get_next_dist(void** state)
 		.pointindex_array2 = NULL,
 		.dist_array = malloc(sizeof(double[10])),
 		.vertex_markers = calloc(100, sizeof(uint_fast16_t)),
-		.edge_store1 = malloc(sizeof(iscc_hi_DistanceEdge[5])),
-		.edge_store2 = malloc(sizeof(iscc_hi_DistanceEdge[5])),
+		.head_store1 = malloc(sizeof(scc_PointIndex[5])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[5])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[5])),
+		.dist_scratch = malloc(sizeof(double[5])),
 	};
 
-	assert_int_equal(iscc_hi_populate_edge_lists(&cl, scc_ut_test_data_large, 6, 4, &wa), SCC_ER_OK);
-
-	assert_int_equal(wa.edge_store1[1].head, 4);
-	assert_double_equal(wa.edge_store1[1].distance, 72.125847);
-	assert_int_equal(wa.edge_store1[2].head, 10);
-	assert_double_equal(wa.edge_store1[2].distance, 76.285875);
-	assert_int_equal(wa.edge_store1[3].head, 8);
-	assert_double_equal(wa.edge_store1[3].distance, 82.249050);
-	assert_int_equal(wa.edge_store1[4].head, 2);
-	assert_double_equal(wa.edge_store1[4].distance, 103.030113);
-	for (size_t i = 0; i < 4; ++i) {
-		assert_ptr_equal(wa.edge_store1[i].next_dist, &wa.edge_store1[i + 1]);
-    }
-    assert_null(wa.edge_store1[4].next_dist);
-
-	assert_int_equal(wa.edge_store2[1].head, 2);
-	assert_double_equal(wa.edge_store2[1].distance, 63.103580);
-	assert_int_equal(wa.edge_store2[2].head, 10);
-	assert_double_equal(wa.edge_store2[2].distance, 67.606177);
-	assert_int_equal(wa.edge_store2[3].head, 6);
-	assert_double_equal(wa.edge_store2[3].distance, 72.125847);
-	assert_int_equal(wa.edge_store2[4].head, 8);
-	assert_double_equal(wa.edge_store2[4].distance, 89.098152);
-	for (size_t i = 0; i < 4; ++i) {
-		assert_ptr_equal(wa.edge_store2[i].next_dist, &wa.edge_store2[i + 1]);
-    }
-    assert_null(wa.edge_store2[4].next_dist);
-
-
-    iscc_hi_DistanceEdge* next0 = iscc_hi_get_next_dist(wa.edge_store1, wa.vertex_markers, 1);
-	assert_int_equal(next0->head, 4);
-	assert_double_equal(next0->distance, 72.125847);
-	assert_ptr_equal(next0->next_dist, &wa.edge_store1[2]);
-
-	iscc_hi_DistanceEdge* next1 = iscc_hi_get_next_dist(&wa.edge_store1[2], wa.vertex_markers, 1);
-	assert_int_equal(next1->head, 8);
-	assert_double_equal(next1->distance, 82.249050);
-	assert_ptr_equal(next1->next_dist, &wa.edge_store1[4]);
-
-	iscc_hi_DistanceEdge* next2 = iscc_hi_get_next_dist(&wa.edge_store1[3], wa.vertex_markers, 1);
-	assert_int_equal(next2->head, 2);
-	assert_double_equal(next2->distance, 103.030113);
-	assert_null(next2->next_dist);
+	iscc_hi_EdgeList list1;
+	iscc_hi_EdgeList list2;
+	assert_int_equal(iscc_hi_populate_edge_lists(&cl, scc_ut_test_data_large, 6, 4, &wa, &list1, &list2), SCC_ER_OK);
+
+	const scc_PointIndex ref_heads1[4] = { 4, 10, 8, 2 };
+	const scc_PointIndex ref_heads2[4] = { 2, 10, 6, 8 };
+	assert_int_equal(list1.len, 4);
+	assert_int_equal(list1.next, 0);
+	assert_memory_equal(list1.heads, ref_heads1, 4 * sizeof(scc_PointIndex));
+	assert_double_equal(list1.distances[0], 72.125847);
+	assert_double_equal(list1.distances[1], 76.285875);
+	assert_double_equal(list1.distances[2], 82.249050);
+	assert_double_equal(list1.distances[3], 103.030113);
+	assert_int_equal(list2.len, 4);
+	assert_int_equal(list2.next, 0);
+	assert_memory_equal(list2.heads, ref_heads2, 4 * sizeof(scc_PointIndex));
+	assert_double_equal(list2.distances[0], 63.103580);
+	assert_double_equal(list2.distances[1], 67.606177);
+	assert_double_equal(list2.distances[2], 72.125847);
+	assert_double_equal(list2.distances[3], 89.098152);
+
+	size_t next0 = iscc_hi_get_next_dist(&list1, wa.vertex_markers, 1);
+	assert_int_equal(next0, 0);
+	assert_int_equal(list1.heads[next0], 4);
+	assert_double_equal(list1.distances[next0], 72.125847);
+
+	wa.vertex_markers[4] = 1;
+
+	size_t next1 = iscc_hi_get_next_dist(&list1, wa.vertex_markers, 1);
+	assert_int_equal(next1, 1);
+	assert_int_equal(list1.heads[next1], 10);
+	assert_double_equal(list1.distances[next1], 76.285875);
+	assert_int_equal(list1.next, 1);
 
+	wa.vertex_markers[10] = 1;
 	wa.vertex_markers[8] = 1;
 
-	iscc_hi_DistanceEdge* next3 = iscc_hi_get_next_dist(&wa.edge_store1[2], wa.vertex_markers, 1);
-	assert_int_equal(next3->head, 2);
-	assert_double_equal(next3->distance, 103.030113);
-	assert_null(next3->next_dist);
-
-	iscc_hi_DistanceEdge* next4 = iscc_hi_get_next_dist(&wa.edge_store1[2], wa.vertex_markers, 1);
-	assert_int_equal(next4->head, 2);
-	assert_double_equal(next4->distance, 103.030113);
-	assert_null(next4->next_dist);
-
-	assert_int_equal(wa.edge_store1[1].head, 4);
-	assert_double_equal(wa.edge_store1[1].distance, 72.125847);
-	assert_int_equal(wa.edge_store1[2].head, 10);
-	assert_double_equal(wa.edge_store1[2].distance, 76.285875);
-	assert_int_equal(wa.edge_store1[3].head, 8);
-	assert_double_equal(wa.edge_store1[3].distance, 82.249050);
-	assert_int_equal(wa.edge_store1[4].head, 2);
-	assert_double_equal(wa.edge_store1[4].distance, 103.030113);
-
-	assert_ptr_equal(wa.edge_store1[0].next_dist, &wa.edge_store1[1]);
-	assert_ptr_equal(wa.edge_store1[1].next_dist, &wa.edge_store1[2]);
-	assert_ptr_equal(wa.edge_store1[2].next_dist, &wa.edge_store1[4]);
-	assert_ptr_equal(wa.edge_store1[3].next_dist, &wa.edge_store1[4]);
-	assert_null(wa.edge_store1[4].next_dist);
+	size_t next2 = iscc_hi_get_next_dist(&list1, wa.vertex_markers, 1);
+	assert_int_equal(next2, 3);
+	assert_int_equal(list1.heads[next2], 2);
+	assert_double_equal(list1.distances[next2], 103.030113);
+	assert_int_equal(list1.next, 3);
+
+	size_t next3 = iscc_hi_get_next_dist(&list1, wa.vertex_markers, 1);
+	assert_int_equal(next3, 3);
+	assert_memory_equal(list1.heads, ref_heads1, 4 * sizeof(scc_PointIndex));
 
 	wa.vertex_markers[2] = 1;
-	wa.vertex_markers[10] = 1;
 
-	iscc_hi_DistanceEdge* next5 = iscc_hi_get_next_dist(wa.edge_store2, wa.vertex_markers, 1);
-	assert_int_equal(next5->head, 6);
-	assert_double_equal(next5->distance, 72.125847);
-	assert_ptr_equal(next5->next_dist, &wa.edge_store2[4]);
-
-	iscc_hi_DistanceEdge* next6 = iscc_hi_get_next_dist(wa.edge_store2, wa.vertex_markers, 1);
-	assert_int_equal(next6->head, 6);
-	assert_double_equal(next6->distance, 72.125847);
-	assert_ptr_equal(next6->next_dist, &wa.edge_store2[4]);
-
-	assert_int_equal(wa.edge_store2[1].head, 2);
-	assert_double_equal(wa.edge_store2[1].distance, 63.103580);
-	assert_int_equal(wa.edge_store2[2].head, 10);
-	assert_double_equal(wa.edge_store2[2].distance, 67.606177);
-	assert_int_equal(wa.edge_store2[3].head, 6);
-	assert_double_equal(wa.edge_store2[3].distance, 72.125847);
-	assert_int_equal(wa.edge_store2[4].head, 8);
-	assert_double_equal(wa.edge_store2[4].distance, 89.098152);
-
-	assert_ptr_equal(wa.edge_store2[0].next_dist, &wa.edge_store2[3]);
-	assert_ptr_equal(wa.edge_store2[1].next_dist, &wa.edge_store2[2]);
-	assert_ptr_equal(wa.edge_store2[2].next_dist, &wa.edge_store2[3]);
-	assert_ptr_equal(wa.edge_store2[3].next_dist, &wa.edge_store2[4]);
-	assert_null(wa.edge_store2[4].next_dist);
+	size_t next4 = iscc_hi_get_next_dist(&list2, wa.vertex_markers, 1);
+	assert_int_equal(next4, 2);
+	assert_int_equal(list2.heads[next4], 6);
+	assert_double_equal(list2.distances[next4], 72.125847);
+
+	size_t next5 = iscc_hi_get_next_dist(&list2, wa.vertex_markers, 1);
+	assert_int_equal(next5, 2);
+	assert_memory_equal(list2.heads, ref_heads2, 4 * sizeof(scc_PointIndex));
 
 	free(wa.dist_array);
 	free(wa.vertex_markers);
-	free(wa.edge_store1);
-	free(wa.edge_store2);
+	free(wa.head_store1);
+	free(wa.head_store2);
+	free(wa.head_scratch);
+	free(wa.dist_scratch);
 }
 
 
@@ -1197,8 +1182,8 @@ void scc_ut_hi_find_centers(void** state)
 		.pointindex_array2 = malloc(sizeof(scc_PointIndex[100])),
 		.dist_array = malloc(sizeof(double[100])),
 		.vertex_markers = calloc(100, sizeof(uint_fast16_t)),
-		.edge_store1 = NULL,
-		.edge_store2 = NULL,
+		.head_store1 = NULL,
+		.head_store2 = NULL,
 	};
 
 	scc_PointIndex ref_members1[10] = { 2, 4, 6, 8, 10, 12, 14, 16, 18, 20 };
@@ -1282,8 +1267,8 @@ void scc_ut_hi_find_centers_second(void** state)
 		.pointindex_array2 = malloc(sizeof(scc_PointIndex[100])),
 		.dist_array = malloc(sizeof(double[100])),
 		.vertex_markers = calloc(100, sizeof(uint_fast16_t)),
-		.edge_store1 = NULL,
-		.edge_store2 = NULL,
+		.head_store1 = NULL,
+		.head_store2 = NULL,
 	};
 
 	scc_PointIndex members1[40] = { 34, 42, 78, 27, 99, 67, 29, 18, 92, 25,
@@ -1325,38 +1310,44 @@ void scc_ut_hi_populate_edge_lists(void** state)
 		.pointindex_array2 = NULL,
 		.dist_array = malloc(sizeof(double[8])),
 		.vertex_markers = NULL,
-		.edge_store1 = malloc(sizeof(iscc_hi_DistanceEdge[4])),
-		.edge_store2 = malloc(sizeof(iscc_hi_DistanceEdge[4])),
+		.head_store1 = malloc(sizeof(scc_PointIndex[4])),
+		.head_store2 = malloc(sizeof(scc_PointIndex[4])),
+		.head_scratch = malloc(sizeof(scc_PointIndex[4])),
+		.dist_scratch = malloc(sizeof(double[4])),
 	};
 
-	scc_ErrorCode ec = iscc_hi_populate_edge_lists(&cl, scc_ut_test_data_large, 10, 5, &wa);
+	iscc_hi_EdgeList list1;
+	iscc_hi_EdgeList list2;
+	scc_ErrorCode ec = iscc_hi_populate_edge_lists(&cl, scc_ut_test_data_large, 10, 5, &wa, &list1, &list2);
 	assert_int_equal(ec, SCC_ER_OK);
 
-	assert_int_equal(wa.edge_store1[1].head, 3);
-	assert_double_equal(wa.edge_store1[1].distance, 65.042314);
-	assert_int_equal(wa.edge_store1[2].head, 5);
-	assert_double_equal(wa.edge_store1[2].distance, 82.967209);
-	assert_int_equal(wa.edge_store1[3].head, 2);
-	assert_double_equal(wa.edge_store1[3].distance, 102.986773);
-	for (size_t i = 0; i < 3; ++i) {
-		assert_ptr_equal(wa.edge_store1[i].next_dist, &wa.edge_store1[i + 1]);
-    }
-    assert_null(wa.edge_store1[3].next_dist);
-
-	assert_int_equal(wa.edge_store2[1].head, 2);
-	assert_double_equal(wa.edge_store2[1].distance, 21.423179);
-	assert_int_equal(wa.edge_store2[2].head, 3);
-	assert_double_equal(wa.edge_store2[2].distance, 52.901061);
-	assert_int_equal(wa.edge_store2[3].head, 10);
-	assert_double_equal(wa.edge_store2[3].distance, 82.967209);
-	for (size_t i = 0; i < 3; ++i) {
-		assert_ptr_equal(wa.edge_store2[i].next_dist, &wa.edge_store2[i + 1]);
-    }
-    assert_null(wa.edge_store2[3].next_dist);
-
-    free(wa.dist_array);
-    free(wa.edge_store1);
-    free(wa.edge_store2);
+	assert_int_equal(list1.len, 3);
+	assert_int_equal(list1.next, 0);
+	assert_ptr_equal(list1.heads, wa.head_store1);
+	assert_ptr_equal(list1.distances, wa.dist_array);
+	assert_int_equal(list1.heads[0], 3);
+	assert_double_equal(list1.distances[0], 65.042314);
+	assert_int_equal(list1.heads[1], 5);
+	assert_double_equal(list1.distances[1], 82.967209);
+	assert_int_equal(list1.heads[2], 2);
+	assert_double_equal(list1.distances[2], 102.986773);
+
+	assert_int_equal(list2.len, 3);
+	assert_int_equal(list2.next, 0);
+	assert_ptr_equal(list2.heads, wa.head_store2);
+	assert_ptr_equal(list2.distances, wa.dist_array + 4);
+	assert_int_equal(list2.heads[0], 2);
+	assert_double_equal(list2.distances[0], 21.423179);
+	assert_int_equal(list2.heads[1], 3);
+	assert_double_equal(list2.distances[1], 52.901061);
+	assert_int_equal(list2.heads[2], 10);
+	assert_double_equal(list2.distances[2], 82.967209);
+
+	free(wa.dist_array);
+	free(wa.head_store1);
+	free(wa.head_store2);
+	free(wa.head_scratch);
+	free(wa.dist_scratch);
 }
 
 
@@ -1374,61 +1365,86 @@ void scc_ut_hi_sort_edge_list(void** state)
 
 	double output_dists[10] = { 10.4, 1.4, 6.2, 5.2, 0.0, 1.2, 9.5, 3.3, 9.6, 3.1 };
 
-	iscc_hi_DistanceEdge* const edge_store = malloc(sizeof(iscc_hi_DistanceEdge[10]));
-
-	iscc_hi_sort_edge_list(&ci, 9, output_dists, edge_store);
-
-	assert_int_equal(edge_store[1].head, 4);
-	assert_double_equal(edge_store[1].distance, 1.2);
-	assert_int_equal(edge_store[2].head, 6);
-	assert_double_equal(edge_store[2].distance, 1.4);
-	assert_int_equal(edge_store[3].head, 14);
-	assert_double_equal(edge_store[3].distance, 3.1);
-	assert_int_equal(edge_store[4].head, 12);
-	assert_double_equal(edge_store[4].distance, 3.3);
-	assert_int_equal(edge_store[5].head, 8);
-	assert_double_equal(edge_store[5].distance, 5.2);
-	assert_int_equal(edge_store[6].head, 3);
-	assert_double_equal(edge_store[6].distance, 6.2);
-	assert_int_equal(edge_store[7].head, 10);
-	assert_double_equal(edge_store[7].distance, 9.5);
-	assert_int_equal(edge_store[8].head, 13);
-	assert_double_equal(edge_store[8].distance, 9.6);
-	assert_int_equal(edge_store[9].head, 1);
-	assert_double_equal(edge_store[9].distance, 10.4);
+	scc_PointIndex* const head_store = malloc(sizeof(scc_PointIndex[10]));
+	scc_PointIndex* const head_scratch = malloc(sizeof(scc_PointIndex[10]));
+	double* const dist_scratch = malloc(sizeof(double[10]));
+
+	iscc_hi_EdgeList list = iscc_hi_sort_edge_list(&ci, 9, output_dists, head_store, head_scratch, dist_scratch);
 
+	assert_int_equal(list.len, 9);
+	assert_int_equal(list.next, 0);
+	assert_ptr_equal(list.heads, head_store);
+	assert_ptr_equal(list.distances, output_dists);
+
+	const scc_PointIndex ref_heads[9] = { 4, 6, 14, 12, 8, 3, 10, 13, 1 };
+	const double ref_dists[9] = { 1.2, 1.4, 3.1, 3.3, 5.2, 6.2, 9.5, 9.6, 10.4 };
 	for (size_t i = 0; i < 9; ++i) {
-		assert_ptr_equal(edge_store[i].next_dist, &edge_store[i + 1]);
-    }
-    assert_null(edge_store[9].next_dist);
+		assert_int_equal(list.heads[i], ref_heads[i]);
+		assert_double_equal(list.distances[i], ref_dists[i]);
+	}
 
-    free(edge_store);
+	free(head_store);
+	free(head_scratch);
+	free(dist_scratch);
 }
 
 
-void scc_ut_hi_compare_dist_edges(void** state)
+void scc_ut_hi_sort_by_distance(void** state)
 {
 	(void) state;
 
-	iscc_hi_DistanceEdge d1 = {
-		.head = 1,
-		.distance = 0.5,
-		.next_dist = NULL,
-	};
-	iscc_hi_DistanceEdge d2 = {
-		.head = 2,
-		.distance = 0.5,
-		.next_dist = NULL,
-	};
-	iscc_hi_DistanceEdge d3 = {
-		.head = 3,
-		.distance = 2.5,
-		.next_dist = NULL,
-	};
+	srand(97531);
+
+	const size_t lengths[4] = { 3, 63, 64, 1000 };
+	scc_PointIndex* const heads = malloc(sizeof(scc_PointIndex[1000]));
+	double* const distances = malloc(sizeof(double[1000]));
+	scc_PointIndex* const ref_heads = malloc(sizeof(scc_PointIndex[1000]));
+	double* const ref_distances = malloc(sizeof(double[1000]));
+	scc_PointIndex* const head_scratch = malloc(sizeof(scc_PointIndex[1000]));
+	double* const dist_scratch = malloc(sizeof(double[1000]));
+
+	for (size_t l = 0; l < 4; ++l) {
+		for (int setting = 0; setting < 3; ++setting) {
+			const size_t len_edges = lengths[l];
+			for (size_t i = 0; i < len_edges; ++i) {
+				heads[i] = (scc_PointIndex) i;
+				if (setting == 0) {
+					distances[i] = ((double) rand()) / ((double) RAND_MAX) * 100.0;
+				} else if (setting == 1) {
+					// Many ties and zeros
+					distances[i] = (double) (rand() % 7);
+				} else {
+					// Wide range of exponents
+					distances[i] = ldexp(((double) rand()) / ((double) RAND_MAX), (rand() % 200) - 100);
+				}
+			}
+
+			// Reference: stable insertion sort
+			for (size_t i = 0; i < len_edges; ++i) {
+				size_t j = i;
+				for (; (j > 0) && (ref_distances[j - 1] > distances[i]); --j) {
+					ref_heads[j] = ref_heads[j - 1];
+					ref_distances[j] = ref_distances[j - 1];
+				}
+				ref_heads[j] = heads[i];
+				ref_distances[j] = distances[i];
+			}
+
+			iscc_hi_sort_by_distance(len_edges, heads, distances, head_scratch, dist_scratch);
+
+			for (size_t i = 0; i < len_edges; ++i) {
+				assert_int_equal(heads[i], ref_heads[i]);
+				assert_true(!(distances[i] < ref_distances[i]) && !(distances[i] > ref_distances[i]));
+			}
+		}
+	}
 
-	assert_int_equal(iscc_hi_compare_dist_edges(&d1, &d2), 0);
-	assert_int_equal(iscc_hi_compare_dist_edges(&d1, &d3), -1);
-	assert_int_equal(iscc_hi_compare_dist_edges(&d3, &d2), 1);
+	free(heads);
+	free(distances);
+	free(ref_heads);
+	free(ref_distances);
+	free(head_scratch);
+	free(dist_scratch);
 }
 
 
@@ -1441,8 +1457,8 @@ int main(void)
 		cmocka_unit_test(scc_ut_hi_init_cl_stack),
 		cmocka_unit_test(scc_ut_hi_push_to_stack),
 		cmocka_unit_test(scc_ut_hi_get_next_marker),
-		cmocka_unit_test(scc_ut_hi_compare_dist_edges),
 		cmocka_unit_test(scc_ut_hi_sort_edge_list),
+		cmocka_unit_test(scc_ut_hi_sort_by_distance),
 		cmocka_unit_test(scc_ut_hi_populate_edge_lists),
 		cmocka_unit_test(scc_ut_hi_get_next_dist),
 		cmocka_unit_test(scc_ut_hi_get_next_k_nn),
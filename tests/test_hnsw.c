@@ -0,0 +1,405 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+#include <src/dist_search_imp.h>
+#include <src/hnsw.h>
+#include <src/threads.h>
+#include "data_object_test.h"
+#include "rand.h"
+
+
+#define SCC_UT_NUM_POINTS 600
+
+
+static void scc_ut_compare_with_brute_force(scc_DataSet* const data_set,
+                                            const size_t len_search_indices,
+                                            const scc_PointIndex* const search_indices,
+                                            const size_t len_query_indices,
+                                            const scc_PointIndex* const query_indices,
+                                            const uint32_t k,
+                                            const bool radius_search,
+                                            const double radius)
+{
+	const size_t num_queries = (query_indices == NULL) ? data_set->num_data_points : len_query_indices;
+	scc_PointIndex* const ref_query_out = malloc(sizeof(scc_PointIndex[num_queries]));
+	scc_PointIndex* const ref_nn_out = malloc(sizeof(scc_PointIndex[num_queries * k]));
+	scc_PointIndex* const hnsw_query_out = malloc(sizeof(scc_PointIndex[num_queries]));
+	scc_PointIndex* const hnsw_nn_out = malloc(sizeof(scc_PointIndex[num_queries * k]));
+
+	size_t ref_num_ok = 0;
+	iscc_NNSearchObject* ref_search;
+	assert_true(iscc_imp_init_nn_search_object(data_set, len_search_indices, search_indices, &ref_search));
+	assert_true(iscc_imp_nearest_neighbor_search(ref_search, num_queries, query_indices, k, radius_search, radius,
+	                                             &ref_num_ok, ref_query_out, ref_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&ref_search));
+
+	size_t hnsw_num_ok = 0;
+	iscc_NNSearchObject* hnsw_search;
+	assert_true(iscc_imp_init_hnsw_nn_search_object(data_set, len_search_indices, search_indices, &hnsw_search));
+	assert_true(iscc_imp_nearest_neighbor_search(hnsw_search, num_queries, query_indices, k, radius_search, radius,
+	                                             &hnsw_num_ok, hnsw_query_out, hnsw_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&hnsw_search));
+	assert_null(hnsw_search);
+
+	assert_int_equal(hnsw_num_ok, ref_num_ok);
+	if (ref_num_ok > 0) {
+		assert_memory_equal(hnsw_query_out, ref_query_out, ref_num_ok * sizeof(scc_PointIndex));
+		assert_memory_equal(hnsw_nn_out, ref_nn_out, ref_num_ok * k * sizeof(scc_PointIndex));
+	}
+
+	free(ref_query_out);
+	free(ref_nn_out);
+	free(hnsw_query_out);
+	free(hnsw_nn_out);
+}
+
+
+// Points around `num_centers` random centers in the unit cube
+static void scc_ut_clustered_data(const size_t num_points,
+                                  const uint32_t num_dimensions,
+                                  const size_t num_centers,
+                                  double* const data_matrix)
+{
+	double* const centers = malloc(sizeof(double[num_centers * num_dimensions]));
+	for (size_t i = 0; i < num_centers * num_dimensions; ++i) {
+		centers[i] = scc_rand_double(0.0, 1.0);
+	}
+	for (size_t i = 0; i < num_points; ++i) {
+		const size_t center = (size_t) rand() % num_centers;
+		for (size_t d = 0; d < num_dimensions; ++d) {
+			data_matrix[i * num_dimensions + d] = centers[center * num_dimensions + d] + scc_rand_double(-0.1, 0.1);
+		}
+	}
+	free(centers);
+}
+
+
+void scc_ut_hnsw_parameters(void** state)
+{
+	(void) state;
+
+	assert_false(scc_set_hnsw_parameters(1, 100, 64));
+	assert_false(scc_set_hnsw_parameters(1025, 100, 64));
+	assert_false(scc_set_hnsw_parameters(16, 0, 64));
+	assert_false(scc_set_hnsw_parameters(16, 100, 0));
+	assert_true(scc_set_hnsw_parameters(2, 1, 1));
+	assert_true(scc_set_hnsw_parameters(16, 100, 64));
+}
+
+
+void scc_ut_hnsw_thread_local_parameters(void** state)
+{
+	(void) state;
+
+	bool set_res[4] = { true, true, true, true };
+
+	#ifdef _OPENMP
+		ISCC_OMP_PRAGMA(omp parallel num_threads(2))
+		{
+			const uint32_t thread = iscc_get_thread_num();
+			if (thread == 0) {
+				set_res[0] = scc_set_hnsw_parameters(4, 20, 1000);
+			}
+			ISCC_OMP_PRAGMA(omp barrier)
+			if (thread == 1) {
+				set_res[1] = scc_set_hnsw_parameters(2, 1, 1);
+			}
+		}
+	#else
+		set_res[0] = scc_set_hnsw_parameters(4, 20, 1000);
+	#endif
+
+	assert_true(set_res[0]);
+	assert_true(set_res[1]);
+
+	// The exact parameters set in this thread are still used
+	srand(424242);
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 32]));
+	scc_ut_clustered_data(SCC_UT_NUM_POINTS, 32, 10, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 32, SCC_UT_NUM_POINTS * 32, data_matrix, &data_set), SCC_ER_OK);
+	scc_ut_compare_with_brute_force(data_set, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, 10, false, 0.0);
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+
+	#ifdef _OPENMP
+		ISCC_OMP_PRAGMA(omp parallel num_threads(2))
+		{
+			const uint32_t thread = iscc_get_thread_num();
+			if (thread < 2) {
+				set_res[2 + thread] = scc_set_hnsw_parameters(16, 100, 64);
+			}
+		}
+	#endif
+	assert_true(scc_set_hnsw_parameters(16, 100, 64));
+	assert_true(set_res[2]);
+	assert_true(set_res[3]);
+}
+
+
+void scc_ut_hnsw_exact(void** state)
+{
+	(void) state;
+
+	// The search is exact when the candidate list holds all points
+	assert_true(scc_set_hnsw_parameters(4, 20, 1000));
+
+	scc_PointIndex search[50];
+	for (scc_PointIndex i = 0; i < 50; ++i) {
+		search[i] = (scc_PointIndex) (99 - 2 * i);
+	}
+
+	for (uint32_t k = 1; k <= 10; ++k) {
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 100, NULL, 100, NULL, k, false, 0.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 100, NULL, 100, NULL, k, true, 20.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 50, search, 100, NULL, k, false, 0.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 50, search, 100, NULL, k, true, 30.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 80, NULL, 25, search, k, true, 25.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_small, 15, NULL, 15, NULL, 1 + k % 5, false, 0.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_small, 15, NULL, 15, NULL, 1 + k % 5, true, 0.2);
+	}
+
+	srand(987654);
+
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 5]));
+	scc_PointIndex* const indices = malloc(sizeof(scc_PointIndex[SCC_UT_NUM_POINTS]));
+
+	for (int grid = 0; grid < 2; ++grid) {
+		// Coarse grid gives many ties in distance
+		for (size_t i = 0; i < SCC_UT_NUM_POINTS * 5; ++i) {
+			data_matrix[i] = (grid == 0) ? scc_rand_double(0.0, 10.0) : (double) (rand() % 3);
+		}
+
+		scc_DataSet* data_set;
+		assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 5, SCC_UT_NUM_POINTS * 5, data_matrix, &data_set), SCC_ER_OK);
+
+		for (size_t i = 0; i < SCC_UT_NUM_POINTS; ++i) {
+			indices[i] = (scc_PointIndex) ((i * 7919) % SCC_UT_NUM_POINTS);
+		}
+
+		const uint32_t k_values[3] = { 1, 4, 33 };
+		for (size_t k_i = 0; k_i < 3; ++k_i) {
+			const uint32_t k = k_values[k_i];
+			scc_ut_compare_with_brute_force(data_set, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, k, false, 0.0);
+			scc_ut_compare_with_brute_force(data_set, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, k, true, 5.0);
+			scc_ut_compare_with_brute_force(data_set, 200, indices, SCC_UT_NUM_POINTS, NULL, k, false, 0.0);
+			scc_ut_compare_with_brute_force(data_set, 200, indices, 100, indices + 300, k, true, 6.0);
+		}
+
+		scc_free_data_set(&data_set);
+	}
+
+	free(data_matrix);
+	free(indices);
+
+	assert_true(scc_set_hnsw_parameters(16, 100, 64));
+}
+
+
+void scc_ut_hnsw_recall(void** state)
+{
+	(void) state;
+
+	srand(112358);
+
+	const size_t num_points = 3000;
+	const uint32_t num_dimensions = 32;
+	const uint32_t k = 10;
+
+	double* const data_matrix = malloc(sizeof(double[num_points * num_dimensions]));
+	scc_ut_clustered_data(num_points, num_dimensions, 20, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex* const ref_nn_out = malloc(sizeof(scc_PointIndex[num_points * k]));
+	scc_PointIndex* const hnsw_nn_out = malloc(sizeof(scc_PointIndex[num_points * k]));
+	size_t num_ok;
+
+	iscc_NNSearchObject* search;
+	assert_true(iscc_imp_init_nn_search_object(data_set, num_points, NULL, &search));
+	assert_true(iscc_imp_nearest_neighbor_search(search, num_points, NULL, k, false, 0.0, &num_ok, NULL, ref_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&search));
+
+	assert_true(iscc_imp_init_hnsw_nn_search_object(data_set, num_points, NULL, &search));
+	assert_true(iscc_imp_nearest_neighbor_search(search, num_points, NULL, k, false, 0.0, &num_ok, NULL, hnsw_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&search));
+	assert_int_equal(num_ok, num_points);
+
+	size_t num_found = 0;
+	for (size_t q = 0; q < num_points; ++q) {
+		// All points are distinct, so each point is its own nearest neighbor
+		assert_int_equal(hnsw_nn_out[q * k], q);
+		for (size_t i = 0; i < k; ++i) {
+			for (size_t j = 0; j < k; ++j) {
+				if (hnsw_nn_out[q * k + i] == ref_nn_out[q * k + j]) {
+					++num_found;
+					break;
+				}
+			}
+		}
+	}
+	assert_true(num_found >= (9 * num_points * k) / 10);
+
+	free(ref_nn_out);
+	free(hnsw_nn_out);
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_hnsw_self_match(void** state)
+{
+	(void) state;
+
+	srand(271828);
+
+	// Few links and short candidate lists give poor graphs
+	assert_true(scc_set_hnsw_parameters(2, 1, 1));
+
+	const size_t num_points = 500;
+	double* const data_matrix = malloc(sizeof(double[num_points * 8]));
+	scc_ut_clustered_data(num_points, 8, 5, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, 8, num_points * 8, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex search[250];
+	for (size_t i = 0; i < 250; ++i) {
+		search[i] = (scc_PointIndex) (2 * i);
+	}
+
+	iscc_NNSearchObject* search_object;
+	assert_true(iscc_imp_init_hnsw_nn_search_object(data_set, 250, search, &search_object));
+
+	const uint32_t k = 3;
+	scc_PointIndex nn_out[500 * 3];
+	size_t num_ok;
+	assert_true(iscc_imp_nearest_neighbor_search(search_object, num_points, NULL, k, false, 0.0, &num_ok, NULL, nn_out));
+	assert_int_equal(num_ok, num_points);
+	for (size_t q = 0; q < num_points; ++q) {
+		if (q % 2 == 0) {
+			assert_int_equal(nn_out[q * k], q);
+		}
+		for (size_t i = 0; i < k; ++i) {
+			assert_int_equal(nn_out[q * k + i] % 2, 0);
+			for (size_t j = 0; j < i; ++j) {
+				assert_true(nn_out[q * k + i] != nn_out[q * k + j]);
+			}
+		}
+	}
+	assert_true(iscc_imp_close_nn_search_object(&search_object));
+
+	assert_true(scc_set_hnsw_parameters(16, 100, 64));
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_hnsw_threads(void** state)
+{
+	(void) state;
+
+	srand(141421);
+
+	const size_t num_points = 5000;
+	const uint32_t num_dimensions = 16;
+	const uint32_t k = 5;
+
+	double* const data_matrix = malloc(sizeof(double[num_points * num_dimensions]));
+	scc_ut_clustered_data(num_points, num_dimensions, 10, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex* const nn_out[2] = {
+		malloc(sizeof(scc_PointIndex[num_points * k])),
+		malloc(sizeof(scc_PointIndex[num_points * k])),
+	};
+
+	// The graph does not depend on the number of threads
+	const uint32_t num_threads[2] = { 1, 4 };
+	for (size_t t = 0; t < 2; ++t) {
+		scc_set_num_threads(num_threads[t]);
+		size_t num_ok;
+		iscc_NNSearchObject* search;
+		assert_true(iscc_imp_init_hnsw_nn_search_object(data_set, num_points, NULL, &search));
+		assert_true(iscc_imp_nearest_neighbor_search(search, num_points, NULL, k, false, 0.0, &num_ok, NULL, nn_out[t]));
+		assert_true(iscc_imp_close_nn_search_object(&search));
+		assert_int_equal(num_ok, num_points);
+	}
+	scc_set_num_threads(0);
+
+	assert_memory_equal(nn_out[0], nn_out[1], num_points * k * sizeof(scc_PointIndex));
+
+	free(nn_out[0]);
+	free(nn_out[1]);
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_set_hnsw_nn_search(void** state)
+{
+	(void) state;
+
+	assert_true(scc_set_hnsw_nn_search());
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(100, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(scc_ut_test_data_large, &options, clustering), SCC_ER_OK);
+	scc_ClusteringStats stats;
+	assert_int_equal(scc_get_clustering_stats(scc_ut_test_data_large, clustering, &stats), SCC_ER_OK);
+	assert_true(stats.min_cluster_size >= 3);
+	scc_free_clustering(&clustering);
+
+	const scc_DistFunctions dist_functions = scc_get_hnsw_dist_functions();
+	const scc_DistFunctions set_functions = scc_get_dist_functions();
+	assert_true(dist_functions.init_nn_search_object == set_functions.init_nn_search_object);
+
+	assert_true(scc_reset_dist_functions());
+	assert_true(scc_ut_init_tests());
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_hnsw_parameters),
+		cmocka_unit_test(scc_ut_hnsw_thread_local_parameters),
+		cmocka_unit_test(scc_ut_hnsw_exact),
+		cmocka_unit_test(scc_ut_hnsw_recall),
+		cmocka_unit_test(scc_ut_hnsw_self_match),
+		cmocka_unit_test(scc_ut_hnsw_threads),
+		cmocka_unit_test(scc_ut_set_hnsw_nn_search),
+	};
+
+	return cmocka_run_group_tests_name("hnsw.c", test_cases, NULL, NULL);
+}
@@ -0,0 +1,537 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+#include <src/dist_search_imp.h>
+#include <src/kdtree.h>
+#include "data_object_test.h"
+#include "rand.h"
+
+
+#define SCC_UT_NUM_POINTS 600
+
+
+static void scc_ut_compare_with_brute_force(scc_DataSet* const data_set,
+                                            const size_t len_search_indices,
+                                            const scc_PointIndex* const search_indices,
+                                            const size_t len_query_indices,
+                                            const scc_PointIndex* const query_indices,
+                                            const uint32_t k,
+                                            const bool radius_search,
+                                            const double radius)
+{
+	const size_t num_queries = (query_indices == NULL) ? data_set->num_data_points : len_query_indices;
+	scc_PointIndex* const ref_query_out = malloc(sizeof(scc_PointIndex[num_queries]));
+	scc_PointIndex* const ref_nn_out = malloc(sizeof(scc_PointIndex[num_queries * k]));
+	scc_PointIndex* const kdt_query_out = malloc(sizeof(scc_PointIndex[num_queries]));
+	scc_PointIndex* const kdt_nn_out = malloc(sizeof(scc_PointIndex[num_queries * k]));
+
+	size_t ref_num_ok = 0;
+	iscc_NNSearchObject* ref_search;
+	assert_true(iscc_imp_init_nn_search_object(data_set, len_search_indices, search_indices, &ref_search));
+	assert_true(iscc_imp_nearest_neighbor_search(ref_search, num_queries, query_indices, k, radius_search, radius,
+	                                             &ref_num_ok, ref_query_out, ref_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&ref_search));
+
+	size_t kdt_num_ok = 0;
+	iscc_NNSearchObject* kdt_search;
+	assert_true(iscc_imp_init_kdtree_nn_search_object(data_set, len_search_indices, search_indices, &kdt_search));
+	assert_true(iscc_imp_nearest_neighbor_search(kdt_search, num_queries, query_indices, k, radius_search, radius,
+	                                             &kdt_num_ok, kdt_query_out, kdt_nn_out));
+	assert_true(iscc_imp_close_nn_search_object(&kdt_search));
+	assert_null(kdt_search);
+
+	assert_int_equal(kdt_num_ok, ref_num_ok);
+	if (ref_num_ok > 0) {
+		assert_memory_equal(kdt_query_out, ref_query_out, ref_num_ok * sizeof(scc_PointIndex));
+		assert_memory_equal(kdt_nn_out, ref_nn_out, ref_num_ok * k * sizeof(scc_PointIndex));
+	}
+
+	free(ref_query_out);
+	free(ref_nn_out);
+	free(kdt_query_out);
+	free(kdt_nn_out);
+}
+
+
+void scc_ut_kdtree_test_data(void** state)
+{
+	(void) state;
+
+	scc_PointIndex search[50];
+	for (scc_PointIndex i = 0; i < 50; ++i) {
+		search[i] = (scc_PointIndex) (99 - 2 * i);
+	}
+
+	for (uint32_t k = 1; k <= 10; ++k) {
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 100, NULL, 100, NULL, k, false, 0.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 100, NULL, 100, NULL, k, true, 20.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 50, search, 100, NULL, k, false, 0.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 50, search, 100, NULL, k, true, 30.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_large, 80, NULL, 25, search, k, true, 25.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_small, 15, NULL, 15, NULL, 1 + k % 5, false, 0.0);
+		scc_ut_compare_with_brute_force(scc_ut_test_data_small, 15, NULL, 15, NULL, 1 + k % 5, true, 0.2);
+	}
+}
+
+
+void scc_ut_kdtree_random_data(void** state)
+{
+	(void) state;
+
+	srand(654321);
+
+	const uint32_t dimensions[4] = { 1, 2, 3, 9 };
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 9]));
+	scc_PointIndex* const indices = malloc(sizeof(scc_PointIndex[SCC_UT_NUM_POINTS]));
+
+	for (size_t dim_i = 0; dim_i < 4; ++dim_i) {
+		for (int grid = 0; grid < 2; ++grid) {
+			// Coarse grid gives many ties in distance
+			for (size_t i = 0; i < SCC_UT_NUM_POINTS * 9; ++i) {
+				data_matrix[i] = (grid == 0) ? scc_rand_double(0.0, 10.0) : (double) (rand() % 5);
+			}
+
+			scc_DataSet* data_set;
+			assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, dimensions[dim_i], SCC_UT_NUM_POINTS * 9, data_matrix, &data_set), SCC_ER_OK);
+
+			for (size_t i = 0; i < SCC_UT_NUM_POINTS; ++i) {
+				indices[i] = (scc_PointIndex) ((i * 7919) % SCC_UT_NUM_POINTS);
+			}
+
+			const uint32_t k_values[4] = { 1, 3, 8, 33 };
+			for (size_t k_i = 0; k_i < 4; ++k_i) {
+				const uint32_t k = k_values[k_i];
+				scc_ut_compare_with_brute_force(data_set, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, k, false, 0.0);
+				scc_ut_compare_with_brute_force(data_set, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, k, true, 1.5);
+				scc_ut_compare_with_brute_force(data_set, 200, indices, SCC_UT_NUM_POINTS, NULL, k, false, 0.0);
+				scc_ut_compare_with_brute_force(data_set, 200, indices, 100, indices + 300, k, true, 2.0);
+				scc_ut_compare_with_brute_force(data_set, 40, indices + 17, 100, indices, k, false, 0.0);
+			}
+
+			scc_free_data_set(&data_set);
+		}
+	}
+
+	free(data_matrix);
+	free(indices);
+}
+
+
+static void scc_ut_compare_farthest_with_brute_force(scc_DataSet* const data_set,
+                                                     const size_t len_search_indices,
+                                                     const scc_PointIndex* const search_indices,
+                                                     const size_t len_query_indices,
+                                                     const scc_PointIndex* const query_indices)
+{
+	scc_PointIndex* const ref_max_indices = malloc(sizeof(scc_PointIndex[len_query_indices]));
+	double* const ref_max_dists = malloc(sizeof(double[len_query_indices]));
+
+	iscc_MaxDistObject* ref_max_dist;
+	assert_true(iscc_imp_init_max_dist_object(data_set, len_search_indices, search_indices, &ref_max_dist));
+	assert_true(iscc_imp_get_max_dist(ref_max_dist, len_query_indices, query_indices, ref_max_indices, ref_max_dists));
+	assert_true(iscc_imp_close_max_dist_object(&ref_max_dist));
+
+	iscc_KDTree* tree;
+	assert_true(iscc_kdt_build_tree(data_set, len_search_indices, search_indices, ISCC_KDT_NN_LEAF_SIZE, true, &tree));
+	for (size_t q = 0; q < len_query_indices; ++q) {
+		const size_t query = (query_indices == NULL) ? q : (size_t) query_indices[q];
+		double max_dist_sq;
+		assert_int_equal(iscc_kdt_farthest_point(tree, query, &max_dist_sq), ref_max_indices[q]);
+		const double max_dist = sqrt(max_dist_sq);
+		assert_true(!(max_dist < ref_max_dists[q]) && !(max_dist > ref_max_dists[q]));
+	}
+	iscc_kdt_free_tree(&tree);
+	assert_null(tree);
+
+	free(ref_max_indices);
+	free(ref_max_dists);
+}
+
+
+void scc_ut_kdtree_farthest_point(void** state)
+{
+	(void) state;
+
+	srand(246810);
+
+	const uint32_t dimensions[4] = { 1, 2, 3, 9 };
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 9]));
+	scc_PointIndex* const indices = malloc(sizeof(scc_PointIndex[SCC_UT_NUM_POINTS]));
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS; ++i) {
+		indices[i] = (scc_PointIndex) ((i * 7919) % SCC_UT_NUM_POINTS);
+	}
+
+	scc_ut_compare_farthest_with_brute_force(scc_ut_test_data_large, 100, NULL, 100, NULL);
+	scc_ut_compare_farthest_with_brute_force(scc_ut_test_data_small, 15, NULL, 15, NULL);
+
+	for (size_t dim_i = 0; dim_i < 4; ++dim_i) {
+		for (int grid = 0; grid < 2; ++grid) {
+			// Coarse grid gives many ties in distance
+			for (size_t i = 0; i < SCC_UT_NUM_POINTS * 9; ++i) {
+				data_matrix[i] = (grid == 0) ? scc_rand_double(0.0, 10.0) : (double) (rand() % 5);
+			}
+
+			scc_DataSet* data_set;
+			assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, dimensions[dim_i], SCC_UT_NUM_POINTS * 9, data_matrix, &data_set), SCC_ER_OK);
+
+			scc_ut_compare_farthest_with_brute_force(data_set, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL);
+			scc_ut_compare_farthest_with_brute_force(data_set, 200, indices, 100, indices + 300);
+			scc_ut_compare_farthest_with_brute_force(data_set, 1, indices + 17, 50, NULL);
+
+			scc_free_data_set(&data_set);
+		}
+	}
+
+	free(data_matrix);
+	free(indices);
+}
+
+
+void scc_ut_kdtree_max_dist_object(void** state)
+{
+	(void) state;
+
+	srand(13579);
+
+	const size_t num_points = 3000;
+	double* const data_matrix = malloc(sizeof(double[num_points * 2]));
+	for (size_t i = 0; i < num_points * 2; ++i) {
+		data_matrix[i] = (double) (rand() % 50);
+	}
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, 2, num_points * 2, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex query_indices[100];
+	for (size_t i = 0; i < 100; ++i) {
+		query_indices[i] = (scc_PointIndex) ((i * 7919) % num_points);
+	}
+
+	// Both large sets (with a tree) and small sets (without)
+	const size_t search_sizes[2] = { 3000, 100 };
+	for (size_t s = 0; s < 2; ++s) {
+		scc_PointIndex ref_max_indices[100];
+		double ref_max_dists[100];
+		iscc_MaxDistObject* ref_max_dist;
+		assert_true(iscc_imp_init_max_dist_object(data_set, search_sizes[s], NULL, &ref_max_dist));
+		assert_true(iscc_imp_get_max_dist(ref_max_dist, 100, query_indices, ref_max_indices, ref_max_dists));
+		assert_true(iscc_imp_close_max_dist_object(&ref_max_dist));
+
+		scc_PointIndex max_indices[100];
+		double max_dists[100];
+		iscc_MaxDistObject* kdt_max_dist;
+		assert_true(iscc_imp_init_kdtree_max_dist_object(data_set, search_sizes[s], NULL, &kdt_max_dist));
+		assert_true(iscc_imp_get_max_dist(kdt_max_dist, 100, query_indices, max_indices, max_dists));
+		assert_true(iscc_imp_close_max_dist_object(&kdt_max_dist));
+		assert_null(kdt_max_dist);
+
+		assert_memory_equal(max_indices, ref_max_indices, 100 * sizeof(scc_PointIndex));
+		assert_memory_equal(max_dists, ref_max_dists, 100 * sizeof(double));
+	}
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_set_kdtree_nn_search(void** state)
+{
+	(void) state;
+
+	assert_true(scc_set_kdtree_nn_search());
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(100, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(scc_ut_test_data_large, &options, clustering), SCC_ER_OK);
+	scc_ClusteringStats stats;
+	assert_int_equal(scc_get_clustering_stats(scc_ut_test_data_large, clustering, &stats), SCC_ER_OK);
+	assert_true(stats.min_cluster_size >= 3);
+
+	assert_true(scc_reset_dist_functions());
+
+	scc_Clustering* ref_clustering;
+	assert_int_equal(scc_init_empty_clustering(100, NULL, &ref_clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(scc_ut_test_data_large, &options, ref_clustering), SCC_ER_OK);
+
+	scc_Clabel labels[100];
+	scc_Clabel ref_labels[100];
+	assert_int_equal(scc_get_cluster_labels(clustering, 100, labels), SCC_ER_OK);
+	assert_int_equal(scc_get_cluster_labels(ref_clustering, 100, ref_labels), SCC_ER_OK);
+	assert_memory_equal(labels, ref_labels, 100 * sizeof(scc_Clabel));
+
+	scc_free_clustering(&clustering);
+	scc_free_clustering(&ref_clustering);
+
+	assert_true(scc_ut_init_tests());
+}
+
+#define SCC_UT_INDEX_FILE "test_kdtree_index.bin"
+#define SCC_UT_INDEX_FILE2 "test_kdtree_index2.bin"
+
+
+static void scc_ut_search_all_points(scc_DataSet* const data_set,
+                                     const bool kdtree,
+                                     const uint32_t k,
+                                     scc_PointIndex out_nn_indices[const])
+{
+	const size_t num_points = data_set->num_data_points;
+	scc_PointIndex* const query_out = malloc(sizeof(scc_PointIndex[num_points]));
+	size_t num_ok = 0;
+	iscc_NNSearchObject* search;
+	if (kdtree) {
+		assert_true(iscc_imp_init_kdtree_nn_search_object(data_set, num_points, NULL, &search));
+	} else {
+		assert_true(iscc_imp_init_nn_search_object(data_set, num_points, NULL, &search));
+	}
+	assert_true(iscc_imp_nearest_neighbor_search(search, num_points, NULL, k, false, 0.0,
+	                                             &num_ok, query_out, out_nn_indices));
+	assert_true(iscc_imp_close_nn_search_object(&search));
+	assert_int_equal(num_ok, num_points);
+	free(query_out);
+}
+
+
+static bool scc_ut_same_file_contents(const char* const file_path1,
+                                      const char* const file_path2)
+{
+	FILE* const file1 = fopen(file_path1, "rb");
+	FILE* const file2 = fopen(file_path2, "rb");
+	assert_non_null(file1);
+	assert_non_null(file2);
+	int c1;
+	int c2;
+	do {
+		c1 = fgetc(file1);
+		c2 = fgetc(file2);
+	} while ((c1 == c2) && (c1 != EOF));
+	fclose(file1);
+	fclose(file2);
+	return (c1 == c2);
+}
+
+
+void scc_ut_kdtree_search_index(void** state)
+{
+	(void) state;
+
+	#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+
+	srand(272727);
+
+	const size_t num_points = SCC_UT_NUM_POINTS;
+	const uint32_t k = 5;
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 3]));
+	double* const other_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 3]));
+	float* const float_matrix = malloc(sizeof(float[SCC_UT_NUM_POINTS * 3]));
+	for (size_t i = 0; i < num_points * 3; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+		other_matrix[i] = data_matrix[i];
+		float_matrix[i] = (float) data_matrix[i];
+	}
+	other_matrix[123] += 1.0;
+
+	scc_PointIndex* const ref_nn = malloc(sizeof(scc_PointIndex[SCC_UT_NUM_POINTS * 5]));
+	scc_PointIndex* const nn = malloc(sizeof(scc_PointIndex[SCC_UT_NUM_POINTS * 5]));
+
+	scc_DataSet* ref_data_set;
+	assert_int_equal(scc_init_data_set(num_points, 3, num_points * 3, data_matrix, &ref_data_set), SCC_ER_OK);
+	scc_ut_search_all_points(ref_data_set, false, k, ref_nn);
+	assert_int_equal(scc_save_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE), SCC_ER_OK);
+
+	// Searches over all points use the loaded index
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, 3, num_points * 3, data_matrix, &data_set), SCC_ER_OK);
+	assert_int_equal(scc_load_nn_search_index(data_set, SCC_UT_INDEX_FILE), SCC_ER_OK);
+	assert_non_null(data_set->nn_index);
+	scc_ut_search_all_points(data_set, false, k, nn);
+	assert_memory_equal(nn, ref_nn, num_points * k * sizeof(scc_PointIndex));
+	scc_ut_search_all_points(data_set, true, k, nn);
+	assert_memory_equal(nn, ref_nn, num_points * k * sizeof(scc_PointIndex));
+	scc_ut_compare_with_brute_force(data_set, num_points, NULL, 100, NULL, 12, true, 1.0);
+
+	// Clustering gives the same result, also when search objects are cached
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	scc_Clabel ref_labels[SCC_UT_NUM_POINTS];
+	scc_Clabel labels[SCC_UT_NUM_POINTS];
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(num_points, ref_labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(ref_data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_true(scc_pin_nn_search_cache(data_set));
+	for (int run = 0; run < 2; ++run) {
+		assert_int_equal(scc_init_empty_clustering(num_points, labels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+		assert_memory_equal(labels, ref_labels, num_points * sizeof(scc_Clabel));
+	}
+	assert_true(scc_unpin_nn_search_cache(data_set));
+
+	// A loaded index is not replaced
+	const iscc_KDTree* const loaded_index = data_set->nn_index;
+	assert_int_equal(scc_load_nn_search_index(data_set, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+	assert_ptr_equal(data_set->nn_index, loaded_index);
+
+	// Saving a loaded index writes the same file
+	assert_int_equal(scc_save_nn_search_index(data_set, SCC_UT_INDEX_FILE2), SCC_ER_OK);
+	assert_true(scc_ut_same_file_contents(SCC_UT_INDEX_FILE, SCC_UT_INDEX_FILE2));
+	scc_free_data_set(&data_set);
+
+	// Files saved from other data sets are rejected
+	assert_int_equal(scc_init_data_set(num_points, 3, num_points * 3, other_matrix, &data_set), SCC_ER_OK);
+	assert_int_equal(scc_load_nn_search_index(data_set, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+	assert_null(data_set->nn_index);
+	scc_free_data_set(&data_set);
+	assert_int_equal(scc_init_data_set_float(num_points, 3, num_points * 3, float_matrix, &data_set), SCC_ER_OK);
+	assert_int_equal(scc_load_nn_search_index(data_set, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+	scc_free_data_set(&data_set);
+	assert_int_equal(scc_init_data_set(num_points / 3, 9, num_points * 3, data_matrix, &data_set), SCC_ER_OK);
+	assert_int_equal(scc_load_nn_search_index(data_set, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+	scc_free_data_set(&data_set);
+
+	// Float data sets
+	assert_int_equal(scc_init_data_set_float(num_points, 3, num_points * 3, float_matrix, &data_set), SCC_ER_OK);
+	scc_ut_search_all_points(data_set, false, k, ref_nn);
+	assert_int_equal(scc_save_nn_search_index(data_set, SCC_UT_INDEX_FILE2), SCC_ER_OK);
+	assert_int_equal(scc_load_nn_search_index(data_set, SCC_UT_INDEX_FILE2), SCC_ER_OK);
+	scc_ut_search_all_points(data_set, false, k, nn);
+	assert_memory_equal(nn, ref_nn, num_points * k * sizeof(scc_PointIndex));
+	scc_free_data_set(&data_set);
+
+	// Damaged files
+	FILE* file = fopen(SCC_UT_INDEX_FILE2, "wb");
+	assert_int_equal(fwrite("SCCKDTX", 1, 8, file), 8);
+	assert_int_equal(fclose(file), 0);
+	assert_int_equal(scc_load_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE2), SCC_ER_INVALID_INPUT);
+
+	file = fopen(SCC_UT_INDEX_FILE, "rb");
+	assert_non_null(file);
+	assert_int_equal(fseek(file, 0, SEEK_END), 0);
+	const size_t len_file = (size_t) ftell(file);
+	assert_int_equal(fseek(file, 0, SEEK_SET), 0);
+	unsigned char* const contents = malloc(len_file);
+	assert_int_equal(fread(contents, 1, len_file, file), len_file);
+	assert_int_equal(fclose(file), 0);
+
+	// Only the nodes and the points follow the header
+	uint64_t num_nodes;
+	memcpy(&num_nodes, contents + 40, sizeof(uint64_t));
+	assert_int_equal(len_file, 64 + 48 * num_nodes + sizeof(scc_PointIndex[num_points]));
+
+	file = fopen(SCC_UT_INDEX_FILE2, "wb");
+	assert_int_equal(fwrite(contents, 1, len_file - 1, file), len_file - 1);
+	assert_int_equal(fclose(file), 0);
+	assert_int_equal(scc_load_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE2), SCC_ER_INVALID_INPUT);
+
+	unsigned char* const damaged = malloc(len_file);
+
+	// Repeated point
+	memcpy(damaged, contents, len_file);
+	memcpy(damaged + 64 + 48 * num_nodes + sizeof(scc_PointIndex), damaged + 64 + 48 * num_nodes, sizeof(scc_PointIndex));
+	file = fopen(SCC_UT_INDEX_FILE2, "wb");
+	assert_int_equal(fwrite(damaged, 1, len_file, file), len_file);
+	assert_int_equal(fclose(file), 0);
+	assert_int_equal(scc_load_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE2), SCC_ER_INVALID_INPUT);
+
+	// Node that partitions its points, but not at the median
+	memcpy(damaged, contents, len_file);
+	bool moved_split = false;
+	for (uint64_t i = 0; !moved_split && (i < num_nodes); ++i) {
+		uint64_t children[2];
+		memcpy(children, damaged + 64 + 48 * i + 16, sizeof(uint64_t[2]));
+		if (children[0] == 0) continue;
+		uint64_t left_left;
+		uint64_t right_left;
+		memcpy(&left_left, damaged + 64 + 48 * children[0] + 16, sizeof(uint64_t));
+		memcpy(&right_left, damaged + 64 + 48 * children[1] + 16, sizeof(uint64_t));
+		if ((left_left == 0) && (right_left == 0)) {
+			uint64_t split;
+			memcpy(&split, damaged + 64 + 48 * children[0] + 8, sizeof(uint64_t));
+			--split;
+			memcpy(damaged + 64 + 48 * children[0] + 8, &split, sizeof(uint64_t));
+			memcpy(damaged + 64 + 48 * children[1], &split, sizeof(uint64_t));
+			moved_split = true;
+		}
+	}
+	assert_true(moved_split);
+	file = fopen(SCC_UT_INDEX_FILE2, "wb");
+	assert_int_equal(fwrite(damaged, 1, len_file, file), len_file);
+	assert_int_equal(fclose(file), 0);
+	assert_int_equal(scc_load_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE2), SCC_ER_INVALID_INPUT);
+
+	free(damaged);
+
+	// Point index of the root node out of range
+	const uint64_t bad_end = num_points + 1;
+	memcpy(contents + 64 + 8, &bad_end, sizeof(uint64_t));
+	file = fopen(SCC_UT_INDEX_FILE2, "wb");
+	assert_int_equal(fwrite(contents, 1, len_file, file), len_file);
+	assert_int_equal(fclose(file), 0);
+	assert_int_equal(scc_load_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE2), SCC_ER_INVALID_INPUT);
+	assert_null(ref_data_set->nn_index);
+
+	free(contents);
+	assert_int_equal(remove(SCC_UT_INDEX_FILE), 0);
+	assert_int_equal(remove(SCC_UT_INDEX_FILE2), 0);
+	assert_int_equal(scc_load_nn_search_index(ref_data_set, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+
+	scc_free_data_set(&ref_data_set);
+	free(data_matrix);
+	free(other_matrix);
+	free(float_matrix);
+	free(ref_nn);
+	free(nn);
+
+	#endif
+
+	assert_int_equal(scc_save_nn_search_index(NULL, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+	assert_int_equal(scc_save_nn_search_index(scc_ut_test_data_large, NULL), SCC_ER_INVALID_INPUT);
+	assert_int_equal(scc_load_nn_search_index(NULL, SCC_UT_INDEX_FILE), SCC_ER_INVALID_INPUT);
+	assert_int_equal(scc_load_nn_search_index(scc_ut_test_data_large, NULL), SCC_ER_INVALID_INPUT);
+}
+
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_kdtree_test_data),
+		cmocka_unit_test(scc_ut_kdtree_random_data),
+		cmocka_unit_test(scc_ut_kdtree_farthest_point),
+		cmocka_unit_test(scc_ut_kdtree_max_dist_object),
+		cmocka_unit_test(scc_ut_set_kdtree_nn_search),
+		cmocka_unit_test(scc_ut_kdtree_search_index),
+	};
+
+	return cmocka_run_group_tests_name("kdtree.c", test_cases, NULL, NULL);
+}
@@ -0,0 +1,163 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+#include "rand.h"
+
+
+#define SCC_UT_NUM_POINTS 500
+
+
+static size_t scc_ut_num_inits = 0;
+static size_t scc_ut_num_closes = 0;
+static scc_init_nn_search_object scc_ut_wrapped_init = NULL;
+static scc_close_nn_search_object scc_ut_wrapped_close = NULL;
+
+
+static bool scc_ut_counting_init(void* const data_set,
+                                 const size_t len_search_indices,
+                                 const scc_PointIndex* const search_indices,
+                                 iscc_NNSearchObject** const out_nn_search_object)
+{
+	++scc_ut_num_inits;
+	return scc_ut_wrapped_init(data_set, len_search_indices, search_indices, out_nn_search_object);
+}
+
+
+static bool scc_ut_counting_close(iscc_NNSearchObject** const nn_search_object)
+{
+	++scc_ut_num_closes;
+	return scc_ut_wrapped_close(nn_search_object);
+}
+
+
+static void scc_ut_cluster(scc_DataSet* const data_set,
+                           const uint32_t size_constraint,
+                           const scc_DistFunctions* const dist_functions,
+                           scc_Clabel labels[const])
+{
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = size_constraint;
+	options.seed_method = SCC_SM_EXCLUSION_ORDER;
+	options.primary_radius = SCC_RM_USE_ESTIMATED;
+	options.primary_unassigned_method = SCC_UM_CLOSEST_SEED;
+
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering_with_dist_functions(data_set, &options, clustering, dist_functions), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+}
+
+
+void scc_ut_nn_search_cache(void** state)
+{
+	(void) state;
+
+	srand(314159);
+	double data_matrix[SCC_UT_NUM_POINTS * 2];
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS * 2; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+	}
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 2, SCC_UT_NUM_POINTS * 2, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_DistFunctions dist_functions = scc_get_kdtree_dist_functions();
+	scc_ut_wrapped_init = dist_functions.init_nn_search_object;
+	scc_ut_wrapped_close = dist_functions.close_nn_search_object;
+	dist_functions.init_nn_search_object = scc_ut_counting_init;
+	dist_functions.close_nn_search_object = scc_ut_counting_close;
+
+	scc_Clabel ref_labels3[SCC_UT_NUM_POINTS];
+	scc_Clabel ref_labels4[SCC_UT_NUM_POINTS];
+	scc_Clabel labels[SCC_UT_NUM_POINTS];
+
+	// Without cache, all objects are closed
+	scc_ut_cluster(data_set, 3, &dist_functions, ref_labels3);
+	scc_ut_cluster(data_set, 4, &dist_functions, ref_labels4);
+	assert_true(scc_ut_num_inits > 0);
+	assert_int_equal(scc_ut_num_closes, scc_ut_num_inits);
+
+	assert_false(scc_invalidate_nn_search_cache(data_set));
+	assert_false(scc_unpin_nn_search_cache(data_set));
+	assert_false(scc_pin_nn_search_cache(NULL));
+	assert_true(scc_pin_nn_search_cache(data_set));
+	assert_true(scc_pin_nn_search_cache(data_set));
+
+	scc_ut_num_inits = 0;
+	scc_ut_num_closes = 0;
+	scc_ut_cluster(data_set, 3, &dist_functions, labels);
+	assert_memory_equal(labels, ref_labels3, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	const size_t num_first_inits = scc_ut_num_inits;
+	assert_true(num_first_inits > 0);
+	assert_int_equal(scc_ut_num_closes, 0);
+
+	// The same call reuses all objects
+	scc_ut_cluster(data_set, 3, &dist_functions, labels);
+	assert_memory_equal(labels, ref_labels3, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	assert_int_equal(scc_ut_num_inits, num_first_inits);
+	assert_int_equal(scc_ut_num_closes, 0);
+
+	// A different size constraint reuses the search over all points
+	scc_ut_cluster(data_set, 4, &dist_functions, labels);
+	assert_memory_equal(labels, ref_labels4, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	assert_true(scc_ut_num_inits < 2 * num_first_inits);
+	assert_int_equal(scc_ut_num_closes, 0);
+
+	// Other distance functions do not use the cached objects
+	const scc_DistFunctions pivot = scc_get_pivot_dist_functions();
+	const size_t num_inits = scc_ut_num_inits;
+	scc_ut_cluster(data_set, 3, &pivot, labels);
+	assert_memory_equal(labels, ref_labels3, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	assert_int_equal(scc_ut_num_inits, num_inits);
+
+	assert_true(scc_invalidate_nn_search_cache(data_set));
+	assert_int_equal(scc_ut_num_closes, scc_ut_num_inits);
+	scc_ut_cluster(data_set, 3, &dist_functions, labels);
+	assert_memory_equal(labels, ref_labels3, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	assert_int_equal(scc_ut_num_inits, num_inits + num_first_inits);
+
+	assert_true(scc_unpin_nn_search_cache(data_set));
+	assert_int_equal(scc_ut_num_closes, scc_ut_num_inits);
+	assert_false(scc_unpin_nn_search_cache(data_set));
+
+	scc_ut_cluster(data_set, 3, &dist_functions, labels);
+	assert_memory_equal(labels, ref_labels3, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	assert_int_equal(scc_ut_num_closes, scc_ut_num_inits);
+
+	scc_free_data_set(&data_set);
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_nn_search_cache),
+	};
+
+	return cmocka_run_group_tests_name("nn_search_cache.c", test_cases, NULL, NULL);
+}
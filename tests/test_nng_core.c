@@ -22,6 +22,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <include/scclust_spi.h>
 #include <src/clustering_struct.h>
 #include <src/digraph_debug.h>
 #include <src/nng_core.h>
@@ -2805,6 +2807,88 @@ void scc_ut_make_nng_clusters_from_seeds(void** state)
 }
 
 
+static void scc_ut_compare_fused_type_nng(scc_DataSet* const data_set,
+                                          const uint32_t size_constraint,
+                                          const uint_fast16_t num_types,
+                                          const uint32_t type_constraints[const],
+                                          const scc_TypeLabel type_labels[const],
+                                          const size_t len_primary_data_points,
+                                          const scc_PointIndex primary_data_points[const],
+                                          const bool radius_constraint,
+                                          const double radius)
+{
+	// The pivot search is searched one type at a time
+	assert_true(scc_set_pivot_nn_search());
+	iscc_Digraph ref_nng;
+	const scc_ErrorCode ref_ec = iscc_get_nng_with_type_constraint(data_set, 300, size_constraint,
+	                                                               num_types, type_constraints, type_labels,
+	                                                               len_primary_data_points, primary_data_points,
+	                                                               radius_constraint, radius, &ref_nng);
+
+	assert_true(scc_reset_dist_functions());
+	iscc_Digraph nng;
+	const scc_ErrorCode ec = iscc_get_nng_with_type_constraint(data_set, 300, size_constraint,
+	                                                           num_types, type_constraints, type_labels,
+	                                                           len_primary_data_points, primary_data_points,
+	                                                           radius_constraint, radius, &nng);
+
+	assert_int_equal(ec, ref_ec);
+	if (ec == SCC_ER_OK) {
+		assert_int_equal(nng.vertices, ref_nng.vertices);
+		assert_memory_equal(nng.tail_ptr, ref_nng.tail_ptr, sizeof(iscc_ArcIndex[301]));
+		assert_memory_equal(nng.head, ref_nng.head, sizeof(scc_PointIndex[ref_nng.tail_ptr[300]]));
+		iscc_free_digraph(&nng);
+		iscc_free_digraph(&ref_nng);
+	}
+}
+
+
+void scc_ut_get_nng_with_type_constraint_fused(void** state)
+{
+	(void) state;
+
+	// Points on a small grid, so there are many duplicates and ties in distance
+	srand(271828);
+	double data_matrix[300 * 3];
+	for (size_t i = 0; i < 300 * 3; ++i) {
+		data_matrix[i] = (double) (rand() % 6);
+	}
+	scc_TypeLabel type_labels[300];
+	for (size_t i = 0; i < 300; ++i) {
+		type_labels[i] = (scc_TypeLabel) (rand() % 3);
+	}
+	scc_PointIndex primary_data_points[100];
+	for (size_t i = 0; i < 100; ++i) {
+		primary_data_points[i] = (scc_PointIndex) (3 * i + 1);
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(300, 3, 300 * 3, data_matrix, &data_set), SCC_ER_OK);
+
+	const uint32_t type_constraints[4][3] = { { 1, 1, 1 }, { 2, 0, 1 }, { 3, 0, 0 }, { 0, 2, 2 } };
+	const uint32_t size_constraints[3] = { 0, 2, 7 };
+	for (size_t t = 0; t < 4; ++t) {
+		const uint32_t sum_type_constraints = type_constraints[t][0] + type_constraints[t][1] + type_constraints[t][2];
+		for (size_t s = 0; s < 3; ++s) {
+			const uint32_t size_constraint = sum_type_constraints + size_constraints[s];
+			scc_ut_compare_fused_type_nng(data_set, size_constraint, 3, type_constraints[t], type_labels,
+			                              0, NULL, false, 0.0);
+			scc_ut_compare_fused_type_nng(data_set, size_constraint, 3, type_constraints[t], type_labels,
+			                              100, primary_data_points, false, 0.0);
+			scc_ut_compare_fused_type_nng(data_set, size_constraint, 3, type_constraints[t], type_labels,
+			                              0, NULL, true, 1.5);
+			scc_ut_compare_fused_type_nng(data_set, size_constraint, 3, type_constraints[t], type_labels,
+			                              100, primary_data_points, true, 2.0);
+			scc_ut_compare_fused_type_nng(data_set, size_constraint, 3, type_constraints[t], type_labels,
+			                              0, NULL, true, 0.5);
+		}
+	}
+
+	scc_free_data_set(&data_set);
+	assert_true(scc_ut_init_tests());
+}
+
+
 int main(void)
 {
 	if(!scc_ut_init_tests()) return 1;
@@ -2812,6 +2896,7 @@ int main(void)
 	const struct CMUnitTest test_cases[] = {
 		cmocka_unit_test(scc_ut_get_nng_with_size_constraint),
 		cmocka_unit_test(scc_ut_get_nng_with_type_constraint),
+		cmocka_unit_test(scc_ut_get_nng_with_type_constraint_fused),
 		cmocka_unit_test(scc_ut_estimate_avg_seed_dist),
 		cmocka_unit_test(scc_ut_make_nng_clusters_from_seeds),
 	};
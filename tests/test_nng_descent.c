@@ -0,0 +1,325 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+#include <src/digraph_core.h>
+#include <src/digraph_debug.h>
+#include <src/dist_search_imp.h>
+#include <src/nng_core.h>
+#include <src/nng_descent.h>
+#include <src/threads.h>
+#include "assert_digraph.h"
+#include "data_object_test.h"
+#include "rand.h"
+
+
+// Points around `num_centers` random centers in the unit cube
+static void scc_ut_clustered_data(const size_t num_points,
+                                  const uint32_t num_dimensions,
+                                  const size_t num_centers,
+                                  double* const data_matrix)
+{
+	double* const centers = malloc(sizeof(double[num_centers * num_dimensions]));
+	for (size_t i = 0; i < num_centers * num_dimensions; ++i) {
+		centers[i] = scc_rand_double(0.0, 1.0);
+	}
+	for (size_t i = 0; i < num_points; ++i) {
+		const size_t center = (size_t) rand() % num_centers;
+		for (size_t d = 0; d < num_dimensions; ++d) {
+			data_matrix[i * num_dimensions + d] = centers[center * num_dimensions + d] + scc_rand_double(-0.2, 0.2);
+		}
+	}
+	free(centers);
+}
+
+
+// Each point links to itself first and then to `k - 1` other distinct points
+static void scc_ut_check_nng(const iscc_Digraph* const nng,
+                             const size_t num_points,
+                             const uint32_t k)
+{
+	assert_balanced_digraph(nng, num_points, k);
+	for (size_t p = 0; p < num_points; ++p) {
+		const scc_PointIndex* const arcs = nng->head + nng->tail_ptr[p];
+		assert_int_equal(arcs[0], p);
+		for (uint32_t i = 1; i < k; ++i) {
+			for (uint32_t j = 0; j < i; ++j) {
+				assert_true(arcs[i] != arcs[j]);
+			}
+		}
+	}
+}
+
+
+void scc_ut_nn_descent_parameters(void** state)
+{
+	(void) state;
+
+	assert_false(iscc_nnd_is_enabled());
+	assert_false(scc_set_nn_descent(10, 0.0, false));
+	assert_false(scc_set_nn_descent(10, -0.5, false));
+	assert_false(scc_set_nn_descent(10, 1.5, false));
+	assert_false(iscc_nnd_is_enabled());
+	assert_true(scc_set_nn_descent(10, 1.0, false));
+	assert_true(iscc_nnd_is_enabled());
+	assert_true(scc_set_nn_descent(0, 1.0, false));
+	assert_false(iscc_nnd_is_enabled());
+}
+
+
+void scc_ut_nn_descent_thread_local(void** state)
+{
+	(void) state;
+
+	#ifdef _OPENMP
+		bool enabled[2] = { false, false };
+		bool set_res[2] = { true, true };
+		int team_size = 1;
+
+		ISCC_OMP_PRAGMA(omp parallel num_threads(2))
+		{
+			const uint32_t thread = iscc_get_thread_num();
+			if (thread == 1) {
+				set_res[0] = scc_set_nn_descent(10, 1.0, false);
+			}
+			ISCC_OMP_PRAGMA(omp barrier)
+			if (thread == 0) {
+				team_size = omp_get_num_threads();
+			}
+			if (thread < 2) {
+				enabled[thread] = iscc_nnd_is_enabled();
+			}
+			ISCC_OMP_PRAGMA(omp barrier)
+			if (thread == 1) {
+				set_res[1] = scc_set_nn_descent(0, 1.0, false);
+			}
+		}
+
+		assert_true(set_res[0]);
+		assert_true(set_res[1]);
+		assert_false(enabled[0]);
+		if (team_size > 1) {
+			assert_true(enabled[1]);
+		}
+	#endif
+
+	assert_false(iscc_nnd_is_enabled());
+}
+
+
+void scc_ut_nn_descent_small_data(void** state)
+{
+	(void) state;
+
+	// The graph of a small data set is exact after the refinement
+	assert_true(scc_set_nn_descent(20, 1.0, true));
+
+	iscc_Digraph out_nng;
+	assert_int_equal(iscc_get_nng_with_size_constraint(&scc_ut_test_data_small_struct,
+	                                                   15, 3, 0, NULL, false, 0.0, &out_nng), SCC_ER_OK);
+	iscc_Digraph ref_nng;
+	iscc_digraph_from_string("..... ..##. ...../"
+	                         "....# ..#.. ...../"
+	                         "..... ..... #.#../"
+	                         "..... #...# ...../"
+	                         "..... ..... ...##/"
+
+	                         "...#. ....# ...../"
+	                         "..... ..... ..#.#/"
+	                         "##... ..... ...../"
+	                         "#.... ..#.. ...../"
+	                         "..##. ..... ...../"
+
+	                         "..... .#... ..#../"
+	                         "...#. #.... ...../"
+	                         "..... .#... ....#/"
+	                         "....# ..... ....#/"
+	                         "..... .#... ..#../", &ref_nng);
+	assert_equal_digraph(&out_nng, &ref_nng);
+	iscc_free_digraph(&out_nng);
+	iscc_free_digraph(&ref_nng);
+
+	// Graphs with a radius constraint are made by nearest neighbor searches
+	assert_int_equal(iscc_get_nng_with_size_constraint(&scc_ut_test_data_small_struct,
+	                                                   15, 3, 0, NULL, true, 0.2, &out_nng), SCC_ER_OK);
+	iscc_Digraph ref_radius_nng;
+	assert_true(scc_set_nn_descent(0, 1.0, false));
+	assert_int_equal(iscc_get_nng_with_size_constraint(&scc_ut_test_data_small_struct,
+	                                                   15, 3, 0, NULL, true, 0.2, &ref_radius_nng), SCC_ER_OK);
+	assert_equal_digraph(&out_nng, &ref_radius_nng);
+	iscc_free_digraph(&out_nng);
+	iscc_free_digraph(&ref_radius_nng);
+}
+
+
+void scc_ut_nn_descent_recall(void** state)
+{
+	(void) state;
+
+	srand(314159);
+
+	const size_t num_points = 3000;
+	const uint32_t num_dimensions = 16;
+	const uint32_t k = 10;
+
+	double* const data_matrix = malloc(sizeof(double[num_points * num_dimensions]));
+	scc_ut_clustered_data(num_points, num_dimensions, 20, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex* const ref_nn = malloc(sizeof(scc_PointIndex[num_points * k]));
+	size_t num_ok;
+	iscc_NNSearchObject* search;
+	assert_true(iscc_imp_init_nn_search_object(data_set, num_points, NULL, &search));
+	assert_true(iscc_imp_nearest_neighbor_search(search, num_points, NULL, k, false, 0.0, &num_ok, NULL, ref_nn));
+	assert_true(iscc_imp_close_nn_search_object(&search));
+
+	const bool refinement[2] = { false, true };
+	size_t num_found[2] = { 0, 0 };
+	for (size_t r = 0; r < 2; ++r) {
+		assert_true(scc_set_nn_descent(20, 1.0, refinement[r]));
+		iscc_Digraph nng;
+		assert_int_equal(iscc_nnd_make_nng(data_set, num_points, k, &nng), SCC_ER_OK);
+		scc_ut_check_nng(&nng, num_points, k);
+
+		for (size_t p = 0; p < num_points; ++p) {
+			const scc_PointIndex* const arcs = nng.head + nng.tail_ptr[p];
+			for (uint32_t i = 0; i < k; ++i) {
+				for (uint32_t j = 0; j < k; ++j) {
+					if (arcs[i] == ref_nn[p * k + j]) {
+						++num_found[r];
+						break;
+					}
+				}
+			}
+		}
+		iscc_free_digraph(&nng);
+	}
+	assert_true(num_found[0] >= (95 * num_points * k) / 100);
+	assert_true(num_found[1] >= num_found[0]);
+
+	// Stops before the first iteration when the target is reached by the random graph
+	assert_true(scc_set_nn_descent(20, 1e-9, false));
+	iscc_Digraph nng;
+	assert_int_equal(iscc_nnd_make_nng(data_set, num_points, k, &nng), SCC_ER_OK);
+	scc_ut_check_nng(&nng, num_points, k);
+	iscc_free_digraph(&nng);
+
+	assert_true(scc_set_nn_descent(0, 1.0, false));
+
+	free(ref_nn);
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_nn_descent_threads(void** state)
+{
+	(void) state;
+
+	srand(271828);
+
+	const size_t num_points = 4000;
+	const uint32_t num_dimensions = 8;
+	const uint32_t k = 6;
+
+	double* const data_matrix = malloc(sizeof(double[num_points * num_dimensions]));
+	scc_ut_clustered_data(num_points, num_dimensions, 10, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, num_dimensions, num_points * num_dimensions, data_matrix, &data_set), SCC_ER_OK);
+
+	assert_true(scc_set_nn_descent(5, 1.0, true));
+
+	// The graph does not depend on the number of threads
+	iscc_Digraph nng[2];
+	const uint32_t num_threads[2] = { 1, 4 };
+	for (size_t t = 0; t < 2; ++t) {
+		scc_set_num_threads(num_threads[t]);
+		assert_int_equal(iscc_nnd_make_nng(data_set, num_points, k, &nng[t]), SCC_ER_OK);
+	}
+	scc_set_num_threads(0);
+
+	assert_identical_digraph(&nng[0], &nng[1]);
+	iscc_free_digraph(&nng[0]);
+	iscc_free_digraph(&nng[1]);
+
+	assert_true(scc_set_nn_descent(0, 1.0, false));
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_nn_descent_clustering(void** state)
+{
+	(void) state;
+
+	srand(161803);
+
+	const size_t num_points = 1000;
+	double* const data_matrix = malloc(sizeof(double[num_points * 4]));
+	scc_ut_clustered_data(num_points, 4, 5, data_matrix);
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, 4, num_points * 4, data_matrix, &data_set), SCC_ER_OK);
+
+	assert_true(scc_set_nn_descent(10, 0.99, false));
+
+	const uint32_t size_constraints[3] = { 2, 3, 7 };
+	for (size_t s = 0; s < 3; ++s) {
+		scc_ClusterOptions options = scc_get_default_options();
+		options.size_constraint = size_constraints[s];
+		scc_Clustering* clustering;
+		assert_int_equal(scc_init_empty_clustering(num_points, NULL, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+		scc_ClusteringStats stats;
+		assert_int_equal(scc_get_clustering_stats(data_set, clustering, &stats), SCC_ER_OK);
+		assert_true(stats.min_cluster_size >= size_constraints[s]);
+		assert_int_equal(stats.num_assigned, num_points);
+		scc_free_clustering(&clustering);
+	}
+
+	assert_true(scc_set_nn_descent(0, 1.0, false));
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_nn_descent_parameters),
+		cmocka_unit_test(scc_ut_nn_descent_thread_local),
+		cmocka_unit_test(scc_ut_nn_descent_small_data),
+		cmocka_unit_test(scc_ut_nn_descent_recall),
+		cmocka_unit_test(scc_ut_nn_descent_threads),
+		cmocka_unit_test(scc_ut_nn_descent_clustering),
+	};
+
+	return cmocka_run_group_tests_name("nng_descent.c", test_cases, NULL, NULL);
+}
@@ -193,6 +193,179 @@ void scc_ut_findseeds_exclusion(void** state)
 }
 
 
+void scc_ut_findseeds_exclusion_implicit(void** state)
+{
+	(void) state;
+
+	srand(252525);
+
+	const size_t vertices = 300;
+	scc_PointIndex* const row_markers = malloc(sizeof(scc_PointIndex[vertices]));
+	scc_PointIndex* const row = malloc(sizeof(scc_PointIndex[vertices]));
+	scc_PointIndex* const not_excluded = malloc(sizeof(scc_PointIndex[vertices]));
+
+	for (int rep = 0; rep < 20; ++rep) {
+		// Random graph with self-loops, duplicate arcs and vertices without arcs
+		iscc_Digraph nng;
+		assert_int_equal(iscc_init_digraph(vertices, 4 * vertices, &nng), SCC_ER_OK);
+		nng.tail_ptr[0] = 0;
+		for (size_t v = 0; v < vertices; ++v) {
+			const iscc_ArcIndex out_degree = (iscc_ArcIndex) (rand() % 5);
+			for (iscc_ArcIndex a = 0; a < out_degree; ++a) {
+				nng.head[nng.tail_ptr[v] + a] = (scc_PointIndex) (rand() % ((rep % 2 == 0) ? 300 : 30));
+			}
+			nng.tail_ptr[v + 1] = nng.tail_ptr[v] + out_degree;
+		}
+
+		// Rows are derived in the same order as in the stored exclusion graph
+		size_t len_not_excluded = 0;
+		for (scc_PointIndex v = 0; v < (scc_PointIndex) vertices; ++v) {
+			row_markers[v] = ISCC_POINTINDEX_MAX_PI;
+			if (nng.tail_ptr[v] != nng.tail_ptr[v + 1]) {
+				not_excluded[len_not_excluded] = v;
+				++len_not_excluded;
+			}
+		}
+		iscc_Digraph transpose;
+		assert_int_equal(iscc_digraph_transpose(&nng, &transpose), SCC_ER_OK);
+		iscc_Digraph exclusion_graph;
+		assert_int_equal(iscc_fs_exclusion_graph(&nng, len_not_excluded, not_excluded, &exclusion_graph), SCC_ER_OK);
+		for (size_t i = 0; i < len_not_excluded; ++i) {
+			const scc_PointIndex v = not_excluded[i];
+			const size_t row_length = iscc_fs_implicit_exclusion_row(v, &nng, &transpose, row_markers, row);
+			assert_int_equal(row_length, exclusion_graph.tail_ptr[v + 1] - exclusion_graph.tail_ptr[v]);
+			if (row_length > 0) {
+				assert_memory_equal(row, exclusion_graph.head + exclusion_graph.tail_ptr[v], row_length * sizeof(scc_PointIndex));
+			}
+		}
+		iscc_free_digraph(&exclusion_graph);
+		iscc_free_digraph(&transpose);
+
+		for (int updating = 0; updating < 2; ++updating) {
+			iscc_SeedResult ref_seeds = {
+				.capacity = 10,
+				.count = 0,
+				.seeds = NULL,
+			};
+			assert_int_equal(iscc_findseeds_exclusion(&nng, (updating == 1), &ref_seeds), SCC_ER_OK);
+
+			iscc_SeedResult seeds = {
+				.capacity = 10,
+				.count = 0,
+				.seeds = NULL,
+			};
+			assert_int_equal(iscc_findseeds_exclusion_implicit(&nng, (updating == 1), &seeds), SCC_ER_OK);
+
+			assert_int_equal(seeds.count, ref_seeds.count);
+			assert_memory_equal(seeds.seeds, ref_seeds.seeds, seeds.count * sizeof(scc_PointIndex));
+			free(ref_seeds.seeds);
+			free(seeds.seeds);
+		}
+
+		iscc_free_digraph(&nng);
+	}
+
+	free(row_markers);
+	free(row);
+	free(not_excluded);
+}
+
+
+static int scc_ut_compare_mis_priority(const void* const a,
+                                       const void* const b)
+{
+	const scc_PointIndex va = *((const scc_PointIndex*) a);
+	const scc_PointIndex vb = *((const scc_PointIndex*) b);
+	const uint64_t pa = iscc_fs_mis_priority(va);
+	const uint64_t pb = iscc_fs_mis_priority(vb);
+	if (pa != pb) return (pa < pb) ? -1 : 1;
+	return (va < vb) ? -1 : ((va > vb) ? 1 : 0);
+}
+
+
+void scc_ut_findseeds_parallel_mis(void** state)
+{
+	(void) state;
+
+	srand(363636);
+
+	const size_t vertices = 2000;
+	scc_PointIndex* const order = malloc(sizeof(scc_PointIndex[vertices]));
+	bool* const not_excluded = malloc(sizeof(bool[vertices]));
+	bool* const is_seed = malloc(sizeof(bool[vertices]));
+	scc_PointIndex* const ref_seeds = malloc(sizeof(scc_PointIndex[vertices]));
+
+	for (int rep = 0; rep < 10; ++rep) {
+		// Random graph with self-loops, duplicate arcs and vertices without arcs
+		iscc_Digraph nng;
+		assert_int_equal(iscc_init_digraph(vertices, 4 * vertices, &nng), SCC_ER_OK);
+		nng.tail_ptr[0] = 0;
+		for (size_t v = 0; v < vertices; ++v) {
+			const iscc_ArcIndex out_degree = (iscc_ArcIndex) (rand() % 5);
+			for (iscc_ArcIndex a = 0; a < out_degree; ++a) {
+				nng.head[nng.tail_ptr[v] + a] = (scc_PointIndex) (rand() % ((rep % 2 == 0) ? 2000 : 200));
+			}
+			nng.tail_ptr[v + 1] = nng.tail_ptr[v] + out_degree;
+		}
+
+		// Reference: add seeds one by one in priority order using the stored exclusion graph
+		size_t len_order = 0;
+		for (scc_PointIndex v = 0; v < (scc_PointIndex) vertices; ++v) {
+			not_excluded[v] = (nng.tail_ptr[v] != nng.tail_ptr[v + 1]);
+			is_seed[v] = false;
+			if (not_excluded[v]) {
+				order[len_order] = v;
+				++len_order;
+			}
+		}
+		iscc_Digraph exclusion_graph;
+		assert_int_equal(iscc_fs_exclusion_graph(&nng, len_order, order, &exclusion_graph), SCC_ER_OK);
+		qsort(order, len_order, sizeof(scc_PointIndex), scc_ut_compare_mis_priority);
+		for (size_t i = 0; i < len_order; ++i) {
+			const scc_PointIndex v = order[i];
+			if (not_excluded[v]) {
+				is_seed[v] = true;
+				not_excluded[v] = false;
+				for (iscc_ArcIndex a = exclusion_graph.tail_ptr[v]; a < exclusion_graph.tail_ptr[v + 1]; ++a) {
+					not_excluded[exclusion_graph.head[a]] = false;
+				}
+			}
+		}
+		iscc_free_digraph(&exclusion_graph);
+		size_t num_ref_seeds = 0;
+		for (scc_PointIndex v = 0; v < (scc_PointIndex) vertices; ++v) {
+			if (is_seed[v]) {
+				ref_seeds[num_ref_seeds] = v;
+				++num_ref_seeds;
+			}
+		}
+
+		// Same seeds independently of the number of threads
+		const uint32_t num_threads[2] = { 1, 4 };
+		for (size_t t = 0; t < 2; ++t) {
+			scc_set_num_threads(num_threads[t]);
+			iscc_SeedResult seeds = {
+				.capacity = 10,
+				.count = 0,
+				.seeds = NULL,
+			};
+			assert_int_equal(iscc_findseeds_parallel_mis(&nng, &seeds), SCC_ER_OK);
+			assert_int_equal(seeds.count, num_ref_seeds);
+			assert_memory_equal(seeds.seeds, ref_seeds, num_ref_seeds * sizeof(scc_PointIndex));
+			free(seeds.seeds);
+		}
+		scc_set_num_threads(0);
+
+		iscc_free_digraph(&nng);
+	}
+
+	free(order);
+	free(not_excluded);
+	free(is_seed);
+	free(ref_seeds);
+}
+
+
 void scc_ut_findseeds_lexical_withdiag(void** state)
 {
 	(void) state;
@@ -1664,6 +1837,8 @@ int main(void)
 		cmocka_unit_test(scc_ut_findseeds_lexical),
 		cmocka_unit_test(scc_ut_findseeds_inwards),
 		cmocka_unit_test(scc_ut_findseeds_exclusion),
+		cmocka_unit_test(scc_ut_findseeds_exclusion_implicit),
+		cmocka_unit_test(scc_ut_findseeds_parallel_mis),
 		cmocka_unit_test(scc_ut_findseeds_lexical_withdiag),
 		cmocka_unit_test(scc_ut_findseeds_inwards_withdiag),
 		cmocka_unit_test(scc_ut_findseeds_exclusion_withdiag),
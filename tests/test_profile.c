@@ -0,0 +1,259 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <include/scclust.h>
+#include "rand.h"
+
+
+#define SCC_UT_NUM_POINTS 500
+
+
+static scc_DataSet* scc_ut_make_data_set(double* const data_matrix)
+{
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS * 2; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+	}
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 2, SCC_UT_NUM_POINTS * 2, data_matrix, &data_set), SCC_ER_OK);
+	return data_set;
+}
+
+
+static void scc_ut_check_profile_totals(const scc_ClusteringProfile* const profile)
+{
+	double sum_wall_time = 0.0;
+	for (int p = 0; p < SCC_PH_NUM_PHASES; ++p) {
+		assert_false(profile->phases[p].wall_time < 0.0);
+		sum_wall_time += profile->phases[p].wall_time;
+	}
+	assert_false(profile->wall_time < 0.0);
+	assert_false(sum_wall_time > profile->wall_time + 1e-6);
+	assert_false(sum_wall_time < profile->wall_time - 1e-6);
+}
+
+
+void scc_ut_profile_disabled(void** state)
+{
+	(void) state;
+
+	srand(314159);
+	double data_matrix[SCC_UT_NUM_POINTS * 2];
+	scc_DataSet* data_set = scc_ut_make_data_set(data_matrix);
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+
+	scc_ClusteringProfile profile;
+	memset(&profile, 0xAB, sizeof(scc_ClusteringProfile));
+	scc_ClusteringProfile untouched;
+	memcpy(&untouched, &profile, sizeof(scc_ClusteringProfile));
+
+	scc_set_clustering_profile(&profile);
+	scc_set_clustering_profile(NULL);
+
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+
+	assert_memory_equal(&profile, &untouched, sizeof(scc_ClusteringProfile));
+
+	scc_free_data_set(&data_set);
+}
+
+
+void scc_ut_profile_phases(void** state)
+{
+	(void) state;
+
+	srand(271828);
+	double data_matrix[SCC_UT_NUM_POINTS * 2];
+	scc_DataSet* data_set = scc_ut_make_data_set(data_matrix);
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	options.seed_method = SCC_SM_EXCLUSION_ORDER;
+	options.primary_radius = SCC_RM_USE_ESTIMATED;
+
+	scc_Clabel ref_labels[SCC_UT_NUM_POINTS];
+	scc_Clabel labels[SCC_UT_NUM_POINTS];
+	scc_Clustering* clustering;
+
+	options.primary_unassigned_method = SCC_UM_IGNORE;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	uint64_t num_unassigned = 0;
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS; ++i) {
+		num_unassigned += (labels[i] == SCC_CLABEL_NA);
+	}
+	assert_true(num_unassigned > 0);
+
+	options.primary_unassigned_method = SCC_UM_CLOSEST_SEED;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, ref_labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+
+	scc_ClusteringProfile profile;
+	memset(&profile, 0xAB, sizeof(scc_ClusteringProfile));
+	scc_set_clustering_profile(&profile);
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	scc_set_clustering_profile(NULL);
+
+	assert_memory_equal(labels, ref_labels, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	scc_ut_check_profile_totals(&profile);
+
+	// One query per data point when building the NNG
+	assert_int_equal(profile.phases[SCC_PH_NNG].nn_queries, SCC_UT_NUM_POINTS);
+	assert_int_equal(profile.phases[SCC_PH_NNG].dist_evaluations, 0);
+	assert_int_equal(profile.phases[SCC_PH_NNG].arcs_allocated, SCC_UT_NUM_POINTS * 3);
+	assert_true(profile.phases[SCC_PH_NNG].peak_scratch_bytes >= SCC_UT_NUM_POINTS * 3 * sizeof(scc_PointIndex));
+
+	// No type constraints
+	assert_int_equal(profile.phases[SCC_PH_TYPE_UNION].nn_queries, 0);
+	assert_int_equal(profile.phases[SCC_PH_TYPE_UNION].arcs_allocated, 0);
+	assert_int_equal(profile.phases[SCC_PH_TYPE_UNION].peak_scratch_bytes, 0);
+
+	// Seed finding builds the exclusion graph from the NNG
+	assert_int_equal(profile.phases[SCC_PH_SEEDS].nn_queries, 0);
+	assert_int_equal(profile.phases[SCC_PH_SEEDS].dist_evaluations, 0);
+	assert_true(profile.phases[SCC_PH_SEEDS].arcs_allocated > 0);
+	assert_true(profile.phases[SCC_PH_SEEDS].peak_scratch_bytes >= profile.phases[SCC_PH_NNG].peak_scratch_bytes);
+
+	// Radius is estimated from distances between seeds and their neighbors
+	assert_true(profile.phases[SCC_PH_RADIUS].dist_evaluations > 0);
+	assert_int_equal(profile.phases[SCC_PH_RADIUS].nn_queries, 0);
+
+	// Unassigned points are assigned by nearest neighbor search
+	assert_int_equal(profile.phases[SCC_PH_ASSIGN].nn_queries, num_unassigned);
+
+	assert_int_equal(profile.phases[SCC_PH_OTHER].nn_queries, 0);
+	assert_int_equal(profile.phases[SCC_PH_OTHER].arcs_allocated, 0);
+
+	scc_free_data_set(&data_set);
+}
+
+
+void scc_ut_profile_type_constraints(void** state)
+{
+	(void) state;
+
+	srand(161803);
+	double data_matrix[SCC_UT_NUM_POINTS * 2];
+	scc_DataSet* data_set = scc_ut_make_data_set(data_matrix);
+
+	scc_TypeLabel type_labels[SCC_UT_NUM_POINTS];
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS; ++i) {
+		type_labels[i] = (scc_TypeLabel) (i % 2);
+	}
+	const uint32_t type_constraints[2] = { 1, 1 };
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	options.num_types = 2;
+	options.type_constraints = type_constraints;
+	options.len_type_labels = SCC_UT_NUM_POINTS;
+	options.type_labels = type_labels;
+
+	scc_ClusteringProfile profile;
+	scc_set_clustering_profile(&profile);
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	scc_set_clustering_profile(NULL);
+
+	scc_ut_check_profile_totals(&profile);
+
+	// One NNG per type and one for the general size constraint
+	assert_int_equal(profile.phases[SCC_PH_NNG].nn_queries, 3 * SCC_UT_NUM_POINTS);
+	assert_true(profile.phases[SCC_PH_TYPE_UNION].arcs_allocated > 0);
+	assert_true(profile.phases[SCC_PH_TYPE_UNION].peak_scratch_bytes > 0);
+	assert_int_equal(profile.phases[SCC_PH_TYPE_UNION].nn_queries, 0);
+
+	scc_free_data_set(&data_set);
+}
+
+
+void scc_ut_profile_batches(void** state)
+{
+	(void) state;
+
+	srand(141421);
+	double data_matrix[SCC_UT_NUM_POINTS * 2];
+	scc_DataSet* data_set = scc_ut_make_data_set(data_matrix);
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+	options.seed_method = SCC_SM_BATCHES;
+	options.batch_size = 50;
+
+	scc_ClusteringProfile profile;
+	scc_set_clustering_profile(&profile);
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+
+	scc_ut_check_profile_totals(&profile);
+	assert_true(profile.phases[SCC_PH_NNG].nn_queries > 0);
+	assert_true(profile.phases[SCC_PH_NNG].nn_queries <= SCC_UT_NUM_POINTS);
+	for (int p = 0; p < SCC_PH_NUM_PHASES; ++p) {
+		assert_int_equal(profile.phases[p].arcs_allocated, 0);
+		if (p != SCC_PH_NNG) {
+			assert_int_equal(profile.phases[p].nn_queries, 0);
+		}
+	}
+
+	// Failed calls are recorded as well
+	options.size_constraint = SCC_UT_NUM_POINTS + 1;
+	assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_NO_SOLUTION);
+	scc_free_clustering(&clustering);
+	scc_set_clustering_profile(NULL);
+
+	scc_ut_check_profile_totals(&profile);
+	assert_int_equal(profile.phases[SCC_PH_NNG].nn_queries, 0);
+
+	scc_free_data_set(&data_set);
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_profile_disabled),
+		cmocka_unit_test(scc_ut_profile_phases),
+		cmocka_unit_test(scc_ut_profile_type_constraints),
+		cmocka_unit_test(scc_ut_profile_batches),
+	};
+
+	return cmocka_run_group_tests_name("profile.c", test_cases, NULL, NULL);
+}
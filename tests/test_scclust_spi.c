@@ -0,0 +1,183 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <include/scclust.h>
+#include <include/scclust_spi.h>
+#include "data_object_test.h"
+
+
+static size_t scc_ut_num_nn_searches = 0;
+static scc_nearest_neighbor_search scc_ut_wrapped_nn_search = NULL;
+
+
+static bool scc_ut_counting_nn_search(iscc_NNSearchObject* const nn_search_object,
+                                      const size_t len_query_indices,
+                                      const scc_PointIndex* const query_indices,
+                                      const uint32_t k,
+                                      const bool radius_search,
+                                      const double radius,
+                                      size_t* const out_num_ok_queries,
+                                      scc_PointIndex* const out_query_indices,
+                                      scc_PointIndex* const out_nn_indices)
+{
+	++scc_ut_num_nn_searches;
+	return scc_ut_wrapped_nn_search(nn_search_object, len_query_indices, query_indices, k, radius_search,
+	                                radius, out_num_ok_queries, out_query_indices, out_nn_indices);
+}
+
+
+void scc_ut_get_dist_functions(void** state)
+{
+	(void) state;
+
+	const scc_DistFunctions current = scc_get_dist_functions();
+	const scc_DistFunctions kdtree = scc_get_kdtree_dist_functions();
+	const scc_DistFunctions pivot = scc_get_pivot_dist_functions();
+	const scc_DistFunctions def = scc_get_default_dist_functions();
+
+	assert_true(def.check_data_set != NULL);
+	assert_true(def.init_nn_search_object != NULL);
+	assert_true(kdtree.check_data_set == def.check_data_set);
+	assert_true(kdtree.nearest_neighbor_search == def.nearest_neighbor_search);
+	assert_true(pivot.init_max_dist_object == def.init_max_dist_object);
+	assert_true(pivot.nearest_neighbor_search == def.nearest_neighbor_search);
+	assert_true(pivot.init_nn_search_object != kdtree.init_nn_search_object);
+	assert_true(current.nearest_neighbor_search != NULL);
+}
+
+
+void scc_ut_sc_clustering_with_dist_functions(void** state)
+{
+	(void) state;
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 3;
+
+	scc_Clabel ref_labels[100];
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(100, ref_labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(scc_ut_test_data_large, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+
+	scc_DistFunctions counting = scc_get_default_dist_functions();
+	scc_ut_wrapped_nn_search = counting.nearest_neighbor_search;
+	counting.nearest_neighbor_search = scc_ut_counting_nn_search;
+
+	scc_Clabel labels[100];
+	scc_ut_num_nn_searches = 0;
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering_with_dist_functions(scc_ut_test_data_large, &options, clustering, &counting), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_true(scc_ut_num_nn_searches > 0);
+	assert_memory_equal(labels, ref_labels, 100 * sizeof(scc_Clabel));
+
+	// Global functions are not changed
+	scc_ut_num_nn_searches = 0;
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(scc_ut_test_data_large, &options, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_int_equal(scc_ut_num_nn_searches, 0);
+
+	const scc_DistFunctions kdtree = scc_get_kdtree_dist_functions();
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering_with_dist_functions(scc_ut_test_data_large, &options, clustering, &kdtree), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_memory_equal(labels, ref_labels, 100 * sizeof(scc_Clabel));
+
+	const scc_DistFunctions pivot = scc_get_pivot_dist_functions();
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering_with_dist_functions(scc_ut_test_data_large, &options, clustering, &pivot), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_memory_equal(labels, ref_labels, 100 * sizeof(scc_Clabel));
+
+	scc_DistFunctions invalid = scc_get_default_dist_functions();
+	invalid.get_max_dist = NULL;
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering_with_dist_functions(scc_ut_test_data_large, &options, clustering, &invalid), SCC_ER_INVALID_INPUT);
+	assert_int_equal(scc_sc_clustering_with_dist_functions(scc_ut_test_data_large, &options, clustering, NULL), SCC_ER_INVALID_INPUT);
+	scc_free_clustering(&clustering);
+}
+
+
+void scc_ut_hierarchical_clustering_with_dist_functions(void** state)
+{
+	(void) state;
+
+	scc_Clabel ref_labels[100];
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(100, ref_labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_hierarchical_clustering(scc_ut_test_data_large, 5, true, clustering), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+
+	const scc_DistFunctions def = scc_get_default_dist_functions();
+	scc_Clabel labels[100];
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_hierarchical_clustering_with_dist_functions(scc_ut_test_data_large, 5, true, clustering, &def), SCC_ER_OK);
+	scc_free_clustering(&clustering);
+	assert_memory_equal(labels, ref_labels, 100 * sizeof(scc_Clabel));
+
+	assert_int_equal(scc_init_empty_clustering(100, labels, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_hierarchical_clustering_with_dist_functions(scc_ut_test_data_large, 5, true, clustering, NULL), SCC_ER_INVALID_INPUT);
+	scc_free_clustering(&clustering);
+}
+
+
+void scc_ut_get_clustering_stats_with_dist_functions(void** state)
+{
+	(void) state;
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 4;
+
+	scc_Clustering* clustering;
+	assert_int_equal(scc_init_empty_clustering(100, NULL, &clustering), SCC_ER_OK);
+	assert_int_equal(scc_sc_clustering(scc_ut_test_data_large, &options, clustering), SCC_ER_OK);
+
+	scc_ClusteringStats ref_stats;
+	assert_int_equal(scc_get_clustering_stats(scc_ut_test_data_large, clustering, &ref_stats), SCC_ER_OK);
+
+	const scc_DistFunctions kdtree = scc_get_kdtree_dist_functions();
+	scc_ClusteringStats stats;
+	assert_int_equal(scc_get_clustering_stats_with_dist_functions(scc_ut_test_data_large, clustering, &stats, &kdtree), SCC_ER_OK);
+	assert_memory_equal(&stats, &ref_stats, sizeof(scc_ClusteringStats));
+
+	assert_int_equal(scc_get_clustering_stats_with_dist_functions(scc_ut_test_data_large, clustering, &stats, NULL), SCC_ER_INVALID_INPUT);
+
+	scc_free_clustering(&clustering);
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_get_dist_functions),
+		cmocka_unit_test(scc_ut_sc_clustering_with_dist_functions),
+		cmocka_unit_test(scc_ut_hierarchical_clustering_with_dist_functions),
+		cmocka_unit_test(scc_ut_get_clustering_stats_with_dist_functions),
+	};
+
+	return cmocka_run_group_tests_name("scclust_spi.c", test_cases, NULL, NULL);
+}
@@ -0,0 +1,407 @@
+/* =============================================================================
+ * scclust -- A C library for size-constrained clustering
+ * https://github.com/fsavje/scclust
+ *
+ * Copyright (C) 2015-2017  Fredrik Savje -- http://fredriksavje.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see http://www.gnu.org/licenses/
+ * ========================================================================== */
+
+#include "init_test.h"
+#include <stdbool.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <include/scclust.h>
+#include <src/dist_search_imp.h>
+#include <src/threads.h>
+#include "rand.h"
+
+
+#define SCC_UT_NUM_POINTS 1000
+
+
+static void scc_ut_run_search(scc_DataSet* const data_set,
+                              const bool kd_tree,
+                              const uint32_t num_threads,
+                              const size_t len_search_indices,
+                              const scc_PointIndex* const search_indices,
+                              const size_t len_query_indices,
+                              const scc_PointIndex* const query_indices,
+                              const uint32_t k,
+                              const bool radius_search,
+                              const double radius,
+                              size_t* const out_num_ok,
+                              scc_PointIndex* const out_query,
+                              scc_PointIndex* const out_nn)
+{
+	scc_set_num_threads(num_threads);
+	iscc_NNSearchObject* nn_search;
+	if (kd_tree) {
+		assert_true(iscc_imp_init_kdtree_nn_search_object(data_set, len_search_indices, search_indices, &nn_search));
+	} else {
+		assert_true(iscc_imp_init_nn_search_object(data_set, len_search_indices, search_indices, &nn_search));
+	}
+	assert_true(iscc_imp_nearest_neighbor_search(nn_search, len_query_indices, query_indices, k, radius_search, radius,
+	                                             out_num_ok, out_query, out_nn));
+	assert_true(iscc_imp_close_nn_search_object(&nn_search));
+	scc_set_num_threads(0);
+}
+
+
+static void scc_ut_compare_threaded(scc_DataSet* const data_set,
+                                    const bool kd_tree,
+                                    const size_t len_search_indices,
+                                    const scc_PointIndex* const search_indices,
+                                    const size_t len_query_indices,
+                                    const scc_PointIndex* const query_indices,
+                                    const uint32_t k,
+                                    const bool radius_search,
+                                    const double radius)
+{
+	scc_PointIndex* const ref_query_out = malloc(sizeof(scc_PointIndex[len_query_indices]));
+	scc_PointIndex* const ref_nn_out = malloc(sizeof(scc_PointIndex[len_query_indices * k]));
+	scc_PointIndex* const thr_query_out = malloc(sizeof(scc_PointIndex[len_query_indices]));
+	scc_PointIndex* const thr_nn_out = malloc(sizeof(scc_PointIndex[len_query_indices * k]));
+
+	size_t ref_num_ok = 0;
+	scc_ut_run_search(data_set, kd_tree, 1, len_search_indices, search_indices, len_query_indices, query_indices,
+	                  k, radius_search, radius, &ref_num_ok, ref_query_out, ref_nn_out);
+
+	const uint32_t thread_counts[3] = { 2, 3, 8 };
+	for (size_t t = 0; t < 3; ++t) {
+		size_t thr_num_ok = 0;
+		scc_ut_run_search(data_set, kd_tree, thread_counts[t], len_search_indices, search_indices, len_query_indices, query_indices,
+		                  k, radius_search, radius, &thr_num_ok, thr_query_out, thr_nn_out);
+		assert_int_equal(thr_num_ok, ref_num_ok);
+		if (ref_num_ok > 0) {
+			assert_memory_equal(thr_query_out, ref_query_out, ref_num_ok * sizeof(scc_PointIndex));
+			assert_memory_equal(thr_nn_out, ref_nn_out, ref_num_ok * k * sizeof(scc_PointIndex));
+		}
+
+		// Query indices may be overwritten by the output
+		if (query_indices != NULL) {
+			memcpy(thr_query_out, query_indices, len_query_indices * sizeof(scc_PointIndex));
+			scc_ut_run_search(data_set, kd_tree, thread_counts[t], len_search_indices, search_indices, len_query_indices, thr_query_out,
+			                  k, radius_search, radius, &thr_num_ok, thr_query_out, thr_nn_out);
+			assert_int_equal(thr_num_ok, ref_num_ok);
+			if (ref_num_ok > 0) {
+				assert_memory_equal(thr_query_out, ref_query_out, ref_num_ok * sizeof(scc_PointIndex));
+				assert_memory_equal(thr_nn_out, ref_nn_out, ref_num_ok * k * sizeof(scc_PointIndex));
+			}
+		}
+	}
+
+	free(ref_query_out);
+	free(ref_nn_out);
+	free(thr_query_out);
+	free(thr_nn_out);
+}
+
+
+void scc_ut_num_threads(void** state)
+{
+	(void) state;
+
+	scc_set_num_threads(3);
+	#ifdef _OPENMP
+		assert_int_equal(scc_get_num_threads(), 3);
+	#else
+		assert_int_equal(scc_get_num_threads(), 1);
+	#endif
+
+	scc_set_num_threads(UINT32_MAX);
+	#ifdef _OPENMP
+		assert_int_equal(scc_get_num_threads(), INT_MAX);
+	#else
+		assert_int_equal(scc_get_num_threads(), 1);
+	#endif
+
+	scc_set_num_threads(0);
+	assert_true(scc_get_num_threads() >= 1);
+}
+
+
+void scc_ut_thread_local_num_threads(void** state)
+{
+	(void) state;
+
+	scc_set_num_threads(5);
+
+	#ifdef _OPENMP
+		uint32_t num_threads_res[2] = { 0, 0 };
+
+		ISCC_OMP_PRAGMA(omp parallel num_threads(2))
+		{
+			const uint32_t thread = iscc_get_thread_num();
+			if (thread == 1) {
+				scc_set_num_threads(7);
+			}
+			ISCC_OMP_PRAGMA(omp barrier)
+			if (thread < 2) {
+				num_threads_res[thread] = scc_get_num_threads();
+			}
+			if (thread == 1) {
+				scc_set_num_threads(0);
+			}
+		}
+
+		// The master thread keeps its setting
+		assert_int_equal(num_threads_res[0], 5);
+		if (num_threads_res[1] > 0) {
+			assert_int_equal(num_threads_res[1], 7);
+		}
+		assert_int_equal(scc_get_num_threads(), 5);
+	#else
+		assert_int_equal(scc_get_num_threads(), 1);
+	#endif
+
+	scc_set_num_threads(0);
+}
+
+
+void scc_ut_threaded_nn_search(void** state)
+{
+	(void) state;
+
+	srand(314159);
+
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 3]));
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS * 3; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+	}
+
+	scc_PointIndex* const indices = malloc(sizeof(scc_PointIndex[SCC_UT_NUM_POINTS]));
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS; ++i) {
+		indices[i] = (scc_PointIndex) ((i * 7919) % SCC_UT_NUM_POINTS);
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 3, SCC_UT_NUM_POINTS * 3, data_matrix, &data_set), SCC_ER_OK);
+
+	for (int kd_tree = 0; kd_tree < 2; ++kd_tree) {
+		const uint32_t k_values[3] = { 1, 4, 17 };
+		for (size_t k_i = 0; k_i < 3; ++k_i) {
+			const uint32_t k = k_values[k_i];
+			scc_ut_compare_threaded(data_set, kd_tree, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, k, false, 0.0);
+			scc_ut_compare_threaded(data_set, kd_tree, SCC_UT_NUM_POINTS, NULL, SCC_UT_NUM_POINTS, NULL, k, true, 1.0);
+			scc_ut_compare_threaded(data_set, kd_tree, 300, indices, 500, indices + 200, k, false, 0.0);
+			scc_ut_compare_threaded(data_set, kd_tree, 300, indices, 500, indices + 200, k, true, 1.5);
+			scc_ut_compare_threaded(data_set, kd_tree, SCC_UT_NUM_POINTS, NULL, 20, indices, k, true, 1.5);
+		}
+	}
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+	free(indices);
+}
+
+
+void scc_ut_threaded_clustering(void** state)
+{
+	(void) state;
+
+	srand(271828);
+
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 2]));
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS * 2; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 2, SCC_UT_NUM_POINTS * 2, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 4;
+
+	scc_Clabel ref_labels[SCC_UT_NUM_POINTS];
+	scc_Clabel labels[SCC_UT_NUM_POINTS];
+	scc_Clustering* clustering;
+
+	const scc_SeedMethod seed_methods[2] = { SCC_SM_LEXICAL, SCC_SM_PARALLEL_MIS };
+	for (size_t m = 0; m < 2; ++m) {
+		options.seed_method = seed_methods[m];
+
+		scc_set_num_threads(1);
+		assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, ref_labels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+		scc_free_clustering(&clustering);
+
+		scc_set_num_threads(4);
+		assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, labels, &clustering), SCC_ER_OK);
+		assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+		bool is_OK = false;
+		assert_int_equal(scc_check_clustering(clustering, &options, &is_OK), SCC_ER_OK);
+		assert_true(is_OK);
+		scc_free_clustering(&clustering);
+		scc_set_num_threads(0);
+
+		assert_memory_equal(labels, ref_labels, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+	}
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_threaded_batch_clustering(void** state)
+{
+	(void) state;
+
+	srand(314159);
+
+	double* const data_matrix = malloc(sizeof(double[SCC_UT_NUM_POINTS * 2]));
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS * 2; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(SCC_UT_NUM_POINTS, 2, SCC_UT_NUM_POINTS * 2, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_PointIndex primary_data_points[SCC_UT_NUM_POINTS / 3];
+	for (size_t i = 0; i < SCC_UT_NUM_POINTS / 3; ++i) {
+		primary_data_points[i] = (scc_PointIndex) (3 * i + 1);
+	}
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.seed_method = SCC_SM_BATCHES;
+
+	scc_Clabel ref_labels[SCC_UT_NUM_POINTS];
+	scc_Clabel labels[SCC_UT_NUM_POINTS];
+	scc_Clustering* clustering;
+
+	const uint32_t batch_sizes[4] = { 1, 7, 100, 0 };
+	for (int kd_tree = 0; kd_tree < 2; ++kd_tree) {
+		if (kd_tree == 1) assert_true(scc_set_kdtree_nn_search());
+		for (size_t b = 0; b < 4; ++b) {
+			for (int setting = 0; setting < 8; ++setting) {
+				options.batch_size = batch_sizes[b];
+				options.size_constraint = 3 + (uint32_t) (setting % 2);
+				options.primary_unassigned_method = ((setting / 2) % 2 == 0) ? SCC_UM_IGNORE : SCC_UM_ANY_NEIGHBOR;
+				options.seed_radius = (setting / 4 == 0) ? SCC_RM_NO_RADIUS : SCC_RM_USE_SUPPLIED;
+				options.seed_supplied_radius = 0.4;
+				options.len_primary_data_points = (b % 2 == 0) ? 0 : SCC_UT_NUM_POINTS / 3;
+				options.primary_data_points = (b % 2 == 0) ? NULL : primary_data_points;
+
+				scc_set_num_threads(1);
+				assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, ref_labels, &clustering), SCC_ER_OK);
+				assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+				scc_ClusteringStats ref_stats;
+				assert_int_equal(scc_get_clustering_stats(data_set, clustering, &ref_stats), SCC_ER_OK);
+				scc_free_clustering(&clustering);
+
+				scc_set_num_threads(4);
+				assert_int_equal(scc_init_empty_clustering(SCC_UT_NUM_POINTS, labels, &clustering), SCC_ER_OK);
+				assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+				scc_ClusteringStats stats;
+				assert_int_equal(scc_get_clustering_stats(data_set, clustering, &stats), SCC_ER_OK);
+				scc_free_clustering(&clustering);
+				scc_set_num_threads(0);
+
+				assert_int_equal(stats.num_clusters, ref_stats.num_clusters);
+				assert_memory_equal(labels, ref_labels, SCC_UT_NUM_POINTS * sizeof(scc_Clabel));
+			}
+		}
+	}
+
+	assert_true(scc_ut_init_tests());
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+}
+
+
+void scc_ut_threaded_hierarchical_clustering(void** state)
+{
+	(void) state;
+
+	srand(161803);
+
+	const size_t num_points = 4 * SCC_UT_NUM_POINTS;
+	double* const data_matrix = malloc(sizeof(double[num_points * 3]));
+	for (size_t i = 0; i < num_points * 3; ++i) {
+		data_matrix[i] = scc_rand_double(0.0, 10.0);
+	}
+
+	scc_DataSet* data_set;
+	assert_int_equal(scc_init_data_set(num_points, 3, num_points * 3, data_matrix, &data_set), SCC_ER_OK);
+
+	scc_Clabel* const ref_labels = malloc(sizeof(scc_Clabel[num_points]));
+	scc_Clabel* const labels = malloc(sizeof(scc_Clabel[num_points]));
+	scc_Clustering* clustering;
+
+	scc_ClusterOptions options = scc_get_default_options();
+	options.size_constraint = 20;
+
+	const uint32_t size_constraints[3] = { 2, 3, 9 };
+	for (int kd_tree = 0; kd_tree < 2; ++kd_tree) {
+		// The parallel version uses the tree only for splits made before the parallel region
+		if (kd_tree == 1) assert_true(scc_set_kdtree_nn_search());
+		for (size_t s = 0; s < 3; ++s) {
+			for (int batch_assign = 0; batch_assign < 2; ++batch_assign) {
+				for (int refine = 0; refine < 2; ++refine) {
+					size_t ref_num_clusters = 0;
+					for (uint32_t num_threads = 1; num_threads <= 4; num_threads += 3) {
+						scc_Clabel* const out_labels = (num_threads == 1) ? ref_labels : labels;
+						scc_set_num_threads(num_threads);
+						assert_int_equal(scc_init_empty_clustering(num_points, out_labels, &clustering), SCC_ER_OK);
+						if (refine == 1) {
+							// Refine a coarser clustering, which also leaves some points unassigned
+							options.primary_unassigned_method = SCC_UM_IGNORE;
+							assert_int_equal(scc_sc_clustering(data_set, &options, clustering), SCC_ER_OK);
+						}
+						assert_int_equal(scc_hierarchical_clustering(data_set, size_constraints[s], (batch_assign == 1), clustering), SCC_ER_OK);
+						scc_ClusteringStats stats;
+						assert_int_equal(scc_get_clustering_stats(data_set, clustering, &stats), SCC_ER_OK);
+						assert_true(stats.min_cluster_size >= size_constraints[s]);
+						if (num_threads == 1) {
+							ref_num_clusters = stats.num_clusters;
+						} else {
+							assert_int_equal(stats.num_clusters, ref_num_clusters);
+						}
+						scc_free_clustering(&clustering);
+						scc_set_num_threads(0);
+					}
+					assert_memory_equal(labels, ref_labels, num_points * sizeof(scc_Clabel));
+				}
+			}
+		}
+	}
+
+	assert_true(scc_ut_init_tests());
+
+	scc_free_data_set(&data_set);
+	free(data_matrix);
+	free(ref_labels);
+	free(labels);
+}
+
+
+int main(void)
+{
+	if(!scc_ut_init_tests()) return 1;
+
+	const struct CMUnitTest test_cases[] = {
+		cmocka_unit_test(scc_ut_num_threads),
+		cmocka_unit_test(scc_ut_thread_local_num_threads),
+		cmocka_unit_test(scc_ut_threaded_nn_search),
+		cmocka_unit_test(scc_ut_threaded_clustering),
+		cmocka_unit_test(scc_ut_threaded_batch_clustering),
+		cmocka_unit_test(scc_ut_threaded_hierarchical_clustering),
+	};
+
+	return cmocka_run_group_tests_name("threads.c", test_cases, NULL, NULL);
+}